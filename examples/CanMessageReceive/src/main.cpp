@@ -1,12 +1,22 @@
 #include <Arduino.h>
 #include <CANMessage.h>
+#include <CANBus.h>
+#include <CANSupervisor.h>
 #include <MCP2515.h>
 
-// Create Instances of the CAN-Controller and 2 Messages
+// Create Instances of the CAN-Controller, the Receive-Dispatcher and 2 Messages
 MCP2515 MCP2515Module;
+CANBus Bus;
+CANSupervisor Supervisor;
 CANMessage TimeCounter;
 CANMessage MessageCounter;
 
+// Latest-Value-Mailbox for the TimeCounter (only the newest Time is of interest)
+CANMailbox TimeCounterMailbox;
+
+// Receive-FIFO for the MessageCounter, so Frames they arrive before the loop() read the previous one are not lost
+CANReceiveFifo<4> MessageCounterFifo;
+
 // Definition of Chip-Select-Pin for the SPI-Communication
 uint8_t CS_Pin = 53;
 
@@ -22,22 +32,24 @@ uint16_t counter_down;
 uint16_t counter_down_overflow;
 
 
-// Interrupt Routine (not really mature at the moment)
+// Called by the Supervisor when a Message is not received within its Timeout (e.g. the Sender is dead)
+void onTimeout(CANMessage &message){
+  Serial.print("Timeout of Message 0x");
+  Serial.println(message.getID(), HEX);
+}
+
+// Interrupt Routine
 void onReceive(){
 
   // It is recommend that Interrupt service routines should generally be as short and fast as possible.
-  // However, timing has not been given much importance so far.
-  // So when you receive Messages in short time cycles it is possible that some Messages are dropped or the Serial print is lagging.
-  // Actually, when you use the default setting in the CanMessageSend-Example it is also possible that TimeCounter-Messages are not recognized.
-  // Especially when both Messages are send simultaniously.
+  // The Dispatcher reads each filled Receive-Buffer of the MCP2515 exactly once and routes the Frame to the registered Message.
+  // The Acceptance-Filters reject most other Frames already in the MCP2515,
+  // Frames without a registered Message they still pass are discarded, so no releaseReceiveBuffer() is nessecary.
   //
-  // So keep in mind. THIS Interrupt-Routine is kept really simple.
-  TimeCounter.checkReceive();
-  MessageCounter.checkReceive();
-
-  // Only nessecary when other Messages are also provided on the CAN-Bus they doesn't match with the defined Messages.
-  MCP2515Module.releaseReceiveBuffer(0);
-  MCP2515Module.releaseReceiveBuffer(1);
+  // Keep in mind that a Message without a Receive-FIFO still rejects a new Frame as long as the Data of the previous Frame is not read in the loop().
+  // The TimeCounter has a Mailbox attached, so it always keeps the newest Frame.
+  // The MessageCounter has a FIFO attached, so up to 4 Frames can be buffered (further Frames are counted as Overruns).
+  Bus.dispatch();
 }
 
 
@@ -98,6 +110,27 @@ void setup() {
   TimeCounter.init((uint32_t) 0xA74BF55, 8, false, CANMESSAGE_FRAME_EXTENDED, CANMESSAGE_DIRECTION_RECEIVE, MCP2515Module);
   MessageCounter.init((uint32_t) 0x1AB, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE, MCP2515Module);
 
+  TimeCounter.attachMailbox(TimeCounterMailbox);
+  MessageCounter.attachFifo(MessageCounterFifo);
+
+  // Register the Messages at the Receive-Dispatcher
+  Bus.init(MCP2515Module, CS_Pin);
+  Bus.registerMessage(TimeCounter);
+  Bus.registerMessage(MessageCounter);
+
+  // Program the Acceptance-Filters of the MCP2515, so only Frames of the registered Messages raise an Interrupt
+  if (!Bus.applyFilters())
+  {
+    Serial.print("ApplyFilters-Error: 0x");
+    Serial.println(Bus.getLastCanError(), HEX);
+  }
+
+  // Supervise the Messages with their Cycle-Time (Timeout = 3 Cycles), dispatch() stores the Time of each Frame
+  Supervisor.init(Bus);
+  Supervisor.watch(TimeCounter, 100);
+  Supervisor.watch(MessageCounter, 1000);
+  Supervisor.setCallback(onTimeout);
+
   pinMode(IntPin, INPUT);
 
   // Prepare SPI-Communication for Interrupts
@@ -105,26 +138,23 @@ void setup() {
 
   // Define the Interrupt
   attachInterrupt(digitalPinToInterrupt(IntPin), onReceive, LOW);
+
+  Supervisor.start();
 }
 
 void loop() {
+  // Check the Receive-Timeouts
+  Supervisor.tick();
 
-  // Check if Data is in the Message-Buffer of the Message TimeCounter
-  if (TimeCounter.dataAvailable())
-  {
-    time_s = 0x00000000;
-    time_ms = 0x00000000;
 
-    // Get the Values from the Message-Buffer
-    time_s = time_s << 8 | TimeCounter.getDataByte();
-    time_s = time_s << 8 | TimeCounter.getDataByte();
-    time_s = time_s << 8 | TimeCounter.getDataByte();
-    time_s = time_s << 8 | TimeCounter.getDataByte();
+  // Check if the Mailbox of the Message TimeCounter was updated and copy all 8 Bytes at once
+  uint8_t TimeData[8];
 
-    time_ms = time_ms << 8 | TimeCounter.getDataByte();
-    time_ms = time_ms << 8 | TimeCounter.getDataByte();
-    time_ms = time_ms << 8 | TimeCounter.getDataByte();
-    time_ms = time_ms << 8 | TimeCounter.getDataByte();
+  if (TimeCounter.readLatest(TimeData))
+  {
+    // Get the Values from the Payload (Big-Endian)
+    time_s = canPayloadGet<uint32_t>(&TimeData[0], CANMESSAGE_BYTEORDER_MOTOROLA);
+    time_ms = canPayloadGet<uint32_t>(&TimeData[4], CANMESSAGE_BYTEORDER_MOTOROLA);
 
     // and print it.
     Serial.print("Time [s]\t");
@@ -136,23 +166,12 @@ void loop() {
   // Check if Data is in the Message-Buffer of the Message MessageCounter
   if (MessageCounter.dataAvailable())
   {
-    counter_up = 0x0000;
-    counter_up_overflow = 0x0000;
-    counter_down = 0x0000;
-    counter_down_overflow = 0x0000;
-
-    // Get the Values from the Message-Buffer
-    counter_up = counter_up << 8 | MessageCounter.getDataByte();
-    counter_up = counter_up << 8 | MessageCounter.getDataByte();
-
-    counter_up_overflow = counter_up_overflow << 8 | MessageCounter.getDataByte();
-    counter_up_overflow = counter_up_overflow << 8 | MessageCounter.getDataByte();
-
-    counter_down = counter_down << 8 | MessageCounter.getDataByte();
-    counter_down = counter_down << 8 | MessageCounter.getDataByte();
-
-    counter_down_overflow = counter_down_overflow << 8 | MessageCounter.getDataByte();
-    counter_down_overflow = counter_down_overflow << 8 | MessageCounter.getDataByte();
+    // Get the Values from the Message-Buffer (Big-Endian) and release it for the next Frame
+    counter_up = MessageCounter.get<uint16_t>(0);
+    counter_up_overflow = MessageCounter.get<uint16_t>(2);
+    counter_down = MessageCounter.get<uint16_t>(4);
+    counter_down_overflow = MessageCounter.get<uint16_t>(6);
+    MessageCounter.releaseData();
 
     // and print it.
     Serial.print("Counter Up\t");
@@ -1,24 +1,71 @@
 #include <Arduino.h>
 #include <CANMessage.h>
+#include <CANBus.h>
+#include <CANScheduler.h>
 #include <MCP2515.h>
 
-// Create Instances of the CAN-Controller and 2 Messages
+// Create Instances of the CAN-Controller, the Bus with the Transmit-Queue and 2 Messages
 MCP2515 MCP2515Module;
+CANBus Bus;
+CANScheduler Scheduler;
 CANMessage TimeCounter;
 CANMessage MessageCounter;
 
 // Definition of Chip-Select-Pin for the SPI-Communication
 uint8_t CS_Pin = 17;
 
+// Definition of Interrupt-Pin for Interrupt-Handling
+uint8_t IntPin = 3;
+
 // Initialize the Message-Counter
 uint16_t counter_up=0;
 uint16_t counter_up_overflow=0;
 uint16_t counter_down=4095;
 uint16_t counter_down_overflow=0;
 
-// Initialize booleans for easyer Message-Handling
-bool TimeCounterFilled=false;
-bool MessageCounterFilled=false;
+// Last reported Misses of the Scheduler
+uint16_t ReportedMisses=0;
+
+// Called by the Scheduler each 100ms before TimeCounter is sent
+void fillTimeCounter(CANMessage &message){
+  // fill the DataBuffer of the Message with the current Time (Big-Endian).
+  message.put<uint32_t>(0, millis()/1000);
+  message.put<uint32_t>(4, millis() % 1000);
+}
+
+// Called by the Scheduler each 1000ms before MessageCounter is sent
+void fillMessageCounter(CANMessage &message){
+  // Calculate the Data
+  if (counter_up > 4094)
+  {
+    counter_up = 0;
+    counter_up_overflow++;
+  } else {
+    counter_up++;
+  }
+
+  if (counter_down < 1)
+  {
+    counter_down = 4095;
+    counter_down_overflow++;
+  } else {
+    counter_down--;
+  }
+
+  // and fill the DataBuffer of the Message with the calculated Data (Big-Endian).
+  message.put<uint16_t>(0, counter_up);
+  message.put<uint16_t>(2, counter_up_overflow);
+  message.put<uint16_t>(4, counter_down);
+  message.put<uint16_t>(6, counter_down_overflow);
+}
+
+// Interrupt Routine
+void onInterrupt(){
+
+  // When a Transmission is finished the Bus refills the free Transmit-Buffer with the next queued Frame (lowest ID first).
+  Bus.dispatch();
+}
+
 
 void setup() {
   // Initialize Serial for Debug
@@ -59,87 +106,39 @@ void setup() {
   // Create CAN-Messages
   TimeCounter.init((uint32_t) 0xA74BF55, 8, false, CANMESSAGE_FRAME_EXTENDED, CANMESSAGE_DIRECTION_TRANSMIT, MCP2515Module);
   MessageCounter.init((uint32_t) 0x1AB, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT, MCP2515Module);
-}
 
-void loop() {
-  uint32_t time_ms = millis() % 1000;
-  uint32_t time_s = millis()/1000;
-  
-  // Each 100ms (when Buffer of Message TimeCounter is not filled)
-  if ((millis() % 100) == 0 && TimeCounterFilled == false)
-  {
-    // fill the DataBuffer of the Message with the calculated Data.
-    TimeCounter.addDataByte((uint8_t)((((time_s >> 8) >> 8) >> 8) & 0xFF), 0);
-    TimeCounter.addDataByte((uint8_t)(((time_s >> 8) >> 8) & 0xFF), 1);
-    TimeCounter.addDataByte((uint8_t)((time_s >> 8) & 0xFF), 2);
-    TimeCounter.addDataByte((uint8_t)(time_s & 0xFF), 3);
-
-    TimeCounter.addDataByte((uint8_t)((((time_ms >> 8) >> 8) >> 8) & 0xFF), 4);
-    TimeCounter.addDataByte((uint8_t)(((time_ms >> 8) >> 8) & 0xFF), 5);
-    TimeCounter.addDataByte((uint8_t)((time_ms >> 8) & 0xFF), 6);
-    TimeCounter.addDataByte((uint8_t)(time_ms & 0xFF), 7);
-
-  } else if ((millis() % 100) != 0 && TimeCounterFilled == true)
-  {
-    TimeCounterFilled = false;
-  }
+  // Register the Messages at the Bus, so send() only adds the Frame to the Transmit-Queue and returns immediately
+  Bus.init(MCP2515Module, CS_Pin);
+  Bus.registerMessage(TimeCounter);
+  Bus.registerMessage(MessageCounter);
+  Bus.enableTransmitInterrupts();
 
-  // Each 1000ms (when Buffer of Message MessageCounter is not filled)
-  if ((millis() % 1000) == 0 && MessageCounterFilled == false)
-  {
-    // Calculate the Data
-    if (counter_up > 4094)
-    {
-      counter_up = 0;
-      counter_up_overflow++;
-    } else {
-      counter_up++;
-    }
-    
-    if (counter_down < 1)
-    {
-      counter_down = 4095;
-      counter_down_overflow++;
-    } else {
-      counter_down--;
-    }
-
-    // and fill the DataBuffer of the Message with the calculated Data.
-    MessageCounter.addDataByte((uint8_t)((counter_up >> 8) & 0xFF), 0);
-    MessageCounter.addDataByte((uint8_t)(counter_up & 0xFF), 1);
-    MessageCounter.addDataByte((uint8_t)((counter_up_overflow >> 8) & 0xFF), 2);
-    MessageCounter.addDataByte((uint8_t)(counter_up_overflow & 0xFF), 3);
-    MessageCounter.addDataByte((uint8_t)((counter_down >> 8) & 0xFF), 4);
-    MessageCounter.addDataByte((uint8_t)(counter_down & 0xFF), 5);
-    MessageCounter.addDataByte((uint8_t)((counter_down_overflow >> 8) & 0xFF), 6);
-    MessageCounter.addDataByte((uint8_t)(counter_down_overflow & 0xFF), 7);
-
-  } else if ((millis() % 1000) != 0 && MessageCounterFilled == true)
-  {
-    MessageCounterFilled = false;
-  }
+  // Send TimeCounter each 100ms and MessageCounter each 1000ms, the Callbacks fill the Payload before each Transmission
+  Scheduler.add(TimeCounter, 100, fillTimeCounter);
+  Scheduler.add(MessageCounter, 1000, fillMessageCounter);
 
-  // Check if Message is Ready to send (Checks if all DataBuffer are filled with Data)
-  if (TimeCounter.messageSendReady())
-  {
-    if (!TimeCounter.send())
-    {
-      Serial.print("TimeCounter send-Error: 0x");
-      Serial.println(TimeCounter.getLastCanError(), HEX);
-    } else {
-      Serial.println("TimeCounter send.");
-    }
-  }
+  pinMode(IntPin, INPUT);
+
+  // Prepare SPI-Communication for Interrupts
+  SPI.usingInterrupt(digitalPinToInterrupt(IntPin));
+
+  // Define the Interrupt
+  attachInterrupt(digitalPinToInterrupt(IntPin), onInterrupt, LOW);
+
+  Scheduler.start();
+}
+
+void loop() {
+  // Sends the due Messages, the Offsets are chosen by the Scheduler so both Messages never reach the Bus at the same Time.
+  // An Error only occurs when the Transmit-Queue is full, no retry is nessecary when all Transmit-Buffers are busy.
+  Scheduler.tick();
 
-  // Check if Message is Ready to send (Checks if all DataBuffer are filled with Data)
-  if (MessageCounter.messageSendReady())
+  if (Scheduler.getMisses() != ReportedMisses)
   {
-    if (!MessageCounter.send())
-    {
-      Serial.print("MessageCounter send-Error: 0x");
-      Serial.println(MessageCounter.getLastCanError(), HEX);
-    } else {
-      Serial.println("MessageCounter send.");
-    }
+    ReportedMisses = Scheduler.getMisses();
+    Serial.print("Scheduler Misses: ");
+    Serial.print(ReportedMisses);
+    Serial.print(" last Error: 0x");
+    Serial.println(Scheduler.getLastCanError(), HEX);
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,300 @@
+/**
+ * @file AsyncBenchmark.cpp
+ * @author MH-Tobi
+ * @brief Host-Benchmark of the Coroutine-API: CPU-Load of idle Waiters compared with a Polling-Loop, Cost of a Wake-Up by ID and Round-Trips.
+ *
+ * All Tests run on one Loopback-Controller. The Waiters are spread over the registered Messages (one Wait-List per ID).
+ * Build and run on Linux with: make run
+ *
+ * Usage: AsyncBenchmark [waiters] [ms] [frames]
+ *  - waiters  Coroutines waiting for a Frame (default 1000)
+ *  - ms       Duration of the Idle-Test in ms (default 200)
+ *  - frames   Injected Frames of the Wake-Up-Test and Round-Trips (default 10000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <vector>
+#include "CANAsync.h"
+
+#define BENCH_MESSAGES      CANBUS_MAX_MESSAGES
+#define BENCH_FIRST_ID      0x200
+#define BENCH_TICK_MS       10      // Period of the Timer-Coroutine in the Idle-Test
+
+
+/**
+ * @brief Reception-Messages with one ID each, registered at a Bus with its Loop.
+ */
+struct Node
+{
+    CANLoopbackController Controller;
+    CANBus Bus;
+    CANAsyncBus Async;
+    CANMessage Messages[BENCH_MESSAGES];
+
+    Node()
+    {
+        Controller.init(500E3);
+        Bus.init(Controller, 0);
+
+        for (uint8_t i = 0; i < BENCH_MESSAGES; i++)
+        {
+            Messages[i].init(BENCH_FIRST_ID + i, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE, Controller);
+            Bus.registerMessage(Messages[i]);
+        }
+        Async.init(Bus, Controller);
+    }
+};
+
+static double wallUs()
+{
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+static double cpuUs()
+{
+    timespec Time;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &Time);
+    return Time.tv_sec * 1e6 + Time.tv_nsec / 1000.0;
+}
+
+/**
+ * @brief Waits for the Frames of one Message, the first resumed Waiter releases the Data.
+ */
+static CANTask waitFrames(CANAsyncBus &async, CANMessage &message, uint32_t &woken)
+{
+    while (true)
+    {
+        CANMessage *Received = co_await async.receive(message);
+
+        if (Received != NULL)
+        {
+            woken++;
+            message.releaseData();
+        }
+    }
+}
+
+/**
+ * @brief Wakes up each BENCH_TICK_MS until the Duration is over.
+ */
+static CANTask tick(CANAsyncBus &async, uint32_t duration)
+{
+    for (uint32_t Time = 0; Time < duration; Time += BENCH_TICK_MS)
+    {
+        co_await async.delay(BENCH_TICK_MS);
+    }
+}
+
+/**
+ * @brief CPU-Time of the idle Loop with waiting Coroutines and of a Polling-Loop over the same Messages.
+ */
+static void benchmarkIdle(uint32_t waiters, uint32_t duration)
+{
+    Node *Test = new Node();
+    std::vector<CANTask> Tasks;
+    uint32_t Woken = 0;
+
+    for (uint32_t i = 0; i < waiters; i++)
+    {
+        Tasks.push_back(waitFrames(Test->Async, Test->Messages[i % BENCH_MESSAGES], Woken));
+    }
+
+    double Wall = wallUs();
+    double Cpu = cpuUs();
+
+    CANTask Ticker = tick(Test->Async, duration);
+    Test->Async.run();
+
+    Wall = wallUs() - Wall;
+    Cpu = cpuUs() - Cpu;
+
+    printf("{\"benchmark\":\"async_idle\",\"waiters\":%u,\"wall_ms\":%.1f,\"cpu_ms\":%.2f,\"cpu_percent\":%.2f,\"resumed\":%u}\n",
+        waiters, Wall / 1000.0, Cpu / 1000.0, 100.0 * Cpu / Wall, Test->Async.getResumed());
+
+    // Hand-written Loop: dispatch() and a Check of each Message without Sleep
+    double End = wallUs() + duration * 1000.0;
+    uint32_t Polls = 0;
+
+    Wall = wallUs();
+    Cpu = cpuUs();
+
+    while (wallUs() < End)
+    {
+        Test->Bus.dispatch();
+
+        for (uint8_t i = 0; i < BENCH_MESSAGES; i++)
+        {
+            if (Test->Messages[i].dataAvailable())
+            {
+                Test->Messages[i].releaseData();
+            }
+        }
+        Polls++;
+    }
+
+    Wall = wallUs() - Wall;
+    Cpu = cpuUs() - Cpu;
+
+    printf("{\"benchmark\":\"poll_idle\",\"messages\":%u,\"wall_ms\":%.1f,\"cpu_ms\":%.2f,\"cpu_percent\":%.2f,\"polls\":%u}\n",
+        BENCH_MESSAGES, Wall / 1000.0, Cpu / 1000.0, 100.0 * Cpu / Wall, Polls);
+
+    Tasks.clear();
+    Ticker = CANTask();
+    delete Test;
+}
+
+/**
+ * @brief Injects Frames for the Messages in turn, each resumes only the Waiters of its ID.
+ */
+static void benchmarkWake(uint32_t waiters, uint32_t frames)
+{
+    Node *Test = new Node();
+    std::vector<CANTask> Tasks;
+    uint32_t Woken = 0;
+    CANFrame Frame;
+
+    for (uint32_t i = 0; i < waiters; i++)
+    {
+        Tasks.push_back(waitFrames(Test->Async, Test->Messages[i % BENCH_MESSAGES], Woken));
+    }
+
+    Frame.Frame = CANMESSAGE_FRAME_STANDARD;
+    Frame.RTR = false;
+    Frame.DLC = 8;
+
+    double Wall = wallUs();
+
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        Frame.ID = BENCH_FIRST_ID + i % BENCH_MESSAGES;
+        Frame.Data[0] = (uint8_t) i;
+        Test->Controller.receiveFrame(Frame);
+        Test->Async.poll();
+    }
+
+    Wall = wallUs() - Wall;
+
+    printf("{\"benchmark\":\"async_wake\",\"waiters\":%u,\"messages\":%u,\"frames\":%u,\"woken_per_frame\":%.1f,\"ns_per_frame\":%.0f,\"ns_per_wake\":%.1f}\n",
+        waiters, BENCH_MESSAGES, frames, (double) Woken / frames, Wall * 1000.0 / frames, Woken > 0 ? Wall * 1000.0 / Woken : 0.0);
+
+    Tasks.clear();
+    delete Test;
+}
+
+/**
+ * @brief Sends a Request and waits for its Response.
+ */
+static CANTask ping(CANAsyncBus &async, CANMessage &request, CANMessage &response, uint32_t rounds, uint32_t &completed)
+{
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        request.addDataByte((uint8_t) i, 0);
+
+        bool Sent = co_await async.sendAsync(request);
+
+        if (!Sent)
+        {
+            co_return;
+        }
+
+        CANMessage *Received = co_await async.receive(response, 100);
+
+        if (Received == NULL)
+        {
+            co_return;
+        }
+        response.releaseData();
+        completed++;
+    }
+}
+
+/**
+ * @brief Answers each Request.
+ */
+static CANTask pong(CANAsyncBus &async, CANMessage &request, CANMessage &response)
+{
+    while (true)
+    {
+        CANMessage *Received = co_await async.receive(request, 100);
+
+        if (Received == NULL)
+        {
+            co_return;
+        }
+
+        response.addDataByte(request.getDataByte(), 0);
+        request.releaseData();
+
+        bool Sent = co_await async.sendAsync(response);
+
+        if (!Sent)
+        {
+            co_return;
+        }
+    }
+}
+
+/**
+ * @brief Request and Response between two Coroutines over the Loopback-Controller (transmitted Frames are received again).
+ */
+static void benchmarkRoundTrip(uint32_t rounds)
+{
+    CANLoopbackController *Controller = new CANLoopbackController();
+    CANBus *Bus = new CANBus();
+    CANAsyncBus *Async = new CANAsyncBus();
+    CANMessage RequestTx, RequestRx, ResponseTx, ResponseRx;
+    uint32_t Completed = 0;
+
+    Controller->init(500E3);
+    Controller->setLoopback(true);
+    Bus->init(*Controller, 0);
+
+    RequestTx.init(0x100, 1, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT, *Controller);
+    RequestRx.init(0x100, 1, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE, *Controller);
+    ResponseTx.init(0x101, 1, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT, *Controller);
+    ResponseRx.init(0x101, 1, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE, *Controller);
+    Bus->registerMessage(RequestTx);
+    Bus->registerMessage(RequestRx);
+    Bus->registerMessage(ResponseTx);
+    Bus->registerMessage(ResponseRx);
+    Async->init(*Bus, *Controller);
+
+    Controller->resetStatistics();
+
+    double Wall = wallUs();
+    {
+        CANTask Server = pong(*Async, RequestRx, ResponseTx);
+        CANTask Client = ping(*Async, RequestTx, ResponseRx, rounds, Completed);
+
+        while (!Client.done())
+        {
+            Async->poll();
+        }
+    }
+    Wall = wallUs() - Wall;
+
+    printf("{\"benchmark\":\"async_round_trip\",\"rounds\":%u,\"completed\":%u,\"ns_per_round_trip\":%.0f,\"spi_per_round_trip\":%.1f}\n",
+        rounds, Completed, Completed > 0 ? Wall * 1000.0 / Completed : 0.0,
+        Completed > 0 ? (double) Controller->getSpiTransactions() / Completed : 0.0);
+
+    delete Async;
+    delete Bus;
+    delete Controller;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t Waiters = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 10) : 1000;
+    uint32_t Duration = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : 200;
+    uint32_t Frames = argc > 3 ? (uint32_t) strtoul(argv[3], NULL, 10) : 10000;
+
+    benchmarkIdle(Waiters, Duration);
+    benchmarkWake(Waiters, Frames);
+    benchmarkRoundTrip(Frames);
+
+    return 0;
+}
@@ -0,0 +1,549 @@
+#include "CANAsync.h"
+#include <chrono>
+#include <thread>
+
+CANAsyncBus *CANAsyncBus::_Active = NULL;
+
+
+/**
+ * @brief Appends a Link at the End of the List.
+ */
+void CANAsyncList::append(CANAsyncLink &link)
+{
+    link.List = this;
+    link.Prev = Tail;
+    link.Next = NULL;
+
+    if (Tail == NULL)
+    {
+        Head = &link;
+    } else {
+        Tail->Next = &link;
+    }
+    Tail = &link;
+}
+
+/**
+ * @brief Removes a Link of this List.
+ */
+void CANAsyncList::remove(CANAsyncLink &link)
+{
+    if (link.Prev == NULL)
+    {
+        Head = link.Next;
+    } else {
+        link.Prev->Next = link.Next;
+    }
+
+    if (link.Next == NULL)
+    {
+        Tail = link.Prev;
+    } else {
+        link.Next->Prev = link.Prev;
+    }
+    link.List = NULL;
+}
+
+
+/**
+ * @brief Prepares the Send, it starts with co_await.
+ */
+CANAsyncSend::CANAsyncSend(CANAsyncBus &bus, CANMessage &message) : _Bus(bus)
+{
+    _Waiter.Handle = nullptr;
+    _Waiter.Links = &_Link;
+    _Waiter.LinkCount = 1;
+    _Waiter.Message = &message;
+    _Waiter.Result = NULL;
+    _Waiter.Timed = false;
+    _Waiter.Ready = false;
+    _Waiter.Waiting = false;
+
+    _Link.Waiter = &_Waiter;
+    _Link.Message = &message;
+    _Link.List = NULL;
+}
+
+/**
+ * @brief Leaves the Wait, when the Coroutine is destroyed during it (the Frame stays in the Transmit-Queue).
+ */
+CANAsyncSend::~CANAsyncSend()
+{
+    _Bus._leave(_Waiter);
+}
+
+/**
+ * @brief Sends the Message, the Coroutine is only suspended until its Frame is transmitted.
+ */
+bool CANAsyncSend::await_ready()
+{
+    return _Bus._send(_Waiter);
+}
+
+
+/**
+ * @brief Constructor
+ */
+CANAsyncBus::CANAsyncBus()
+{
+    _Bus = NULL;
+    _Controller = NULL;
+    _Waiting = 0;
+    _Resumed = 0;
+    _Timeouts = 0;
+    _lastCanError = EMPTY_VALUE_16_BIT;
+}
+
+/**
+ * @brief Destructor, the Bus delivers the Frames to the Messages again. Destroy the Tasks before their Loop.
+ */
+CANAsyncBus::~CANAsyncBus()
+{
+    if (_Bus != NULL)
+    {
+        _Bus->attachHandlers(NULL);
+    }
+
+    if (_Active == this)
+    {
+        _Active = NULL;
+    }
+}
+
+/**
+ * @brief Returns the last occurred Error.
+ * @return Error-Code (see CANMessageError.h)
+ */
+uint16_t CANAsyncBus::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Links the Loop with an initialised Bus and its Loopback-Controller.
+ *
+ * The Loop takes the Receive-Handlers of the Bus and enables the Receive- and Transmit-Interrupts of the Controller.
+ * @param bus Bus, initialised with the Controller
+ * @param controller Loopback-Controller of the Bus
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANAsyncBus::init(CANBus &bus, CANLoopbackController &controller)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!bus.enableTransmitInterrupts())
+    {
+        _lastCanError = bus.getLastCanError();
+        return false;
+    }
+
+    // interruptPending() of the Controller shows the received Frames to poll()
+    controller.bitModify(MCP2515_REGISTER_CANINTE, MCP2515_CANINT_RX0I | (MCP2515_CANINT_RX0I << 1), MCP2515_CANINT_RX0I | (MCP2515_CANINT_RX0I << 1));
+
+    _Bus = &bus;
+    _Controller = &controller;
+    _Handlers.init(bus);
+    _Receivers.assign(CANBUS_MAX_MESSAGES, CANAsyncList());
+
+    return true;
+}
+
+/**
+ * @brief Waits for the next Frame of a registered Reception-Message, returns at once when the Message has unread Data.
+ *
+ * The Frame is delivered to the Message (Buffer, FIFO or Mailbox) before the Coroutine is resumed,
+ * read it with the Methods of the Message (Data left unread ends the next Wait at once).
+ * @param message Reception-Message registered at the Bus
+ * @param timeout Max. Time [ms], CANASYNC_FOREVER = no Timeout
+ * @return Awaitable, co_await returns the Message, NULL on Timeout or when the Message is not registered
+ */
+CANAsyncWait<1> CANAsyncBus::receive(CANMessage &message, uint32_t timeout)
+{
+    CANMessage *List[] = { &message };
+
+    return CANAsyncWait<1>(*this, timeout, List);
+}
+
+/**
+ * @brief Sends a Transmission-Message registered at the Bus and waits until its Frame is transmitted.
+ *
+ * When the Transmit-Queue is full the Coroutine waits for Space, the Order of these Senders is kept.
+ * A Payload suppressed by a CANChangeFilter returns at once.
+ * @param message Transmission-Message with complete Payload, registered at the Bus
+ * @return Awaitable, co_await returns true when the Frame is transmitted, false when it is not sent (Check getLastCanError() of the Message)
+ */
+CANAsyncSend CANAsyncBus::sendAsync(CANMessage &message)
+{
+    return CANAsyncSend(*this, message);
+}
+
+/**
+ * @brief Waits for a Time, 0 continues with the next poll() (after the other ready Coroutines).
+ * @param duration Time [ms]
+ * @return Awaitable, co_await returns NULL
+ */
+CANAsyncWait<0> CANAsyncBus::delay(uint32_t duration)
+{
+    return CANAsyncWait<0>(*this, duration, NULL);
+}
+
+/**
+ * @brief One Round of the Loop: transmits the requested Transmit-Buffers, dispatches the received Frames,
+ * expires the Timeouts and resumes the ready Coroutines.
+ * @return uint32_t Work done (transmitted and received Frames and resumed Coroutines), 0 = idle
+ */
+uint32_t CANAsyncBus::poll()
+{
+    if (_Bus == NULL)
+    {
+        return 0;
+    }
+
+    uint32_t Work = 0;
+    CANFrame Frame;
+    CANAsyncBus *Previous = _Active;
+
+    _Active = this;
+
+    // Bus-Side: each Frame is dispatched at once, so the Receive-Buffers do not overflow in Loopback-Mode
+    while (_Controller->transmit(Frame))
+    {
+        Work++;
+        _transmitted(Frame);
+        _Bus->dispatch();
+        _Handlers.processPending();
+    }
+
+    while (_Controller->interruptPending() && _Bus->dispatch() != 0)
+    {
+        Work++;
+        _Handlers.processPending();
+    }
+
+    _Active = Previous;
+
+    _retry();
+
+    uint64_t Now = micros();
+
+    while (!_Timers.empty() && _Timers.begin()->first <= Now)
+    {
+        CANAsyncWaiter &Waiter = *_Timers.begin()->second;
+
+        if (Waiter.LinkCount != 0)
+        {
+            _Timeouts++;
+        }
+        _wake(Waiter, NULL);
+    }
+
+    // Coroutines getting ready now follow with the next poll()
+    size_t Count = _Ready.size();
+
+    while (Count-- > 0 && !_Ready.empty())
+    {
+        CANAsyncWaiter &Waiter = *_Ready.front();
+
+        _Ready.pop_front();
+        Waiter.Ready = false;
+        Work++;
+        _Resumed++;
+        Waiter.Handle.resume();
+    }
+
+    return Work;
+}
+
+/**
+ * @brief Runs the Loop until no Coroutine can continue (no Work and no Timeout left).
+ *
+ * Between the Timeouts the Thread sleeps. With the virtual Clock of a Simulation (canHostClock())
+ * it returns instead, so the Simulation advances the Time.
+ */
+void CANAsyncBus::run()
+{
+    while (true)
+    {
+        if (poll() != 0)
+        {
+            continue;
+        }
+
+        if (_Timers.empty() || canHostClock() != NULL)
+        {
+            return;
+        }
+        _sleep(_Timers.begin()->first);
+    }
+}
+
+/**
+ * @brief Runs the Loop for a Time, without Work it sleeps until the next Timeout.
+ * @param duration Time [ms]
+ */
+void CANAsyncBus::runFor(uint32_t duration)
+{
+    uint64_t End = (uint64_t) micros() + (uint64_t) duration * 1000;
+
+    while (true)
+    {
+        if (poll() != 0)
+        {
+            continue;
+        }
+
+        if ((uint64_t) micros() >= End || canHostClock() != NULL)
+        {
+            return;
+        }
+        _sleep(!_Timers.empty() && _Timers.begin()->first < End ? _Timers.begin()->first : End);
+    }
+}
+
+/**
+ * @brief Coroutines waiting for a Frame, a Transmission or a Time.
+ * @return uint32_t Count
+ */
+uint32_t CANAsyncBus::getWaiting()
+{
+    return _Waiting;
+}
+
+/**
+ * @brief Resumed Coroutines since the Start.
+ * @return uint32_t Count
+ */
+uint32_t CANAsyncBus::getResumed()
+{
+    return _Resumed;
+}
+
+/**
+ * @brief Waits for Frames ended by their Timeout.
+ * @return uint32_t Count
+ */
+uint32_t CANAsyncBus::getTimeouts()
+{
+    return _Timeouts;
+}
+
+/**
+ * @brief Receive-Handler of the awaited Messages: delivers the Frame and resumes the Waiters of this Message.
+ */
+void CANAsyncBus::_received(const CANFrame &frame, CANMessage *message)
+{
+    CANAsyncBus *Loop = _Active;
+
+    if (Loop == NULL || message == NULL)
+    {
+        return;
+    }
+
+    message->deliver(frame);
+
+    int16_t Index = Loop->_Bus->getMessageIndex(*message);
+
+    if (Index < 0)
+    {
+        return;
+    }
+
+    CANAsyncList &Waiters = Loop->_Receivers[Index];
+
+    while (Waiters.Head != NULL)
+    {
+        Loop->_wake(*Waiters.Head->Waiter, message);
+    }
+}
+
+/**
+ * @brief Sets the Receive-Handler of the awaited Messages.
+ * @return true when all Messages are registered at the Bus
+ */
+bool CANAsyncBus::_prepare(CANMessage *const *messages, uint8_t count)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_Bus == NULL)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!_Handlers.onMessage(*messages[i], _received))
+        {
+            _lastCanError = _Handlers.getLastCanError();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Adds a Waiter to the Wait-Lists of its Messages and starts its Timeout.
+ */
+void CANAsyncBus::_wait(CANAsyncWaiter &waiter, uint32_t timeout)
+{
+    for (uint8_t i = 0; i < waiter.LinkCount; i++)
+    {
+        _Receivers[_Bus->getMessageIndex(*waiter.Links[i].Message)].append(waiter.Links[i]);
+    }
+
+    if (timeout != CANASYNC_FOREVER || waiter.LinkCount == 0)
+    {
+        waiter.Timer = _Timers.emplace((uint64_t) micros() + (uint64_t) timeout * 1000, &waiter);
+        waiter.Timed = true;
+    }
+
+    waiter.Waiting = true;
+    _Waiting++;
+}
+
+/**
+ * @brief Sends the Message of a Waiter.
+ * @return true when finished (Result is set), false when the Waiter waits for the Transmission or for Space in the Queue
+ */
+bool CANAsyncBus::_send(CANAsyncWaiter &waiter)
+{
+    CANMessage &Message = *waiter.Message;
+
+    waiter.Result = NULL;
+
+    if (_Bus == NULL || Message.getBus() != _Bus)
+    {
+        _lastCanError = _Bus == NULL ? ERROR_CAN_NOT_INITIALIZED : ERROR_CAN_METHOD_NOT_ALLOWED;
+        return true;
+    }
+
+    // A suppressed Payload (CANChangeFilter) does not add a Frame
+    uint16_t Frames = _Bus->getQueuedFrames() + _Controller->pendingTransmissions();
+
+    if (!Message.send())
+    {
+        if (Message.getLastCanError() != ERROR_CAN_BUS_TX_QUEUE_FULL)
+        {
+            return true;
+        }
+        _Full.append(waiter.Links[0]);
+    } else if (_Bus->getQueuedFrames() + _Controller->pendingTransmissions() == Frames)
+    {
+        waiter.Result = &Message;
+        return true;
+    } else {
+        CANFrame Frame;
+
+        Frame.ID = Message.getID();
+        Frame.Frame = Message.getFrame();
+        Frame.RTR = Message.getRTR();
+
+        _Senders[CANBus::arbitrationKey(Frame)].append(waiter.Links[0]);
+    }
+
+    waiter.Waiting = true;
+    _Waiting++;
+
+    return false;
+}
+
+/**
+ * @brief Ends the Wait and moves the Waiter into the Ready-Queue.
+ */
+void CANAsyncBus::_wake(CANAsyncWaiter &waiter, CANMessage *result)
+{
+    _leave(waiter);
+
+    waiter.Result = result;
+    waiter.Ready = true;
+    _Ready.push_back(&waiter);
+}
+
+/**
+ * @brief Removes a Waiter from its Wait-Lists, its Timer and the Ready-Queue.
+ */
+void CANAsyncBus::_leave(CANAsyncWaiter &waiter)
+{
+    for (uint8_t i = 0; i < waiter.LinkCount; i++)
+    {
+        if (waiter.Links[i].List != NULL)
+        {
+            waiter.Links[i].List->remove(waiter.Links[i]);
+        }
+    }
+
+    if (waiter.Timed)
+    {
+        _Timers.erase(waiter.Timer);
+        waiter.Timed = false;
+    }
+
+    if (waiter.Ready)
+    {
+        for (std::deque<CANAsyncWaiter *>::iterator It = _Ready.begin(); It != _Ready.end(); ++It)
+        {
+            if (*It == &waiter)
+            {
+                _Ready.erase(It);
+                break;
+            }
+        }
+        waiter.Ready = false;
+    }
+
+    if (waiter.Waiting)
+    {
+        waiter.Waiting = false;
+        _Waiting--;
+    }
+}
+
+/**
+ * @brief Resumes the oldest Sender of a transmitted Frame (Frames with the same Key keep their Order in the Queue).
+ */
+void CANAsyncBus::_transmitted(const CANFrame &frame)
+{
+    std::unordered_map<uint32_t, CANAsyncList>::iterator Senders = _Senders.find(CANBus::arbitrationKey(frame));
+
+    if (Senders != _Senders.end() && Senders->second.Head != NULL)
+    {
+        CANAsyncWaiter &Waiter = *Senders->second.Head->Waiter;
+
+        _wake(Waiter, Waiter.Message);
+    }
+}
+
+/**
+ * @brief Sends the Messages waiting for Space in the Transmit-Queue, in the Order they came.
+ */
+void CANAsyncBus::_retry()
+{
+    while (_Full.Head != NULL && _Bus->getQueuedFrames() < CANBUS_TX_QUEUE_SIZE)
+    {
+        CANAsyncWaiter &Waiter = *_Full.Head->Waiter;
+
+        _leave(Waiter);
+
+        if (_send(Waiter))
+        {
+            _wake(Waiter, Waiter.Result);
+        } else if (Waiter.Links[0].List == &_Full)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Sleeps until a Time of micros().
+ */
+void CANAsyncBus::_sleep(uint64_t until)
+{
+    uint64_t Now = micros();
+
+    if (until > Now)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(until - Now));
+    }
+}
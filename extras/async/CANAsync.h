@@ -0,0 +1,341 @@
+/**
+ * @file CANAsync.h
+ * @author MH-Tobi
+ * @brief Host-only Coroutine-API (C++20) of a CANBus: single-threaded Event-Loop over the Loopback-Controller.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANASYNC_H
+#define CANASYNC_H
+
+#if defined(ARDUINO)
+#error "CANAsync is Host-only (C++20 Coroutines), it is not part of the Arduino-Library"
+#endif
+
+#include <stdint.h>
+#include <coroutine>
+#include <exception>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <CANBus.h>
+#include <CANHandlers.h>
+
+
+#define CANASYNC_FOREVER                0       // receive() and anyOf() without Timeout
+
+class CANAsyncBus;
+struct CANAsyncList;
+
+
+/**
+ * @brief Coroutine of the Event-Loop, it starts at once and runs until its first co_await.
+ *
+ * The Coroutine-Frame lives as long as the Task, a destroyed Task leaves all its Waits.
+ * co_await of a Task waits for its End.
+ */
+class CANTask
+{
+	public:
+        struct promise_type
+        {
+            std::coroutine_handle<> Continuation;   // Coroutine waiting for the End of the Task
+
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    std::coroutine_handle<> Continuation = handle.promise().Continuation;
+                    return Continuation ? Continuation : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+
+            CANTask get_return_object() { return CANTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        CANTask() : _Handle(nullptr) {}
+        CANTask(CANTask &&other) noexcept : _Handle(other._Handle) { other._Handle = nullptr; }
+        CANTask(const CANTask &) = delete;
+        CANTask &operator=(const CANTask &) = delete;
+
+        CANTask &operator=(CANTask &&other) noexcept
+        {
+            if (this != &other)
+            {
+                _destroy();
+                _Handle = other._Handle;
+                other._Handle = nullptr;
+            }
+            return *this;
+        }
+
+        ~CANTask() { _destroy(); }
+
+        /**
+         * @brief The Coroutine has finished (or the Task is empty).
+         */
+        bool done() const { return !_Handle || _Handle.done(); }
+
+        bool await_ready() const noexcept { return done(); }
+        void await_suspend(std::coroutine_handle<> handle) noexcept { _Handle.promise().Continuation = handle; }
+        void await_resume() const noexcept {}
+
+	private:
+        std::coroutine_handle<promise_type> _Handle;
+
+        explicit CANTask(std::coroutine_handle<promise_type> handle) : _Handle(handle) {}
+
+        void _destroy()
+        {
+            if (_Handle)
+            {
+                _Handle.destroy();
+                _Handle = nullptr;
+            }
+        }
+};
+
+
+/**
+ * @brief Waiting Coroutine (lives in its Coroutine-Frame, so Waiting costs no Allocation).
+ */
+struct CANAsyncWaiter
+{
+    std::coroutine_handle<> Handle;
+    struct CANAsyncLink *Links;         // One Link per awaited Message
+    uint8_t LinkCount;
+    CANMessage *Message;                // Message of sendAsync()
+    CANMessage *Result;                 // Message they ended the Wait, NULL = Timeout or Failure
+    std::multimap<uint64_t, CANAsyncWaiter *>::iterator Timer;
+    bool Timed;                         // Timer is valid
+    bool Ready;                         // Waiting for its Resume in the Ready-Queue
+    bool Waiting;
+};
+
+/**
+ * @brief Entry of a Waiter in the Wait-List of a Message (intrusive, unlinked in constant Time).
+ */
+struct CANAsyncLink
+{
+    CANAsyncWaiter *Waiter;
+    CANMessage *Message;
+    CANAsyncList *List;                 // NULL = not linked
+    CANAsyncLink *Prev;
+    CANAsyncLink *Next;
+};
+
+/**
+ * @brief Wait-List in Order of the Waits.
+ */
+struct CANAsyncList
+{
+    CANAsyncLink *Head = NULL;
+    CANAsyncLink *Tail = NULL;
+
+    void append(CANAsyncLink &link);
+    void remove(CANAsyncLink &link);
+};
+
+
+/**
+ * @brief Awaitable of receive(), anyOf() and delay(): returns the Message with unread Data or the next received Frame, NULL on Timeout.
+ * @tparam N Number of awaited Messages
+ */
+template <uint8_t N>
+class CANAsyncWait
+{
+	private:
+        CANAsyncBus &_Bus;
+        CANAsyncWaiter _Waiter;
+        CANAsyncLink _Links[N > 0 ? N : 1];
+        uint32_t _Timeout;
+        bool _Valid;
+
+	public:
+        CANAsyncWait(CANAsyncBus &bus, uint32_t timeout, CANMessage *const *messages);
+        CANAsyncWait(const CANAsyncWait &) = delete;
+        CANAsyncWait &operator=(const CANAsyncWait &) = delete;
+        ~CANAsyncWait();
+
+        bool await_ready() { return !_Valid || _Waiter.Result != NULL; }
+        void await_suspend(std::coroutine_handle<> handle);
+        CANMessage *await_resume() { return _Waiter.Result; }
+};
+
+/**
+ * @brief Awaitable of sendAsync(): returns true when the Frame is transmitted, false when it is not sent.
+ */
+class CANAsyncSend
+{
+	private:
+        CANAsyncBus &_Bus;
+        CANAsyncWaiter _Waiter;
+        CANAsyncLink _Link;
+
+	public:
+        CANAsyncSend(CANAsyncBus &bus, CANMessage &message);
+        CANAsyncSend(const CANAsyncSend &) = delete;
+        CANAsyncSend &operator=(const CANAsyncSend &) = delete;
+        ~CANAsyncSend();
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle) { _Waiter.Handle = handle; }
+        bool await_resume() { return _Waiter.Result != NULL; }
+};
+
+
+/**
+ * @brief Single-threaded Event-Loop of a CANBus on the Loopback-Controller with Awaitables for Coroutines.
+ *
+ * The Receive-Handlers of the Bus take the Frames of the awaited Messages, each Frame is delivered to its
+ * Message (Buffer, FIFO or Mailbox) and resumes only the Coroutines waiting for this Message: the Wait-Lists
+ * are found with the Hash-Lookup of dispatch(), so idle Waiters cost no CPU.
+ * The Loop is the Bus-Side of the Loopback-Controller: it transmits the requested Transmit-Buffers
+ * (in Loopback-Mode they are received again) and resumes the Senders of the transmitted Frames.
+ * Without Work it sleeps until the next Timeout, a Loop without Timers and Work returns.
+ */
+class CANAsyncBus
+{
+    template <uint8_t N> friend class CANAsyncWait;
+    friend class CANAsyncSend;
+
+	private:
+        CANBus *_Bus;
+        CANLoopbackController *_Controller;
+        CANHandlers _Handlers;
+        std::vector<CANAsyncList> _Receivers;                   // Wait-List per Index of the registered Message
+        std::unordered_map<uint32_t, CANAsyncList> _Senders;    // Wait-List per Arbitration-Key (Order of the Transmit-Queue)
+        CANAsyncList _Full;                                     // sendAsync() waiting for Space in the Transmit-Queue
+        std::multimap<uint64_t, CANAsyncWaiter *> _Timers;      // Timeouts in us
+        std::deque<CANAsyncWaiter *> _Ready;
+        uint32_t _Waiting;
+        uint32_t _Resumed;
+        uint32_t _Timeouts;
+        uint16_t _lastCanError;
+
+        static CANAsyncBus *_Active;                            // Loop in poll(), for the Receive-Handler
+
+        static void _received(const CANFrame &frame, CANMessage *message);
+        bool _prepare(CANMessage *const *messages, uint8_t count);
+        void _wait(CANAsyncWaiter &waiter, uint32_t timeout);
+        bool _send(CANAsyncWaiter &waiter);
+        void _wake(CANAsyncWaiter &waiter, CANMessage *result);
+        void _leave(CANAsyncWaiter &waiter);
+        void _transmitted(const CANFrame &frame);
+        void _retry();
+        void _sleep(uint64_t until);
+
+	public:
+
+        CANAsyncBus();
+        ~CANAsyncBus();
+
+        uint16_t getLastCanError();
+
+        bool init(CANBus &bus, CANLoopbackController &controller);
+
+        // Awaitables
+
+        CANAsyncWait<1> receive(CANMessage &message, uint32_t timeout = CANASYNC_FOREVER);
+        CANAsyncSend sendAsync(CANMessage &message);
+        CANAsyncWait<0> delay(uint32_t duration);
+
+        /**
+         * @brief Waits for the next Frame of one of the Messages (at once when one has unread Data).
+         * @return Awaitable, co_await returns the Message with the Frame
+         */
+        template <typename... Messages>
+        CANAsyncWait<1 + sizeof...(Messages)> anyOf(CANMessage &first, Messages &...messages)
+        {
+            CANMessage *List[] = { &first, &messages... };
+            return CANAsyncWait<1 + sizeof...(Messages)>(*this, CANASYNC_FOREVER, List);
+        }
+
+        /**
+         * @brief Waits for the next Frame of one of the Messages (at once when one has unread Data), at most timeout ms.
+         * @return Awaitable, co_await returns the Message with the Frame, NULL on Timeout
+         */
+        template <typename... Messages>
+        CANAsyncWait<1 + sizeof...(Messages)> anyOf(uint32_t timeout, CANMessage &first, Messages &...messages)
+        {
+            CANMessage *List[] = { &first, &messages... };
+            return CANAsyncWait<1 + sizeof...(Messages)>(*this, timeout, List);
+        }
+
+        // Event-Loop
+
+        uint32_t poll();
+        void run();
+        void runFor(uint32_t duration);
+
+        // Statistics
+
+        uint32_t getWaiting();
+        uint32_t getResumed();
+        uint32_t getTimeouts();
+
+};
+
+
+/**
+ * @brief Checks the Messages, the Wait starts with co_await (not when a Message has unread Data).
+ */
+template <uint8_t N>
+CANAsyncWait<N>::CANAsyncWait(CANAsyncBus &bus, uint32_t timeout, CANMessage *const *messages) : _Bus(bus), _Timeout(timeout)
+{
+    _Waiter.Handle = nullptr;
+    _Waiter.Links = _Links;
+    _Waiter.LinkCount = N;
+    _Waiter.Message = NULL;
+    _Waiter.Result = NULL;
+    _Waiter.Timed = false;
+    _Waiter.Ready = false;
+    _Waiter.Waiting = false;
+
+    for (uint8_t i = 0; i < N; i++)
+    {
+        _Links[i].Waiter = &_Waiter;
+        _Links[i].Message = messages[i];
+        _Links[i].List = NULL;
+    }
+
+    _Valid = _Bus._prepare(messages, N);
+
+    // Unread Data ends the Wait at once, so a Frame received before the co_await is not missed
+    for (uint8_t i = 0; i < N && _Valid && _Waiter.Result == NULL; i++)
+    {
+        if (messages[i]->dataAvailable())
+        {
+            _Waiter.Result = messages[i];
+        }
+    }
+}
+
+/**
+ * @brief Leaves the Wait, when the Coroutine is destroyed during it.
+ */
+template <uint8_t N>
+CANAsyncWait<N>::~CANAsyncWait()
+{
+    _Bus._leave(_Waiter);
+}
+
+template <uint8_t N>
+void CANAsyncWait<N>::await_suspend(std::coroutine_handle<> handle)
+{
+    _Waiter.Handle = handle;
+    _Bus._wait(_Waiter, _Timeout);
+}
+
+#endif
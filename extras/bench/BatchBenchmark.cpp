@@ -0,0 +1,315 @@
+/**
+ * @file BatchBenchmark.cpp
+ * @author MH-Tobi
+ * @brief Host-Benchmark of a Burst of Frames: SPI-Cost per Frame and Gaps on the Bus with send(), the Transmit-Queue and sendBatch().
+ *
+ * Runs against the Loopback-Controller, which counts the SPI-Transactions and their Bytes like the MCP2515.
+ * The Time of the CPU is modelled from the SPI-Transactions, the Bus-Side (Arbitration of the Transmit-Buffers by
+ * TXP-Priority, Frame-Length with Bit-Stuffing, Transmit-Interrupt at the End of each Frame) is simulated by the Benchmark.
+ * The Frames of a Burst are sent from the lowest to the highest Priority, so a Frame sent too early shows up as Inversion.
+ * Build and run on Linux with: make run
+ *
+ * Usage: BatchBenchmark [bitrate] [spi_us] [byte_us] [isr_us]
+ *  - bitrate  Bitrate of the Bus in bit/s (default 500000)
+ *  - spi_us   Modelled fixed Duration of one SPI-Transaction on the Target in us (default 4, Chip-Select and Call-Overhead)
+ *  - byte_us  Modelled Duration of one SPI-Byte in us (default 1, 8 MHz SPI-Clock)
+ *  - isr_us   Modelled fixed Duration of one Interrupt-Routine on the Target in us (default 5)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <CANBus.h>
+#include <CANBusLoad.h>
+
+#define BENCH_MAX_FRAMES    6
+#define BENCH_NEVER         1e18
+#define BENCH_FIRST_ID      0x100   // ID of the Frame with the highest Priority
+#define BENCH_ID_STEP       0x10
+
+#define BENCH_MODE_DIRECT   0       // send() of Messages without Bus (Message-Level: Free Buffer, Fill, Request)
+#define BENCH_MODE_QUEUED   1       // send() of Messages registered at a Bus, one after the other
+#define BENCH_MODE_BATCH    2       // sendBatch() of Messages registered at a Bus
+
+static const char *ModeNames[] = { "direct", "queued", "batch" };
+
+
+/**
+ * @brief Model of the Target and the Bus during one Burst.
+ */
+struct Timeline
+{
+    double SpiUs;
+    double ByteUs;
+    double IsrUs;
+    double BitUs;
+    double Cpu;                     // End of the last Action of the CPU
+    double BusFree;                 // End of the last Frame on the Bus
+    double Requested[CANBUS_TX_BUFFERS];
+    double FirstStart;
+    double Gaps;                    // Idle-Time of the Bus between the Frames of the Burst
+    uint32_t Spi;
+    uint32_t Bytes;
+    uint8_t Sent;                   // Bit n = Frame with Rank n sent (Rank 0 = highest Priority)
+    int8_t OnWire;                  // Transmit-Buffer on the Bus, -1 = Bus idle
+    uint8_t Frames;
+    uint8_t Inversions;
+};
+
+static CANLoopbackController Controller;
+static CANBus *Bus = NULL;
+static CANMessage Messages[BENCH_MAX_FRAMES];
+
+/**
+ * @brief Notes the Transmit-Buffers requested since the last Call with the Time of the CPU.
+ */
+static void noteRequests(Timeline &t)
+{
+    uint8_t Requests = Controller.getTransmitRequests();
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANBUS_TX_BUFFERS; BufferNumber++)
+    {
+        // TXREQ stays set during the Transmission
+        if ((Requests & (1 << BufferNumber)) != 0 && t.Requested[BufferNumber] >= BENCH_NEVER && BufferNumber != t.OnWire)
+        {
+            t.Requested[BufferNumber] = t.Cpu;
+        }
+    }
+}
+
+/**
+ * @brief Adds the SPI-Cost of an Action of the CPU since the given Counters.
+ */
+static void addCost(Timeline &t, uint32_t spi, uint32_t bytes)
+{
+    uint32_t Spi = Controller.getSpiTransactions() - spi;
+    uint32_t Bytes = Controller.getSpiBytes() - bytes;
+
+    t.Spi += Spi;
+    t.Bytes += Bytes;
+    t.Cpu += Spi * t.SpiUs + Bytes * t.ByteUs;
+    noteRequests(t);
+}
+
+/**
+ * @brief Reads the TXP-Priority and the Frame of a Transmit-Buffer (not counted, outside of the modelled Actions).
+ */
+static uint8_t readTransmitBuffer(uint8_t BufferNumber, CANFrame &frame)
+{
+    uint8_t Address = MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4);
+    uint8_t Header[5];
+
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        Header[i] = Controller.readRegister(Address + 1 + i);
+    }
+    canRegisterDecode(Header, frame);
+
+    for (uint8_t i = 0; i < frame.DLC; i++)
+    {
+        frame.Data[i] = Controller.readRegister(Address + 6 + i);
+    }
+    return Controller.readRegister(Address) & MCP2515_TXBCTRL_TXP;
+}
+
+/**
+ * @brief Runs the Bus up to the given Time: each Frame wins against the other requested Buffers with its TXP-Priority
+ * (equal Priority: the higher Buffer), at its End the Transmit-Interrupt refills the Buffers from the Queue.
+ */
+static void runBus(Timeline &t, double until)
+{
+    while (true)
+    {
+        if (t.OnWire >= 0)
+        {
+            if (t.BusFree > until)
+            {
+                return;
+            }
+
+            // Transmission finished: TXREQ cleared, TXnIF set
+            Controller.bitModify(MCP2515_REGISTER_TXB0CTRL + (t.OnWire << 4), MCP2515_TXBCTRL_TXREQ, 0x00);
+            Controller.bitModify(MCP2515_REGISTER_CANINTF, MCP2515_CANINT_TX0I << t.OnWire, MCP2515_CANINT_TX0I << t.OnWire);
+            t.OnWire = -1;
+
+            // Transmit-Interrupt of the Bus
+            if (Bus != NULL)
+            {
+                t.Cpu = (t.Cpu > t.BusFree ? t.Cpu : t.BusFree) + t.IsrUs;
+
+                uint32_t Spi = Controller.getSpiTransactions();
+                uint32_t Bytes = Controller.getSpiBytes();
+                Bus->dispatch();
+                addCost(t, Spi, Bytes);
+            }
+            continue;
+        }
+
+        double Start = BENCH_NEVER;
+
+        for (uint8_t BufferNumber = 0; BufferNumber < CANBUS_TX_BUFFERS; BufferNumber++)
+        {
+            if (t.Requested[BufferNumber] < Start)
+            {
+                Start = t.Requested[BufferNumber];
+            }
+        }
+
+        Start = Start > t.BusFree ? Start : t.BusFree;
+
+        if (Start >= BENCH_NEVER || Start > until)
+        {
+            return;
+        }
+
+        int8_t Winner = -1;
+        uint8_t WinnerLevel = 0;
+        CANFrame Frame;
+        CANFrame WinnerFrame;
+
+        for (uint8_t BufferNumber = 0; BufferNumber < CANBUS_TX_BUFFERS; BufferNumber++)
+        {
+            if (t.Requested[BufferNumber] > Start)
+            {
+                continue;
+            }
+
+            uint8_t Level = readTransmitBuffer(BufferNumber, Frame);
+
+            if (Winner < 0 || Level >= WinnerLevel)
+            {
+                Winner = BufferNumber;
+                WinnerLevel = Level;
+                WinnerFrame = Frame;
+            }
+        }
+
+        uint8_t Rank = (uint8_t) ((WinnerFrame.ID - BENCH_FIRST_ID) / BENCH_ID_STEP);
+
+        if (t.Frames == 0)
+        {
+            t.FirstStart = Start;
+        } else {
+            t.Gaps += Start - t.BusFree;
+        }
+
+        // A Frame of the Burst with higher Priority is not sent yet
+        if ((t.Sent & ((1 << Rank) - 1)) != ((1 << Rank) - 1))
+        {
+            t.Inversions++;
+        }
+
+        t.Sent |= 1 << Rank;
+        t.Frames++;
+        t.BusFree = Start + CANBusLoad::frameBits(WinnerFrame) * t.BitUs;
+        t.Requested[Winner] = BENCH_NEVER;
+        t.OnWire = Winner;
+    }
+}
+
+/**
+ * @brief Sends a Burst of Frames (lowest Priority first) and prints the SPI-Cost and the Timeline.
+ */
+static void benchmarkBurst(uint8_t mode, uint8_t frames, uint32_t bitrate, double spiUs, double byteUs, double isrUs)
+{
+    Timeline t = {};
+    uint8_t Failed = 0;
+
+    t.SpiUs = spiUs;
+    t.ByteUs = byteUs;
+    t.IsrUs = isrUs;
+    t.BitUs = 1e6 / bitrate;
+    t.OnWire = -1;
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANBUS_TX_BUFFERS; BufferNumber++)
+    {
+        t.Requested[BufferNumber] = BENCH_NEVER;
+    }
+
+    Controller = CANLoopbackController();
+    Controller.init(bitrate);
+
+    delete Bus;
+    Bus = NULL;
+
+    if (mode != BENCH_MODE_DIRECT)
+    {
+        Bus = new CANBus();
+        Bus->init(Controller, 0);
+    }
+
+    for (uint8_t i = 0; i < frames; i++)
+    {
+        Messages[i] = CANMessage();
+        Messages[i].init(BENCH_FIRST_ID + (frames - 1 - i) * BENCH_ID_STEP, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT, Controller);
+
+        for (uint8_t j = 0; j < 8; j++)
+        {
+            Messages[i].addDataByte((uint8_t) (i * 8 + j), j);
+        }
+
+        if (Bus != NULL)
+        {
+            Bus->registerMessage(Messages[i]);
+        }
+    }
+
+    Controller.resetStatistics();
+
+    if (mode == BENCH_MODE_BATCH)
+    {
+        CANMessage *Batch[BENCH_MAX_FRAMES];
+
+        for (uint8_t i = 0; i < frames; i++)
+        {
+            Batch[i] = &Messages[i];
+        }
+
+        uint32_t Spi = Controller.getSpiTransactions();
+        uint32_t Bytes = Controller.getSpiBytes();
+        Failed = frames - Bus->sendBatch(Batch, frames);
+        addCost(t, Spi, Bytes);
+    } else {
+        for (uint8_t i = 0; i < frames; i++)
+        {
+            runBus(t, t.Cpu);
+
+            uint32_t Spi = Controller.getSpiTransactions();
+            uint32_t Bytes = Controller.getSpiBytes();
+
+            if (!Messages[i].send())
+            {
+                Failed++;
+            }
+            addCost(t, Spi, Bytes);
+        }
+    }
+
+    runBus(t, BENCH_NEVER);
+
+    uint8_t Sent = t.Frames > 0 ? t.Frames : 1;
+
+    printf("{\"benchmark\":\"burst_%s\",\"frames\":%u,\"sent\":%u,\"failed\":%u,\"spi_per_frame\":%.2f,\"spi_bytes_per_frame\":%.1f,\"cpu_us_per_frame\":%.1f,\"gap_us_per_frame\":%.1f,\"first_frame_us\":%.1f,\"burst_us\":%.1f,\"inversions\":%u}\n",
+        ModeNames[mode], frames, t.Frames, Failed, (double) t.Spi / Sent, (double) t.Bytes / Sent,
+        (t.Spi * spiUs + t.Bytes * byteUs) / Sent, t.Frames > 1 ? t.Gaps / (t.Frames - 1) : 0.0, t.FirstStart, t.BusFree, t.Inversions);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t Bitrate = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 10) : 500000;
+    double SpiUs = argc > 2 ? atof(argv[2]) : 4.0;
+    double ByteUs = argc > 3 ? atof(argv[3]) : 1.0;
+    double IsrUs = argc > 4 ? atof(argv[4]) : 5.0;
+    const uint8_t Bursts[] = { 2, 3, 6 };
+
+    for (uint8_t i = 0; i < sizeof(Bursts); i++)
+    {
+        for (uint8_t Mode = BENCH_MODE_DIRECT; Mode <= BENCH_MODE_BATCH; Mode++)
+        {
+            benchmarkBurst(Mode, Bursts[i], Bitrate, SpiUs, ByteUs, IsrUs);
+        }
+    }
+
+    delete Bus;
+
+    return 0;
+}
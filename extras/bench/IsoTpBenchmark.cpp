@@ -0,0 +1,140 @@
+/**
+ * @file IsoTpBenchmark.cpp
+ * @author MH-Tobi
+ * @brief Host-Benchmark of the ISO-TP-Throughput compared with the theoretical Limit of the Bus.
+ *
+ * Two ISO-TP-Channels (Tester 0x7E0 and ECU 0x7E8) share one Bus on the Loopback-Controller.
+ * The Time on the Bus is simulated: each transmitted Frame takes its Bits at the Bitrate, without Frame on the Bus the Time advances by 0.1 ms.
+ * Build and run on Linux with: make run
+ *
+ * Usage: IsoTpBenchmark [bitrate]
+ *  - bitrate  Bitrate of the Bus in bit/s (default 500000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <CANIsoTp.h>
+
+#define BENCH_FRAME_BITS    111     // Standard-Frame with 8 Data-Bytes incl. Interframe-Space, without Bit-Stuffing
+#define BENCH_IDLE_US       100.0   // Time Step without Frame on the Bus
+
+
+struct Node
+{
+    CANMessage Tx;
+    CANMessage Rx;
+    CANReceiveFifo<16> Fifo;
+    CANIsoTp Channel;
+};
+
+static CANLoopbackController Controller;
+
+/**
+ * @brief Transfers length Bytes from the Tester to the ECU and returns the simulated Duration in us (negative on Failure).
+ */
+static double transfer(uint16_t length, uint8_t blockSize, uint8_t stMin, double bitrate, uint32_t &frames)
+{
+    static uint8_t Data[CANISOTP_MAX_LENGTH];
+    static uint8_t Received[CANISOTP_MAX_LENGTH];
+    CANBus *Bus = new CANBus();
+    Node *Tester = new Node();
+    Node *Ecu = new Node();
+
+    Controller.init(bitrate);
+    Controller.setLoopback(true);
+    Controller.bitModify(MCP2515_REGISTER_CANINTE, 0x03, 0x03);
+    Bus->init(Controller, 0);
+
+    Tester->Tx.init(0x7E0, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT, Controller);
+    Tester->Rx.init(0x7E8, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE, Controller);
+    Ecu->Tx.init(0x7E8, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT, Controller);
+    Ecu->Rx.init(0x7E0, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE, Controller);
+
+    Node *Nodes[2] = { Tester, Ecu };
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        Nodes[i]->Rx.attachFifo(Nodes[i]->Fifo);
+        Bus->registerMessage(Nodes[i]->Tx);
+        Bus->registerMessage(Nodes[i]->Rx);
+        Nodes[i]->Channel.init(Nodes[i]->Tx, Nodes[i]->Rx, blockSize, stMin);
+    }
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        Data[i] = (uint8_t) (i * 31 + 7);
+    }
+
+    double Now = 0;
+    bool Ok = Ecu->Channel.receive(Received, sizeof(Received)) && Tester->Channel.send(Data, length);
+    CANFrame Frame;
+
+    frames = 0;
+
+    while (Ok && (Tester->Channel.getTransmitState() == CANISOTP_BUSY || Ecu->Channel.getReceiveState() == CANISOTP_BUSY))
+    {
+        Tester->Channel.service((uint32_t) (Now / 1000));
+        Ecu->Channel.service((uint32_t) (Now / 1000));
+        Bus->service();
+
+        if (Controller.transmit(Frame))
+        {
+            Now += BENCH_FRAME_BITS * 1e6 / bitrate;
+            frames++;
+
+            while (Controller.interruptPending())
+            {
+                Bus->dispatch();
+            }
+        } else {
+            Now += BENCH_IDLE_US;
+        }
+
+        if (Now > 60e6)
+        {
+            Ok = false;
+        }
+    }
+
+    Ok = Ok && Ecu->Channel.getReceiveState() == CANISOTP_DONE && Ecu->Channel.getReceivedLength() == length;
+
+    for (uint16_t i = 0; Ok && i < length; i++)
+    {
+        Ok = Received[i] == Data[i];
+    }
+
+    delete Tester;
+    delete Ecu;
+    delete Bus;
+
+    return Ok ? Now : -1;
+}
+
+int main(int argc, char **argv)
+{
+    const double Bitrate = argc > 1 ? atof(argv[1]) : 500000.0;
+    const uint16_t Lengths[] = { 64, 512, 4095 };
+    const uint8_t BlockSizes[] = { 0, 8, 2 };
+    const uint8_t SeparationTimes[] = { 0, 1 };
+
+    // All Frames carry 7 Bytes (Consecutive-Frames) and follow each other without Gap
+    const double Limit = 7 * Bitrate / BENCH_FRAME_BITS;
+
+    for (uint8_t l = 0; l < sizeof(Lengths) / sizeof(Lengths[0]); l++)
+    {
+        for (uint8_t b = 0; b < sizeof(BlockSizes); b++)
+        {
+            for (uint8_t s = 0; s < sizeof(SeparationTimes); s++)
+            {
+                uint32_t Frames;
+                double Duration = transfer(Lengths[l], BlockSizes[b], SeparationTimes[s], Bitrate, Frames);
+                double Rate = Duration > 0 ? Lengths[l] * 1e6 / Duration : 0;
+
+                printf("{\"benchmark\":\"isotp_transfer\",\"bytes\":%u,\"block_size\":%u,\"st_min\":%u,\"bitrate\":%.0f,\"ok\":%s,\"frames\":%u,\"duration_ms\":%.2f,\"bytes_per_s\":%.0f,\"limit_bytes_per_s\":%.0f,\"efficiency\":%.3f}\n",
+                    Lengths[l], BlockSizes[b], SeparationTimes[s], Bitrate, Duration > 0 ? "true" : "false", Frames,
+                    Duration / 1000, Rate, Limit, Rate / Limit);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,235 @@
+/**
+ * @file J1939Benchmark.cpp
+ * @author MH-Tobi
+ * @brief Host-Benchmark of the J1939-Node: Cost of the PGN-Routing per Frame for 1 - 16 PGNs and of Multi-Packet-Transfers (BAM and RTS/CTS).
+ *
+ * The Frames are injected into the Loopback-Controller and received with dispatch() of the Bus, the Sender of an
+ * RTS/CTS-Transfer is played by the Benchmark: it answers each Clear-to-Send with the requested Data-Transfer-Frames.
+ * Build and run on Linux with: make run
+ *
+ * Usage: J1939Benchmark [frames] [transfers]
+ *  - frames     Injected Frames of the Routing-Test (default 200000)
+ *  - transfers  Transfers per Length and Mode (default 200)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <CANJ1939.h>
+
+#define BENCH_ADDRESS       0x2A
+#define BENCH_SOURCES       32      // Source-Addresses of the injected Frames
+#define BENCH_PEER          0x33    // Sender of the Transfers
+
+static CANLoopbackController Controller;
+static CANBus *Bus = NULL;
+static CANJ1939 *Node = NULL;
+static uint32_t Delivered = 0;
+
+static const uint32_t Pgns[] = { 0xFEF1, 0xFEEE, 0xF004, 0xFECA, 0xEF00, 0xFE6C, 0xFEF2, 0xFEF5,
+    0xFEE5, 0xFEFC, 0xFD7D, 0xFEE6, 0xFEDF, 0xF003, 0xFE56, 0xFEEF };
+
+static double nowNs()
+{
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void onPgn(const CANJ1939Header &header, const uint8_t *data, uint16_t length)
+{
+    (void) header;
+    (void) data;
+    (void) length;
+    Delivered++;
+}
+
+/**
+ * @brief New Bus and Node with the first count PGNs.
+ */
+static void setup(uint8_t count, uint8_t *buffer, uint16_t size)
+{
+    Controller = CANLoopbackController();
+    Controller.init(250E3);
+
+    delete Node;
+    delete Bus;
+    Bus = new CANBus();
+    Bus->init(Controller, 0);
+    Node = new CANJ1939();
+    Node->init(*Bus, BENCH_ADDRESS, 0x1000);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Node->onPgn(Pgns[i], onPgn);
+    }
+
+    if (buffer != NULL)
+    {
+        Node->addSession(buffer, size);
+    }
+}
+
+static void inject(uint32_t id, const uint8_t *data)
+{
+    CANFrame Frame;
+
+    Frame.ID = id;
+    Frame.Frame = CANMESSAGE_FRAME_EXTENDED;
+    Frame.RTR = false;
+    Frame.DLC = 8;
+    memcpy(Frame.Data, data, 8);
+
+    Controller.receiveFrame(Frame);
+    Bus->dispatch();
+}
+
+/**
+ * @brief Takes the next Frame sent by the Node (the Bus refills the Transmit-Buffers from its Queue).
+ */
+static bool takeResponse(CANFrame &frame)
+{
+    if (Controller.transmit(frame))
+    {
+        return true;
+    }
+
+    Bus->service();
+    return Controller.transmit(frame);
+}
+
+/**
+ * @brief Frames of the PGNs from BENCH_SOURCES Senders (each 4th Frame with a PGN without Handler): dispatch() and service() per Frame.
+ */
+static void benchmarkRouting(uint8_t count, uint32_t frames)
+{
+    uint8_t Data[8] = { 0 };
+    CANJ1939Header Header;
+
+    setup(count, NULL, 0);
+    Delivered = 0;
+
+    double Start = nowNs();
+
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        Header.Priority = CANJ1939_PRIORITY_DEFAULT;
+        Header.PGN = (i & 3) == 3 ? 0xFEE9 : Pgns[i % count];
+        Header.Source = (uint8_t) (i % BENCH_SOURCES);
+        Header.Destination = CANJ1939_ADDRESS_GLOBAL;
+        Data[0] = (uint8_t) i;
+
+        inject(canJ1939Encode(Header), Data);
+        Node->service(0);
+    }
+
+    double Ns = nowNs() - Start;
+
+    printf("{\"benchmark\":\"j1939_routing\",\"pgns\":%u,\"sources\":%u,\"messages_without_j1939\":%u,\"frames\":%u,\"delivered\":%u,\"unmatched\":%u,\"ns_per_frame\":%.1f}\n",
+        count, BENCH_SOURCES, count * BENCH_SOURCES, frames, Delivered, Bus->getUnmatchedFrames(), Ns / frames);
+}
+
+/**
+ * @brief Transfers of length Bytes as BAM or RTS/CTS from BENCH_PEER, the Benchmark sends the Data-Transfer-Frames.
+ */
+static void benchmarkTransfer(bool directed, uint16_t length, uint32_t transfers)
+{
+    static uint8_t Buffer[CANJ1939_MAX_LENGTH];
+    uint8_t Packets = (uint8_t) ((length + 6) / 7);
+    uint8_t Destination = directed ? BENCH_ADDRESS : CANJ1939_ADDRESS_GLOBAL;
+    uint32_t ControlId = 0x1CEC0000 | ((uint32_t) Destination << 8) | BENCH_PEER;
+    uint32_t DataId = 0x1CEB0000 | ((uint32_t) Destination << 8) | BENCH_PEER;
+    uint8_t Announce[8] = { (uint8_t) (directed ? CANJ1939_TP_RTS : CANJ1939_TP_BAM), (uint8_t) length, (uint8_t) (length >> 8), Packets,
+        0xFF, 0xCA, 0xFE, 0x00 };
+    uint8_t Data[8];
+    uint32_t Frames = 0;
+    uint32_t Responses = 0;
+
+    setup(4, Buffer, sizeof(Buffer));
+    Delivered = 0;
+
+    double Start = nowNs();
+
+    for (uint32_t t = 0; t < transfers; t++)
+    {
+        inject(ControlId, Announce);
+        Node->service(t);
+        Frames++;
+
+        uint8_t Sequence = 1;
+        uint8_t Count = directed ? 0 : Packets;
+        CANFrame Response;
+
+        while (Sequence <= Packets)
+        {
+            // RTS/CTS: the next Window is given by the Clear-to-Send of the Node
+            while (directed && Count == 0)
+            {
+                if (!takeResponse(Response))
+                {
+                    break;
+                }
+                Responses++;
+
+                if (Response.Data[0] == CANJ1939_TP_CTS)
+                {
+                    Count = Response.Data[1];
+                    Sequence = Response.Data[2];
+                }
+            }
+
+            if (Count == 0)
+            {
+                break;
+            }
+
+            Data[0] = Sequence;
+
+            for (uint8_t i = 1; i < 8; i++)
+            {
+                Data[i] = (uint8_t) (Sequence + i);
+            }
+
+            inject(DataId, Data);
+            Node->service(t);
+            Frames++;
+            Sequence++;
+            Count--;
+        }
+
+        // End of Message Acknowledgment
+        while (takeResponse(Response))
+        {
+            Responses++;
+        }
+    }
+
+    double Ns = nowNs() - Start;
+
+    printf("{\"benchmark\":\"j1939_%s\",\"length\":%u,\"transfers\":%u,\"completed\":%u,\"aborts\":%u,\"frames_per_transfer\":%.1f,\"responses_per_transfer\":%.1f,\"ns_per_transfer\":%.0f,\"ns_per_byte\":%.2f}\n",
+        directed ? "cmdt" : "bam", length, transfers, Node->getTransfers(), Node->getAborts(), (double) Frames / transfers,
+        (double) Responses / transfers, Ns / transfers, Ns / transfers / length);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t Frames = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 10) : 200000;
+    uint32_t Transfers = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : 200;
+    const uint8_t Counts[] = { 1, 4, 16 };
+    const uint16_t Lengths[] = { 20, 256, CANJ1939_MAX_LENGTH };
+
+    for (uint8_t i = 0; i < sizeof(Counts); i++)
+    {
+        benchmarkRouting(Counts[i], Frames);
+    }
+
+    for (uint8_t i = 0; i < sizeof(Lengths) / sizeof(Lengths[0]); i++)
+    {
+        benchmarkTransfer(false, Lengths[i], Transfers);
+        benchmarkTransfer(true, Lengths[i], Transfers);
+    }
+
+    delete Node;
+    delete Bus;
+
+    return 0;
+}
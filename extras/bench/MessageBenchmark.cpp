@@ -0,0 +1,541 @@
+/**
+ * @file MessageBenchmark.cpp
+ * @author MH-Tobi
+ * @brief Host-Benchmark of the Message-API, the Interrupt-Path and the Frame-Rate until Frames are dropped.
+ *
+ * Runs against the Loopback-Controller, which counts one SPI-Transaction per Register-Access.
+ * Build and run on Linux with: make run
+ *
+ * Usage: MessageBenchmark [rounds] [spi_us] [isr_us]
+ *  - rounds  Repetitions of the Throughput-Measurements (default 20000)
+ *  - spi_us  Modelled Duration of one SPI-Transaction on the Target in us (default 8, AVR with 8 MHz SPI)
+ *  - isr_us  Modelled fixed Duration of one Interrupt-Routine on the Target in us (default 5)
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <CANBus.h>
+#include <CANStaticMessage.h>
+#include <CANBusLoad.h>
+#include <CANGateway.h>
+#include <CANHandlers.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()      __rdtsc()
+#else
+#define BENCH_CYCLES()      (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+#endif
+
+#define BENCH_MAX_MESSAGES  CANBUS_MAX_MESSAGES
+#define BENCH_RATE_FRAMES   4000        // Frames per Rate-Step
+
+
+/**
+ * @brief Result of a measured Call (Sum over all Calls).
+ */
+struct Measurement
+{
+    uint64_t Cycles;
+    uint64_t MaxCycles;
+    double Nanoseconds;
+    uint32_t Calls;
+    uint32_t SpiTransactions;
+};
+
+static uint64_t Overhead = 0;
+
+static void addSample(Measurement &m, uint64_t cycles, double ns, uint32_t calls, uint32_t spi)
+{
+    cycles = cycles > Overhead ? cycles - Overhead : 0;
+    m.Cycles += cycles;
+    m.Nanoseconds += ns;
+    m.Calls += calls;
+    m.SpiTransactions += spi;
+
+    if (cycles > m.MaxCycles)
+    {
+        m.MaxCycles = cycles;
+    }
+}
+
+static void printMeasurement(const char *name, const Measurement &m, uint8_t messages)
+{
+    printf("{\"benchmark\":\"%s\",\"messages\":%u,\"calls\":%u,\"cycles_per_call\":%.1f,\"max_cycles\":%llu,\"ns_per_call\":%.2f,\"calls_per_s\":%.0f,\"spi_per_call\":%.2f}\n",
+        name, messages, m.Calls, (double) m.Cycles / m.Calls, (unsigned long long) m.MaxCycles, m.Nanoseconds / m.Calls,
+        m.Nanoseconds > 0 ? m.Calls * 1e9 / m.Nanoseconds : 0.0, (double) m.SpiTransactions / m.Calls);
+}
+
+/**
+ * @brief Measures a Code-Block with Cycle-Counter and Clock.
+ */
+#define BENCH_MEASURE(m, calls, block) \
+    do \
+    { \
+        uint32_t Spi = Controller.getSpiTransactions(); \
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now(); \
+        uint64_t Cycles = BENCH_CYCLES(); \
+        block; \
+        Cycles = BENCH_CYCLES() - Cycles; \
+        double Ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count(); \
+        addSample(m, Cycles, Ns, calls, Controller.getSpiTransactions() - Spi); \
+    } while (0)
+
+
+static CANLoopbackController Controller;
+static CANMessage Messages[BENCH_MAX_MESSAGES];
+static CANBus *Bus;
+static volatile uint32_t Sink;
+
+static CANFrame makeFrame(uint32_t id, uint8_t seed)
+{
+    CANFrame Frame;
+
+    Frame.ID = id;
+    Frame.Frame = CANMESSAGE_FRAME_STANDARD;
+    Frame.RTR = false;
+    Frame.DLC = 8;
+
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        Frame.Data[i] = (uint8_t) (seed + i);
+    }
+    return Frame;
+}
+
+/**
+ * @brief Initialises the Controller and N Receive-Messages (ID 0x100 + n), optional registered at a new Bus.
+ */
+static void setupReceive(uint8_t count, bool withBus)
+{
+    static CANBus *Owned = NULL;
+
+    Controller.init(500E3);
+    Controller.bitModify(MCP2515_REGISTER_CANINTE, 0x03, 0x03);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Messages[i] = CANMessage();
+        Messages[i].init(0x100 + i, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE, Controller);
+    }
+
+    Bus = NULL;
+
+    if (withBus)
+    {
+        // A Bus can not unregister Messages, so a fresh one is used
+        delete Owned;
+        Owned = new CANBus();
+        Bus = Owned;
+        Bus->init(Controller, 0);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            Bus->registerMessage(Messages[i]);
+        }
+    }
+
+    Controller.resetStatistics();
+}
+
+/**
+ * @brief Interrupt-Routine of the original Example (checkReceive() on each Message) or the Dispatcher.
+ */
+static void runIsr(uint8_t count)
+{
+    if (Bus != NULL)
+    {
+        Bus->dispatch();
+        return;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Messages[i].checkReceive();
+    }
+}
+
+/**
+ * @brief The loop() reads all received Data at once.
+ */
+static void drainMessages(uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (Messages[i].dataAvailable())
+        {
+            Messages[i].releaseData();
+        }
+    }
+}
+
+static void benchmarkApi(uint32_t rounds)
+{
+    Measurement Add = {}, Send = {}, Receive = {}, Get = {};
+    CANMessage Tx;
+    CANFrame Frame;
+
+    Controller.init(500E3);
+    Tx.init(0x123, 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT, Controller);
+    setupReceive(1, false);
+
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        uint8_t Value = (uint8_t) r;
+
+        BENCH_MEASURE(Add, 8, for (uint8_t i = 0; i < 8; i++) { Tx.addDataByte(Value, i); });
+        BENCH_MEASURE(Send, 1, Tx.send());
+
+        while (Controller.transmit(Frame))
+        {
+        }
+
+        Frame = makeFrame(0x100, Value);
+        Controller.receiveFrame(Frame);
+
+        BENCH_MEASURE(Receive, 1, Messages[0].checkReceive());
+        BENCH_MEASURE(Get, 8, for (uint8_t i = 0; i < 8; i++) { Sink = Messages[0].getDataByte(); });
+    }
+
+    printMeasurement("addDataByte", Add, 1);
+    printMeasurement("send", Send, 1);
+    printMeasurement("checkReceive", Receive, 1);
+    printMeasurement("getDataByte", Get, 1);
+}
+
+/**
+ * @brief CAN FD-Messages with 64 Bytes and Bit-Rate-Switch over the FD-Mode of the Loopback-Controller (Frames are received again).
+ */
+static void benchmarkFD(uint32_t rounds)
+{
+    Measurement Set = {}, Send = {}, Receive = {}, Get = {};
+    CANMessageFD Tx, Rx;
+    CANLoopbackFrameFD Frame;
+    uint8_t Payload[CANFRAME_MAX_LENGTH_FD];
+    uint32_t Errors = 0;
+
+    Controller.init(500E3);
+    Controller.setFD(true);
+    Controller.setLoopback(true);
+    Tx.init(0x123, CANFRAME_MAX_LENGTH_FD, false, CANMESSAGE_FRAME_STANDARD | CANMESSAGE_FRAME_FD | CANMESSAGE_FRAME_BRS, CANMESSAGE_DIRECTION_TRANSMIT, Controller);
+    Rx.init(0x123, CANFRAME_MAX_LENGTH_FD, false, CANMESSAGE_FRAME_STANDARD | CANMESSAGE_FRAME_FD, CANMESSAGE_DIRECTION_RECEIVE, Controller);
+
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (uint8_t i = 0; i < CANFRAME_MAX_LENGTH_FD; i++)
+        {
+            Payload[i] = (uint8_t) (r + i);
+        }
+
+        BENCH_MEASURE(Set, 1, Tx.setPayload(Payload, CANFRAME_MAX_LENGTH_FD));
+        BENCH_MEASURE(Send, 1, Tx.send());
+
+        while (Controller.transmitFD(Frame))
+        {
+        }
+
+        BENCH_MEASURE(Receive, 1, Rx.checkReceive());
+        BENCH_MEASURE(Get, 1, Rx.getPayload(Payload));
+
+        if (Payload[CANFRAME_MAX_LENGTH_FD - 1] != (uint8_t) (r + CANFRAME_MAX_LENGTH_FD - 1) || !Rx.getBRS())
+        {
+            Errors++;
+        }
+    }
+
+    Controller.setFD(false);
+    Controller.setLoopback(false);
+
+    printMeasurement("fd_setPayload", Set, 1);
+    printMeasurement("fd_send", Send, 1);
+    printMeasurement("fd_checkReceive", Receive, 1);
+    printMeasurement("fd_getPayload", Get, 1);
+    printf("{\"benchmark\":\"fd_loopback\",\"frames\":%u,\"length\":%u,\"errors\":%u}\n", rounds, CANFRAME_MAX_LENGTH_FD, Errors);
+}
+
+/**
+ * @brief Same Calls with Compile-Time defined Messages (no init(), no Runtime-Checks).
+ */
+static void benchmarkStaticApi(uint32_t rounds)
+{
+    Measurement Put = {}, Send = {}, Receive = {}, Get = {};
+    CANStaticMessage<0x123, 8, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT> Tx(Controller);
+    CANStaticMessage<0x100, 8, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE> Rx(Controller);
+    CANFrame Frame;
+
+    Controller.init(500E3);
+
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        uint32_t Value = r;
+
+        // Template-Arguments in Parentheses, so their Commas do not split the Macro-Arguments
+        BENCH_MEASURE(Put, 8, { (Tx.put<0, uint32_t>(Value)); (Tx.put<4, uint32_t>(~Value)); });
+        BENCH_MEASURE(Send, 1, Tx.send());
+
+        while (Controller.transmit(Frame))
+        {
+        }
+
+        Frame = makeFrame(0x100, (uint8_t) r);
+        Controller.receiveFrame(Frame);
+
+        BENCH_MEASURE(Receive, 1, Rx.checkReceive());
+        BENCH_MEASURE(Get, 8, { Sink = (Rx.get<0, uint32_t>()); Sink = (Rx.get<4, uint32_t>()); Rx.releaseData(); });
+    }
+
+    printMeasurement("static_put", Put, 1);
+    printMeasurement("static_send", Send, 1);
+    printMeasurement("static_checkReceive", Receive, 1);
+    printMeasurement("static_get", Get, 1);
+}
+
+/**
+ * @brief Worst Case of the Interrupt-Routine: both Receive-Buffers filled with Frames of the last registered Messages.
+ */
+static void benchmarkIsr(uint32_t rounds, uint8_t count, bool withBus)
+{
+    Measurement Isr = {};
+
+    setupReceive(count, withBus);
+
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        Controller.receiveFrame(makeFrame(0x100 + count - 1, (uint8_t) r));
+        Controller.receiveFrame(makeFrame(0x100 + (count > 1 ? count - 2 : 0), (uint8_t) r));
+
+        BENCH_MEASURE(Isr, 1, runIsr(count));
+
+        drainMessages(count);
+    }
+
+    printMeasurement(withBus ? "isr_dispatch" : "isr_check_receive", Isr, count);
+}
+
+/**
+ * @brief Worst Case of the Dispatcher with a linked Bus-Load (both Receive-Buffers filled).
+ */
+static void benchmarkBusLoad(uint32_t rounds, uint8_t count, uint8_t stuffing)
+{
+    static CANBusLoad *Load = NULL;
+    Measurement Isr = {};
+
+    setupReceive(count, true);
+
+    delete Load;
+    Load = new CANBusLoad();
+    Load->init(*Bus, 500000, stuffing);
+
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        Controller.receiveFrame(makeFrame(0x100 + count - 1, (uint8_t) r));
+        Controller.receiveFrame(makeFrame(0x100 + (count > 1 ? count - 2 : 0), (uint8_t) r));
+
+        BENCH_MEASURE(Isr, 1, runIsr(count));
+
+        drainMessages(count);
+    }
+
+    printMeasurement(stuffing == CANBUSLOAD_STUFFING_ACTUAL ? "isr_dispatch_busload_actual" : "isr_dispatch_busload_worst_case", Isr, count);
+}
+
+static void sinkHandler(const CANFrame &frame, CANMessage *)
+{
+    Sink += frame.Data[0];
+}
+
+/**
+ * @brief Top-Half (dispatch() with Receive-Handlers for all Messages) and Bottom-Half (processPending()), both Receive-Buffers filled.
+ */
+static void benchmarkHandlers(uint32_t rounds, uint8_t count)
+{
+    static CANHandlers *Handlers = NULL;
+    Measurement Isr = {};
+    Measurement Loop = {};
+
+    setupReceive(count, true);
+
+    delete Handlers;
+    Handlers = new CANHandlers();
+    Handlers->init(*Bus);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Handlers->onMessage(Messages[i], sinkHandler, i % CANHANDLERS_PRIORITIES);
+    }
+
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        Controller.receiveFrame(makeFrame(0x100 + count - 1, (uint8_t) r));
+        Controller.receiveFrame(makeFrame(0x100 + (count > 1 ? count - 2 : 0), (uint8_t) r));
+
+        BENCH_MEASURE(Isr, 1, runIsr(count));
+        BENCH_MEASURE(Loop, 1, Handlers->processPending());
+    }
+
+    printMeasurement("isr_dispatch_handlers", Isr, count);
+    printMeasurement("loop_process_pending", Loop, count);
+}
+
+/**
+ * @brief Dispatcher of a Gateway-Bus: both Receive-Buffers filled with Frames of the last Route (with ID-Rewrite).
+ *
+ * The second Bus transmits the forwarded Frames after each Round, so its Transmit-Queue never runs full.
+ */
+static void benchmarkGateway(uint32_t rounds, uint8_t routes)
+{
+    static CANLoopbackController Destination;
+    static CANBus *Target = NULL;
+    static CANGateway *Gateway = NULL;
+    Measurement Isr = {};
+    CANFrame Frame;
+
+    setupReceive(1, true);
+    Destination.init(500E3);
+    Destination.resetStatistics();
+
+    delete Target;
+    Target = new CANBus();
+    Target->init(Destination, 0);
+
+    delete Gateway;
+    Gateway = new CANGateway();
+    Gateway->addBus(*Bus);
+    Gateway->addBus(*Target);
+
+    for (uint8_t i = 0; i < routes; i++)
+    {
+        Gateway->addRoute(0, 0x200 + i, 0x7FF, CANMESSAGE_FRAME_STANDARD, 0x02, i == routes - 1 ? 0x300 : CANGATEWAY_KEEP_ID);
+    }
+
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        Controller.receiveFrame(makeFrame(0x200 + routes - 1, (uint8_t) r));
+        Controller.receiveFrame(makeFrame(0x200 + routes - 1, (uint8_t) (r + 1)));
+
+        BENCH_MEASURE(Isr, 1, runIsr(1));
+
+        while (Destination.transmit(Frame))
+        {
+            Target->service();
+        }
+    }
+
+    printf("{\"benchmark\":\"isr_dispatch_gateway\",\"routes\":%u,\"calls\":%u,\"cycles_per_call\":%.1f,\"max_cycles\":%llu,\"ns_per_call\":%.2f,\"forwarded\":%u,\"dropped\":%u,\"transmitted\":%u}\n",
+        routes, Isr.Calls, (double) Isr.Cycles / Isr.Calls, (unsigned long long) Isr.MaxCycles, Isr.Nanoseconds / Isr.Calls,
+        Gateway->getForwarded(routes - 1), Gateway->getDropped(routes - 1), Destination.getTransmittedFrames());
+}
+
+/**
+ * @brief Simulates the Target with the given Frame-Rate and returns the Number of dropped Frames.
+ *
+ * The Duration of an Interrupt-Routine is modelled from its SPI-Transactions, the loop() reads the Data immediately afterwards.
+ */
+static uint32_t simulateRate(double rate, uint8_t count, bool withBus, double spiUs, double isrUs)
+{
+    setupReceive(count, withBus);
+
+    double CpuFree = 0;
+    double PendingSince = 0;
+    uint32_t Dropped = 0;
+
+    for (uint32_t k = 0; k < BENCH_RATE_FRAMES; k++)
+    {
+        double Arrival = k * 1e6 / rate;
+
+        // Interrupt-Routines they start before the next Frame arrives
+        while (Controller.interruptPending())
+        {
+            double Start = CpuFree > PendingSince ? CpuFree : PendingSince;
+
+            if (Start >= Arrival)
+            {
+                break;
+            }
+
+            uint32_t Spi = Controller.getSpiTransactions();
+            runIsr(count);
+            CpuFree = Start + isrUs + (Controller.getSpiTransactions() - Spi) * spiUs;
+            PendingSince = CpuFree;
+            drainMessages(count);
+        }
+
+        bool WasPending = Controller.interruptPending();
+
+        if (!Controller.receiveFrame(makeFrame(0x100 + (k * 7) % count, (uint8_t) k)))
+        {
+            Dropped++;
+        }
+
+        if (!WasPending && Controller.interruptPending())
+        {
+            PendingSince = Arrival;
+        }
+    }
+    return Dropped;
+}
+
+static void benchmarkRate(uint8_t count, bool withBus, double spiUs, double isrUs)
+{
+    double Low = 100;
+    double High = 200000;
+
+    // Highest Frame-Rate without a dropped Frame
+    for (uint8_t i = 0; i < 30 && High - Low > 10; i++)
+    {
+        double Rate = (Low + High) / 2;
+
+        if (simulateRate(Rate, count, withBus, spiUs, isrUs) == 0)
+        {
+            Low = Rate;
+        } else {
+            High = Rate;
+        }
+    }
+
+    printf("{\"benchmark\":\"%s\",\"messages\":%u,\"spi_us\":%.1f,\"isr_us\":%.1f,\"max_frames_per_s_without_drop\":%.0f}\n",
+        withBus ? "drop_rate_dispatch" : "drop_rate_check_receive", count, spiUs, isrUs, Low);
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t Rounds = argc > 1 ? (uint32_t) atoi(argv[1]) : 20000;
+    const double SpiUs = argc > 2 ? atof(argv[2]) : 8.0;
+    const double IsrUs = argc > 3 ? atof(argv[3]) : 5.0;
+    const uint8_t Counts[] = { 1, 4, 8, 16, 32 };
+
+    // Cycles of an empty Measurement
+    uint64_t Min = ~(uint64_t) 0;
+    for (uint16_t i = 0; i < 1000; i++)
+    {
+        uint64_t Cycles = BENCH_CYCLES();
+        Cycles = BENCH_CYCLES() - Cycles;
+        Min = Cycles < Min ? Cycles : Min;
+    }
+    Overhead = Min;
+
+    benchmarkApi(Rounds);
+    benchmarkStaticApi(Rounds);
+    benchmarkFD(Rounds);
+
+    for (uint8_t i = 0; i < sizeof(Counts) && Counts[i] <= BENCH_MAX_MESSAGES; i++)
+    {
+        benchmarkIsr(Rounds / 4, Counts[i], false);
+        benchmarkIsr(Rounds / 4, Counts[i], true);
+    }
+
+    benchmarkBusLoad(Rounds / 4, BENCH_MAX_MESSAGES, CANBUSLOAD_STUFFING_WORST_CASE);
+    benchmarkBusLoad(Rounds / 4, BENCH_MAX_MESSAGES, CANBUSLOAD_STUFFING_ACTUAL);
+    benchmarkHandlers(Rounds / 4, BENCH_MAX_MESSAGES);
+    benchmarkGateway(Rounds / 4, 1);
+    benchmarkGateway(Rounds / 4, CANGATEWAY_MAX_ROUTES);
+
+    for (uint8_t i = 0; i < sizeof(Counts) && Counts[i] <= BENCH_MAX_MESSAGES; i++)
+    {
+        benchmarkRate(Counts[i], false, SpiUs, IsrUs);
+        benchmarkRate(Counts[i], true, SpiUs, IsrUs);
+    }
+
+    return 0;
+}
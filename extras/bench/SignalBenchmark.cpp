@@ -0,0 +1,147 @@
+/**
+ * @file SignalBenchmark.cpp
+ * @author MH-Tobi
+ * @brief Host-Benchmark of the Compile-Time Signal-Codec (CANSignal) against a generic Runtime-Bit-Extractor.
+ *
+ * Build and run on Linux with: make run
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <CANSignal.h>
+
+
+constexpr CANSignalDescriptor Counter12 = { 0, 12, CANMESSAGE_BYTEORDER_INTEL, false, 1.0f, 0.0f };
+constexpr CANSignalDescriptor Temperature = { 12, 10, CANMESSAGE_BYTEORDER_INTEL, true, 0.1f, -40.0f };
+constexpr CANSignalDescriptor Speed = { 39, 16, CANMESSAGE_BYTEORDER_MOTOROLA, false, 0.01f, 0.0f };
+constexpr CANSignalDescriptor Torque = { 52, 13, CANMESSAGE_BYTEORDER_MOTOROLA, true, 0.5f, 0.0f };
+
+static const CANSignalDescriptor *const Descriptors[] = { &Counter12, &Temperature, &Speed, &Torque };
+
+
+/**
+ * @brief Generic Bit-Extractor, interprets the Descriptor at Runtime (one Bit per Iteration).
+ */
+static int32_t runtimeUnpack(const uint8_t *Data, const CANSignalDescriptor &D)
+{
+    uint32_t Value = 0;
+    uint8_t Bit = D.StartBit;
+
+    for (uint8_t i = 0; i < D.Length; i++)
+    {
+        uint8_t Set = (Data[Bit / 8] >> (Bit % 8)) & 0x01;
+
+        if (D.ByteOrder == CANMESSAGE_BYTEORDER_INTEL)
+        {
+            Value |= (uint32_t) Set << i;
+            Bit++;
+        } else {
+            Value = (Value << 1) | Set;
+
+            if ((Bit % 8) == 0)
+            {
+                Bit += 15;
+            } else {
+                Bit--;
+            }
+        }
+    }
+
+    if (D.Signed && (Value & ((uint32_t) 1 << (D.Length - 1))) != 0 && D.Length < 32)
+    {
+        Value |= ~(((uint32_t) 1 << D.Length) - 1);
+    }
+    return (int32_t) Value;
+}
+
+static int32_t templateUnpack(const uint8_t *Data, uint8_t Index)
+{
+    switch (Index)
+    {
+        case 0: return CANSignal<Counter12>::unpack(Data);
+        case 1: return CANSignal<Temperature>::unpack(Data);
+        case 2: return CANSignal<Speed>::unpack(Data);
+        default: return CANSignal<Torque>::unpack(Data);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t Frames = 4096;
+    const uint32_t Rounds = argc > 1 ? (uint32_t) atoi(argv[1]) : 2000;
+    static uint8_t Payload[Frames][8];
+
+    srand(1);
+    for (uint32_t f = 0; f < Frames; f++)
+    {
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            Payload[f][i] = (uint8_t) rand();
+        }
+    }
+
+    // Both Codecs must return the same Values, pack() must restore the Payload
+    for (uint32_t f = 0; f < Frames; f++)
+    {
+        for (uint8_t s = 0; s < 4; s++)
+        {
+            if (runtimeUnpack(Payload[f], *Descriptors[s]) != templateUnpack(Payload[f], s))
+            {
+                printf("{\"error\":\"mismatch\",\"frame\":%u,\"signal\":%u}\n", f, s);
+                return 1;
+            }
+        }
+
+        uint8_t Copy[8] = { 0 };
+        CANSignal<Counter12>::pack(Copy, CANSignal<Counter12>::unpack(Payload[f]));
+        CANSignal<Temperature>::pack(Copy, CANSignal<Temperature>::unpack(Payload[f]));
+        CANSignal<Speed>::pack(Copy, CANSignal<Speed>::unpack(Payload[f]));
+        CANSignal<Torque>::pack(Copy, CANSignal<Torque>::unpack(Payload[f]));
+
+        if (CANSignal<Speed>::unpack(Copy) != CANSignal<Speed>::unpack(Payload[f]) || CANSignal<Torque>::unpack(Copy) != CANSignal<Torque>::unpack(Payload[f]))
+        {
+            printf("{\"error\":\"pack\",\"frame\":%u}\n", f);
+            return 1;
+        }
+    }
+
+    volatile int32_t Sink = 0;
+    int32_t Sum = 0;
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < Rounds; r++)
+    {
+        for (uint32_t f = 0; f < Frames; f++)
+        {
+            for (uint8_t s = 0; s < 4; s++)
+            {
+                Sum += runtimeUnpack(Payload[f], *Descriptors[s]);
+            }
+        }
+    }
+    Sink = Sum;
+    double Runtime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count();
+
+    Sum = 0;
+    Start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < Rounds; r++)
+    {
+        for (uint32_t f = 0; f < Frames; f++)
+        {
+            Sum += CANSignal<Counter12>::unpack(Payload[f]);
+            Sum += CANSignal<Temperature>::unpack(Payload[f]);
+            Sum += CANSignal<Speed>::unpack(Payload[f]);
+            Sum += CANSignal<Torque>::unpack(Payload[f]);
+        }
+    }
+    Sink = Sum;
+    double Template = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count();
+    (void) Sink;
+
+    double Signals = (double) Rounds * Frames * 4;
+    printf("{\"benchmark\":\"signal_unpack\",\"signals\":%.0f,\"runtime_ns_per_signal\":%.3f,\"template_ns_per_signal\":%.3f,\"speedup\":%.2f}\n",
+        Signals, Runtime / Signals, Template / Signals, Runtime / Template);
+
+    return 0;
+}
@@ -0,0 +1,474 @@
+/**
+ * @file CaptureTool.cpp
+ * @author MH-Tobi
+ * @brief Host-Tool for the Captures of a CANCapture: Conversion to candump- and ASC-Files and Replay on the Loopback-Controller.
+ *
+ * The Capture-File is the raw Output of CANCapture::stream() (e.g. saved from the Serial-Port), other Output between the Bursts is skipped.
+ * The Replay injects the received Frames into the Loopback-Controller and dispatches them, the sent Frames go through the Transmit-Queue.
+ * The replayed Traffic is captured again and compared with the File, so a Field-Capture serves as Regression- and Throughput-Test.
+ * Build on Linux with: make
+ *
+ * Usage: CaptureTool candump <file> [interface]
+ *        CaptureTool asc <file>
+ *        CaptureTool replay <file> [fast|realtime] [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <CANBus.h>
+#include <CANCapture.h>
+
+#if !CANMESSAGE_CAPTURE
+#error "CaptureTool needs the Library with -DCANMESSAGE_CAPTURE=1 (see Makefile)"
+#endif
+
+
+/**
+ * @brief Record of the File with its Time since the Start of the Capture.
+ */
+struct Entry
+{
+    CANCaptureRecord Record;
+    double Time;                    // s
+};
+
+struct Capture
+{
+    std::vector<Entry> Entries;     // Frames only, the Gap-Records are added to the Time
+    uint32_t Bursts;
+    uint32_t BadBursts;             // Checksum wrong or File truncated
+    uint32_t LostRecords;           // Gaps of the Sequence
+};
+
+/**
+ * @brief Reads all Bursts of a Capture-File.
+ */
+static bool load(const char *path, Capture &capture)
+{
+    FILE *File = fopen(path, "rb");
+
+    if (File == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    std::vector<uint8_t> Data;
+    uint8_t Chunk[4096];
+    size_t Length;
+
+    while ((Length = fread(Chunk, 1, sizeof(Chunk), File)) > 0)
+    {
+        Data.insert(Data.end(), Chunk, Chunk + Length);
+    }
+    fclose(File);
+
+    double Time = 0;
+    bool First = true;
+    uint8_t Sequence = 0;
+    size_t Position = 0;
+
+    capture.Bursts = 0;
+    capture.BadBursts = 0;
+    capture.LostRecords = 0;
+
+    while (Position + CANCAPTURE_BURST_HEADER <= Data.size())
+    {
+        if (Data[Position] != CANCAPTURE_SYNC_0 || Data[Position + 1] != CANCAPTURE_SYNC_1)
+        {
+            Position++;
+            continue;
+        }
+
+        uint8_t Count = Data[Position + 2];
+        uint16_t Resolution = (uint16_t) (Data[Position + 3] | (Data[Position + 4] << 8));
+        size_t End = Position + CANCAPTURE_BURST_HEADER + (size_t) Count * CANCAPTURE_RECORD_SIZE;
+        uint8_t Checksum = 0;
+
+        if (Count == 0 || Resolution == 0 || End >= Data.size())
+        {
+            capture.BadBursts += End >= Data.size() ? 1 : 0;
+            Position++;
+            continue;
+        }
+
+        for (size_t i = Position + 2; i < End; i++)
+        {
+            Checksum ^= Data[i];
+        }
+
+        if (Checksum != Data[End])
+        {
+            capture.BadBursts++;
+            Position++;
+            continue;
+        }
+
+        for (uint8_t i = 0; i < Count; i++)
+        {
+            Entry Current;
+
+            CANCapture::decode(&Data[Position + CANCAPTURE_BURST_HEADER + i * CANCAPTURE_RECORD_SIZE], Current.Record);
+
+            if (!First && Current.Record.Sequence != Sequence)
+            {
+                capture.LostRecords += (uint8_t) (Current.Record.Sequence - Sequence);
+            }
+
+            First = false;
+            Sequence = Current.Record.Sequence + 1;
+
+            if ((Current.Record.Control & CANCAPTURE_CONTROL_GAP) != 0)
+            {
+                Time += Current.Record.Descriptor * (Resolution / 1e6);
+                continue;
+            }
+
+            Time += Current.Record.Delta * (Resolution / 1e6);
+            Current.Time = Time;
+            capture.Entries.push_back(Current);
+        }
+
+        capture.Bursts++;
+        Position = End + 1;
+    }
+
+    if (capture.BadBursts != 0 || capture.LostRecords != 0)
+    {
+        fprintf(stderr, "%s: %u damaged Bursts, %u lost Records\n", path, capture.BadBursts, capture.LostRecords);
+    }
+
+    return true;
+}
+
+static uint32_t recordId(const CANCaptureRecord &record)
+{
+    return record.Descriptor & CANMESSAGE_DESCRIPTOR_ID_MASK;
+}
+
+static bool isExtended(const CANCaptureRecord &record)
+{
+    return (record.Descriptor & CANMESSAGE_DESCRIPTOR_EXTENDED) != 0;
+}
+
+static bool isRemote(const CANCaptureRecord &record)
+{
+    return (record.Descriptor & CANMESSAGE_DESCRIPTOR_RTR) != 0;
+}
+
+static bool isTransmit(const CANCaptureRecord &record)
+{
+    return (record.Descriptor & CANMESSAGE_DESCRIPTOR_TRANSMIT) != 0;
+}
+
+/**
+ * @brief Returns the Number of recorded Data-Bytes (max. 8, also for CAN FD-Frames).
+ */
+static uint8_t recordLength(const CANCaptureRecord &record)
+{
+    uint8_t Length = canDlcToLength(record.Control & CANCAPTURE_CONTROL_DLC);
+
+    return isRemote(record) ? 0 : (Length > 8 ? 8 : Length);
+}
+
+/**
+ * @brief Writes the Frames in the Log-Format of candump (candump -l), CAN FD-Frames only with the recorded Bytes.
+ */
+static void writeCandump(const Capture &capture, const char *interface)
+{
+    for (size_t i = 0; i < capture.Entries.size(); i++)
+    {
+        const CANCaptureRecord &Record = capture.Entries[i].Record;
+        // Rounded once, so the Seconds carry over with the Microseconds and the Log stays monotonic
+        uint64_t Us = (uint64_t) llround(capture.Entries[i].Time * 1e6);
+
+        printf("(%010lu.%06lu) %s ", (unsigned long) (Us / 1000000), (unsigned long) (Us % 1000000), interface);
+        printf(isExtended(Record) ? "%08X" : "%03X", recordId(Record));
+
+        if (isRemote(Record))
+        {
+            printf("#R\n");
+            continue;
+        }
+
+        printf((Record.Control & CANCAPTURE_CONTROL_FD) != 0 ? "##0" : "#");
+
+        for (uint8_t j = 0; j < recordLength(Record); j++)
+        {
+            printf("%02X", Record.Data[j]);
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Writes the Frames in the ASC-Format of Vector (Channel 1, Timestamps relative to the Start of the Capture).
+ */
+static void writeAsc(const Capture &capture, const char *path)
+{
+    struct stat Info;
+    char Date[64] = "Thu Jan 1 12:00:00.000 am 1970";
+
+    // The Capture has no absolute Time, the Date of the File is used
+    if (stat(path, &Info) == 0)
+    {
+        strftime(Date, sizeof(Date), "%a %b %d %I:%M:%S.000 %p %Y", localtime(&Info.st_mtime));
+    }
+
+    printf("date %s\n", Date);
+    printf("base hex  timestamps absolute\n");
+    printf("no internal events logged\n");
+    printf("Begin Triggerblock %s\n", Date);
+    printf("   0.000000 Start of measurement\n");
+
+    for (size_t i = 0; i < capture.Entries.size(); i++)
+    {
+        const CANCaptureRecord &Record = capture.Entries[i].Record;
+        char Id[16];
+
+        snprintf(Id, sizeof(Id), isExtended(Record) ? "%Xx" : "%X", recordId(Record));
+
+        if ((Record.Control & CANCAPTURE_CONTROL_FD) != 0)
+        {
+            printf("%11.6f CANFD   1 %-4s %8s %32s 0 0 %X %2u", capture.Entries[i].Time, isTransmit(Record) ? "Tx" : "Rx", Id, "", Record.Control & CANCAPTURE_CONTROL_DLC, recordLength(Record));
+        } else if (isRemote(Record))
+        {
+            printf("%11.6f 1  %-15s %-4s r %X\n", capture.Entries[i].Time, Id, isTransmit(Record) ? "Tx" : "Rx", Record.Control & CANCAPTURE_CONTROL_DLC);
+            continue;
+        } else {
+            printf("%11.6f 1  %-15s %-4s d %X", capture.Entries[i].Time, Id, isTransmit(Record) ? "Tx" : "Rx", Record.Control & CANCAPTURE_CONTROL_DLC);
+        }
+
+        for (uint8_t j = 0; j < recordLength(Record); j++)
+        {
+            printf(" %02X", Record.Data[j]);
+        }
+        printf("\n");
+    }
+
+    printf("End TriggerBlock\n");
+}
+
+/**
+ * @brief Receive-Messages for the Replay, one per received Key of the Capture (up to CANBUS_MAX_MESSAGES).
+ */
+struct Receiver
+{
+    CANMessage Message;
+    CANReceiveFifo<4> Fifo;
+};
+
+/**
+ * @brief Replays the Capture once through Bus and Loopback-Controller and compares the captured Frames with the File.
+ * @return Number of Frames they do not match (ID, Direction, DLC or Data)
+ */
+static uint32_t replayOnce(const Capture &capture, bool realtime, uint32_t &frames, uint32_t &skipped, uint32_t &dropped, double &seconds)
+{
+    static CANLoopbackController Controller;
+    static CANCapture Recapture;
+    CANBus *Bus = new CANBus();
+    std::vector<Receiver *> Receivers;
+    std::vector<CANCaptureRecord> Expected;
+    std::vector<CANCaptureRecord> Replayed;
+    CANCaptureRecord Record;
+    CANFrame Frame;
+
+    Controller.init(500000);
+    Controller.resetStatistics();
+    Controller.bitModify(MCP2515_REGISTER_CANINTE, 0x03, 0x03);
+    Bus->init(Controller, 0);
+
+    for (size_t i = 0; i < capture.Entries.size() && Receivers.size() < CANBUS_MAX_MESSAGES; i++)
+    {
+        const CANCaptureRecord &Current = capture.Entries[i].Record;
+        uint8_t FrameType = isExtended(Current) ? CANMESSAGE_FRAME_EXTENDED : CANMESSAGE_FRAME_STANDARD;
+
+        if (isTransmit(Current) || isRemote(Current) || Bus->findMessage(recordId(Current), FrameType) != NULL)
+        {
+            continue;
+        }
+
+        Receiver *Next = new Receiver();
+
+        Next->Message.init(recordId(Current), 8, false, FrameType, CANMESSAGE_DIRECTION_RECEIVE, Controller);
+        Next->Message.attachFifo(Next->Fifo);
+        Bus->registerMessage(Next->Message);
+        Receivers.push_back(Next);
+    }
+
+    frames = 0;
+    skipped = 0;
+    Recapture.start(CANCAPTURE_MODE_STOP);
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < capture.Entries.size(); i++)
+    {
+        const CANCaptureRecord &Current = capture.Entries[i].Record;
+
+        // The Loopback-Controller models the MCP2515, CAN FD-Frames can not be replayed
+        if ((Current.Control & CANCAPTURE_CONTROL_FD) != 0)
+        {
+            skipped++;
+            continue;
+        }
+
+        if (realtime)
+        {
+            std::this_thread::sleep_until(Start + std::chrono::microseconds((long long) (capture.Entries[i].Time * 1e6)));
+        }
+
+        Frame.ID = recordId(Current);
+        Frame.Frame = isExtended(Current) ? CANMESSAGE_FRAME_EXTENDED : CANMESSAGE_FRAME_STANDARD;
+        Frame.RTR = isRemote(Current);
+        Frame.DLC = Current.Control & CANCAPTURE_CONTROL_DLC;
+        memcpy(Frame.Data, Current.Data, sizeof(Frame.Data));
+
+        if (isTransmit(Current))
+        {
+            if (Bus->enqueue(Frame))
+            {
+                Controller.transmit(Frame);
+                Bus->service();
+            }
+        } else {
+            Controller.receiveFrame(Frame);
+
+            // Interrupt-Routine
+            while (Controller.interruptPending())
+            {
+                Bus->dispatch();
+            }
+        }
+
+        for (size_t j = 0; j < Receivers.size(); j++)
+        {
+            while (Receivers[j]->Message.readFrame(Frame))
+            {
+            }
+        }
+
+        Expected.push_back(Current);
+        frames++;
+
+        while (Recapture.read(Record))
+        {
+            Replayed.push_back(Record);
+        }
+    }
+
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    Recapture.stop();
+    dropped = Controller.getOverflowFrames() + Controller.getFilteredFrames() + Recapture.getLost();
+
+    uint32_t Mismatches = 0;
+
+    for (size_t i = 0; i < Expected.size(); i++)
+    {
+        uint8_t Length = recordLength(Expected[i]);
+
+        if (i >= Replayed.size()
+            || Replayed[i].Descriptor != Expected[i].Descriptor
+            || (Replayed[i].Control & CANCAPTURE_CONTROL_DLC) != (Expected[i].Control & CANCAPTURE_CONTROL_DLC)
+            || memcmp(Replayed[i].Data, Expected[i].Data, Length) != 0)
+        {
+            Mismatches++;
+        }
+    }
+
+    for (size_t j = 0; j < Receivers.size(); j++)
+    {
+        delete Receivers[j];
+    }
+    delete Bus;
+
+    return Mismatches;
+}
+
+/**
+ * @brief Replays the Capture and prints the Result as one JSON-Line.
+ */
+static int replay(const Capture &capture, bool realtime, uint32_t rounds)
+{
+    uint32_t Frames = 0;
+    uint32_t Skipped = 0;
+    uint32_t Dropped = 0;
+    uint32_t Mismatches = 0;
+    double Seconds = 0;
+
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        uint32_t RoundFrames;
+        uint32_t RoundSkipped;
+        uint32_t RoundDropped;
+        double RoundSeconds;
+
+        Mismatches += replayOnce(capture, realtime, RoundFrames, RoundSkipped, RoundDropped, RoundSeconds);
+        Frames += RoundFrames;
+        Skipped += RoundSkipped;
+        Dropped += RoundDropped;
+        Seconds += RoundSeconds;
+    }
+
+    double Duration = capture.Entries.empty() ? 0 : capture.Entries.back().Time * rounds;
+
+    printf("{\"benchmark\":\"capture_replay\",\"mode\":\"%s\",\"rounds\":%u,\"frames\":%u,\"skipped_fd\":%u,\"seconds\":%.6f,\"frames_per_s\":%.0f,"
+        "\"capture_seconds\":%.6f,\"speedup\":%.1f,\"dropped\":%u,\"mismatches\":%u,\"lost_records\":%u}\n",
+        realtime ? "realtime" : "fast", rounds, Frames, Skipped, Seconds, Seconds > 0 ? Frames / Seconds : 0,
+        Duration, Seconds > 0 ? Duration / Seconds : 0, Dropped, Mismatches, capture.LostRecords);
+
+    return Mismatches == 0 && Dropped == 0 ? 0 : 2;
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: CaptureTool candump <file> [interface]\n");
+    fprintf(stderr, "       CaptureTool asc <file>\n");
+    fprintf(stderr, "       CaptureTool replay <file> [fast|realtime] [rounds]\n");
+}
+
+int main(int argc, char **argv)
+{
+    Capture Loaded;
+
+    if (argc < 3)
+    {
+        usage();
+        return 1;
+    }
+
+    if (!load(argv[2], Loaded))
+    {
+        return 1;
+    }
+
+    if (strcmp(argv[1], "candump") == 0)
+    {
+        writeCandump(Loaded, argc > 3 ? argv[3] : "can0");
+        return 0;
+    }
+
+    if (strcmp(argv[1], "asc") == 0)
+    {
+        writeAsc(Loaded, argv[2]);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "replay") == 0)
+    {
+        bool Realtime = argc > 3 && strcmp(argv[3], "realtime") == 0;
+        uint32_t Rounds = argc > 4 ? (uint32_t) strtoul(argv[4], NULL, 10) : 1;
+
+        return replay(Loaded, Realtime, Rounds > 0 ? Rounds : 1);
+    }
+
+    usage();
+    return 1;
+}
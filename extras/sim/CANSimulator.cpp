@@ -0,0 +1,465 @@
+#include "CANSimulator.h"
+#include <CANBusLoad.h>
+#include <algorithm>
+#include <cmath>
+
+CANSimulator *CANSimulator::_Active = NULL;
+
+
+/**
+ * @brief Constructor, the virtual Time starts at 0 and replaces the Clock of the Host (millis(), micros()).
+ * @param bitrate Bitrate of the Bus in bit/s
+ * @param seed Seed of the Random-Generator (Error-Frames, random() of the Applications)
+ */
+CANSimulator::CANSimulator(uint32_t bitrate, uint32_t seed)
+{
+    _Now = 0;
+    _Bitrate = bitrate > 0 ? bitrate : 500000;
+    _BitTime = 1000000000UL / _Bitrate;
+    _Seed = seed;
+    _Random = seed != 0 ? seed : 0x9E3779B9;
+    _ErrorRate = 0;
+    _BusyTime = 0;
+    _Frames = 0;
+    _ErrorFrames = 0;
+    _Collisions = 0;
+
+    _Active = this;
+    canHostClock() = _clock;
+}
+
+/**
+ * @brief Destructor, the Host-Clock is the steady Clock again.
+ */
+CANSimulator::~CANSimulator()
+{
+    if (_Active == this)
+    {
+        _Active = NULL;
+        canHostClock() = NULL;
+    }
+}
+
+/**
+ * @brief Adds a Node, setup() of the Node is called at once (Time 0).
+ * @param node Node
+ * @return true when success, false when CANSIM_MAX_NODES are added
+ */
+bool CANSimulator::addNode(CANSimNode &node)
+{
+    if (_Nodes.size() >= CANSIM_MAX_NODES)
+    {
+        return false;
+    }
+
+    NodeState State;
+
+    State.Node = &node;
+    State.NextLoop = _Now;
+    State.NextIsr = CANSIM_NEVER;
+    State.Sent = 0;
+    State.ArbitrationLosses = 0;
+    State.Errors = 0;
+    State.Tec = 0;
+    State.BusOff = false;
+    State.LatencySum = 0;
+    State.LatencyMax = 0;
+    State.Histogram.assign(CANSIM_HISTOGRAM_US + 1, 0);
+    State.Overflow.clear();
+
+    for (uint8_t i = 0; i < CANLOOPBACK_TX_BUFFERS; i++)
+    {
+        State.LoadTime[i] = CANSIM_NEVER;
+    }
+
+    node.Controller.init(_Bitrate);
+    node.Bus.init(node.Controller, 0);
+
+    if (node.IsrLatency != CANSIM_NO_ISR)
+    {
+        node.Controller.bitModify(MCP2515_REGISTER_CANINTE, MCP2515_CANINT_RX0I | (MCP2515_CANINT_RX0I << 1), 0xFF);
+    }
+
+    node.setup();
+
+    _Nodes.push_back(State);
+    _trackLoads(_Nodes.back());
+
+    return true;
+}
+
+/**
+ * @brief Sets the Probability of an Error-Frame per Frame.
+ * @param perFrame Probability (0 - 1)
+ */
+void CANSimulator::setErrorRate(double perFrame)
+{
+    if (perFrame <= 0)
+    {
+        _ErrorRate = 0;
+    } else {
+        _ErrorRate = perFrame >= 1 ? 0xFFFFFFFF : (uint32_t) (perFrame * 4294967296.0);
+    }
+}
+
+/**
+ * @brief Runs the Simulation.
+ * @param duration Virtual Time in us
+ */
+void CANSimulator::run(uint32_t duration)
+{
+    uint64_t End = _Now + (uint64_t) duration * 1000;
+
+    while (_Now < End)
+    {
+        _runUntil(_Now, true);
+
+        if (_arbitrate())
+        {
+            continue;
+        }
+
+        // Bus idle until the next Node-Event
+        uint64_t Next = _nextEvent();
+
+        _Now = Next < End ? Next : End;
+    }
+}
+
+/**
+ * @brief Returns a deterministic Random-Number (xorshift32), e.g. for the Payloads and Jitter of the Applications.
+ */
+uint32_t CANSimulator::random()
+{
+    _Random ^= _Random << 13;
+    _Random ^= _Random >> 17;
+    _Random ^= _Random << 5;
+
+    return _Random;
+}
+
+/**
+ * @brief Returns the virtual Time in ns.
+ */
+uint64_t CANSimulator::getTime()
+{
+    return _Now;
+}
+
+/**
+ * @brief Returns the Load of the Bus since the Start in % (Frames and Error-Frames).
+ */
+float CANSimulator::getLoad()
+{
+    return _Now > 0 ? (float) (_BusyTime * 100.0 / _Now) : 0;
+}
+
+/**
+ * @brief Prints one JSON-Line per Node and one for the Bus.
+ * @param out Output
+ */
+void CANSimulator::printResults(FILE *out)
+{
+    for (size_t i = 0; i < _Nodes.size(); i++)
+    {
+        NodeState &State = _Nodes[i];
+        CANSimNode &Node = *State.Node;
+        CANBusStatistics Stats;
+        uint32_t Latencies = 0;
+
+        Node.Bus.getStatistics(Stats);
+
+        for (size_t j = 0; j < State.Histogram.size(); j++)
+        {
+            Latencies += State.Histogram[j];
+        }
+
+        fprintf(out, "{\"benchmark\":\"sim_node\",\"seed\":%u,\"node\":\"%s\",\"sent\":%u,\"arbitration_losses\":%u,\"tx_errors\":%u,\"tec\":%u,\"bus_off\":%s,"
+            "\"latency_avg_us\":%.1f,\"latency_p99_us\":%u,\"latency_max_us\":%.1f,\"received\":%u,\"rx_overflow\":%u,\"rejected\":%u,\"tx_queue_full\":%u,\"tx_aborts\":%u",
+            _Seed, Node.Name, State.Sent, State.ArbitrationLosses, State.Errors, State.Tec, State.BusOff ? "true" : "false",
+            Latencies > 0 ? State.LatencySum / 1000.0 / Latencies : 0, _percentile(State, 0.99), State.LatencyMax / 1000.0,
+            Node.Controller.getReceivedFrames(), Node.Controller.getOverflowFrames(), Stats.RejectedFrames, Stats.TxQueueFull, Stats.TxAborts);
+        Node.printResults(out);
+        fprintf(out, "}\n");
+    }
+
+    fprintf(out, "{\"benchmark\":\"sim_bus\",\"seed\":%u,\"nodes\":%u,\"bitrate\":%u,\"time_s\":%.3f,\"frames\":%u,\"error_frames\":%u,\"collisions\":%u,\"load_percent\":%.1f}\n",
+        _Seed, (unsigned) _Nodes.size(), _Bitrate, _Now / 1e9, _Frames, _ErrorFrames, _Collisions, getLoad());
+}
+
+/**
+ * @brief Host-Clock of the active Simulator in us.
+ */
+unsigned long long CANSimulator::_clock()
+{
+    return _Active != NULL ? _Active->_Now / 1000 : 0;
+}
+
+/**
+ * @brief Runs all Node-Events up to a Time in the Order of their Time (equal Times: Interrupt before loop(), lower Node first).
+ * @param time End in ns
+ * @param inclusive true = also the Events at the End
+ */
+void CANSimulator::_runUntil(uint64_t time, bool inclusive)
+{
+    uint64_t Start = _Now;
+
+    while (true)
+    {
+        NodeState *Next = NULL;
+        bool Isr = false;
+        uint64_t NextTime = CANSIM_NEVER;
+
+        for (size_t i = 0; i < _Nodes.size(); i++)
+        {
+            if (_Nodes[i].NextIsr < NextTime)
+            {
+                Next = &_Nodes[i];
+                NextTime = _Nodes[i].NextIsr;
+                Isr = true;
+            }
+
+            if (_Nodes[i].NextLoop < NextTime)
+            {
+                Next = &_Nodes[i];
+                NextTime = _Nodes[i].NextLoop;
+                Isr = false;
+            }
+        }
+
+        if (Next == NULL || NextTime > time || (!inclusive && NextTime == time))
+        {
+            break;
+        }
+
+        _Now = NextTime > Start ? NextTime : Start;
+        _runNode(*Next, Isr);
+    }
+
+    _Now = time > Start ? time : Start;
+}
+
+/**
+ * @brief Runs the Interrupt-Routine or loop() of a Node.
+ */
+void CANSimulator::_runNode(NodeState &state, bool isr)
+{
+    CANSimNode &Node = *state.Node;
+
+    if (isr)
+    {
+        state.NextIsr = CANSIM_NEVER;
+        Node.interrupt();
+    } else {
+        state.NextLoop += (uint64_t) Node.LoopPeriod * 1000;
+        Node.loop();
+    }
+
+    _trackLoads(state);
+}
+
+/**
+ * @brief Notes the Load-Time of newly loaded Transmit-Buffers and arms the Interrupt-Routine.
+ */
+void CANSimulator::_trackLoads(NodeState &state)
+{
+    CANSimNode &Node = *state.Node;
+    uint8_t Requests = Node.Controller.getTransmitRequests();
+
+    for (uint8_t i = 0; i < CANLOOPBACK_TX_BUFFERS; i++)
+    {
+        if ((Requests & (1 << i)) == 0)
+        {
+            state.LoadTime[i] = CANSIM_NEVER;
+        } else if (state.LoadTime[i] == CANSIM_NEVER)
+        {
+            state.LoadTime[i] = _Now;
+        }
+    }
+
+    if (Node.IsrLatency != CANSIM_NO_ISR && state.NextIsr == CANSIM_NEVER && Node.Controller.interruptPending())
+    {
+        // An Interrupt-Routine they does not clear its Flag is called again after 1us at the latest
+        state.NextIsr = _Now + (uint64_t) (Node.IsrLatency > 0 ? Node.IsrLatency : 1) * 1000;
+    }
+}
+
+/**
+ * @brief Returns the Time of the next Node-Event in ns.
+ */
+uint64_t CANSimulator::_nextEvent()
+{
+    uint64_t Next = CANSIM_NEVER;
+
+    for (size_t i = 0; i < _Nodes.size(); i++)
+    {
+        Next = _Nodes[i].NextIsr < Next ? _Nodes[i].NextIsr : Next;
+        Next = _Nodes[i].NextLoop < Next ? _Nodes[i].NextLoop : Next;
+    }
+    return Next;
+}
+
+/**
+ * @brief Arbitrates the pending Frames of all Nodes and transmits the Winner.
+ * @return true when a Frame (or Error-Frame) was on the Bus, false when no Node had a Frame
+ */
+bool CANSimulator::_arbitrate()
+{
+    NodeState *Winner = NULL;
+    int8_t WinnerBuffer = -1;
+    uint32_t WinnerKey = 0;
+    uint8_t Competitors = 0;
+    CANFrame Frame;
+    CANFrame Candidate;
+
+    for (size_t i = 0; i < _Nodes.size(); i++)
+    {
+        if (_Nodes[i].BusOff)
+        {
+            continue;
+        }
+
+        int8_t Buffer = _Nodes[i].Node->Controller.peekTransmit(Candidate);
+
+        if (Buffer < 0)
+        {
+            continue;
+        }
+
+        uint32_t Key = CANBus::arbitrationKey(Candidate);
+
+        Competitors++;
+
+        if (Winner == NULL || Key < WinnerKey)
+        {
+            if (Winner != NULL)
+            {
+                Winner->ArbitrationLosses++;
+            }
+
+            Winner = &_Nodes[i];
+            WinnerBuffer = Buffer;
+            WinnerKey = Key;
+            Frame = Candidate;
+        } else {
+            _Nodes[i].ArbitrationLosses++;
+        }
+    }
+
+    if (Winner == NULL)
+    {
+        return false;
+    }
+
+    if (Competitors > 1)
+    {
+        _Collisions++;
+    }
+
+    uint64_t Start = _Now;
+    uint64_t End = Start + (uint64_t) CANBusLoad::frameBits(Frame) * _BitTime;
+
+    // Error-Frame: the Frame is destroyed and stays in the Transmit-Buffer for the Retransmission
+    if (_ErrorRate != 0 && random() < _ErrorRate)
+    {
+        uint32_t ErrorBits = CANSIM_ERROR_FLAG_BITS + random() % (CANSIM_ERROR_FLAG_BITS + 1) + CANSIM_ERROR_DELIMITER_BITS;
+
+        End += (uint64_t) ErrorBits * _BitTime;
+        _runUntil(End, false);
+        _BusyTime += End - Start;
+        _ErrorFrames++;
+        Winner->Errors++;
+        Winner->Tec += CANSIM_TEC_ERROR;
+
+        if (Winner->Tec > CANSIM_TEC_BUS_OFF)
+        {
+            Winner->BusOff = true;
+        }
+        return true;
+    }
+
+    // Events during the Frame can not take part in this Arbitration
+    _runUntil(End, false);
+    _BusyTime += End - Start;
+    _Frames++;
+
+    CANSimNode &Node = *Winner->Node;
+
+    // The Frame may have been aborted in the Meantime (Transmit-Queue of the Bus)
+    if (Node.Controller.peekTransmit(Candidate) == WinnerBuffer && CANBus::arbitrationKey(Candidate) == WinnerKey)
+    {
+        Node.Controller.transmit(Candidate);
+        Winner->Sent++;
+        Winner->Tec = Winner->Tec > 0 ? Winner->Tec - 1 : 0;
+
+        if (Winner->LoadTime[WinnerBuffer] != CANSIM_NEVER)
+        {
+            _recordLatency(*Winner, End - Winner->LoadTime[WinnerBuffer]);
+        }
+        Winner->LoadTime[WinnerBuffer] = CANSIM_NEVER;
+        _trackLoads(*Winner);
+    }
+
+    for (size_t i = 0; i < _Nodes.size(); i++)
+    {
+        if (&_Nodes[i] != Winner)
+        {
+            _Nodes[i].Node->Controller.receiveFrame(Frame);
+            _trackLoads(_Nodes[i]);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Adds a Latency (ns) to the Statistics of a Node.
+ */
+void CANSimulator::_recordLatency(NodeState &state, uint64_t latency)
+{
+    uint64_t Bucket = latency / 1000;
+
+    state.LatencySum += latency;
+    state.LatencyMax = latency > state.LatencyMax ? latency : state.LatencyMax;
+    state.Histogram[Bucket < CANSIM_HISTOGRAM_US ? Bucket : CANSIM_HISTOGRAM_US]++;
+
+    if (Bucket >= CANSIM_HISTOGRAM_US)
+    {
+        state.Overflow.push_back((uint32_t) Bucket);
+    }
+}
+
+/**
+ * @brief Returns the Latency in us they is not exceeded by the Fraction of the Frames of a Node.
+ */
+uint32_t CANSimulator::_percentile(const NodeState &state, double fraction)
+{
+    uint64_t Total = 0;
+    uint64_t Count = 0;
+
+    for (size_t i = 0; i < state.Histogram.size(); i++)
+    {
+        Total += state.Histogram[i];
+    }
+
+    for (size_t i = 0; i < state.Histogram.size(); i++)
+    {
+        Count += state.Histogram[i];
+
+        if (Total > 0 && Count >= Total * fraction)
+        {
+            if (i < CANSIM_HISTOGRAM_US)
+            {
+                return (uint32_t) i;
+            }
+
+            // The Percentile is above the Histogram: take it from the sorted Latencies of the last Bucket
+            std::vector<uint32_t> Overflow(state.Overflow);
+            uint64_t Rank = (uint64_t) std::ceil(Total * fraction) - (Count - state.Histogram[i]);
+
+            std::sort(Overflow.begin(), Overflow.end());
+            return Overflow[Rank > 0 ? Rank - 1 : 0];
+        }
+    }
+    return 0;
+}
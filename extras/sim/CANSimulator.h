@@ -0,0 +1,142 @@
+/**
+ * @file CANSimulator.h
+ * @author MH-Tobi
+ * @brief Deterministic Virtual-Time Simulation of several Nodes (Loopback-Controller, CANBus and Application) on one Bus.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANSIMULATOR_H
+#define CANSIMULATOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <CANBus.h>
+
+
+#define CANSIM_MAX_NODES                16
+#define CANSIM_NO_ISR                   0xFFFFFFFF  // Node without Interrupt-Routine (polls in loop())
+#define CANSIM_NEVER                    0xFFFFFFFFFFFFFFFFULL
+#define CANSIM_HISTOGRAM_US             20000       // Latencies above are counted in the last Bucket and kept in the Overflow-List
+#define CANSIM_ERROR_FLAG_BITS          6           // Error-Flag, superposed by the Flags of the other Nodes (up to 6 more Bits)
+#define CANSIM_ERROR_DELIMITER_BITS     11          // Error-Delimiter (8) and Interframe-Space (3)
+#define CANSIM_TEC_ERROR                8           // Transmit-Error-Counter per Error as Transmitter
+#define CANSIM_TEC_BUS_OFF              255         // Above the Node goes Bus-Off and stops transmitting
+
+
+/**
+ * @brief Application of a Node: owns its Controller and Bus, the Messages are initialised with the Controller.
+ *
+ * setup() is called once at Time 0, loop() with the Loop-Period of the Node and interrupt() when the Interrupt-Pin
+ * of the Controller is active (after the Interrupt-Latency). millis() and micros() return the virtual Time.
+ */
+class CANSimNode
+{
+	public:
+        CANLoopbackController Controller;
+        CANBus Bus;
+
+        const char *Name;
+        uint32_t LoopPeriod;                // us between two Calls of loop()
+        uint32_t IsrLatency;                // us from the Interrupt to interrupt(), CANSIM_NO_ISR = no Interrupt-Routine
+
+        CANSimNode(const char *name, uint32_t loopPeriod, uint32_t isrLatency = 0) :
+            Name(name),
+            LoopPeriod(loopPeriod > 0 ? loopPeriod : 1),
+            IsrLatency(isrLatency)
+        {
+        }
+
+        virtual ~CANSimNode() {}
+
+        virtual void setup() = 0;
+        virtual void loop() = 0;
+
+        /**
+         * @brief Interrupt-Routine, default is the Receive-Dispatcher of the Bus.
+         */
+        virtual void interrupt()
+        {
+            Bus.dispatch();
+        }
+
+        /**
+         * @brief Prints additional Results of the Application as JSON-Fields (e.g. ,"misses":3).
+         */
+        virtual void printResults(FILE *) {}
+};
+
+
+/**
+ * @brief Shared Bus with bitwise Arbitration, exact Frame-Lengths (Bit-Stuffing) and Error-Frames.
+ *
+ * The Nodes load their Transmit-Buffers in loop() and interrupt(), at each free Bus the Frame with the lowest
+ * Arbitration-Key of all Nodes wins (equal Keys: the lower Node-Number). The Frame is stored in the Receive-Buffers
+ * of all other Nodes at its End, so a Node they do not read its Receive-Buffers in Time loses Frames (Overflow).
+ * With an Error-Rate a Frame is destroyed by an Error-Frame and repeated by its Transmitter.
+ * All Decisions depend only on the Seed, so each Run with the same Seed gives the same Result.
+ */
+class CANSimulator
+{
+	private:
+        struct NodeState
+        {
+            CANSimNode *Node;
+            uint64_t NextLoop;              // ns
+            uint64_t NextIsr;               // ns, CANSIM_NEVER = no Interrupt pending
+            uint64_t LoadTime[CANLOOPBACK_TX_BUFFERS];  // Time the Transmit-Buffer was loaded, CANSIM_NEVER = empty
+            uint32_t Sent;                  // Frames won the Arbitration and transmitted
+            uint32_t ArbitrationLosses;
+            uint32_t Errors;                // Error-Frames as Transmitter
+            uint16_t Tec;                   // Transmit-Error-Counter
+            bool BusOff;
+            uint64_t LatencySum;            // ns
+            uint64_t LatencyMax;
+            std::vector<uint32_t> Histogram; // 1us Buckets
+            std::vector<uint32_t> Overflow; // us, Latencies of the last Bucket (exact Percentiles above the Histogram)
+        };
+
+        std::vector<NodeState> _Nodes;
+        uint64_t _Now;                      // ns
+        uint32_t _BitTime;                  // ns
+        uint32_t _Bitrate;
+        uint32_t _Seed;
+        uint32_t _Random;
+        uint32_t _ErrorRate;                // Error-Frames per 2^32 Frames
+        uint64_t _BusyTime;                 // ns with Frames or Error-Frames on the Bus
+        uint32_t _Frames;
+        uint32_t _ErrorFrames;
+        uint32_t _Collisions;               // Arbitrations with more than one Node
+
+        static CANSimulator *_Active;
+        static unsigned long long _clock();
+
+        void _runUntil(uint64_t time, bool inclusive);
+        void _runNode(NodeState &state, bool isr);
+        void _trackLoads(NodeState &state);
+        uint64_t _nextEvent();
+        bool _arbitrate();
+        void _recordLatency(NodeState &state, uint64_t latency);
+        static uint32_t _percentile(const NodeState &state, double fraction);
+
+	public:
+
+        CANSimulator(uint32_t bitrate, uint32_t seed);
+        ~CANSimulator();
+
+        bool addNode(CANSimNode &node);
+        void setErrorRate(double perFrame);
+        void run(uint32_t duration);
+        uint32_t random();
+
+        uint64_t getTime();
+        float getLoad();
+        void printResults(FILE *out);
+
+};
+
+#endif
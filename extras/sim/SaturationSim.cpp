@@ -0,0 +1,261 @@
+/**
+ * @file SaturationSim.cpp
+ * @author MH-Tobi
+ * @brief Saturation-Test: several Nodes with cyclic Messages compete for one simulated Bus.
+ *
+ * Each Node sends 4 cyclic Messages with the CANScheduler through the Transmit-Queue of its CANBus and
+ * receives 2 Messages of the next Node with the Receive-Dispatcher in its Interrupt-Routine.
+ * The last Node has no Interrupt-Routine, it polls its Messages with checkReceive() and sends them directly with send()
+ * every Loop (like the Examples), so it shows Receive-Overflows and Transmit-Buffer-Contention.
+ * The Message-IDs interleave the Nodes, so the Priority of a Node does not depend on its Number.
+ * Build and run on Linux with: make run
+ *
+ * Usage: SaturationSim [nodes] [bitrate] [seed] [ms] [scale] [error_rate]
+ *  - nodes       Number of Nodes (2 - CANSIM_MAX_NODES, default 8)
+ *  - bitrate     Bitrate of the Bus in bit/s (default 1000000)
+ *  - seed        Seed of the Simulation (default 1)
+ *  - ms          Simulated Time in ms (default 2000)
+ *  - scale       Periods in % of 5, 10, 20 and 50 ms, without the Sweep 100, 50, 35 and 25 % is simulated
+ *  - error_rate  Probability of an Error-Frame per Frame (default 0.001)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <CANScheduler.h>
+#include "CANSimulator.h"
+
+#define SIM_TX_MESSAGES     4
+#define SIM_RX_MESSAGES     2
+
+static const uint16_t Periods[SIM_TX_MESSAGES] = { 5, 10, 20, 50 };
+static CANSimulator *Simulator = NULL;
+
+
+/**
+ * @brief Fills the Payload of a cyclic Message with deterministic Random-Data.
+ */
+static void fillPayload(CANMessage &message)
+{
+    uint8_t Data[8];
+
+    for (uint8_t i = 0; i < sizeof(Data); i++)
+    {
+        Data[i] = (uint8_t) Simulator->random();
+    }
+    message.setPayload(Data, message.getLength());
+}
+
+static uint32_t messageId(uint8_t node, uint8_t message)
+{
+    return 0x100 + message * 0x40 + node;
+}
+
+
+/**
+ * @brief Node with Interrupt-Routine, Transmit-Queue and Receive-FIFOs.
+ */
+class QueuedNode : public CANSimNode
+{
+	private:
+        uint8_t _Number;
+        uint8_t _Peer;
+        uint8_t _Scale;
+        CANMessage _Tx[SIM_TX_MESSAGES];
+        CANMessage _Rx[SIM_RX_MESSAGES];
+        CANReceiveFifo<8> _Fifo[SIM_RX_MESSAGES];
+        CANScheduler _Scheduler;
+        uint32_t _Received;
+
+	public:
+
+        QueuedNode(const char *name, uint8_t number, uint8_t peer, uint8_t scale) :
+            CANSimNode(name, 100, 5),
+            _Number(number),
+            _Peer(peer),
+            _Scale(scale),
+            _Received(0)
+        {
+        }
+
+        void setup()
+        {
+            for (uint8_t i = 0; i < SIM_TX_MESSAGES; i++)
+            {
+                uint32_t Period = (uint32_t) Periods[i] * _Scale / 100;
+
+                _Tx[i].init(messageId(_Number, i), 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT, Controller);
+                Bus.registerMessage(_Tx[i]);
+                _Scheduler.add(_Tx[i], (uint16_t) (Period > 0 ? Period : 1), fillPayload);
+            }
+
+            for (uint8_t i = 0; i < SIM_RX_MESSAGES; i++)
+            {
+                _Rx[i].init(messageId(_Peer, i), 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE, Controller);
+                _Rx[i].attachFifo(_Fifo[i]);
+                Bus.registerMessage(_Rx[i]);
+            }
+
+            Bus.enableTransmitInterrupts();
+        }
+
+        void loop()
+        {
+            CANFrame Frame;
+
+            _Scheduler.tick();
+
+            for (uint8_t i = 0; i < SIM_RX_MESSAGES; i++)
+            {
+                while (_Rx[i].readFrame(Frame))
+                {
+                    _Received++;
+                }
+            }
+        }
+
+        void printResults(FILE *out)
+        {
+            fprintf(out, ",\"app_received\":%u,\"scheduler_misses\":%u,\"max_jitter_ms\":%u", _Received, _Scheduler.getMisses(), _Scheduler.getMaxJitter());
+        }
+};
+
+
+/**
+ * @brief Node without Interrupt-Routine, polls and sends directly (one Loop per ms).
+ */
+class PollingNode : public CANSimNode
+{
+	private:
+        uint8_t _Number;
+        uint8_t _Peer;
+        uint8_t _Scale;
+        CANMessage _Tx[SIM_TX_MESSAGES];
+        CANMessage _Rx[SIM_RX_MESSAGES];
+        CANScheduler _Scheduler;
+        uint32_t _Received;
+
+	public:
+
+        PollingNode(const char *name, uint8_t number, uint8_t peer, uint8_t scale) :
+            CANSimNode(name, 1000, CANSIM_NO_ISR),
+            _Number(number),
+            _Peer(peer),
+            _Scale(scale),
+            _Received(0)
+        {
+        }
+
+        void setup()
+        {
+            for (uint8_t i = 0; i < SIM_TX_MESSAGES; i++)
+            {
+                uint32_t Period = (uint32_t) Periods[i] * _Scale / 100;
+
+                _Tx[i].init(messageId(_Number, i), 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT, Controller);
+                _Scheduler.add(_Tx[i], (uint16_t) (Period > 0 ? Period : 1), fillPayload);
+            }
+
+            for (uint8_t i = 0; i < SIM_RX_MESSAGES; i++)
+            {
+                _Rx[i].init(messageId(_Peer, i), 8, false, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_RECEIVE, Controller);
+            }
+        }
+
+        void loop()
+        {
+            for (uint8_t i = 0; i < SIM_RX_MESSAGES; i++)
+            {
+                if (_Rx[i].checkReceive())
+                {
+                    _Received++;
+                    _Rx[i].releaseData();
+                }
+            }
+
+            // Frames of other IDs would block the Receive-Buffers (no Acceptance-Filters in this Test)
+            for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_RX_BUFFERS; BufferNumber++)
+            {
+                Controller.releaseReceiveBuffer(BufferNumber);
+            }
+
+            _Scheduler.tick();
+        }
+
+        void printResults(FILE *out)
+        {
+            fprintf(out, ",\"app_received\":%u,\"scheduler_misses\":%u,\"max_jitter_ms\":%u", _Received, _Scheduler.getMisses(), _Scheduler.getMaxJitter());
+        }
+};
+
+
+/**
+ * @brief Simulates one Configuration and prints the Results.
+ */
+static void simulate(uint8_t nodes, uint32_t bitrate, uint32_t seed, uint32_t ms, uint8_t scale, double errorRate)
+{
+    static char Names[CANSIM_MAX_NODES][8];
+    CANSimNode *Nodes[CANSIM_MAX_NODES];
+    CANSimulator *Current = new CANSimulator(bitrate, seed);
+
+    Simulator = Current;
+    Current->setErrorRate(errorRate);
+
+    for (uint8_t i = 0; i < nodes; i++)
+    {
+        snprintf(Names[i], sizeof(Names[i]), "n%u", i);
+
+        if (i == nodes - 1)
+        {
+            Nodes[i] = new PollingNode(Names[i], i, (uint8_t) ((i + 1) % nodes), scale);
+        } else {
+            Nodes[i] = new QueuedNode(Names[i], i, (uint8_t) ((i + 1) % nodes), scale);
+        }
+        Current->addNode(*Nodes[i]);
+    }
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+    Current->run(ms * 1000);
+
+    double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+    Current->printResults(stdout);
+    printf("{\"benchmark\":\"sim_speed\",\"seed\":%u,\"scale\":%u,\"wall_s\":%.3f,\"speedup\":%.1f}\n", seed, scale, Seconds, Seconds > 0 ? ms / 1000.0 / Seconds : 0);
+
+    for (uint8_t i = 0; i < nodes; i++)
+    {
+        delete Nodes[i];
+    }
+    delete Current;
+    Simulator = NULL;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t Nodes = argc > 1 ? (uint8_t) atoi(argv[1]) : 8;
+    uint32_t Bitrate = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : 1000000;
+    uint32_t Seed = argc > 3 ? (uint32_t) strtoul(argv[3], NULL, 10) : 1;
+    uint32_t Ms = argc > 4 ? (uint32_t) strtoul(argv[4], NULL, 10) : 2000;
+    double ErrorRate = argc > 6 ? atof(argv[6]) : 0.001;
+    static const uint8_t Sweep[] = { 100, 50, 35, 25 };
+
+    if (Nodes < 2 || Nodes > CANSIM_MAX_NODES)
+    {
+        fprintf(stderr, "nodes must be 2 - %u\n", CANSIM_MAX_NODES);
+        return 1;
+    }
+
+    if (argc > 5)
+    {
+        simulate(Nodes, Bitrate, Seed, Ms, (uint8_t) atoi(argv[5]), ErrorRate);
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < sizeof(Sweep); i++)
+    {
+        simulate(Nodes, Bitrate, Seed, Ms, Sweep[i], ErrorRate);
+    }
+
+    return 0;
+}
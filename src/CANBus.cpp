@@ -0,0 +1,1159 @@
+#include "CANBus.h"
+#include "CANRegisterMap.h"
+#include "CANSupervisor.h"
+#include "CANBusLoad.h"
+#include "CANGateway.h"
+#include "CANHandlers.h"
+#include "CANJ1939.h"
+#include "CANCapture.h"
+
+/**
+ * @brief Constructor
+ */
+CANBus::CANBus() :
+    _Controller(NULL),
+    _CsPin(0),
+    _MessageCount(0),
+    _SpiTransactions(0),
+    _ReceivedFrames(0),
+    _UnmatchedFrames(0),
+    _RejectedFrames(0),
+    _TxNextOrder(0),
+    _TxCount(0),
+    _BatchDepth(0),
+    _TxBusy(0),
+    _TxAbort(0),
+    _TransmittedFrames(0),
+    _FalseAccepts(0),
+    _FalseAcceptRate(0),
+    _Supervisor(NULL),
+    _BusLoad(NULL),
+    _Gateway(NULL),
+    _GatewayPort(0),
+    _Handlers(NULL),
+    _J1939(NULL),
+    _isInitialized(false),
+    _lastCanError(EMPTY_VALUE_16_BIT)
+{
+#if CANMESSAGE_STATISTICS
+    _TxQueueFull = 0;
+    _TxAborts = 0;
+    _FillFailures = 0;
+    _SendErrors = 0;
+    _LastControllerError = 0;
+#endif
+
+    for (size_t i = 0; i < sizeof(_StandardBitmap); i++)
+    {
+        _StandardBitmap[i] = 0;
+    }
+
+    for (size_t i = 0; i < CANBUS_HASH_SIZE; i++)
+    {
+        _Slots[i] = CANBUS_SLOT_EMPTY;
+    }
+}
+
+/**
+ * @brief Deconstructor
+ */
+CANBus::~CANBus()
+{
+}
+
+/**
+ * @brief Returns the last CAN-Error.
+ *
+ * The last CAN-Error will always been reset at the beginning of a Method.
+ * @return uint16_t CAN-Error
+ *
+ * 0x0000 = no Error
+ */
+uint16_t CANBus::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Initialisation of the Bus.
+ *
+ * The Chip-Select-Pin is needed because the Dispatcher reads the Receive-Buffers with a single SPI-Transaction each.
+ * @param controller Controller of the CANDriver, e.g. a MCP2515 Instance (already initialised)
+ * @param csPin Chip-Select-Pin of the MCP2515 (not used by the Loopback-Controller)
+ * @return True when initialisation is successfull, False when not.
+ */
+bool CANBus::init(CANController &controller, uint8_t csPin)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    _Controller = &controller;
+    _CsPin = csPin;
+    _isInitialized = true;
+
+    return true;
+}
+
+/**
+ * @brief Registers a Message at the Bus.
+ *
+ * Receive-Messages are added to the Dispatcher, Transmit-Messages are linked with the Transmit-Queue.
+ * @param message Initialised Message
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANBus::registerMessage(CANMessage &message)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!_isInitialized || !message.isInitialized())
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (message.getDirection() == CANMESSAGE_DIRECTION_TRANSMIT)
+    {
+        if (!message.attachBus(*this))
+        {
+            _lastCanError = message.getLastCanError();
+            return false;
+        }
+        return true;
+    }
+
+    if (_MessageCount >= CANBUS_MAX_MESSAGES)
+    {
+        _lastCanError = ERROR_CAN_BUS_MESSAGE_TABLE_FULL;
+        return false;
+    }
+
+    uint32_t Key = message.getDescriptor() & CANMESSAGE_DESCRIPTOR_KEY_MASK;
+
+    if (_lookup(Key) >= 0)
+    {
+        _lastCanError = ERROR_CAN_BUS_ID_ALREADY_REGISTERED;
+        return false;
+    }
+
+    uint8_t Slot = _hash(Key);
+
+    while (_Slots[Slot] != CANBUS_SLOT_EMPTY)
+    {
+        Slot = (Slot + 1) & (CANBUS_HASH_SIZE - 1);
+    }
+
+    _Messages[_MessageCount] = &message;
+    _Keys[_MessageCount] = Key;
+    _Slots[Slot] = _MessageCount;
+    _MessageCount++;
+
+    if (message.getFrame() == CANMESSAGE_FRAME_STANDARD)
+    {
+        _StandardBitmap[message.getID() >> 3] |= (1 << (message.getID() & 0x07));
+    }
+
+    if (_BusLoad != NULL)
+    {
+        _BusLoad->prepare(_MessageCount - 1);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Returns the registered Message with the given ID and Frame.
+ * @param id Message-ID
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return Pointer to the Message, NULL when no Message is registered
+ */
+CANMessage *CANBus::findMessage(uint32_t id, uint8_t frame)
+{
+    int16_t Index = _findIndex(id, frame);
+
+    if (Index < 0)
+    {
+        return NULL;
+    }
+    return _Messages[Index];
+}
+
+/**
+ * @brief Returns the Index of a registered Message (Order of the Registration).
+ * @param message Registered Reception-Message
+ * @return Index (0 - CANBUS_MAX_MESSAGES-1), -1 when the Message is not registered
+ */
+int16_t CANBus::getMessageIndex(CANMessage &message)
+{
+    int16_t Index = _lookup(message.getDescriptor() & CANMESSAGE_DESCRIPTOR_KEY_MASK);
+
+    if (Index < 0 || _Messages[Index] != &message)
+    {
+        return -1;
+    }
+    return Index;
+}
+
+/**
+ * @brief Returns the registered Message with the given Index.
+ * @param index Index (Order of the Registration)
+ * @return Pointer to the Message, NULL when no Message has this Index
+ */
+CANMessage *CANBus::getMessage(uint8_t index)
+{
+    if (index >= _MessageCount)
+    {
+        return NULL;
+    }
+    return _Messages[index];
+}
+
+/**
+ * @brief Links a Supervisor, dispatch() reports each received Frame of a registered Message to it.
+ * @param supervisor Supervisor of the Receive-Timeouts, NULL to unlink
+ */
+void CANBus::attachSupervisor(CANSupervisor *supervisor)
+{
+    _Supervisor = supervisor;
+}
+
+/**
+ * @brief Links a Bus-Load, dispatch() reports each received and the Transmit-Queue each transmitted Frame to it.
+ * @param busLoad Bus-Load, NULL to unlink
+ */
+void CANBus::attachBusLoad(CANBusLoad *busLoad)
+{
+    _BusLoad = busLoad;
+}
+
+/**
+ * @brief Links a Gateway, dispatch() passes each received Frame to its Routes and the Transmit-Queue reports each transmitted Frame.
+ *
+ * Called by addBus() of the Gateway.
+ * @param gateway Gateway, NULL to unlink
+ * @param port Number of the Bus in the Gateway
+ */
+void CANBus::attachGateway(CANGateway *gateway, uint8_t port)
+{
+    _Gateway = gateway;
+    _GatewayPort = port;
+}
+
+/**
+ * @brief Links Receive-Handlers, dispatch() queues the Frames they have a Handler instead of delivering them.
+ * @param handlers Receive-Handlers, NULL to unlink
+ */
+void CANBus::attachHandlers(CANHandlers *handlers)
+{
+    _Handlers = handlers;
+}
+
+/**
+ * @brief Links a J1939-Node, dispatch() passes the Extended Frames without a registered Message to it (any Source-Address).
+ *
+ * Called by init() of the J1939-Node.
+ * @param j1939 J1939-Node, NULL to unlink
+ */
+void CANBus::attachJ1939(CANJ1939 *j1939)
+{
+    _J1939 = j1939;
+}
+
+/**
+ * @brief Reads all filled Receive-Buffers of the MCP2515 and routes the Frames to the registered Messages.
+ *
+ * Call this Method from the Interrupt-Routine instead of checkReceive() on each Message.
+ * Each Receive-Buffer is read exactly once, reading releases the Buffer for the next incomming Message.
+ * @return Number of Frames read from the Receive-Buffers
+ */
+uint8_t CANBus::dispatch()
+{
+    if (!_isInitialized)
+    {
+        return 0;
+    }
+
+    uint8_t Status = _readStatus();
+    uint8_t Frames = 0;
+    CANFrame Frame;
+
+    for (uint8_t BufferNumber = 0; BufferNumber < 2; BufferNumber++)
+    {
+        if ((Status & (1 << BufferNumber)) == 0)
+        {
+            continue;
+        }
+
+        _readReceiveBuffer(BufferNumber, Frame);
+        Frames++;
+        _ReceivedFrames++;
+        CANCAPTURE_RECORD(CANCapture::makeDescriptor(Frame, false), Frame.DLC, Frame.Data);
+
+        // Forwarded straight from the Receive-Buffer, also Frames without a registered Message
+        if (_Gateway != NULL)
+        {
+            _Gateway->route(_GatewayPort, Frame);
+        }
+
+        int16_t Index = _findIndex(Frame.ID, Frame.Frame);
+
+        if (_BusLoad != NULL)
+        {
+            _BusLoad->count(Index, Frame);
+        }
+
+        if (Index < 0 || Frame.RTR)
+        {
+            // Frames without a registered Message can still be a J1939-PGN or have the Handler of an ID-Range
+            if (Frame.RTR || ((_J1939 == NULL || !_J1939->push(Frame)) && (_Handlers == NULL || !_Handlers->push(-1, Frame))))
+            {
+                _UnmatchedFrames++;
+            }
+            continue;
+        }
+
+        // The Sender is alive, also when the Message could not take the Frame
+        if (_Supervisor != NULL)
+        {
+            _Supervisor->received((uint8_t) Index);
+        }
+
+        if (_Handlers != NULL && _Handlers->push(Index, Frame))
+        {
+            continue;
+        }
+
+        if (!_Messages[Index]->deliver(Frame))
+        {
+            _RejectedFrames++;
+        }
+    }
+
+    if (_TxBusy != 0 || _TxCount != 0)
+    {
+        _serviceTransmit(Status);
+    }
+
+    return Frames;
+}
+
+/**
+ * @brief Adds a Frame to the priority-ordered Transmit-Queue and returns immediately.
+ *
+ * Free Transmit-Buffers are filled at once, the Rest is sent from the Transmit-Interrupt (or service()) in Order of the Arbitration-Priority (lowest ID first).
+ * When all Transmit-Buffers are busy with lower-priority Frames, the lowest one is aborted and requeued.
+ * @param frame Frame to be sent
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANBus::enqueue(const CANFrame &frame)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!_isInitialized)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    // Also called by a Gateway from the Interrupt-Routine of another Bus, so the Interrupt-State is restored
+    CANMESSAGE_LOCK();
+
+    // A Slot stays reserved for the Frame of a requested Abort
+    if (_TxCount + (_TxAbort != 0 ? 1 : 0) >= CANBUS_TX_QUEUE_SIZE)
+    {
+        CANSTATISTICS_COUNT(_TxQueueFull);
+        CANMESSAGE_UNLOCK();
+        _lastCanError = ERROR_CAN_BUS_TX_QUEUE_FULL;
+        return false;
+    }
+
+    _queuePush(frame, arbitrationKey(frame), _TxNextOrder++);
+
+    // Within a Batch the Transmit-Buffers are filled by endBatch()
+    if (_BatchDepth == 0)
+    {
+        _serviceTransmit(_readStatus());
+    }
+
+    CANMESSAGE_UNLOCK();
+
+    return true;
+}
+
+/**
+ * @brief Starts a Batch: the following enqueue() (and send() of the registered Messages) only add their Frames to the Queue.
+ *
+ * Batches can be nested, the outermost endBatch() fills the Transmit-Buffers.
+ */
+void CANBus::beginBatch()
+{
+    CANMESSAGE_LOCK();
+    _BatchDepth++;
+    CANMESSAGE_UNLOCK();
+}
+
+/**
+ * @brief Ends a Batch: fills all free Transmit-Buffers with the Frames of the highest Priority and starts them with one Request-to-Send.
+ *
+ * Each Buffer is filled with one SPI-Transaction (TXP-Priority, Header and Data), the Frames left in the Queue follow
+ * from the Transmit-Interrupt (or service()).
+ * @return uint8_t Number of Frames still waiting in the Queue
+ */
+uint8_t CANBus::endBatch()
+{
+    if (!_isInitialized)
+    {
+        return 0;
+    }
+
+    CANMESSAGE_LOCK();
+
+    if (_BatchDepth != 0)
+    {
+        _BatchDepth--;
+    }
+
+    if (_BatchDepth == 0 && _TxCount != 0)
+    {
+        _serviceTransmit(_readStatus());
+    }
+
+    uint8_t Waiting = _TxCount;
+
+    CANMESSAGE_UNLOCK();
+
+    return Waiting;
+}
+
+/**
+ * @brief Sends several registered Transmission-Messages as one Batch (see beginBatch() and endBatch()).
+ * @param messages Messages registered at this Bus, with complete Payload
+ * @param count Number of Messages
+ * @return uint8_t Number of Messages added to the Queue (on a Failure Check getLastCanError() of the Message)
+ */
+uint8_t CANBus::sendBatch(CANMessage *const *messages, uint8_t count)
+{
+    uint8_t Sent = 0;
+
+    beginBatch();
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (messages[i]->getBus() == this && messages[i]->send())
+        {
+            Sent++;
+        }
+    }
+
+    endBatch();
+
+    return Sent;
+}
+
+/**
+ * @brief Processes finished Transmissions and refills the Transmit-Buffers from the Queue.
+ *
+ * dispatch() does this automatically, call it in the loop() when the Transmit-Interrupts are not used.
+ */
+void CANBus::service()
+{
+    if (!_isInitialized)
+    {
+        return;
+    }
+
+    CANMESSAGE_LOCK();
+    _serviceTransmit(_readStatus());
+    CANMESSAGE_UNLOCK();
+}
+
+/**
+ * @brief Enables the Transmit-Interrupts (TX0IE - TX2IE) of the MCP2515.
+ *
+ * Afterwards dispatch() in the Interrupt-Routine also refills the Transmit-Buffers.
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANBus::enableTransmitInterrupts()
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!_isInitialized)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    uint8_t Mask = MCP2515_CANINT_TX0I | (MCP2515_CANINT_TX0I << 1) | (MCP2515_CANINT_TX0I << 2);
+    _bitModify(MCP2515_REGISTER_CANINTE, Mask, Mask);
+
+    return true;
+}
+
+/**
+ * @brief Returns the Number of Frames waiting in the Transmit-Queue.
+ * @return uint8_t Queued Frames
+ */
+uint8_t CANBus::getQueuedFrames()
+{
+    return _TxCount;
+}
+
+/**
+ * @brief Returns the Number of Frames transmitted from the Transmit-Queue.
+ * @return uint32_t Transmitted Frames
+ */
+uint32_t CANBus::getTransmittedFrames()
+{
+    CANMESSAGE_LOCK();
+    uint32_t Value = _TransmittedFrames;
+    CANMESSAGE_UNLOCK();
+    return Value;
+}
+
+/**
+ * @brief Programs the Acceptance-Masks and -Filters of the MCP2515 for the registered Receive-Messages.
+ *
+ * The 2 Masks and 6 Filters are planned with the CANFilterPlanner, so all registered IDs pass and as few other IDs as possible.
+ * Frames they do not pass are rejected by the MCP2515 without an Interrupt or SPI-Transaction.
+ * The IDs of the Gateway-Routes of this Bus, the ID-Ranges of the CANHandlers and the PGNs of the J1939-Node are planned too,
+ * ID-Sets overlapping partially can not be planned.
+ * The MCP2515 is switched to the Configuration-Mode and back to the previous Mode.
+ * Call it after all Messages are registered and before the Interrupt is attached, again after further Messages are registered.
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANBus::applyFilters()
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!_isInitialized)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    CANFilterPlanner Planner;
+
+    for (uint8_t i = 0; i < _MessageCount; i++)
+    {
+        Planner.addId(_Keys[i] & CANMESSAGE_DESCRIPTOR_ID_MASK, (_Keys[i] & CANMESSAGE_DESCRIPTOR_EXTENDED) ? CANMESSAGE_FRAME_EXTENDED : CANMESSAGE_FRAME_STANDARD);
+    }
+
+    // Receivers without a registered Message also need their Frames to pass
+    if ((_Gateway != NULL && !_Gateway->addFilterIds(_GatewayPort, Planner)) || (_Handlers != NULL && !_Handlers->addFilterIds(Planner))
+        || (_J1939 != NULL && !_J1939->addFilterIds(Planner)))
+    {
+        _lastCanError = ERROR_CAN_BUS_FILTERS_NOT_PLANNABLE;
+        return false;
+    }
+
+    if (!Planner.plan())
+    {
+        _lastCanError = ERROR_CAN_BUS_NO_RECEIVE_MESSAGE;
+        return false;
+    }
+
+    uint8_t Registers[4];
+    uint8_t PreviousMode = _readRegister(MCP2515_REGISTER_CANSTAT) & MCP2515_CANCTRL_REQOP;
+
+    if (!_setMode(MCP2515_MODE_CONFIGURATION))
+    {
+        _lastCanError = ERROR_CAN_BUS_MODE_CHANGE_FAILED;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < CANFILTERPLANNER_MASKS; i++)
+    {
+        canRegisterEncodeAcceptance(Planner.getMask(i), false, Registers);
+        _writeRegisters(MCP2515_REGISTER_RXM0SIDH + (i << 2), Registers, sizeof(Registers));
+    }
+
+    for (uint8_t i = 0; i < CANFILTERPLANNER_FILTERS; i++)
+    {
+        // RXF0 - RXF2 start at 0x00, RXF3 - RXF5 at 0x10
+        canRegisterEncodeAcceptance(Planner.getFilter(i), Planner.getFilterFrame(i) == CANMESSAGE_FRAME_EXTENDED, Registers);
+        _writeRegisters(MCP2515_REGISTER_RXF0SIDH + (i < 3 ? 0x00 : 0x04) + (i << 2), Registers, sizeof(Registers));
+    }
+
+    _bitModify(MCP2515_REGISTER_RXB0CTRL, MCP2515_RXBCTRL_RXM, 0x00);
+    _bitModify(MCP2515_REGISTER_RXB1CTRL, MCP2515_RXBCTRL_RXM, 0x00);
+
+    _FalseAccepts = Planner.getFalseAccepts();
+    _FalseAcceptRate = Planner.getFalseAcceptRate();
+
+    if (!_setMode(PreviousMode))
+    {
+        _lastCanError = ERROR_CAN_BUS_MODE_CHANGE_FAILED;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Returns the Number of unwanted IDs passing the Filters programmed by applyFilters().
+ * @return uint32_t False Accepts
+ */
+uint32_t CANBus::getFalseAccepts()
+{
+    return _FalseAccepts;
+}
+
+/**
+ * @brief Returns the expected Rate of unwanted Frames passing the Filters programmed by applyFilters().
+ *
+ * Assumes the unwanted IDs are evenly distributed on the Bus.
+ * @return float False-Accept-Rate (0.0 - 1.0)
+ */
+float CANBus::getFalseAcceptRate()
+{
+    return _FalseAcceptRate;
+}
+
+/**
+ * @brief Returns the Number of SPI-Transactions executed by dispatch().
+ * @return uint32_t SPI-Transactions
+ */
+uint32_t CANBus::getSpiTransactions()
+{
+    CANMESSAGE_LOCK();
+    uint32_t Value = _SpiTransactions;
+    CANMESSAGE_UNLOCK();
+    return Value;
+}
+
+/**
+ * @brief Returns the Number of Frames read from the Receive-Buffers.
+ * @return uint32_t Received Frames
+ */
+uint32_t CANBus::getReceivedFrames()
+{
+    CANMESSAGE_LOCK();
+    uint32_t Value = _ReceivedFrames;
+    CANMESSAGE_UNLOCK();
+    return Value;
+}
+
+/**
+ * @brief Returns the Number of received Frames without a registered Message.
+ * @return uint32_t Unmatched Frames
+ */
+uint32_t CANBus::getUnmatchedFrames()
+{
+    CANMESSAGE_LOCK();
+    uint32_t Value = _UnmatchedFrames;
+    CANMESSAGE_UNLOCK();
+    return Value;
+}
+
+/**
+ * @brief Returns the Number of Frames a registered Message could not take, because its Data was not read yet.
+ * @return uint32_t Rejected Frames
+ */
+uint32_t CANBus::getRejectedFrames()
+{
+    CANMESSAGE_LOCK();
+    uint32_t Value = _RejectedFrames;
+    CANMESSAGE_UNLOCK();
+    return Value;
+}
+
+/**
+ * @brief Returns the average Number of SPI-Transactions per received Frame.
+ * @return float SPI-Transactions per Frame (0 when no Frame was received)
+ */
+float CANBus::getSpiTransactionsPerFrame()
+{
+    uint32_t Frames = getReceivedFrames();
+
+    if (Frames == 0)
+    {
+        return 0;
+    }
+    return (float) getSpiTransactions() / (float) Frames;
+}
+
+/**
+ * @brief Resets all Statistic-Counters.
+ */
+void CANBus::resetStatistics()
+{
+    CANMESSAGE_LOCK();
+    _clearStatistics();
+    CANMESSAGE_UNLOCK();
+}
+
+/**
+ * @brief Clears all Statistic-Counters (the Caller locks the Interrupts).
+ */
+void CANBus::_clearStatistics()
+{
+    _SpiTransactions = 0;
+    _ReceivedFrames = 0;
+    _UnmatchedFrames = 0;
+    _RejectedFrames = 0;
+    _TransmittedFrames = 0;
+#if CANMESSAGE_STATISTICS
+    _TxQueueFull = 0;
+    _TxAborts = 0;
+    _FillFailures = 0;
+    _SendErrors = 0;
+    _LastControllerError = 0;
+#endif
+}
+
+/**
+ * @brief Copies all Statistic-Counters (with disabled Interrupts, so all Counters belong to the same Moment).
+ *
+ * The saturating Counters are only available when CANMESSAGE_STATISTICS is defined as 1.
+ * @param stats Counters to be filled (the saturating Counters are 0 when disabled)
+ * @param reset Reset the Counters in the same Step
+ * @return true when the saturating Counters are enabled, false when not
+ */
+bool CANBus::getStatistics(CANBusStatistics &stats, bool reset)
+{
+    CANMESSAGE_LOCK();
+    stats.SpiTransactions = _SpiTransactions;
+    stats.ReceivedFrames = _ReceivedFrames;
+    stats.UnmatchedFrames = _UnmatchedFrames;
+    stats.RejectedFrames = _RejectedFrames;
+    stats.TransmittedFrames = _TransmittedFrames;
+#if CANMESSAGE_STATISTICS
+    stats.TxQueueFull = _TxQueueFull;
+    stats.TxAborts = _TxAborts;
+    stats.FillFailures = _FillFailures;
+    stats.SendErrors = _SendErrors;
+    stats.LastControllerError = _LastControllerError;
+#else
+    stats.TxQueueFull = 0;
+    stats.TxAborts = 0;
+    stats.FillFailures = 0;
+    stats.SendErrors = 0;
+    stats.LastControllerError = 0;
+#endif
+
+    if (reset)
+    {
+        _clearStatistics();
+    }
+    CANMESSAGE_UNLOCK();
+
+    return CANMESSAGE_STATISTICS != 0;
+}
+
+/**
+ * @brief Returns the Number of registered Messages.
+ * @return uint8_t Number of Messages
+ */
+uint8_t CANBus::getMessageCount()
+{
+    return _MessageCount;
+}
+
+/**
+ * @brief Hash-Function for the Slot-Table (xor-folding, cheap on 8-bit Controllers).
+ * @param key Lookup-Key
+ * @return uint8_t Start-Slot
+ */
+uint8_t CANBus::_hash(uint32_t key)
+{
+    uint16_t Folded = (uint16_t) (key ^ (key >> 16));
+    Folded ^= Folded >> 7;
+    return (uint8_t) ((Folded ^ (Folded >> 13)) & (CANBUS_HASH_SIZE - 1));
+}
+
+/**
+ * @brief Searches the Index of a registered Message.
+ * @param key Lookup-Key
+ * @return int16_t Index in _Messages, -1 when not registered
+ */
+int16_t CANBus::_lookup(uint32_t key)
+{
+    uint8_t Slot = _hash(key);
+
+    while (_Slots[Slot] != CANBUS_SLOT_EMPTY)
+    {
+        if (_Keys[_Slots[Slot]] == key)
+        {
+            return _Slots[Slot];
+        }
+        Slot = (Slot + 1) & (CANBUS_HASH_SIZE - 1);
+    }
+    return -1;
+}
+
+/**
+ * @brief Searches the Index of a registered Message by ID and Frame (Standard-IDs are checked in the Bitmap first).
+ * @param id Message-ID
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return int16_t Index in _Messages, -1 when not registered
+ */
+int16_t CANBus::_findIndex(uint32_t id, uint8_t frame)
+{
+    if (frame == CANMESSAGE_FRAME_STANDARD)
+    {
+        if (id > 0x7FF || (_StandardBitmap[id >> 3] & (1 << (id & 0x07))) == 0)
+        {
+            return -1;
+        }
+    }
+    return _lookup(CANMessage::makeKey(id, frame));
+}
+
+/**
+ * @brief Builds the Arbitration-Key of a Frame (the Bits in the Order they are sent on the Bus).
+ *
+ * Bit 21-31 = Base-ID; Bit 20 = RTR (Standard) or SRR (Extended); Bit 19 = IDE; Bit 1-18 = Extended-ID; Bit 0 = RTR (Extended).
+ * A lower Key wins the Arbitration.
+ * @param frame Frame
+ * @return uint32_t Arbitration-Key
+ */
+uint32_t CANBus::arbitrationKey(const CANFrame &frame)
+{
+    if (frame.Frame == CANMESSAGE_FRAME_EXTENDED)
+    {
+        return ((frame.ID >> 18) << 21) | ((uint32_t) 0x03 << 19) | ((frame.ID & 0x3FFFF) << 1) | (frame.RTR ? 1 : 0);
+    }
+    return (frame.ID << 21) | ((uint32_t) (frame.RTR ? 1 : 0) << 20);
+}
+
+/**
+ * @brief Compares the Priority of two Frames, Frames with the same Key keep their Enqueue-Order (e.g. segmented Transfers).
+ * @return true when the first Frame must be sent before the other one
+ */
+bool CANBus::_txBefore(uint32_t key, uint8_t order, uint32_t otherKey, uint8_t otherOrder)
+{
+    if (key != otherKey)
+    {
+        return key < otherKey;
+    }
+    return (int8_t) (order - otherOrder) < 0;
+}
+
+/**
+ * @brief Adds a Frame to the Transmit-Queue (Sift-Up of the Min-Heap).
+ * @param frame Frame
+ * @param key Arbitration-Key of the Frame
+ * @param order Enqueue-Order of the Frame
+ */
+void CANBus::_queuePush(const CANFrame &frame, uint32_t key, uint8_t order)
+{
+    uint8_t Index = _TxCount++;
+
+    while (Index > 0)
+    {
+        uint8_t Parent = (Index - 1) >> 1;
+
+        if (!_txBefore(key, order, _TxKeys[Parent], _TxOrder[Parent]))
+        {
+            break;
+        }
+
+        _TxQueue[Index] = _TxQueue[Parent];
+        _TxKeys[Index] = _TxKeys[Parent];
+        _TxOrder[Index] = _TxOrder[Parent];
+        Index = Parent;
+    }
+
+    _TxQueue[Index] = frame;
+    _TxKeys[Index] = key;
+    _TxOrder[Index] = order;
+}
+
+/**
+ * @brief Takes the Frame with the highest Priority from the Transmit-Queue (Sift-Down of the Min-Heap).
+ * @param frame Frame to be filled
+ * @param key Arbitration-Key of the Frame
+ * @param order Enqueue-Order of the Frame
+ */
+void CANBus::_queuePop(CANFrame &frame, uint32_t &key, uint8_t &order)
+{
+    frame = _TxQueue[0];
+    key = _TxKeys[0];
+    order = _TxOrder[0];
+
+    _TxCount--;
+
+    uint32_t LastKey = _TxKeys[_TxCount];
+    uint8_t LastOrder = _TxOrder[_TxCount];
+    uint8_t Index = 0;
+
+    while (true)
+    {
+        uint8_t Child = (Index << 1) + 1;
+
+        if (Child >= _TxCount)
+        {
+            break;
+        }
+
+        if (Child + 1 < _TxCount && _txBefore(_TxKeys[Child + 1], _TxOrder[Child + 1], _TxKeys[Child], _TxOrder[Child]))
+        {
+            Child++;
+        }
+
+        if (!_txBefore(_TxKeys[Child], _TxOrder[Child], LastKey, LastOrder))
+        {
+            break;
+        }
+
+        _TxQueue[Index] = _TxQueue[Child];
+        _TxKeys[Index] = _TxKeys[Child];
+        _TxOrder[Index] = _TxOrder[Child];
+        Index = Child;
+    }
+
+    _TxQueue[Index] = _TxQueue[_TxCount];
+    _TxKeys[Index] = LastKey;
+    _TxOrder[Index] = LastOrder;
+}
+
+/**
+ * @brief Processes finished or aborted Transmissions and refills the free Transmit-Buffers.
+ *
+ * Must be called with disabled Interrupts or from the Interrupt-Routine.
+ * @param Status Status of the MCP2515 (READ STATUS)
+ */
+void CANBus::_serviceTransmit(uint8_t Status)
+{
+    uint8_t ClearFlags = 0;
+
+    // Finished or aborted Transmissions
+    for (uint8_t BufferNumber = 0; BufferNumber < CANBUS_TX_BUFFERS; BufferNumber++)
+    {
+        uint8_t Mask = 1 << BufferNumber;
+
+        if ((_TxBusy & Mask) == 0 || (Status & MCP2515_STATUS_TXREQ(BufferNumber)) != 0)
+        {
+            continue;
+        }
+
+        if ((Status & MCP2515_STATUS_TXIF(BufferNumber)) != 0)
+        {
+            _TransmittedFrames++;
+            ClearFlags |= MCP2515_CANINT_TX0I << BufferNumber;
+
+            if (_BusLoad != NULL)
+            {
+                _BusLoad->count(-1, _TxLoaded[BufferNumber]);
+            }
+
+            if (_Gateway != NULL)
+            {
+                _Gateway->transmitted(_GatewayPort, _TxLoadedKeys[BufferNumber], _TxLoaded[BufferNumber]);
+            }
+
+            CANCAPTURE_RECORD(CANCapture::makeDescriptor(_TxLoaded[BufferNumber], true), _TxLoaded[BufferNumber].DLC, _TxLoaded[BufferNumber].Data);
+        } else if ((_TxAbort & Mask) != 0)
+        {
+            _queuePush(_TxLoaded[BufferNumber], _TxLoadedKeys[BufferNumber], _TxLoadedOrder[BufferNumber]);
+        }
+
+        _TxBusy &= ~Mask;
+        _TxAbort &= ~Mask;
+    }
+
+    if (ClearFlags != 0)
+    {
+        _bitModify(MCP2515_REGISTER_CANINTF, ClearFlags, 0x00);
+    }
+
+    // Refill the free Transmit-Buffers in Order of the Priority, the Frames left in the Queue follow with the next Transmit-Interrupt
+    uint8_t Requests = 0;
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANBUS_TX_BUFFERS && _TxCount != 0; BufferNumber++)
+    {
+        if ((_TxBusy & (1 << BufferNumber)) != 0 || (Status & MCP2515_STATUS_TXREQ(BufferNumber)) != 0)
+        {
+            continue;
+        }
+
+        _queuePop(_TxLoaded[BufferNumber], _TxLoadedKeys[BufferNumber], _TxLoadedOrder[BufferNumber]);
+        _loadTransmitBuffer(BufferNumber);
+        Requests |= 1 << BufferNumber;
+    }
+
+    // All filled Buffers start with one Request-to-Send, so they enter the Arbitration together in the Order of their TXP-Priority
+    if (Requests != 0)
+    {
+        _updatePriorities();
+        _requestToSend(Requests);
+    }
+
+    // A queued Frame must not wait behind a lower-priority Frame, so the lowest loaded Frame is aborted (it is requeued, so the Queue needs a free Slot)
+    if (_TxCount != 0 && _TxCount < CANBUS_TX_QUEUE_SIZE)
+    {
+        int8_t Lowest = -1;
+
+        for (uint8_t BufferNumber = 0; BufferNumber < CANBUS_TX_BUFFERS; BufferNumber++)
+        {
+            uint8_t Mask = 1 << BufferNumber;
+
+            if ((_TxBusy & Mask) != 0 && (_TxAbort & Mask) == 0
+                && (Lowest < 0 || _txBefore(_TxLoadedKeys[Lowest], _TxLoadedOrder[Lowest], _TxLoadedKeys[BufferNumber], _TxLoadedOrder[BufferNumber])))
+            {
+                Lowest = BufferNumber;
+            }
+        }
+
+        if (Lowest >= 0 && _TxKeys[0] < _TxLoadedKeys[Lowest] && _TxAbort == 0)
+        {
+            _bitModify(MCP2515_REGISTER_TXB0CTRL + (Lowest << 4), MCP2515_TXBCTRL_TXREQ, 0x00);
+            _TxAbort |= 1 << Lowest;
+            CANSTATISTICS_COUNT(_TxAborts);
+        }
+    }
+}
+
+/**
+ * @brief Fills a Transmit-Buffer with its loaded Frame (TXP-Priority, Header and Data with one SPI-Transaction).
+ *
+ * The Transmission is not requested yet, so several Buffers can be started with one Request-to-Send.
+ * @param BufferNumber Number of the Transmit-Buffer (0 - 2), _TxLoaded, _TxLoadedKeys and _TxLoadedOrder are set
+ */
+void CANBus::_loadTransmitBuffer(uint8_t BufferNumber)
+{
+    const CANFrame &Frame = _TxLoaded[BufferNumber];
+    uint8_t Registers[6 + 8];
+    uint8_t Rank = 0;
+
+    for (uint8_t i = 0; i < CANBUS_TX_BUFFERS; i++)
+    {
+        if ((_TxBusy & (1 << i)) != 0 && _txBefore(_TxLoadedKeys[i], _TxLoadedOrder[i], _TxLoadedKeys[BufferNumber], _TxLoadedOrder[BufferNumber]))
+        {
+            Rank++;
+        }
+    }
+
+    _TxLevel[BufferNumber] = 3 - Rank;
+
+    uint8_t Length = Frame.RTR ? 0 : (Frame.DLC > 8 ? 8 : Frame.DLC);
+
+    Registers[0] = _TxLevel[BufferNumber];
+    canRegisterEncode(Frame, &Registers[1]);
+
+    for (uint8_t i = 0; i < Length; i++)
+    {
+        Registers[6 + i] = Frame.Data[i];
+    }
+
+    _writeRegisters(MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4), Registers, 6 + Length);
+    _TxBusy |= 1 << BufferNumber;
+}
+
+/**
+ * @brief Adjusts the TXP-Priority of the loaded Transmit-Buffers, so the MCP2515 sends them in Order of the Arbitration-Priority.
+ */
+void CANBus::_updatePriorities()
+{
+    for (uint8_t BufferNumber = 0; BufferNumber < CANBUS_TX_BUFFERS; BufferNumber++)
+    {
+        if ((_TxBusy & (1 << BufferNumber)) == 0)
+        {
+            continue;
+        }
+
+        uint8_t Rank = 0;
+
+        for (uint8_t i = 0; i < CANBUS_TX_BUFFERS; i++)
+        {
+            if (i != BufferNumber && (_TxBusy & (1 << i)) != 0
+                && _txBefore(_TxLoadedKeys[i], _TxLoadedOrder[i], _TxLoadedKeys[BufferNumber], _TxLoadedOrder[BufferNumber]))
+            {
+                Rank++;
+            }
+        }
+
+        if (_TxLevel[BufferNumber] != 3 - Rank)
+        {
+            _TxLevel[BufferNumber] = 3 - Rank;
+            _bitModify(MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4), MCP2515_TXBCTRL_TXP, _TxLevel[BufferNumber]);
+        }
+    }
+}
+
+/**
+ * @brief Reads the Status of the MCP2515 (Bit 0 = RX0IF; Bit 1 = RX1IF; Bit 2/4/6 = TXnREQ; Bit 3/5/7 = TXnIF).
+ * @return uint8_t Status
+ */
+uint8_t CANBus::_readStatus()
+{
+    _SpiTransactions++;
+    return CANDriver::readStatus(*_Controller, _CsPin);
+}
+
+/**
+ * @brief Reads a complete Receive-Buffer (ID, DLC and Data) with one SPI-Transaction.
+ *
+ * The MCP2515 clears the corresponding RXnIF-Flag automatically after the Transaction, so the Buffer is released.
+ * @param BufferNumber Number of the Receive-Buffer (0 - 1)
+ * @param frame Frame to be filled
+ */
+void CANBus::_readReceiveBuffer(uint8_t BufferNumber, CANFrame &frame)
+{
+    _SpiTransactions++;
+    CANDriver::readReceiveBuffer(*_Controller, _CsPin, BufferNumber, frame);
+}
+
+/**
+ * @brief Changes single Bits of a Register of the MCP2515 (BIT MODIFY).
+ * @param address Register-Address
+ * @param mask Bits to be changed
+ * @param data New Value of the Bits
+ */
+void CANBus::_bitModify(uint8_t address, uint8_t mask, uint8_t data)
+{
+    _SpiTransactions++;
+    CANDriver::bitModify(*_Controller, _CsPin, address, mask, data);
+}
+
+/**
+ * @brief REQUEST TO SEND for several Transmit-Buffers.
+ * @param buffers Bit n = Transmit-Buffer n
+ */
+void CANBus::_requestToSend(uint8_t buffers)
+{
+    _SpiTransactions++;
+    CANDriver::requestToSend(*_Controller, _CsPin, buffers);
+}
+
+/**
+ * @brief Reads a Register of the MCP2515 (READ).
+ * @param address Register-Address
+ * @return uint8_t Value
+ */
+uint8_t CANBus::_readRegister(uint8_t address)
+{
+    _SpiTransactions++;
+    return CANDriver::readRegister(*_Controller, _CsPin, address);
+}
+
+/**
+ * @brief Writes sequential Registers of the MCP2515 with one SPI-Transaction (WRITE).
+ * @param address Address of the first Register
+ * @param Data Values
+ * @param length Number of Registers
+ */
+void CANBus::_writeRegisters(uint8_t address, const uint8_t *Data, uint8_t length)
+{
+    _SpiTransactions++;
+    CANDriver::writeRegisters(*_Controller, _CsPin, address, Data, length);
+}
+
+/**
+ * @brief Requests an Operation-Mode of the MCP2515 and waits until it is active.
+ * @param mode Operation-Mode (REQOP-Bits of CANCTRL)
+ * @return true when the Mode is active, false when not within CANBUS_MODE_TIMEOUT
+ */
+bool CANBus::_setMode(uint8_t mode)
+{
+    _bitModify(MCP2515_REGISTER_CANCTRL, MCP2515_CANCTRL_REQOP, mode);
+
+    unsigned long Start = millis();
+
+    while ((_readRegister(MCP2515_REGISTER_CANSTAT) & MCP2515_CANCTRL_REQOP) != mode)
+    {
+        if (millis() - Start > CANBUS_MODE_TIMEOUT)
+        {
+            return false;
+        }
+    }
+    return true;
+}
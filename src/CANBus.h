@@ -0,0 +1,188 @@
+/**
+ * @file CANBus.h
+ * @author MH-Tobi
+ * @brief Bus-level Receive-Dispatcher for CAN-Messages.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANBUS_H
+#define CANBUS_H
+
+#include "CANPlatform.h"
+#include "CANDriver.h"
+#include "CANFrame.h"
+#include "CANMessage.h"
+#include "CANFilterPlanner.h"
+#include "CANMessageError.h"
+
+class CANSupervisor;
+class CANBusLoad;
+class CANGateway;
+class CANHandlers;
+class CANJ1939;
+
+
+#ifndef CANBUS_MAX_MESSAGES
+#define CANBUS_MAX_MESSAGES             32      // Max. Number of Messages they can be registered at one CANBus
+#endif
+
+#ifndef CANBUS_HASH_SIZE
+#define CANBUS_HASH_SIZE                64      // Number of Hash-Slots (power of 2, at least 2 * CANBUS_MAX_MESSAGES)
+#endif
+
+#ifndef CANBUS_TX_QUEUE_SIZE
+#define CANBUS_TX_QUEUE_SIZE            8       // Max. Number of Frames waiting for a free Transmit-Buffer
+#endif
+
+#ifndef CANBUS_MODE_TIMEOUT
+#define CANBUS_MODE_TIMEOUT             10      // Max. Time [ms] to wait for a Mode-Change of the MCP2515
+#endif
+
+#define CANBUS_SLOT_EMPTY               0xFF
+#define CANBUS_TX_BUFFERS               3       // Number of Transmit-Buffers of the MCP2515
+
+
+class CANBus
+{
+	private:
+        CANController *_Controller;                 // Controller Instance of the CANDriver the Bus belongs to
+        uint8_t _CsPin;                             // Chip-Select-Pin of the MCP2515
+        uint8_t _StandardBitmap[256];               // One Bit per Standard-ID, set when a Message with this ID is registered
+        CANMessage *_Messages[CANBUS_MAX_MESSAGES]; // Registered Messages
+        uint32_t _Keys[CANBUS_MAX_MESSAGES];        // Lookup-Key (Descriptor with ID and Frame) of the registered Messages
+        uint8_t _Slots[CANBUS_HASH_SIZE];           // Hash-Table with the Index of the registered Messages
+        uint8_t _MessageCount;
+        volatile uint32_t _SpiTransactions;         // SPI-Transactions executed by dispatch()
+        volatile uint32_t _ReceivedFrames;          // Frames read from the Receive-Buffers
+        volatile uint32_t _UnmatchedFrames;         // Frames without a registered Message
+        volatile uint32_t _RejectedFrames;          // Frames the Message could not take (Data still in Buffer)
+        CANFrame _TxQueue[CANBUS_TX_QUEUE_SIZE];    // Transmit-Queue (Min-Heap ordered by Arbitration-Priority)
+        uint32_t _TxKeys[CANBUS_TX_QUEUE_SIZE];     // Arbitration-Key of the queued Frames (lower = higher Priority)
+        uint8_t _TxOrder[CANBUS_TX_QUEUE_SIZE];     // Enqueue-Order of the queued Frames, keeps Frames with the same Key in Order
+        uint8_t _TxNextOrder;
+        uint8_t _TxCount;                           // Number of queued Frames
+        volatile uint8_t _BatchDepth;               // > 0 = enqueue() does not fill the Transmit-Buffers (see beginBatch())
+        CANFrame _TxLoaded[CANBUS_TX_BUFFERS];      // Copy of the Frames in the Transmit-Buffers (requeued after an Abort)
+        uint32_t _TxLoadedKeys[CANBUS_TX_BUFFERS];
+        uint8_t _TxLoadedOrder[CANBUS_TX_BUFFERS];
+        uint8_t _TxLevel[CANBUS_TX_BUFFERS];        // TXP-Priority (0 - 3) of the Transmit-Buffers
+        uint8_t _TxBusy;                            // Bit n = Transmit-Buffer n is loaded by the Bus
+        uint8_t _TxAbort;                           // Bit n = Abort of Transmit-Buffer n is requested
+        volatile uint32_t _TransmittedFrames;       // Frames transmitted from the Transmit-Queue
+        uint32_t _FalseAccepts;                     // Unwanted IDs passing the programmed Acceptance-Filters
+        float _FalseAcceptRate;
+        CANSupervisor *_Supervisor;                 // Receive-Timeouts of the registered Messages (optional)
+        CANBusLoad *_BusLoad;                       // Bus-Load of the received and transmitted Frames (optional)
+        CANGateway *_Gateway;                       // Forwarding of the received Frames to other Buses (optional)
+        uint8_t _GatewayPort;                       // Number of the Bus in the Gateway
+        CANHandlers *_Handlers;                     // Deferred Receive-Handlers (optional)
+        CANJ1939 *_J1939;                           // J1939-Node for the Extended Frames without a registered Message (optional)
+#if CANMESSAGE_STATISTICS
+        uint16_t _TxQueueFull;                      // Saturating Counters (see CANBusStatistics)
+        uint16_t _TxAborts;
+        uint16_t _FillFailures;
+        uint16_t _SendErrors;
+        uint16_t _LastControllerError;
+#endif
+        bool _isInitialized;
+        uint16_t _lastCanError;
+
+        static uint8_t _hash(uint32_t key);
+        int16_t _lookup(uint32_t key);
+        int16_t _findIndex(uint32_t id, uint8_t frame);
+
+        static bool _txBefore(uint32_t key, uint8_t order, uint32_t otherKey, uint8_t otherOrder);
+        void _queuePush(const CANFrame &frame, uint32_t key, uint8_t order);
+        void _queuePop(CANFrame &frame, uint32_t &key, uint8_t &order);
+        void _serviceTransmit(uint8_t Status);
+        void _loadTransmitBuffer(uint8_t BufferNumber);
+        void _updatePriorities();
+        void _clearStatistics();
+
+        uint8_t _readStatus();
+        void _readReceiveBuffer(uint8_t BufferNumber, CANFrame &frame);
+        void _bitModify(uint8_t address, uint8_t mask, uint8_t data);
+        void _requestToSend(uint8_t buffers);
+        uint8_t _readRegister(uint8_t address);
+        void _writeRegisters(uint8_t address, const uint8_t *Data, uint8_t length);
+        bool _setMode(uint8_t mode);
+
+	public:
+
+		CANBus();
+		~CANBus();
+
+        uint16_t getLastCanError();
+
+        bool init(CANController &controller, uint8_t csPin);
+        bool registerMessage(CANMessage &message);
+
+        /**
+         * @brief Registers all Messages of a Table.
+         * @param table Table with initialised Messages
+         * @return true when success, false on any error (Check _lastCanError)
+         */
+        template <uint8_t N>
+        bool registerTable(CANMessageTable<N> &table)
+        {
+            for (CANMessage *Message = table.begin(); Message != table.end(); Message++)
+            {
+                if (!registerMessage(*Message))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        CANMessage *findMessage(uint32_t id, uint8_t frame);
+        int16_t getMessageIndex(CANMessage &message);
+        CANMessage *getMessage(uint8_t index);
+        void attachSupervisor(CANSupervisor *supervisor);
+        void attachBusLoad(CANBusLoad *busLoad);
+        void attachGateway(CANGateway *gateway, uint8_t port);
+        void attachHandlers(CANHandlers *handlers);
+        void attachJ1939(CANJ1939 *j1939);
+
+        // For the Interrupt-Routine
+
+        uint8_t dispatch();
+
+        // For Transmission
+
+        bool enqueue(const CANFrame &frame);
+        void service();
+        void beginBatch();
+        uint8_t endBatch();
+        uint8_t sendBatch(CANMessage *const *messages, uint8_t count);
+        bool enableTransmitInterrupts();
+        uint8_t getQueuedFrames();
+        uint32_t getTransmittedFrames();
+
+        // Hardware-Filters
+
+        bool applyFilters();
+        uint32_t getFalseAccepts();
+        float getFalseAcceptRate();
+
+        // Statistics
+
+        uint32_t getSpiTransactions();
+        uint32_t getReceivedFrames();
+        uint32_t getUnmatchedFrames();
+        uint32_t getRejectedFrames();
+        float getSpiTransactionsPerFrame();
+        void resetStatistics();
+        bool getStatistics(CANBusStatistics &stats, bool reset = false);
+
+        uint8_t getMessageCount();
+
+        static uint32_t arbitrationKey(const CANFrame &frame);
+
+};
+
+#endif
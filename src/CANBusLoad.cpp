@@ -0,0 +1,515 @@
+#include "CANBusLoad.h"
+
+static_assert(CANBUSLOAD_SLOTS > 0 && CANBUSLOAD_SLOTS <= 127, "CANBUSLOAD_SLOTS must be 1 - 127");
+static_assert(CANBUS_MAX_MESSAGES <= 0x7FFF, "CANBUS_MAX_MESSAGES is too large for the CANBusLoad");
+
+#define CANBUSLOAD_CRC_POLYNOMIAL       0x4599  // CRC-15 of Classic CAN
+#define CANBUSLOAD_STUFF_RUN            5       // After 5 equal Bits a Stuff-Bit of the other Level follows
+
+
+/**
+ * @brief Constructor
+ */
+CANBusLoad::CANBusLoad()
+{
+    _Bus = NULL;
+    _Bitrate = 0;
+    _Stuffing = CANBUSLOAD_STUFFING_ACTUAL;
+    _Position = 0;
+    _Rounds = 0;
+    _WindowBits = 0;
+    _Current = 0;
+    _SlotTime = 0;
+    _isStarted = false;
+    _PeakBits = 0;
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    for (uint8_t i = 0; i < CANBUS_MAX_MESSAGES; i++)
+    {
+        _Entries[i].Header.Crc = 0;
+        _Entries[i].Header.Bits = 0;
+        _Entries[i].Header.Level = 0;
+        _Entries[i].Header.Run = 0;
+        _Entries[i].Control = 0;
+        _Entries[i].WorstCase = 0;
+        _Entries[i].Bits = 0;
+        _Entries[i].Frames = 0;
+        _Entries[i].WindowBits = 0;
+        _Entries[i].WindowFrames = 0;
+        _Entries[i].LastBits = 0;
+    }
+
+    for (uint8_t i = 0; i < CANBUSLOAD_SLOTS; i++)
+    {
+        _Slots[i] = 0;
+    }
+}
+
+/**
+ * @brief Returns the last occurred Error.
+ * @return Error-Code (see CANMessageError.h)
+ */
+uint16_t CANBusLoad::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Links the Bus-Load with a Bus and precalculates the Frames of the already registered Messages.
+ *
+ * Messages registered afterwards are precalculated by registerMessage().
+ * @param bus Initialised Bus
+ * @param bitrate Bitrate of the Bus in bit/s
+ * @param stuffing CANBUSLOAD_STUFFING_ACTUAL (default) or CANBUSLOAD_STUFFING_WORST_CASE
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANBusLoad::init(CANBus &bus, uint32_t bitrate, uint8_t stuffing)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (bitrate == 0 || stuffing > CANBUSLOAD_STUFFING_ACTUAL)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    _Bitrate = bitrate;
+    _Stuffing = stuffing;
+    _Bus = &bus;
+
+    for (uint8_t i = 0; i < _Bus->getMessageCount(); i++)
+    {
+        prepare(i);
+    }
+
+    _Bus->attachBusLoad(this);
+
+    return true;
+}
+
+/**
+ * @brief Starts the Window now, the Load of the Frames before is discarded.
+ *
+ * Without start() the first tick() starts the Window.
+ */
+void CANBusLoad::start()
+{
+    start((uint32_t) millis());
+}
+
+/**
+ * @brief Starts the Window now, the Load of the Frames before is discarded.
+ * @param now Current Time in ms
+ */
+void CANBusLoad::start(uint32_t now)
+{
+    CANMESSAGE_LOCK();
+    _Current = 0;
+
+    for (uint8_t i = 0; i < CANBUS_MAX_MESSAGES; i++)
+    {
+        _Entries[i].Bits = 0;
+        _Entries[i].Frames = 0;
+        _Entries[i].WindowBits = 0;
+        _Entries[i].WindowFrames = 0;
+    }
+    CANMESSAGE_UNLOCK();
+
+    for (uint8_t i = 0; i < CANBUSLOAD_SLOTS; i++)
+    {
+        _Slots[i] = 0;
+    }
+
+    _WindowBits = 0;
+    _Position = 0;
+    _Rounds = 0;
+    _SlotTime = now;
+    _isStarted = true;
+}
+
+/**
+ * @brief Closes the Slots passed since the last tick().
+ *
+ * Call it in the loop() at least once per CANBUSLOAD_RESOLUTION.
+ */
+void CANBusLoad::tick()
+{
+    tick((uint32_t) millis());
+}
+
+/**
+ * @brief Closes the Slots passed since the last tick().
+ * @param now Current Time in ms
+ */
+void CANBusLoad::tick(uint32_t now)
+{
+    if (!_isStarted)
+    {
+        start(now);
+        return;
+    }
+
+    if ((int32_t) (now - _SlotTime) < CANBUSLOAD_RESOLUTION)
+    {
+        return;
+    }
+
+    uint32_t Steps = (now - _SlotTime) / CANBUSLOAD_RESOLUTION;
+
+    // After a long Pause two Windows clear the Slots and the Windows of the Messages
+    if (Steps > 2 * CANBUSLOAD_SLOTS)
+    {
+        _SlotTime += (Steps - 2 * CANBUSLOAD_SLOTS) * CANBUSLOAD_RESOLUTION;
+        Steps = 2 * CANBUSLOAD_SLOTS;
+    }
+
+    for (uint32_t i = 0; i < Steps; i++)
+    {
+        _SlotTime += CANBUSLOAD_RESOLUTION;
+        _rollSlot();
+    }
+}
+
+/**
+ * @brief Precalculates the Stream up to the Control-Field and the Worst-Case Length of a registered Message.
+ *
+ * CAN FD-Messages are not precalculated, their Frames are counted with frameBits().
+ * @param index Index of the Message at the Bus
+ */
+void CANBusLoad::prepare(uint8_t index)
+{
+    if (_Bus == NULL || index >= CANBUS_MAX_MESSAGES)
+    {
+        return;
+    }
+
+    CANMessage *Message = _Bus->getMessage(index);
+    Entry &Current = _Entries[index];
+
+    // The Interrupt-Routine uses the Entry only with a Worst-Case, so it is set last
+    Current.WorstCase = 0;
+
+    if (Message == NULL || Message->isFD())
+    {
+        return;
+    }
+
+    CANFrame Frame;
+
+    Frame.ID = Message->getID();
+    Frame.Frame = Message->getFrame();
+    Frame.RTR = Message->getRTR();
+    Frame.DLC = Message->getDLC();
+
+    _header(Current.Header, Frame);
+    Current.Control = (uint8_t) ((Frame.DLC & 0x0F) | (Frame.RTR ? 0x80 : 0));
+    Current.WorstCase = frameBits(Frame, CANBUSLOAD_STUFFING_WORST_CASE);
+}
+
+/**
+ * @brief Counts a Frame on the Bus, called by dispatch() for each received and by the Transmit-Queue for each transmitted Frame.
+ * @param index Index of the Message at the Bus, -1 for a Frame without registered Reception-Message (e.g. a transmitted Frame)
+ * @param frame Frame
+ */
+void CANBusLoad::count(int16_t index, const CANFrame &frame)
+{
+    uint8_t Bits;
+
+    if (index < 0 || index >= CANBUS_MAX_MESSAGES)
+    {
+        _Current += frameBits(frame, _Stuffing);
+        return;
+    }
+
+    Entry &Current = _Entries[index];
+
+    // A Frame with an other DLC or a Remote-Frame of the ID does not match the precalculated Control-Field
+    if (Current.WorstCase != 0 && Current.Control == (uint8_t) ((frame.DLC & 0x0F) | (frame.RTR ? 0x80 : 0)))
+    {
+        if (_Stuffing == CANBUSLOAD_STUFFING_WORST_CASE)
+        {
+            Bits = Current.WorstCase;
+        } else {
+            Stream Tail = Current.Header;
+
+            Bits = _finish(Tail, frame.Data, frame.RTR ? 0 : _length(frame));
+        }
+    } else {
+        Bits = frameBits(frame, _Stuffing);
+    }
+
+    _Current += Bits;
+    Current.Bits += Bits;
+    Current.LastBits = Bits;
+
+    if (Current.Frames != 0xFFFF)
+    {
+        Current.Frames++;
+    }
+}
+
+/**
+ * @brief Returns the Load of the Bus in the last complete Window (all Frames seen by the Bus).
+ *
+ * Only the Frames passing the Acceptance-Filters and the own Frames of the Transmit-Queue are counted,
+ * Frames of other Nodes outside the Filters are missing.
+ * @return Load in % of the Bitrate
+ */
+float CANBusLoad::getLoad()
+{
+    return _percent(_WindowBits);
+}
+
+/**
+ * @brief Returns the Load of one Message in the last complete Window.
+ *
+ * The Windows of the Messages follow each other (they do not slide), they end every CANBUSLOAD_SLOTS Slots.
+ * @param message Message registered at the Bus
+ * @return Load in % of the Bitrate
+ */
+float CANBusLoad::getLoad(CANMessage &message)
+{
+    return _percent(getWindowBits(message));
+}
+
+/**
+ * @brief Returns the highest Load of the Bus since start() or resetStatistics().
+ * @return Load in % of the Bitrate
+ */
+float CANBusLoad::getPeakLoad()
+{
+    return _percent(_PeakBits);
+}
+
+/**
+ * @brief Returns the Bits of all Frames in the last complete Window.
+ */
+uint32_t CANBusLoad::getWindowBits()
+{
+    return _WindowBits;
+}
+
+/**
+ * @brief Returns the Bits of the Frames of one Message in the last complete Window.
+ * @param message Message registered at the Bus
+ */
+uint32_t CANBusLoad::getWindowBits(CANMessage &message)
+{
+    int16_t Index = _index(message);
+
+    return Index < 0 ? 0 : _Entries[Index].WindowBits;
+}
+
+/**
+ * @brief Returns the Number of Frames of one Message in the last complete Window.
+ * @param message Message registered at the Bus
+ */
+uint16_t CANBusLoad::getFrames(CANMessage &message)
+{
+    int16_t Index = _index(message);
+
+    return Index < 0 ? 0 : _Entries[Index].WindowFrames;
+}
+
+/**
+ * @brief Returns the Length of the last Frame of one Message on the Wire.
+ * @param message Message registered at the Bus
+ * @return Length in Bits incl. Stuff-Bits and Interframe-Space, 0 when no Frame was counted
+ */
+uint8_t CANBusLoad::getFrameBits(CANMessage &message)
+{
+    int16_t Index = _index(message);
+
+    return Index < 0 ? 0 : _Entries[Index].LastBits;
+}
+
+/**
+ * @brief Resets the Peak-Load.
+ */
+void CANBusLoad::resetStatistics()
+{
+    _PeakBits = _WindowBits;
+}
+
+/**
+ * @brief Calculates the Length of a Classic Frame on the Wire, from Start of Frame up to the Interframe-Space.
+ *
+ * Without Stuffing a Standard-Frame has 47 + 8 * Length Bits and an Extended-Frame 67 + 8 * Length Bits.
+ * The Worst-Case adds one Stuff-Bit per 4 Bits of the stuffed Part (Start of Frame up to the CRC) after the first one.
+ * @param frame Frame (Remote-Frames have no Payload)
+ * @param stuffing CANBUSLOAD_STUFFING_ACTUAL (default) or CANBUSLOAD_STUFFING_WORST_CASE
+ * @return uint8_t Length in Bits
+ */
+uint8_t CANBusLoad::frameBits(const CANFrame &frame, uint8_t stuffing)
+{
+    uint8_t Length = frame.RTR ? 0 : _length(frame);
+
+    if (stuffing == CANBUSLOAD_STUFFING_WORST_CASE)
+    {
+        uint8_t Stuffed = (uint8_t) ((frame.Frame == CANMESSAGE_FRAME_EXTENDED ? 54 : 34) + 8 * Length);
+
+        return (uint8_t) (Stuffed + CANBUSLOAD_FRAME_TAIL + (Stuffed - 1) / 4);
+    }
+
+    Stream Current;
+
+    _header(Current, frame);
+    return _finish(Current, frame.Data, Length);
+}
+
+/**
+ * @brief Appends Bits to the Stream (most significant Bit first) and inserts the Stuff-Bits.
+ * @param stream Stream
+ * @param value Bits
+ * @param count Number of Bits (max. 32)
+ * @param crc true when the Bits are covered by the CRC (all but the CRC itself)
+ */
+void CANBusLoad::_shift(Stream &stream, uint32_t value, uint8_t count, bool crc)
+{
+    while (count > 0)
+    {
+        count--;
+
+        uint8_t Bit = (uint8_t) ((value >> count) & 0x01);
+
+        if (crc)
+        {
+            bool Feedback = (Bit ^ (stream.Crc >> 14)) & 0x01;
+
+            stream.Crc = (uint16_t) ((stream.Crc << 1) & 0x7FFF);
+
+            if (Feedback)
+            {
+                stream.Crc ^= CANBUSLOAD_CRC_POLYNOMIAL;
+            }
+        }
+
+        stream.Bits++;
+
+        if (Bit != stream.Level)
+        {
+            stream.Level = Bit;
+            stream.Run = 1;
+        } else if (++stream.Run == CANBUSLOAD_STUFF_RUN)
+        {
+            // The Stuff-Bit starts the next Run
+            stream.Bits++;
+            stream.Level = Bit ^ 0x01;
+            stream.Run = 1;
+        }
+    }
+}
+
+/**
+ * @brief Starts a Stream with Start of Frame, Arbitration- and Control-Field of the Frame.
+ * @param stream Stream
+ * @param frame Frame (ID, Frame, RTR and DLC are used)
+ */
+void CANBusLoad::_header(Stream &stream, const CANFrame &frame)
+{
+    uint32_t Control = ((frame.RTR ? 1UL : 0UL) << 6) | (frame.DLC & 0x0F);
+
+    // Start of Frame (dominant, the CRC stays 0)
+    stream.Crc = 0;
+    stream.Bits = 1;
+    stream.Level = 0;
+    stream.Run = 1;
+
+    if (frame.Frame == CANMESSAGE_FRAME_EXTENDED)
+    {
+        // Base-ID, SRR, IDE; Extended-ID, RTR, r1, r0, DLC
+        _shift(stream, (((frame.ID >> 18) & 0x7FF) << 2) | 0x03, 13, true);
+        _shift(stream, ((frame.ID & 0x3FFFF) << 7) | Control, 25, true);
+    } else {
+        // ID, RTR, IDE, r0, DLC
+        _shift(stream, ((frame.ID & 0x7FF) << 7) | Control, 18, true);
+    }
+}
+
+/**
+ * @brief Appends Payload and CRC to a Stream started by _header().
+ * @param stream Stream
+ * @param Data Payload
+ * @param length Number of Bytes
+ * @return uint8_t Length of the Frame in Bits
+ */
+uint8_t CANBusLoad::_finish(Stream &stream, const uint8_t *Data, uint8_t length)
+{
+    for (uint8_t i = 0; i < length; i++)
+    {
+        _shift(stream, Data[i], 8, true);
+    }
+
+    _shift(stream, stream.Crc, 15, false);
+
+    return (uint8_t) (stream.Bits + CANBUSLOAD_FRAME_TAIL);
+}
+
+/**
+ * @brief Returns the Payload of a Classic Frame (a DLC of 9 - 15 means 8 Bytes).
+ */
+uint8_t CANBusLoad::_length(const CANFrame &frame)
+{
+    return frame.DLC > 8 ? 8 : frame.DLC;
+}
+
+/**
+ * @brief Converts the Bits of one Window into % of the Bitrate.
+ */
+float CANBusLoad::_percent(uint32_t bits)
+{
+    if (_Bitrate == 0)
+    {
+        return 0;
+    }
+    return bits * 100.0f / (_Bitrate * ((float) CANBUSLOAD_SLOTS * CANBUSLOAD_RESOLUTION / 1000.0f));
+}
+
+/**
+ * @brief Closes the running Slot, every CANBUSLOAD_SLOTS Slots also the Windows of the Messages.
+ */
+void CANBusLoad::_rollSlot()
+{
+    CANMESSAGE_LOCK();
+    uint32_t Bits = _Current;
+    _Current = 0;
+    CANMESSAGE_UNLOCK();
+
+    _WindowBits = _WindowBits - _Slots[_Position] + Bits;
+    _Slots[_Position] = Bits;
+    _Position = (uint8_t) ((_Position + 1) % CANBUSLOAD_SLOTS);
+
+    if (_WindowBits > _PeakBits)
+    {
+        _PeakBits = _WindowBits;
+    }
+
+    if (++_Rounds < CANBUSLOAD_SLOTS)
+    {
+        return;
+    }
+
+    _Rounds = 0;
+
+    for (uint8_t i = 0; i < CANBUS_MAX_MESSAGES; i++)
+    {
+        CANMESSAGE_LOCK();
+        _Entries[i].WindowBits = _Entries[i].Bits;
+        _Entries[i].WindowFrames = _Entries[i].Frames;
+        _Entries[i].Bits = 0;
+        _Entries[i].Frames = 0;
+        CANMESSAGE_UNLOCK();
+    }
+}
+
+/**
+ * @brief Returns the Index of a registered Message, -1 when not registered.
+ */
+int16_t CANBusLoad::_index(CANMessage &message)
+{
+    if (_Bus == NULL)
+    {
+        return -1;
+    }
+    return _Bus->getMessageIndex(message);
+}
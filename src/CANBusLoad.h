@@ -0,0 +1,126 @@
+/**
+ * @file CANBusLoad.h
+ * @author MH-Tobi
+ * @brief Bus-Load of the Frames seen by a CANBus, with the exact Length of each Frame on the Wire.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANBUSLOAD_H
+#define CANBUSLOAD_H
+
+#include "CANPlatform.h"
+#include "CANFrame.h"
+#include "CANMessage.h"
+#include "CANBus.h"
+#include "CANMessageError.h"
+
+
+#ifndef CANBUSLOAD_SLOTS
+#define CANBUSLOAD_SLOTS                10      // Slots of the sliding Window
+#endif
+
+#ifndef CANBUSLOAD_RESOLUTION
+#define CANBUSLOAD_RESOLUTION           100     // ms per Slot, the Window is CANBUSLOAD_SLOTS * CANBUSLOAD_RESOLUTION long
+#endif
+
+#define CANBUSLOAD_STUFFING_WORST_CASE  0       // Max. Number of Stuff-Bits for the DLC (constant per Message)
+#define CANBUSLOAD_STUFFING_ACTUAL      1       // Stuff-Bits of the actual Payload and CRC
+
+#define CANBUSLOAD_FRAME_TAIL           13      // CRC-Delimiter, ACK-Slot, ACK-Delimiter, End of Frame (7) and Interframe-Space (3), not stuffed
+
+
+/**
+ * @brief Measures the Utilisation of the Bus over a sliding Window, in total and per registered Reception-Message.
+ *
+ * Linked with init(), dispatch() of the Bus reports each received Frame and the Transmit-Queue each finished Transmission
+ * (Frames sent without the Transmit-Queue are not seen).
+ * Frames of other Nodes they are rejected by the Acceptance-Filters (e.g. after applyFilters() of the Bus) are not seen either,
+ * so the measured Load is a lower Bound of the real Bus-Load.
+ * Each Frame is counted with its Length on the Wire: Start of Frame up to the Interframe-Space incl. the Stuff-Bits.
+ * The Stuffing of the fixed Part (Start of Frame, Arbitration- and Control-Field) and the CRC after it are
+ * calculated once per Message when it is registered, so the Interrupt-Routine only processes the Payload and the CRC
+ * (CANBUSLOAD_STUFFING_ACTUAL) or only adds a precalculated Constant (CANBUSLOAD_STUFFING_WORST_CASE).
+ */
+class CANBusLoad
+{
+	private:
+        /**
+         * @brief Bit-Stream from Start of Frame on: Bits incl. Stuff-Bits, CRC-15 and the Run of equal Bits.
+         */
+        struct Stream
+        {
+            uint16_t Crc;
+            uint8_t Bits;
+            uint8_t Level;                  // Level of the last Bit (incl. Stuff-Bits)
+            uint8_t Run;                    // Number of equal Bits up to the last Bit (1 - 4)
+        };
+
+        struct Entry
+        {
+            Stream Header;                  // Stream after the Control-Field
+            uint8_t Control;                // DLC (Bit 0-3) and RTR (Bit 7) of the precalculated Frame
+            uint8_t WorstCase;              // Worst-Case Length in Bits (0 = not precalculated)
+            volatile uint32_t Bits;         // Bits in the running Window
+            volatile uint16_t Frames;
+            uint32_t WindowBits;            // Bits in the last complete Window
+            uint16_t WindowFrames;
+            volatile uint8_t LastBits;      // Length of the last Frame
+        };
+
+        CANBus *_Bus;
+        uint32_t _Bitrate;
+        uint8_t _Stuffing;
+        Entry _Entries[CANBUS_MAX_MESSAGES];        // Same Index as the Message at the Bus
+        uint32_t _Slots[CANBUSLOAD_SLOTS];          // Bits of the complete Slots in the Window
+        uint8_t _Position;                          // Oldest Slot
+        uint8_t _Rounds;                            // Slots since the last complete Window of the Messages
+        uint32_t _WindowBits;                       // Sum of _Slots
+        volatile uint32_t _Current;                 // Bits of the running Slot
+        uint32_t _SlotTime;                         // Start of the running Slot
+        bool _isStarted;
+        uint32_t _PeakBits;                         // Highest _WindowBits
+        uint16_t _lastCanError;
+
+        static void _shift(Stream &stream, uint32_t value, uint8_t count, bool crc);
+        static void _header(Stream &stream, const CANFrame &frame);
+        static uint8_t _finish(Stream &stream, const uint8_t *Data, uint8_t length);
+        static uint8_t _length(const CANFrame &frame);
+        float _percent(uint32_t bits);
+        void _rollSlot();
+        int16_t _index(CANMessage &message);
+
+	public:
+
+        CANBusLoad();
+
+        uint16_t getLastCanError();
+
+        bool init(CANBus &bus, uint32_t bitrate, uint8_t stuffing = CANBUSLOAD_STUFFING_ACTUAL);
+        void start();
+        void start(uint32_t now);
+        void tick();
+        void tick(uint32_t now);
+
+        // For the Bus (called by registerMessage(), dispatch() and the Transmit-Queue)
+
+        void prepare(uint8_t index);
+        void count(int16_t index, const CANFrame &frame);
+
+        float getLoad();
+        float getLoad(CANMessage &message);
+        float getPeakLoad();
+        uint32_t getWindowBits();
+        uint32_t getWindowBits(CANMessage &message);
+        uint16_t getFrames(CANMessage &message);
+        uint8_t getFrameBits(CANMessage &message);
+        void resetStatistics();
+
+        static uint8_t frameBits(const CANFrame &frame, uint8_t stuffing = CANBUSLOAD_STUFFING_ACTUAL);
+
+};
+
+#endif
@@ -0,0 +1,327 @@
+#include "CANCapture.h"
+#include <string.h>
+
+static_assert(CANCAPTURE_RECORDS >= 2 && CANCAPTURE_RECORDS <= 4096 && (CANCAPTURE_RECORDS & (CANCAPTURE_RECORDS - 1)) == 0, "CANCAPTURE_RECORDS must be a power of 2 between 2 and 4096");
+static_assert(CANCAPTURE_RESOLUTION > 0 && CANCAPTURE_RESOLUTION <= 0xFFFF, "CANCAPTURE_RESOLUTION must be 1 - 65535 us");
+static_assert(sizeof(CANCaptureRecord) == CANCAPTURE_RECORD_SIZE, "CANCaptureRecord must have 16 Bytes");
+
+#define CANCAPTURE_MASK                 (CANCAPTURE_RECORDS - 1)
+
+CANCapture *CANCapture::_Active = NULL;
+
+
+/**
+ * @brief Constructor
+ */
+CANCapture::CANCapture()
+{
+    _Head = 0;
+    _Tail = 0;
+    _LastTime = 0;
+    _Sequence = 0;
+    _Mode = CANCAPTURE_MODE_RING;
+    _Lost = 0;
+    _isRunning = false;
+    _lastCanError = EMPTY_VALUE_16_BIT;
+}
+
+/**
+ * @brief Destructor, a started Capture is stopped.
+ */
+CANCapture::~CANCapture()
+{
+    stop();
+}
+
+/**
+ * @brief Returns the last occurred Error.
+ * @return Error-Code (see CANMessageError.h)
+ */
+uint16_t CANCapture::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Clears the Records and starts the Capture, it gets all Frames of the Messages and Buses (only one Capture can be started).
+ * @param mode CANCAPTURE_MODE_RING (default) or CANCAPTURE_MODE_STOP
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANCapture::start(uint8_t mode)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (mode > CANCAPTURE_MODE_STOP)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    CANMESSAGE_LOCK();
+    _Head = 0;
+    _Tail = 0;
+    _Sequence = 0;
+    _Lost = 0;
+    _Mode = mode;
+    _LastTime = (uint32_t) micros();
+    _isRunning = true;
+
+    if (_Active != NULL && _Active != this)
+    {
+        _Active->_isRunning = false;
+    }
+    _Active = this;
+    CANMESSAGE_UNLOCK();
+
+    return true;
+}
+
+/**
+ * @brief Stops the Capture, the Records stay readable (e.g. to keep the Frames before a Fault).
+ */
+void CANCapture::stop()
+{
+    CANMESSAGE_LOCK();
+    _isRunning = false;
+
+    if (_Active == this)
+    {
+        _Active = NULL;
+    }
+    CANMESSAGE_UNLOCK();
+}
+
+/**
+ * @brief Returns true while the Capture records.
+ */
+bool CANCapture::isRunning()
+{
+    return _isRunning;
+}
+
+/**
+ * @brief Records a Frame, can be called from the loop() and the Interrupt-Routine.
+ *
+ * A Delta-Time above 65535 Units is stored in a Gap-Record in front of the Frame.
+ * @param descriptor ID, Extended, RTR and Transmit (see CANMESSAGE_DESCRIPTOR_*)
+ * @param control Data-Length-Code and CANCAPTURE_CONTROL_FD
+ * @param Data Payload (the first 8 Bytes are recorded, not used for Remote-Frames)
+ */
+void CANCapture::record(uint32_t descriptor, uint8_t control, const uint8_t *Data)
+{
+    if (!_isRunning)
+    {
+        return;
+    }
+
+    CANMESSAGE_LOCK();
+
+    uint32_t Now = (uint32_t) micros();
+    uint32_t Units = (Now - _LastTime) / CANCAPTURE_RESOLUTION;
+    CANCaptureRecord *Record = NULL;
+
+    _LastTime += Units * CANCAPTURE_RESOLUTION;
+
+    if (Units > 0xFFFF)
+    {
+        Record = _next();
+
+        if (Record != NULL)
+        {
+            Record->Delta = 0;
+            Record->Control = CANCAPTURE_CONTROL_GAP;
+            Record->Descriptor = Units;
+            memset(Record->Data, 0, sizeof(Record->Data));
+            Units = 0;
+        }
+    }
+
+    Record = _next();
+
+    if (Record != NULL)
+    {
+        uint8_t Length = canDlcToLength(control & CANCAPTURE_CONTROL_DLC);
+
+        if (Length > 8)
+        {
+            Length = 8;
+        }
+
+        if ((descriptor & CANMESSAGE_DESCRIPTOR_RTR) != 0 || Data == NULL)
+        {
+            Length = 0;
+        }
+
+        Record->Delta = (uint16_t) (Units > 0xFFFF ? 0xFFFF : Units);
+        Record->Control = control & (CANCAPTURE_CONTROL_DLC | CANCAPTURE_CONTROL_FD);
+        Record->Descriptor = descriptor;
+        memcpy(Record->Data, Data, Length);
+        memset(Record->Data + Length, 0, sizeof(Record->Data) - Length);
+    }
+
+    CANMESSAGE_UNLOCK();
+}
+
+/**
+ * @brief Records a Classic Frame.
+ * @param frame Frame
+ * @param transmit true for a sent, false for a received Frame
+ */
+void CANCapture::record(const CANFrame &frame, bool transmit)
+{
+    record(makeDescriptor(frame, transmit), frame.DLC & CANCAPTURE_CONTROL_DLC, frame.Data);
+}
+
+/**
+ * @brief Takes the oldest Record from the Ring-Buffer.
+ * @param record Record to be filled
+ * @return true when a Record was available, false when the Buffer is empty
+ */
+bool CANCapture::read(CANCaptureRecord &record)
+{
+    bool Available = false;
+
+    CANMESSAGE_LOCK();
+    if (_Head != _Tail)
+    {
+        record = _Records[_Tail & CANCAPTURE_MASK];
+        _Tail = _Tail + 1;
+        Available = true;
+    }
+    CANMESSAGE_UNLOCK();
+
+    return Available;
+}
+
+/**
+ * @brief Returns the Number of Records in the Ring-Buffer.
+ */
+uint16_t CANCapture::available()
+{
+    CANMESSAGE_LOCK();
+    uint16_t Count = (uint16_t) (_Head - _Tail);
+    CANMESSAGE_UNLOCK();
+
+    return Count;
+}
+
+/**
+ * @brief Returns the Number of lost Records (overwritten in CANCAPTURE_MODE_RING, not stored in CANCAPTURE_MODE_STOP).
+ * @return uint16_t Lost Records (saturates at 0xFFFF)
+ */
+uint16_t CANCapture::getLost()
+{
+    CANMESSAGE_LOCK();
+    uint16_t Lost = _Lost;
+    CANMESSAGE_UNLOCK();
+
+    return Lost;
+}
+
+/**
+ * @brief Discards all Records, the Capture keeps running.
+ */
+void CANCapture::clear()
+{
+    CANMESSAGE_LOCK();
+    _Tail = _Head;
+    CANMESSAGE_UNLOCK();
+}
+
+/**
+ * @brief Records a Frame in the started Capture, called by the Messages and the Bus (see CANCAPTURE_RECORD).
+ * @param descriptor ID, Extended, RTR and Transmit (see CANMESSAGE_DESCRIPTOR_*)
+ * @param control Data-Length-Code and CANCAPTURE_CONTROL_FD
+ * @param Data Payload
+ */
+void CANCapture::capture(uint32_t descriptor, uint8_t control, const uint8_t *Data)
+{
+    CANCapture *Active = _Active;
+
+    if (Active != NULL)
+    {
+        Active->record(descriptor, control, Data);
+    }
+}
+
+/**
+ * @brief Returns the Descriptor of a Frame.
+ * @param frame Frame
+ * @param transmit true for a sent, false for a received Frame
+ * @return uint32_t Descriptor (see CANMESSAGE_DESCRIPTOR_*)
+ */
+uint32_t CANCapture::makeDescriptor(const CANFrame &frame, bool transmit)
+{
+    return CANMessageBase::makeKey(frame.ID, frame.Frame) | (frame.RTR ? CANMESSAGE_DESCRIPTOR_RTR : 0) | (transmit ? CANMESSAGE_DESCRIPTOR_TRANSMIT : 0);
+}
+
+/**
+ * @brief Encodes a Record into 16 Bytes (Little-Endian, independent of the Platform).
+ * @param record Record
+ * @param Data Buffer with CANCAPTURE_RECORD_SIZE Bytes
+ */
+void CANCapture::encode(const CANCaptureRecord &record, uint8_t *Data)
+{
+    Data[0] = (uint8_t) record.Delta;
+    Data[1] = (uint8_t) (record.Delta >> 8);
+    Data[2] = record.Control;
+    Data[3] = record.Sequence;
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        Data[4 + i] = (uint8_t) (record.Descriptor >> (8 * i));
+    }
+
+    memcpy(&Data[8], record.Data, 8);
+}
+
+/**
+ * @brief Decodes a Record encoded by encode().
+ * @param Data Buffer with CANCAPTURE_RECORD_SIZE Bytes
+ * @param record Record to be filled
+ */
+void CANCapture::decode(const uint8_t *Data, CANCaptureRecord &record)
+{
+    record.Delta = (uint16_t) (Data[0] | (Data[1] << 8));
+    record.Control = Data[2];
+    record.Sequence = Data[3];
+    record.Descriptor = 0;
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        record.Descriptor |= (uint32_t) Data[4 + i] << (8 * i);
+    }
+
+    memcpy(record.Data, &Data[8], 8);
+}
+
+/**
+ * @brief Reserves the next Record (Interrupts are locked by the Caller).
+ * @return Record with Sequence, NULL when the Buffer is full in CANCAPTURE_MODE_STOP
+ */
+CANCaptureRecord *CANCapture::_next()
+{
+    if ((uint16_t) (_Head - _Tail) >= CANCAPTURE_RECORDS)
+    {
+        if (_Lost != 0xFFFF)
+        {
+            _Lost = _Lost + 1;
+        }
+
+        if (_Mode == CANCAPTURE_MODE_STOP)
+        {
+            // The Sequence also counts the lost Record, so the Reader sees the Gap
+            _Sequence++;
+            return NULL;
+        }
+
+        _Tail = _Tail + 1;
+    }
+
+    CANCaptureRecord *Record = &_Records[_Head & CANCAPTURE_MASK];
+
+    Record->Sequence = _Sequence++;
+    _Head = _Head + 1;
+
+    return Record;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file CANCapture.h
+ * @author MH-Tobi
+ * @brief Capture of the sent and received Frames in a RAM-Ring-Buffer with compact binary Records.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANCAPTURE_H
+#define CANCAPTURE_H
+
+#include "CANPlatform.h"
+#include "CANFrame.h"
+#include "CANMessage.h"
+#include "CANMessageError.h"
+
+
+// Define CANMESSAGE_CAPTURE as 1 with a Build-Flag (e.g. build_flags = -DCANMESSAGE_CAPTURE=1), so all Files of the Library see the same Value.
+// When disabled the Messages and the Bus contain no Capture-Code, a CANCapture only records the Frames passed to record().
+#ifndef CANMESSAGE_CAPTURE
+#define CANMESSAGE_CAPTURE              0
+#endif
+
+#ifndef CANCAPTURE_RECORDS
+#define CANCAPTURE_RECORDS              32      // Records in the Ring-Buffer (power of 2, 16 Bytes each)
+#endif
+
+#ifndef CANCAPTURE_RESOLUTION
+#define CANCAPTURE_RESOLUTION           100     // us per Unit of the Delta-Time (max. 65535 Units between two Records)
+#endif
+
+#ifndef CANCAPTURE_BURST
+#define CANCAPTURE_BURST                8       // Default Number of Records per Burst of stream()
+#endif
+
+#define CANCAPTURE_MODE_RING            0       // Keeps the newest Records, the oldest are overwritten
+#define CANCAPTURE_MODE_STOP            1       // Keeps the oldest Records, further Frames are lost when the Buffer is full
+
+// Layout of the Control-Byte of a Record
+#define CANCAPTURE_CONTROL_DLC          0x0F    // Bit 0-3: Data-Length-Code
+#define CANCAPTURE_CONTROL_FD           0x10    // CAN FD-Frame, only the first 8 Bytes are recorded
+#define CANCAPTURE_CONTROL_GAP          0x80    // No Frame: the Descriptor holds the Time since the previous Record (Delta-Time too long)
+
+#define CANCAPTURE_RECORD_SIZE          16      // Bytes of an encoded Record
+#define CANCAPTURE_SYNC_0               0xA5    // Start of a Burst
+#define CANCAPTURE_SYNC_1               0x5A
+#define CANCAPTURE_BURST_HEADER         5       // Sync (2), Count (1), Resolution in us (2, Little-Endian)
+
+#if CANMESSAGE_CAPTURE
+#define CANCAPTURE_RECORD(descriptor, control, data)    CANCapture::capture(descriptor, control, data)
+#else
+#define CANCAPTURE_RECORD(descriptor, control, data)    do { } while (0)
+#endif
+
+
+/**
+ * @brief Fixed-Size Record of a Frame (16 Bytes).
+ */
+struct CANCaptureRecord
+{
+    uint16_t Delta;                 // Time since the previous Record in CANCAPTURE_RESOLUTION
+    uint8_t Control;                // DLC and Flags (see CANCAPTURE_CONTROL_*)
+    uint8_t Sequence;               // Running Number, a Gap shows lost Records
+    uint32_t Descriptor;            // ID, Extended, RTR and Transmit (see CANMESSAGE_DESCRIPTOR_*), Time of a Gap-Record
+    uint8_t Data[8];
+};
+
+
+/**
+ * @brief Records every Frame sent and received by the Messages and the Bus into a Ring-Buffer.
+ *
+ * With CANMESSAGE_CAPTURE the started Capture gets the Frames of send() and checkReceive() of the Messages,
+ * each Frame read by dispatch() and each Frame transmitted by the Transmit-Queue of a Bus.
+ * The Records are read with read() or streamed in Bursts to a Serial-Port with stream(),
+ * the Host-Tool in extras/capture converts them to candump- and ASC-Files and replays them.
+ */
+class CANCapture
+{
+	private:
+        CANCaptureRecord _Records[CANCAPTURE_RECORDS];
+        volatile uint16_t _Head;                    // Next Record to be written
+        volatile uint16_t _Tail;                    // Oldest Record
+        uint32_t _LastTime;                         // Time of the previous Record in us
+        uint8_t _Sequence;
+        uint8_t _Mode;
+        volatile uint16_t _Lost;                    // Records lost (saturating)
+        volatile bool _isRunning;
+        uint16_t _lastCanError;
+
+        static CANCapture *_Active;
+
+        CANCaptureRecord *_next();
+
+	public:
+
+        CANCapture();
+        ~CANCapture();
+
+        uint16_t getLastCanError();
+
+        bool start(uint8_t mode = CANCAPTURE_MODE_RING);
+        void stop();
+        bool isRunning();
+
+        void record(uint32_t descriptor, uint8_t control, const uint8_t *Data);
+        void record(const CANFrame &frame, bool transmit);
+
+        bool read(CANCaptureRecord &record);
+        uint16_t available();
+        uint16_t getLost();
+        void clear();
+
+        /**
+         * @brief Writes the oldest Records as one Burst to a Serial-Port (or any Print with write(const uint8_t *, size_t)).
+         *
+         * A Burst is the Header (CANCAPTURE_SYNC_0, CANCAPTURE_SYNC_1, Count, Resolution), the encoded Records and a Checksum
+         * (XOR of Count, Resolution and Records). Call it in the loop() until it returns 0.
+         * @param serial Serial-Port
+         * @param maxRecords Max. Number of Records in the Burst
+         * @return uint8_t Number of written Records
+         */
+        template <class S>
+        uint8_t stream(S &serial, uint8_t maxRecords = CANCAPTURE_BURST)
+        {
+            uint8_t Header[CANCAPTURE_BURST_HEADER] = { CANCAPTURE_SYNC_0, CANCAPTURE_SYNC_1, 0, (uint8_t) (CANCAPTURE_RESOLUTION & 0xFF), (uint8_t) (CANCAPTURE_RESOLUTION >> 8) };
+            uint8_t Data[CANCAPTURE_RECORD_SIZE];
+            uint8_t Count = available() < maxRecords ? (uint8_t) available() : maxRecords;
+            CANCaptureRecord Record;
+
+            if (Count == 0)
+            {
+                return 0;
+            }
+
+            Header[2] = Count;
+            uint8_t Checksum = Header[2] ^ Header[3] ^ Header[4];
+            serial.write(Header, sizeof(Header));
+
+            // Records overwritten in the Meantime are replaced by newer ones, the Sequence shows the Gap
+            for (uint8_t i = 0; i < Count; i++)
+            {
+                read(Record);
+                encode(Record, Data);
+
+                for (uint8_t j = 0; j < CANCAPTURE_RECORD_SIZE; j++)
+                {
+                    Checksum ^= Data[j];
+                }
+                serial.write(Data, sizeof(Data));
+            }
+
+            serial.write(&Checksum, 1);
+
+            return Count;
+        }
+
+        static void capture(uint32_t descriptor, uint8_t control, const uint8_t *Data);
+        static uint32_t makeDescriptor(const CANFrame &frame, bool transmit);
+        static void encode(const CANCaptureRecord &record, uint8_t *Data);
+        static void decode(const uint8_t *Data, CANCaptureRecord &record);
+
+};
+
+#endif
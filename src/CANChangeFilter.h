@@ -0,0 +1,241 @@
+/**
+ * @file CANChangeFilter.h
+ * @author MH-Tobi
+ * @brief Send-on-Change for Transmit-Messages with Heartbeat and Deadbands per Signal.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANCHANGEFILTER_H
+#define CANCHANGEFILTER_H
+
+#include <stdint.h>
+#include <string.h>
+#include "CANPlatform.h"
+#include "CANSignal.h"
+
+
+#ifndef CANCHANGEFILTER_MAX_DEADBANDS
+#define CANCHANGEFILTER_MAX_DEADBANDS   4       // Signals with a Deadband per Filter
+#endif
+
+// Result of check()
+#define CANCHANGEFILTER_SUPPRESS        0       // Payload unchanged (or within the Deadbands) and Heartbeat not elapsed
+#define CANCHANGEFILTER_FIRST           1       // Nothing sent yet (or reset())
+#define CANCHANGEFILTER_CHANGED         2       // A Bit outside the Deadband-Signals changed
+#define CANCHANGEFILTER_DEADBAND        3       // A Signal left its Deadband
+#define CANCHANGEFILTER_HEARTBEAT       4       // Heartbeat-Interval elapsed
+
+
+class CANBus;
+
+
+/**
+ * @brief Decides if the Payload of a Transmit-Message is sent.
+ *
+ * Attached with CANMessage::attachChangeFilter(), send() then only transmits a Frame when the Payload differs from the last sent one,
+ * a Signal leaves its Deadband or the Heartbeat-Interval elapsed. Otherwise send() returns true without a Frame and the Suppression is counted.
+ * The Payload (max. 8 Bytes) is compared as one 64-bit Word, the Bits of the Deadband-Signals are masked out of this Compare.
+ */
+class CANChangeFilter
+{
+	private:
+        typedef int64_t (*Unpack)(const uint8_t *Data);
+
+        struct Deadband
+        {
+            Unpack Signal;                  // Raw-Value of the Signal
+            uint32_t Limit;                 // Max. Difference of the Raw-Value without Transmission
+        };
+
+        CANBus *_Bus;                       // Transmit-Queue of the Message (NULL = Transmit-Buffer of the Controller)
+        uint64_t _Last;                     // Payload of the last sent Frame
+        uint64_t _DeadbandMask;             // Bits of the Deadband-Signals
+        Deadband _Deadbands[CANCHANGEFILTER_MAX_DEADBANDS];
+        uint8_t _DeadbandCount;
+        bool _hasSent;
+        uint16_t _Heartbeat;                // Max. Time between two Frames in ms (0 = none)
+        uint32_t _LastSent;                 // Time of the last sent Frame
+        uint16_t _Sent;
+        uint16_t _Heartbeats;
+        uint16_t _SuppressedUnchanged;
+        uint16_t _SuppressedDeadband;
+
+        template <const CANSignalDescriptor &D>
+        static int64_t _unpack(const uint8_t *Data)
+        {
+            return (int64_t) CANSignal<D>::unpack(Data);
+        }
+
+        static void _count(uint16_t &counter)
+        {
+            if (counter != 0xFFFF)
+            {
+                counter++;
+            }
+        }
+
+	public:
+
+        CANChangeFilter() :
+            _Bus(NULL),
+            _Last(0),
+            _DeadbandMask(0),
+            _DeadbandCount(0),
+            _hasSent(false),
+            _Heartbeat(0),
+            _LastSent(0)
+        {
+            resetStatistics();
+        }
+
+        /**
+         * @brief Sets the max. Time between two Frames, the unchanged Payload is sent again after it.
+         * @param interval Heartbeat-Interval in ms (0 = only on Change)
+         */
+        void setHeartbeat(uint16_t interval)
+        {
+            _Heartbeat = interval;
+        }
+
+        /**
+         * @brief Adds a Deadband, Changes of the Signal up to the Limit do not trigger a Transmission.
+         * @tparam D constexpr Descriptor of the Signal (see CANSignal)
+         * @param limit Max. Difference of the Raw-Value to the last sent Frame
+         * @return true when success, false when CANCHANGEFILTER_MAX_DEADBANDS Deadbands are set
+         */
+        template <const CANSignalDescriptor &D>
+        bool addDeadband(uint32_t limit)
+        {
+            if (_DeadbandCount >= CANCHANGEFILTER_MAX_DEADBANDS)
+            {
+                return false;
+            }
+
+            // Packing all ones into an empty Payload gives the Bits of the Signal
+            uint8_t Bits[8] = { 0 };
+            uint64_t Mask;
+
+            CANSignal<D>::pack(Bits, (typename CANSignal<D>::RawType) ~(uint32_t) 0);
+            memcpy(&Mask, Bits, sizeof(Mask));
+
+            _DeadbandMask |= Mask;
+            _Deadbands[_DeadbandCount].Signal = &_unpack<D>;
+            _Deadbands[_DeadbandCount].Limit = limit;
+            _DeadbandCount++;
+
+            return true;
+        }
+
+        /**
+         * @brief The next check() sends the Frame in any Case.
+         */
+        void reset()
+        {
+            _hasSent = false;
+        }
+
+        /**
+         * @brief Decides if the Payload is sent, a Suppression is counted.
+         * @param Data Payload
+         * @param length Number of Bytes (max. 8)
+         * @param now Current Time in ms
+         * @return Reason of the Transmission (CANCHANGEFILTER_FIRST, _CHANGED, _DEADBAND, _HEARTBEAT) or CANCHANGEFILTER_SUPPRESS
+         */
+        uint8_t check(const uint8_t *Data, uint8_t length, uint32_t now)
+        {
+            if (!_hasSent)
+            {
+                return CANCHANGEFILTER_FIRST;
+            }
+
+            uint64_t Current = 0;
+            memcpy(&Current, Data, length);
+
+            uint64_t Changed = Current ^ _Last;
+
+            if ((Changed & ~_DeadbandMask) != 0)
+            {
+                return CANCHANGEFILTER_CHANGED;
+            }
+
+            if (Changed != 0)
+            {
+                uint8_t Last[8];
+                memcpy(Last, &_Last, sizeof(Last));
+
+                for (uint8_t i = 0; i < _DeadbandCount; i++)
+                {
+                    int64_t Delta = _Deadbands[i].Signal(Data) - _Deadbands[i].Signal(Last);
+
+                    if ((Delta < 0 ? -Delta : Delta) > (int64_t) _Deadbands[i].Limit)
+                    {
+                        return CANCHANGEFILTER_DEADBAND;
+                    }
+                }
+            }
+
+            if (_Heartbeat != 0 && (int32_t) (now - _LastSent) >= (int32_t) _Heartbeat)
+            {
+                return CANCHANGEFILTER_HEARTBEAT;
+            }
+
+            _count(Changed == 0 ? _SuppressedUnchanged : _SuppressedDeadband);
+
+            return CANCHANGEFILTER_SUPPRESS;
+        }
+
+        /**
+         * @brief Stores the Payload of a sent Frame as Reference for the next check().
+         * @param Data Payload
+         * @param length Number of Bytes (max. 8)
+         * @param now Current Time in ms
+         * @param reason Result of check()
+         */
+        void commit(const uint8_t *Data, uint8_t length, uint32_t now, uint8_t reason)
+        {
+            _Last = 0;
+            memcpy(&_Last, Data, length);
+            _LastSent = now;
+            _hasSent = true;
+
+            _count(_Sent);
+
+            if (reason == CANCHANGEFILTER_HEARTBEAT)
+            {
+                _count(_Heartbeats);
+            }
+        }
+
+        // Statistics (saturating at 0xFFFF)
+
+        uint16_t getSent() { return _Sent; }
+        uint16_t getHeartbeats() { return _Heartbeats; }
+        uint16_t getSuppressedUnchanged() { return _SuppressedUnchanged; }
+        uint16_t getSuppressedDeadband() { return _SuppressedDeadband; }
+        uint16_t getSuppressed()
+        {
+            uint32_t Sum = (uint32_t) _SuppressedUnchanged + _SuppressedDeadband;
+
+            return Sum > 0xFFFF ? 0xFFFF : (uint16_t) Sum;
+        }
+
+        void resetStatistics()
+        {
+            _Sent = 0;
+            _Heartbeats = 0;
+            _SuppressedUnchanged = 0;
+            _SuppressedDeadband = 0;
+        }
+
+        // For CANMessage (the Filter takes the Place of the Bus in the Message)
+
+        CANBus *getBus() { return _Bus; }
+        void setBus(CANBus *bus) { _Bus = bus; }
+
+};
+
+#endif
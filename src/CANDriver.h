@@ -0,0 +1,58 @@
+/**
+ * @file CANDriver.h
+ * @author MH-Tobi
+ * @brief Selection of the CAN-Driver the Messages and the Bus are bound to.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANDRIVER_H
+#define CANDRIVER_H
+
+/*
+ * A Driver is a Struct with static Methods (resolved at Compile-Time, no virtual Calls) and the Type of its Controller:
+ *
+ *  typedef ... Controller;
+ *  static const bool SupportsFD;                                                        // true when the Controller sends and receives CAN FD-Frames
+ *
+ *  Message-Level (used by CANMessage)
+ *  static uint8_t findFreeTransmitBuffer(Controller &controller);                      // Buffer-Number, >= 0xE0 when no Buffer is free
+ *  static bool fillTransmitBuffer(Controller &controller, uint8_t BufferNumber, uint32_t id, uint8_t frame, bool rtr, uint8_t dlc, uint8_t *Data);
+ *  static bool sendTransmitBuffer(Controller &controller, uint8_t BufferNumber, uint8_t priority);
+ *  static bool checkRtr(Controller &controller, uint32_t id, uint8_t frame);
+ *  static bool receive(Controller &controller, uint32_t id, uint8_t frame, uint8_t dlc, uint8_t *Data);
+ *  static uint8_t getReceiveFlags(Controller &controller);                             // CANMESSAGE_FRAME_BRS and _ESI of the last received CAN FD-Frame
+ *  static uint16_t getLastError(Controller &controller);
+ *
+ *  For CAN FD-Frames frame also contains CANMESSAGE_FRAME_FD (and CANMESSAGE_FRAME_BRS) and dlc is the Data-Length-Code (0 - 15),
+ *  Data holds the Length of the Code (up to 64 Bytes). Classic Drivers only get Classic Frames.
+ *
+ *  Register-Level of the MCP2515 (used by CANBus, one SPI-Transaction each)
+ *  static uint8_t readStatus(Controller &controller, uint8_t csPin);
+ *  static void readReceiveBuffer(Controller &controller, uint8_t csPin, uint8_t BufferNumber, CANFrame &frame);
+ *  static uint8_t readRegister(Controller &controller, uint8_t csPin, uint8_t address);
+ *  static void writeRegisters(Controller &controller, uint8_t csPin, uint8_t address, const uint8_t *Data, uint8_t length);
+ *  static void bitModify(Controller &controller, uint8_t csPin, uint8_t address, uint8_t mask, uint8_t data);
+ *  static void requestToSend(Controller &controller, uint8_t csPin, uint8_t buffers);                 // Bit n = Transmit-Buffer n
+ *
+ * Default is the MCP2515-Library on Arduino and the Loopback-Controller on the Host.
+ * Another Driver is selected with the Build-Flags CANMESSAGE_DRIVER (Name of the Struct) and CANMESSAGE_DRIVER_HEADER (Header with the Struct).
+ */
+
+#if defined(CANMESSAGE_DRIVER)
+#include CANMESSAGE_DRIVER_HEADER
+#elif defined(ARDUINO)
+#include "CANDriverMCP2515.h"
+#define CANMESSAGE_DRIVER               CANDriverMCP2515
+#else
+#include "CANDriverLoopback.h"
+#define CANMESSAGE_DRIVER               CANDriverLoopback
+#endif
+
+typedef CANMESSAGE_DRIVER CANDriver;
+typedef CANDriver::Controller CANController;
+
+#endif
@@ -0,0 +1,882 @@
+#include "CANDriverLoopback.h"
+#include <string.h>
+
+#define CANLOOPBACK_SIDH        1       // Offset of SIDH to the Control-Register of a Buffer
+#define CANLOOPBACK_DLC         5
+#define CANLOOPBACK_DATA        6
+
+
+/**
+ * @brief Constructor
+ *
+ * Like the MCP2515 after a Reset the Controller is in Configuration-Mode.
+ */
+CANLoopbackController::CANLoopbackController() :
+    _lastError(0),
+    _Loopback(false),
+    _FD(false),
+    _ErrorPassive(false),
+    _RxFDFull(0),
+    _ReceiveFlags(0),
+    _SpiTransactions(0),
+    _SpiBytes(0),
+    _TransmittedFrames(0),
+    _ReceivedFrames(0),
+    _FilteredFrames(0),
+    _OverflowFrames(0)
+{
+    memset(_Registers, 0, sizeof(_Registers));
+    memset(_TxFlags, 0, sizeof(_TxFlags));
+    _Registers[MCP2515_REGISTER_CANSTAT] = MCP2515_MODE_CONFIGURATION;
+    _Registers[MCP2515_REGISTER_CANCTRL] = MCP2515_MODE_CONFIGURATION;
+}
+
+/**
+ * @brief Initialisation (all Frames are received, Rollover to RXB1, Normal-Mode).
+ * @param speed Bitrate (not used)
+ * @return true
+ */
+bool CANLoopbackController::init(long speed)
+{
+    (void) speed;
+
+    _lastError = 0;
+    memset(_Registers, 0, sizeof(_Registers));
+    memset(_TxFlags, 0, sizeof(_TxFlags));
+    _RxFDFull = 0;
+    _ReceiveFlags = 0;
+    _Registers[MCP2515_REGISTER_RXB0CTRL] = MCP2515_RXBCTRL_RXM | MCP2515_RXBCTRL_BUKT;
+    _Registers[MCP2515_REGISTER_RXB1CTRL] = MCP2515_RXBCTRL_RXM;
+    _Registers[MCP2515_REGISTER_CANSTAT] = MCP2515_MODE_NORMAL;
+    _Registers[MCP2515_REGISTER_CANCTRL] = MCP2515_MODE_NORMAL;
+
+    return true;
+}
+
+/**
+ * @brief Enables or disables the Loopback (transmitted Frames are received again).
+ * @param loopback true = Loopback
+ */
+void CANLoopbackController::setLoopback(bool loopback)
+{
+    _Loopback = loopback;
+}
+
+/**
+ * @brief Enables or disables the FD-Mode (CAN FD-Frames are sent and received).
+ *
+ * Without the FD-Mode the Controller is Classic like the MCP2515: FD-Frames can not be loaded and are not received.
+ * @param fd true = FD-Mode
+ */
+void CANLoopbackController::setFD(bool fd)
+{
+    _FD = fd;
+}
+
+/**
+ * @brief Returns the FD-Mode.
+ * @return true when CAN FD-Frames are sent and received
+ */
+bool CANLoopbackController::isFD()
+{
+    return _FD;
+}
+
+/**
+ * @brief Sets the Error-State of the Controller, an Error-Passive Controller sends its FD-Frames with the ESI-Bit.
+ * @param passive true = Error-Passive
+ */
+void CANLoopbackController::setErrorPassive(bool passive)
+{
+    _ErrorPassive = passive;
+}
+
+/**
+ * @brief Receives a Frame from the Bus (Masks, Filters and Rollover like the MCP2515).
+ * @param frame Frame
+ * @return true when the Frame is stored in a Receive-Buffer, false when it is filtered or the Buffer is full
+ */
+bool CANLoopbackController::receiveFrame(const CANFrame &frame)
+{
+    bool Accept1;
+    bool Accept0 = _accept(frame, Accept1);
+
+    uint8_t Flags = _Registers[MCP2515_REGISTER_CANINTF];
+
+    if (Accept0)
+    {
+        if ((Flags & MCP2515_CANINT_RX0I) == 0)
+        {
+            _storeFrame(0, frame);
+            return true;
+        }
+
+        if ((_Registers[MCP2515_REGISTER_RXB0CTRL] & MCP2515_RXBCTRL_BUKT) != 0 && (Flags & (MCP2515_CANINT_RX0I << 1)) == 0)
+        {
+            _storeFrame(1, frame);
+            return true;
+        }
+
+        _OverflowFrames++;
+        return false;
+    }
+
+    if (Accept1)
+    {
+        if ((Flags & (MCP2515_CANINT_RX0I << 1)) == 0)
+        {
+            _storeFrame(1, frame);
+            return true;
+        }
+
+        _OverflowFrames++;
+        return false;
+    }
+
+    _FilteredFrames++;
+    return false;
+}
+
+/**
+ * @brief Receives a Frame from the Bus in the FD-Format (Classic Frames are passed to receiveFrame()).
+ *
+ * An FD-Frame passes the Masks and Filters with its ID (and the first 2 Data-Bytes of a Standard-Frame) and is stored in
+ * a free FD-Receive-Buffer, the Data behind its Length is cleared. Without the FD-Mode it is not received.
+ * @param frame Frame
+ * @return true when the Frame is stored in a Receive-Buffer, false when it is filtered or the Buffer is full
+ */
+bool CANLoopbackController::receiveFrameFD(const CANLoopbackFrameFD &frame)
+{
+    CANFrame Header;
+    uint8_t Length = canDlcToLength(frame.DLC & 0x0F);
+
+    Header.ID = frame.ID;
+    Header.Frame = frame.Frame & 0x01;
+    Header.RTR = frame.RTR;
+    Header.DLC = Length > 8 ? 8 : Length;
+    memcpy(Header.Data, frame.Data, Header.DLC);
+
+    if ((frame.Frame & CANLOOPBACK_FRAME_FD) == 0)
+    {
+        return receiveFrame(Header);
+    }
+
+    bool Accept1;
+
+    if (!_FD || (!_accept(Header, Accept1) && !Accept1))
+    {
+        _FilteredFrames++;
+        return false;
+    }
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_FD_RX_BUFFERS; BufferNumber++)
+    {
+        if ((_RxFDFull & (1 << BufferNumber)) == 0)
+        {
+            CANLoopbackFrameFD &Buffer = _RxFD[BufferNumber];
+
+            Buffer.ID = frame.ID;
+            Buffer.Frame = frame.Frame;
+            Buffer.RTR = false;
+            Buffer.DLC = frame.DLC & 0x0F;
+            memcpy(Buffer.Data, frame.Data, Length);
+            memset(&Buffer.Data[Length], 0, CANFRAME_MAX_LENGTH_FD - Length);
+
+            _RxFDFull |= 1 << BufferNumber;
+            _ReceivedFrames++;
+            return true;
+        }
+    }
+
+    _OverflowFrames++;
+    return false;
+}
+
+/**
+ * @brief Sends the loaded Transmit-Buffer with the highest Priority (TXP, on equal TXP the higher Buffer-Number).
+ *
+ * The TXREQ-Bit is cleared and the TXnIF-Flag is set, in Loopback-Mode the Frame is received again.
+ * An FD-Frame is returned with its first 8 Bytes, use transmitFD() for the whole Frame.
+ * @param frame Sent Frame
+ * @return true when a Frame was sent, false when no Transmit-Buffer is loaded
+ */
+bool CANLoopbackController::transmit(CANFrame &frame)
+{
+    int8_t Next = _transmit(frame);
+
+    if (Next < 0)
+    {
+        return false;
+    }
+
+    if (_Loopback)
+    {
+        if (_TxFlags[Next] != 0)
+        {
+            CANLoopbackFrameFD FDFrame;
+
+            _readTransmitFD(Next, frame, FDFrame);
+            receiveFrameFD(FDFrame);
+        } else {
+            receiveFrame(frame);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Sends the loaded Transmit-Buffer with the highest Priority like transmit() and returns it in the FD-Format.
+ *
+ * FD-Frames carry their whole Data, CANLOOPBACK_FRAME_BRS and CANLOOPBACK_FRAME_ESI (set when the Controller is Error-Passive).
+ * @param frame Sent Frame
+ * @return true when a Frame was sent, false when no Transmit-Buffer is loaded
+ */
+bool CANLoopbackController::transmitFD(CANLoopbackFrameFD &frame)
+{
+    CANFrame Classic;
+    int8_t Next = _transmit(Classic);
+
+    if (Next < 0)
+    {
+        return false;
+    }
+
+    _readTransmitFD(Next, Classic, frame);
+
+    if (_Loopback)
+    {
+        receiveFrameFD(frame);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Returns the Frame transmit() would send next, without sending it (e.g. for the Arbitration of a simulated Bus).
+ * @param frame Next Frame
+ * @return int8_t Number of the Transmit-Buffer, -1 when no Transmit-Buffer is loaded
+ */
+int8_t CANLoopbackController::peekTransmit(CANFrame &frame)
+{
+    int8_t Next = -1;
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_TX_BUFFERS; BufferNumber++)
+    {
+        uint8_t Control = _Registers[MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4)];
+
+        if ((Control & MCP2515_TXBCTRL_TXREQ) != 0 && (Next < 0 || (Control & MCP2515_TXBCTRL_TXP) >= (_Registers[MCP2515_REGISTER_TXB0CTRL + (Next << 4)] & MCP2515_TXBCTRL_TXP)))
+        {
+            Next = BufferNumber;
+        }
+    }
+
+    if (Next < 0)
+    {
+        return -1;
+    }
+
+    uint8_t Address = MCP2515_REGISTER_TXB0CTRL + (Next << 4);
+
+    _readFrame(Address + CANLOOPBACK_SIDH, frame);
+    frame.RTR = (_Registers[Address + CANLOOPBACK_DLC] & MCP2515_DLC_RTR) != 0;
+
+    return Next;
+}
+
+/**
+ * @brief Returns the Transmit-Buffers with a requested Transmission (not counted as SPI-Transaction).
+ * @return uint8_t Bit n = TXREQ of Transmit-Buffer n
+ */
+uint8_t CANLoopbackController::getTransmitRequests()
+{
+    uint8_t Requests = 0;
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_TX_BUFFERS; BufferNumber++)
+    {
+        if ((_Registers[MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4)] & MCP2515_TXBCTRL_TXREQ) != 0)
+        {
+            Requests |= 1 << BufferNumber;
+        }
+    }
+    return Requests;
+}
+
+/**
+ * @brief Returns the Number of loaded Transmit-Buffers.
+ * @return uint8_t Transmit-Buffers with TXREQ
+ */
+uint8_t CANLoopbackController::pendingTransmissions()
+{
+    uint8_t Count = 0;
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_TX_BUFFERS; BufferNumber++)
+    {
+        if ((_Registers[MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4)] & MCP2515_TXBCTRL_TXREQ) != 0)
+        {
+            Count++;
+        }
+    }
+    return Count;
+}
+
+/**
+ * @brief Returns the State of the Interrupt-Pin (an enabled Interrupt-Flag is set).
+ * @return true when the Interrupt-Routine has to be called
+ */
+bool CANLoopbackController::interruptPending()
+{
+    return (_Registers[MCP2515_REGISTER_CANINTF] & _Registers[MCP2515_REGISTER_CANINTE]) != 0;
+}
+
+/**
+ * @brief Searches a free Transmit-Buffer.
+ * @return uint8_t Number of the Transmit-Buffer, CANLOOPBACK_NO_FREE_BUFFER when all are busy
+ */
+uint8_t CANLoopbackController::check4FreeTransmitBuffer()
+{
+    uint8_t Status = readStatus();
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_TX_BUFFERS; BufferNumber++)
+    {
+        if ((Status & MCP2515_STATUS_TXREQ(BufferNumber)) == 0)
+        {
+            return BufferNumber;
+        }
+    }
+    return CANLOOPBACK_NO_FREE_BUFFER;
+}
+
+/**
+ * @brief Fills a Transmit-Buffer (LOAD TX BUFFER).
+ * @param BufferNumber Number of the Transmit-Buffer (0 - 2)
+ * @param id Message-ID
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame), in the FD-Mode combined with CANLOOPBACK_FRAME_FD and optional CANLOOPBACK_FRAME_BRS
+ * @param rtr Remote-Transmission-Request
+ * @param dlc Datalength (0 - 8), for FD-Frames the Data-Length-Code (0 - 15)
+ * @param Data Data
+ * @return true when success, false on any error (Check getLastMCPError())
+ */
+bool CANLoopbackController::fillTransmitBuffer(uint8_t BufferNumber, uint32_t id, uint8_t frame, bool rtr, uint8_t dlc, uint8_t *Data)
+{
+    _lastError = 0;
+
+    bool FD = (frame & CANLOOPBACK_FRAME_FD) != 0;
+
+    if (BufferNumber >= CANLOOPBACK_TX_BUFFERS || dlc > (FD ? CANFRAME_MAX_DLC : 8) || (_Registers[MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4)] & MCP2515_TXBCTRL_TXREQ) != 0)
+    {
+        _lastError = CANLOOPBACK_ERROR_BUFFER;
+        return false;
+    }
+
+    if (FD && (!_FD || rtr))
+    {
+        _lastError = CANLOOPBACK_ERROR_FD;
+        return false;
+    }
+
+    CANFrame Frame;
+    uint8_t Address = MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4);
+    uint8_t Length = canDlcToLength(dlc);
+
+    Frame.ID = id;
+    Frame.Frame = frame & 0x01;
+    Frame.RTR = rtr;
+    Frame.DLC = dlc;
+
+    _spi(6 + Length);
+    canRegisterEncode(Frame, &_Registers[Address + CANLOOPBACK_SIDH]);
+    memcpy(&_Registers[Address + CANLOOPBACK_DATA], Data, Length > 8 ? 8 : Length);
+
+    // The Data behind the 8 Bytes of the Register-File is held by the FD-Transmit-Buffer
+    _TxFlags[BufferNumber] = FD ? frame & (CANLOOPBACK_FRAME_FD | CANLOOPBACK_FRAME_BRS) : 0;
+
+    if (FD)
+    {
+        memcpy(_TxData[BufferNumber], Data, Length);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Requests the Transmission of a filled Transmit-Buffer.
+ * @param BufferNumber Number of the Transmit-Buffer (0 - 2)
+ * @param priority TXP-Priority (0 - 3)
+ * @return true when success, false on any error (Check getLastMCPError())
+ */
+bool CANLoopbackController::sendMessage(uint8_t BufferNumber, uint8_t priority)
+{
+    _lastError = 0;
+
+    if (BufferNumber >= CANLOOPBACK_TX_BUFFERS)
+    {
+        _lastError = CANLOOPBACK_ERROR_BUFFER;
+        return false;
+    }
+
+    bitModify(MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4), MCP2515_TXBCTRL_TXREQ | MCP2515_TXBCTRL_TXP, MCP2515_TXBCTRL_TXREQ | (priority & MCP2515_TXBCTRL_TXP));
+
+    return true;
+}
+
+/**
+ * @brief Checks if a Remote-Transmission-Request with the ID is in a Receive-Buffer and releases it.
+ * @param id Message-ID
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return true when a Remote-Transmission-Request was received
+ */
+bool CANLoopbackController::check4Rtr(uint32_t id, uint8_t frame)
+{
+    uint8_t Status = readStatus();
+    CANFrame Frame;
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_RX_BUFFERS; BufferNumber++)
+    {
+        if ((Status & MCP2515_STATUS_RXIF(BufferNumber)) == 0)
+        {
+            continue;
+        }
+
+        _spi(6);
+        _readFrame(MCP2515_REGISTER_RXB0CTRL + (BufferNumber << 4) + CANLOOPBACK_SIDH, Frame);
+
+        if (Frame.ID == id && Frame.Frame == frame && Frame.RTR)
+        {
+            return releaseReceiveBuffer(BufferNumber);
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Checks if a Frame with the ID is in a Receive-Buffer, copies the Data and releases the Buffer.
+ *
+ * With CANLOOPBACK_FRAME_FD the FD-Receive-Buffers are searched, BRS and ESI of the Frame are returned by getReceiveFlags().
+ * @param id Message-ID
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame), optional combined with CANLOOPBACK_FRAME_FD
+ * @param dlc Number of Data-Bytes to be copied, for FD-Frames the Data-Length-Code (0 - 15)
+ * @param Data Buffer for the Data
+ * @return true when success, false when no Frame was received (Check getLastMCPError())
+ */
+bool CANLoopbackController::check4Receive(uint32_t id, uint8_t frame, uint8_t dlc, uint8_t *Data)
+{
+    _lastError = 0;
+
+    if ((frame & CANLOOPBACK_FRAME_FD) != 0)
+    {
+        uint8_t Length = canDlcToLength(dlc & 0x0F);
+
+        for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_FD_RX_BUFFERS; BufferNumber++)
+        {
+            const CANLoopbackFrameFD &Buffer = _RxFD[BufferNumber];
+
+            if ((_RxFDFull & (1 << BufferNumber)) != 0 && Buffer.ID == id && (Buffer.Frame & 0x01) == (frame & 0x01))
+            {
+                _spi(6);
+                _spi(1 + Length);
+                memcpy(Data, Buffer.Data, Length);
+                _ReceiveFlags = Buffer.Frame & (CANLOOPBACK_FRAME_BRS | CANLOOPBACK_FRAME_ESI);
+                _RxFDFull &= ~(1 << BufferNumber);
+                return true;
+            }
+        }
+
+        _lastError = CANLOOPBACK_ERROR_NO_MESSAGE;
+        return false;
+    }
+
+    uint8_t Status = readStatus();
+    CANFrame Frame;
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_RX_BUFFERS; BufferNumber++)
+    {
+        if ((Status & MCP2515_STATUS_RXIF(BufferNumber)) == 0)
+        {
+            continue;
+        }
+
+        uint8_t Address = MCP2515_REGISTER_RXB0CTRL + (BufferNumber << 4);
+
+        _spi(6);
+        _readFrame(Address + CANLOOPBACK_SIDH, Frame);
+
+        if (Frame.ID == id && Frame.Frame == frame && !Frame.RTR)
+        {
+            _spi(1 + (dlc > 8 ? 8 : dlc));
+            memcpy(Data, &_Registers[Address + CANLOOPBACK_DATA], dlc > 8 ? 8 : dlc);
+            return releaseReceiveBuffer(BufferNumber);
+        }
+    }
+
+    _lastError = CANLOOPBACK_ERROR_NO_MESSAGE;
+    return false;
+}
+
+/**
+ * @brief Releases a Receive-Buffer (clears the RXnIF-Flag).
+ * @param BufferNumber Number of the Receive-Buffer (0 - 1)
+ * @return true when success, false when the Buffer-Number is not valid
+ */
+bool CANLoopbackController::releaseReceiveBuffer(uint8_t BufferNumber)
+{
+    if (BufferNumber >= CANLOOPBACK_RX_BUFFERS)
+    {
+        return false;
+    }
+
+    bitModify(MCP2515_REGISTER_CANINTF, MCP2515_CANINT_RX0I << BufferNumber, 0x00);
+    return true;
+}
+
+/**
+ * @brief Returns BRS and ESI of the last FD-Frame read by check4Receive().
+ * @return uint8_t CANLOOPBACK_FRAME_BRS and CANLOOPBACK_FRAME_ESI
+ */
+uint8_t CANLoopbackController::getReceiveFlags()
+{
+    return _ReceiveFlags;
+}
+
+/**
+ * @brief Returns the last Error of a Message-Level Method.
+ * @return uint16_t Error (0 = no Error)
+ */
+uint16_t CANLoopbackController::getLastMCPError()
+{
+    return _lastError;
+}
+
+/**
+ * @brief READ STATUS (Bit 0 = RX0IF; Bit 1 = RX1IF; Bit 2/4/6 = TXnREQ; Bit 3/5/7 = TXnIF).
+ * @return uint8_t Status
+ */
+uint8_t CANLoopbackController::readStatus()
+{
+    uint8_t Flags = _Registers[MCP2515_REGISTER_CANINTF];
+    uint8_t Status = Flags & (MCP2515_CANINT_RX0I | (MCP2515_CANINT_RX0I << 1));
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_TX_BUFFERS; BufferNumber++)
+    {
+        if ((_Registers[MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4)] & MCP2515_TXBCTRL_TXREQ) != 0)
+        {
+            Status |= MCP2515_STATUS_TXREQ(BufferNumber);
+        }
+
+        if ((Flags & (MCP2515_CANINT_TX0I << BufferNumber)) != 0)
+        {
+            Status |= MCP2515_STATUS_TXIF(BufferNumber);
+        }
+    }
+
+    _spi(2);
+
+    return Status;
+}
+
+/**
+ * @brief READ RX BUFFER (Header and Data), the RXnIF-Flag is cleared afterwards.
+ * @param BufferNumber Number of the Receive-Buffer (0 - 1)
+ * @param frame Frame to be filled
+ */
+void CANLoopbackController::readReceiveBuffer(uint8_t BufferNumber, CANFrame &frame)
+{
+    _readFrame(MCP2515_REGISTER_RXB0CTRL + (BufferNumber << 4) + CANLOOPBACK_SIDH, frame);
+    _spi(6 + frame.DLC);
+    _Registers[MCP2515_REGISTER_CANINTF] &= ~(MCP2515_CANINT_RX0I << BufferNumber);
+}
+
+/**
+ * @brief READ
+ * @param address Register-Address
+ * @return uint8_t Value
+ */
+uint8_t CANLoopbackController::readRegister(uint8_t address)
+{
+    _spi(3);
+    return _Registers[address & (CANLOOPBACK_REGISTERS - 1)];
+}
+
+/**
+ * @brief WRITE (sequential Registers)
+ * @param address Address of the first Register
+ * @param Data Values
+ * @param length Number of Registers
+ */
+void CANLoopbackController::writeRegisters(uint8_t address, const uint8_t *Data, uint8_t length)
+{
+    _spi(2 + length);
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        _writeRegister((address + i) & (CANLOOPBACK_REGISTERS - 1), Data[i]);
+    }
+}
+
+/**
+ * @brief BIT MODIFY
+ * @param address Register-Address
+ * @param mask Bits to be changed
+ * @param data New Value of the Bits
+ */
+void CANLoopbackController::bitModify(uint8_t address, uint8_t mask, uint8_t data)
+{
+    _spi(4);
+    address &= CANLOOPBACK_REGISTERS - 1;
+    _writeRegister(address, (_Registers[address] & ~mask) | (data & mask));
+}
+
+/**
+ * @brief REQUEST TO SEND: Requests the Transmission of several filled Transmit-Buffers with one Instruction-Byte.
+ * @param buffers Bit n = Transmit-Buffer n (0x07 = all)
+ */
+void CANLoopbackController::requestToSend(uint8_t buffers)
+{
+    _spi(1);
+
+    for (uint8_t BufferNumber = 0; BufferNumber < CANLOOPBACK_TX_BUFFERS; BufferNumber++)
+    {
+        if ((buffers & (1 << BufferNumber)) != 0)
+        {
+            _Registers[MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4)] |= MCP2515_TXBCTRL_TXREQ;
+        }
+    }
+}
+/**
+ * @brief Returns the Number of counted SPI-Transactions (one per Register-Access).
+ * @return uint32_t SPI-Transactions
+ */
+uint32_t CANLoopbackController::getSpiTransactions()
+{
+    return _SpiTransactions;
+}
+
+/**
+ * @brief Returns the Number of Bytes of the counted SPI-Transactions (Instruction, Address and Data like on the MCP2515).
+ * @return uint32_t SPI-Bytes
+ */
+uint32_t CANLoopbackController::getSpiBytes()
+{
+    return _SpiBytes;
+}
+
+/**
+ * @brief Returns the Number of Frames sent with transmit().
+ * @return uint32_t Transmitted Frames
+ */
+uint32_t CANLoopbackController::getTransmittedFrames()
+{
+    return _TransmittedFrames;
+}
+
+/**
+ * @brief Returns the Number of Frames stored in a Receive-Buffer.
+ * @return uint32_t Received Frames
+ */
+uint32_t CANLoopbackController::getReceivedFrames()
+{
+    return _ReceivedFrames;
+}
+
+/**
+ * @brief Returns the Number of Frames rejected by the Masks and Filters.
+ * @return uint32_t Filtered Frames
+ */
+uint32_t CANLoopbackController::getFilteredFrames()
+{
+    return _FilteredFrames;
+}
+
+/**
+ * @brief Returns the Number of Frames lost because the Receive-Buffer was full.
+ * @return uint32_t Overflow Frames
+ */
+uint32_t CANLoopbackController::getOverflowFrames()
+{
+    return _OverflowFrames;
+}
+
+/**
+ * @brief Resets all Statistic-Counters.
+ */
+void CANLoopbackController::resetStatistics()
+{
+    _SpiTransactions = 0;
+    _SpiBytes = 0;
+    _TransmittedFrames = 0;
+    _ReceivedFrames = 0;
+    _FilteredFrames = 0;
+    _OverflowFrames = 0;
+}
+
+/**
+ * @brief Counts one SPI-Transaction.
+ * @param bytes Bytes of the Transaction on the MCP2515
+ */
+void CANLoopbackController::_spi(uint8_t bytes)
+{
+    _SpiTransactions++;
+    _SpiBytes += bytes;
+}
+
+/**
+ * @brief Checks a Frame against the Masks and Filters of both Receive-Buffers.
+ * @param frame Frame
+ * @param Accept1 Set when Receive-Buffer 1 accepts the Frame
+ * @return true when Receive-Buffer 0 accepts the Frame
+ */
+bool CANLoopbackController::_accept(const CANFrame &frame, bool &Accept1)
+{
+    bool Accept0 = (_Registers[MCP2515_REGISTER_RXB0CTRL] & MCP2515_RXBCTRL_RXM) == MCP2515_RXBCTRL_RXM || _matchFilter(0, frame) || _matchFilter(1, frame);
+
+    Accept1 = (_Registers[MCP2515_REGISTER_RXB1CTRL] & MCP2515_RXBCTRL_RXM) == MCP2515_RXBCTRL_RXM;
+
+    for (uint8_t FilterNumber = 2; FilterNumber < 6 && !Accept1; FilterNumber++)
+    {
+        Accept1 = _matchFilter(FilterNumber, frame);
+    }
+
+    return Accept0;
+}
+
+/**
+ * @brief Checks a Frame against a Filter and its Mask (RXF0 - RXF1 use RXM0, RXF2 - RXF5 use RXM1).
+ *
+ * Like the MCP2515 the Extended-ID-Bits of the Mask are compared with the first 2 Data-Bytes of a Standard-Frame.
+ * @param FilterNumber Number of the Filter (0 - 5)
+ * @param frame Frame
+ * @return true when the Frame passes the Filter
+ */
+bool CANLoopbackController::_matchFilter(uint8_t FilterNumber, const CANFrame &frame)
+{
+    const uint8_t *Filter = &_Registers[(FilterNumber < 3 ? 0x00 : 0x04) + (FilterNumber << 2)];
+    const uint8_t *Mask = &_Registers[MCP2515_REGISTER_RXM0SIDH + (FilterNumber < 2 ? 0x00 : 0x04)];
+
+    if (((Filter[1] & MCP2515_SIDL_IDE) != 0) != (frame.Frame == 1))
+    {
+        return false;
+    }
+
+    uint32_t FilterValue = ((uint32_t) Filter[0] << 21) | ((uint32_t) (Filter[1] >> 5) << 18) | ((uint32_t) (Filter[1] & 0x03) << 16) | ((uint32_t) Filter[2] << 8) | Filter[3];
+    uint32_t MaskValue = ((uint32_t) Mask[0] << 21) | ((uint32_t) (Mask[1] >> 5) << 18) | ((uint32_t) (Mask[1] & 0x03) << 16) | ((uint32_t) Mask[2] << 8) | Mask[3];
+    uint32_t Value;
+
+    if (frame.Frame == 1)
+    {
+        Value = frame.ID;
+    } else {
+        Value = (frame.ID << 18) | (frame.DLC > 0 ? (uint32_t) frame.Data[0] << 8 : 0) | (frame.DLC > 1 ? frame.Data[1] : 0);
+        MaskValue &= ~((uint32_t) 0x03 << 16);
+    }
+
+    return ((Value ^ FilterValue) & MaskValue) == 0;
+}
+
+/**
+ * @brief Stores a Frame in a Receive-Buffer and sets the RXnIF-Flag.
+ * @param BufferNumber Number of the Receive-Buffer (0 - 1)
+ * @param frame Frame
+ */
+void CANLoopbackController::_storeFrame(uint8_t BufferNumber, const CANFrame &frame)
+{
+    uint8_t Address = MCP2515_REGISTER_RXB0CTRL + (BufferNumber << 4);
+
+    canRegisterEncode(frame, &_Registers[Address + CANLOOPBACK_SIDH]);
+
+    // The Receive-Buffer shows the RTR of a Standard-Frame in the SRR-Bit
+    if (frame.Frame == 0 && frame.RTR)
+    {
+        _Registers[Address + CANLOOPBACK_SIDH + 1] |= MCP2515_SIDL_SRR;
+        _Registers[Address + CANLOOPBACK_DLC] &= ~MCP2515_DLC_RTR;
+    }
+
+    memcpy(&_Registers[Address + CANLOOPBACK_DATA], frame.Data, frame.DLC > 8 ? 8 : frame.DLC);
+
+    _Registers[MCP2515_REGISTER_CANINTF] |= MCP2515_CANINT_RX0I << BufferNumber;
+    _ReceivedFrames++;
+}
+
+/**
+ * @brief Reads Header and Data of a Buffer.
+ * @param address Address of the SIDH-Register
+ * @param frame Frame to be filled
+ */
+void CANLoopbackController::_readFrame(uint8_t address, CANFrame &frame)
+{
+    canRegisterDecode(&_Registers[address], frame);
+    memcpy(frame.Data, &_Registers[address + CANLOOPBACK_DATA - CANLOOPBACK_SIDH], frame.DLC);
+}
+
+/**
+ * @brief Sends the next Transmit-Buffer: clears the TXREQ-Bit and sets the TXnIF-Flag.
+ * @param frame Sent Frame (Classic View)
+ * @return int8_t Number of the Transmit-Buffer, -1 when no Transmit-Buffer is loaded
+ */
+int8_t CANLoopbackController::_transmit(CANFrame &frame)
+{
+    int8_t Next = peekTransmit(frame);
+
+    if (Next < 0)
+    {
+        return -1;
+    }
+
+    _Registers[MCP2515_REGISTER_TXB0CTRL + (Next << 4)] &= ~MCP2515_TXBCTRL_TXREQ;
+    _Registers[MCP2515_REGISTER_CANINTF] |= MCP2515_CANINT_TX0I << Next;
+    _TransmittedFrames++;
+
+    return Next;
+}
+
+/**
+ * @brief Returns a Transmit-Buffer in the FD-Format.
+ * @param BufferNumber Number of the Transmit-Buffer (0 - 2)
+ * @param frame Classic View of the Buffer (from peekTransmit())
+ * @param FDFrame Frame to be filled
+ */
+void CANLoopbackController::_readTransmitFD(uint8_t BufferNumber, const CANFrame &frame, CANLoopbackFrameFD &FDFrame)
+{
+    FDFrame.ID = frame.ID;
+    FDFrame.Frame = frame.Frame;
+    FDFrame.RTR = frame.RTR;
+    FDFrame.DLC = frame.DLC;
+
+    if (_TxFlags[BufferNumber] == 0)
+    {
+        memcpy(FDFrame.Data, frame.Data, frame.DLC);
+        return;
+    }
+
+    FDFrame.Frame |= _TxFlags[BufferNumber] | (_ErrorPassive ? CANLOOPBACK_FRAME_ESI : 0);
+    FDFrame.DLC = _Registers[MCP2515_REGISTER_TXB0CTRL + (BufferNumber << 4) + CANLOOPBACK_DLC] & 0x0F;
+    memcpy(FDFrame.Data, _TxData[BufferNumber], canDlcToLength(FDFrame.DLC));
+}
+
+/**
+ * @brief Writes a Register with the Side-Effects of the MCP2515.
+ *
+ * The requested Operation-Mode is active at once, Masks and Filters can only be changed in Configuration-Mode.
+ * Writing the Header or Data of a Transmit-Buffer makes it a Classic Frame again.
+ * @param address Register-Address
+ * @param value Value
+ */
+void CANLoopbackController::_writeRegister(uint8_t address, uint8_t value)
+{
+    if (address < MCP2515_REGISTER_CANINTE && (address & 0x0F) < 0x0C && (_Registers[MCP2515_REGISTER_CANSTAT] & MCP2515_CANCTRL_REQOP) != MCP2515_MODE_CONFIGURATION)
+    {
+        return;
+    }
+
+    _Registers[address] = value;
+
+    if (address == MCP2515_REGISTER_CANCTRL)
+    {
+        _Registers[MCP2515_REGISTER_CANSTAT] = (_Registers[MCP2515_REGISTER_CANSTAT] & ~MCP2515_CANCTRL_REQOP) | (value & MCP2515_CANCTRL_REQOP);
+    }
+
+    // A Transmit-Buffer loaded over the Registers holds a Classic Frame
+    if (address > MCP2515_REGISTER_TXB0CTRL && address < MCP2515_REGISTER_RXB0CTRL && (address & 0x0F) != 0 && (address & 0x0F) < 0x0E)
+    {
+        _TxFlags[(address - MCP2515_REGISTER_TXB0CTRL) >> 4] = 0;
+    }
+}
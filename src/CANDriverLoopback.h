@@ -0,0 +1,173 @@
+/**
+ * @file CANDriverLoopback.h
+ * @author MH-Tobi
+ * @brief In-Process Loopback-Controller and its Driver-Adapter (default Driver on the Host).
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANDRIVERLOOPBACK_H
+#define CANDRIVERLOOPBACK_H
+
+#include <stdint.h>
+#include "CANFrame.h"
+#include "CANRegisterMap.h"
+
+
+#define CANLOOPBACK_REGISTERS           128     // Register-File of the MCP2515
+#define CANLOOPBACK_TX_BUFFERS          3
+#define CANLOOPBACK_RX_BUFFERS          2
+#define CANLOOPBACK_FD_RX_BUFFERS       2       // Receive-Buffers for CAN FD-Frames (FD-Mode only)
+
+// Flags of a CAN FD-Frame in CANLoopbackFrameFD::Frame (same Bits as CANMESSAGE_FRAME_FD, _BRS and _ESI)
+#define CANLOOPBACK_FRAME_FD            0x02
+#define CANLOOPBACK_FRAME_BRS           0x04
+#define CANLOOPBACK_FRAME_ESI           0x08
+
+#define CANLOOPBACK_NO_FREE_BUFFER      0xE0    // Returned by check4FreeTransmitBuffer() when all Transmit-Buffers are busy
+#define CANLOOPBACK_ERROR_NO_MESSAGE    0x0100  // No Frame with the requested ID in the Receive-Buffers
+#define CANLOOPBACK_ERROR_BUFFER        0x0200  // Transmit-Buffer not valid or busy
+#define CANLOOPBACK_ERROR_FD            0x0400  // CAN FD-Frame while the FD-Mode is off (or with RTR)
+
+
+/**
+ * @brief Frame of the Bus-Side in the FD-Mode (Classic or CAN FD with up to 64 Bytes).
+ */
+struct CANLoopbackFrameFD
+{
+    uint32_t ID;                                // Message-ID (11 bit for Standard-Frame; 29 bit for Extended Frame)
+    uint8_t Frame;                              // Standard-Frame = 0; Extended-Frame = 1, combined with CANLOOPBACK_FRAME_FD, _BRS and _ESI
+    bool RTR;                                   // Remote Transmission Request (Classic Frames only)
+    uint8_t DLC;                                // Data-Length-Code (0 - 15)
+    uint8_t Data[CANFRAME_MAX_LENGTH_FD];
+};
+
+
+/**
+ * @brief Models the MCP2515 without Hardware (Register-File, 3 Transmit- and 2 Receive-Buffers, Masks and Filters).
+ *
+ * Frames of the Bus are injected with receiveFrame(), loaded Transmit-Buffers are sent with transmit()
+ * (in Loopback-Mode the sent Frame is received again). Each Register-Access is counted as one SPI-Transaction
+ * with the Bytes the MCP2515 would transfer.
+ * The Message-Level Methods have the same Names as the MCP2515-Library.
+ *
+ * In the FD-Mode (setFD()) the Controller also sends and receives CAN FD-Frames: a Transmit-Buffer holds up to 64 Bytes,
+ * received FD-Frames pass the Masks and Filters and are stored in CANLOOPBACK_FD_RX_BUFFERS own Receive-Buffers
+ * (the Register-File of the MCP2515 only holds Classic Frames, so the Register-Level never sees them).
+ */
+class CANLoopbackController
+{
+	private:
+        uint8_t _Registers[CANLOOPBACK_REGISTERS];
+        uint16_t _lastError;
+        bool _Loopback;
+        bool _FD;
+        bool _ErrorPassive;                     // Sets the ESI-Bit of sent FD-Frames
+        uint8_t _TxFlags[CANLOOPBACK_TX_BUFFERS];                       // 0 = Classic, else CANLOOPBACK_FRAME_FD and _BRS
+        uint8_t _TxData[CANLOOPBACK_TX_BUFFERS][CANFRAME_MAX_LENGTH_FD];
+        CANLoopbackFrameFD _RxFD[CANLOOPBACK_FD_RX_BUFFERS];
+        uint8_t _RxFDFull;                      // Bit n = FD-Receive-Buffer n is full
+        uint8_t _ReceiveFlags;                  // CANLOOPBACK_FRAME_BRS and _ESI of the last FD-Frame read by check4Receive()
+        uint32_t _SpiTransactions;
+        uint32_t _SpiBytes;
+        uint32_t _TransmittedFrames;            // Frames sent with transmit()
+        uint32_t _ReceivedFrames;               // Frames stored in a Receive-Buffer
+        uint32_t _FilteredFrames;               // Frames rejected by the Masks and Filters
+        uint32_t _OverflowFrames;               // Frames lost because the Receive-Buffer was full
+
+        void _spi(uint8_t bytes);
+        bool _matchFilter(uint8_t FilterNumber, const CANFrame &frame);
+        bool _accept(const CANFrame &frame, bool &Accept1);
+        void _storeFrame(uint8_t BufferNumber, const CANFrame &frame);
+        void _readFrame(uint8_t address, CANFrame &frame);
+        void _writeRegister(uint8_t address, uint8_t value);
+        int8_t _transmit(CANFrame &frame);
+        void _readTransmitFD(uint8_t BufferNumber, const CANFrame &frame, CANLoopbackFrameFD &FDFrame);
+
+	public:
+
+        CANLoopbackController();
+
+        bool init(long speed);
+        void setLoopback(bool loopback);
+        void setFD(bool fd);
+        bool isFD();
+        void setErrorPassive(bool passive);
+
+        // Bus-Side
+
+        bool receiveFrame(const CANFrame &frame);
+        bool receiveFrameFD(const CANLoopbackFrameFD &frame);
+        bool transmit(CANFrame &frame);
+        bool transmitFD(CANLoopbackFrameFD &frame);
+        int8_t peekTransmit(CANFrame &frame);
+        uint8_t getTransmitRequests();
+        uint8_t pendingTransmissions();
+        bool interruptPending();
+
+        // Message-Level (same as MCP2515-Library)
+
+        uint8_t check4FreeTransmitBuffer();
+        bool fillTransmitBuffer(uint8_t BufferNumber, uint32_t id, uint8_t frame, bool rtr, uint8_t dlc, uint8_t *Data);
+        bool sendMessage(uint8_t BufferNumber, uint8_t priority);
+        bool check4Rtr(uint32_t id, uint8_t frame);
+        bool check4Receive(uint32_t id, uint8_t frame, uint8_t dlc, uint8_t *Data);
+        bool releaseReceiveBuffer(uint8_t BufferNumber);
+        uint8_t getReceiveFlags();
+        uint16_t getLastMCPError();
+
+        // Register-Level (SPI-Instructions)
+
+        uint8_t readStatus();
+        void readReceiveBuffer(uint8_t BufferNumber, CANFrame &frame);
+        uint8_t readRegister(uint8_t address);
+        void writeRegisters(uint8_t address, const uint8_t *Data, uint8_t length);
+        void bitModify(uint8_t address, uint8_t mask, uint8_t data);
+        void requestToSend(uint8_t buffers);
+
+        // Statistics
+
+        uint32_t getSpiTransactions();
+        uint32_t getSpiBytes();
+        uint32_t getTransmittedFrames();
+        uint32_t getReceivedFrames();
+        uint32_t getFilteredFrames();
+        uint32_t getOverflowFrames();
+        void resetStatistics();
+
+};
+
+
+/**
+ * @brief Static Driver-Adapter for the Loopback-Controller.
+ */
+struct CANDriverLoopback
+{
+    typedef CANLoopbackController Controller;
+
+    static const bool SupportsFD = true;                // FD-Frames are sent and received in the FD-Mode (setFD()) only
+
+    // Message-Level
+
+    static uint8_t findFreeTransmitBuffer(Controller &controller) { return controller.check4FreeTransmitBuffer(); }
+    static bool fillTransmitBuffer(Controller &controller, uint8_t BufferNumber, uint32_t id, uint8_t frame, bool rtr, uint8_t dlc, uint8_t *Data) { return controller.fillTransmitBuffer(BufferNumber, id, frame, rtr, dlc, Data); }
+    static bool sendTransmitBuffer(Controller &controller, uint8_t BufferNumber, uint8_t priority) { return controller.sendMessage(BufferNumber, priority); }
+    static bool checkRtr(Controller &controller, uint32_t id, uint8_t frame) { return controller.check4Rtr(id, frame); }
+    static bool receive(Controller &controller, uint32_t id, uint8_t frame, uint8_t dlc, uint8_t *Data) { return controller.check4Receive(id, frame, dlc, Data); }
+    static uint8_t getReceiveFlags(Controller &controller) { return controller.getReceiveFlags(); }
+    static uint16_t getLastError(Controller &controller) { return controller.getLastMCPError(); }
+
+    // Register-Level (the Chip-Select-Pin is not used)
+
+    static uint8_t readStatus(Controller &controller, uint8_t) { return controller.readStatus(); }
+    static void readReceiveBuffer(Controller &controller, uint8_t, uint8_t BufferNumber, CANFrame &frame) { controller.readReceiveBuffer(BufferNumber, frame); }
+    static uint8_t readRegister(Controller &controller, uint8_t, uint8_t address) { return controller.readRegister(address); }
+    static void writeRegisters(Controller &controller, uint8_t, uint8_t address, const uint8_t *Data, uint8_t length) { controller.writeRegisters(address, Data, length); }
+    static void bitModify(Controller &controller, uint8_t, uint8_t address, uint8_t mask, uint8_t data) { controller.bitModify(address, mask, data); }
+    static void requestToSend(Controller &controller, uint8_t, uint8_t buffers) { controller.requestToSend(buffers); }
+};
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * @file CANDriverMCP2515.h
+ * @author MH-Tobi
+ * @brief Driver-Adapter for the MCP2515-Library (default Driver on Arduino).
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANDRIVERMCP2515_H
+#define CANDRIVERMCP2515_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <MCP2515.h>
+#include "CANFrame.h"
+#include "CANRegisterMap.h"
+
+
+#ifndef CANBUS_SPI_CLOCK
+#define CANBUS_SPI_CLOCK                10000000    // SPI-Clock for the direct Register-Access (MCP2515 max. 10 MHz)
+#endif
+
+// SPI-Instructions of the MCP2515
+#define MCP2515_INSTRUCTION_WRITE               0x02
+#define MCP2515_INSTRUCTION_READ                0x03
+#define MCP2515_INSTRUCTION_BIT_MODIFY          0x05
+#define MCP2515_INSTRUCTION_READ_RX_BUFFER      0x90    // | (BufferNumber << 2) starts reading at RXBnSIDH
+#define MCP2515_INSTRUCTION_READ_STATUS         0xA0
+#define MCP2515_INSTRUCTION_RTS                 0x80    // | Bit n = Transmit-Buffer n
+
+
+/**
+ * @brief Static Driver-Adapter, all Calls are inlined into the Message and the Bus (no virtual Calls).
+ *
+ * The Message-Level Calls are forwarded to the MCP2515-Library,
+ * the Register-Level Calls of the CAN-Bus access the MCP2515 directly with one SPI-Transaction each.
+ */
+struct CANDriverMCP2515
+{
+    typedef MCP2515 Controller;
+
+    static const bool SupportsFD = false;               // The MCP2515 only knows Classic Frames
+
+    // Message-Level
+
+    static uint8_t findFreeTransmitBuffer(Controller &controller)
+    {
+        return controller.check4FreeTransmitBuffer();
+    }
+
+    static bool fillTransmitBuffer(Controller &controller, uint8_t BufferNumber, uint32_t id, uint8_t frame, bool rtr, uint8_t dlc, uint8_t *Data)
+    {
+        return controller.fillTransmitBuffer(BufferNumber, id, frame, rtr, dlc, Data);
+    }
+
+    static bool sendTransmitBuffer(Controller &controller, uint8_t BufferNumber, uint8_t priority)
+    {
+        return controller.sendMessage(BufferNumber, priority);
+    }
+
+    static bool checkRtr(Controller &controller, uint32_t id, uint8_t frame)
+    {
+        return controller.check4Rtr(id, frame);
+    }
+
+    static bool receive(Controller &controller, uint32_t id, uint8_t frame, uint8_t dlc, uint8_t *Data)
+    {
+        return controller.check4Receive(id, frame, dlc, Data);
+    }
+
+    static uint8_t getReceiveFlags(Controller &controller)
+    {
+        (void) controller;
+
+        return 0;
+    }
+
+    static uint16_t getLastError(Controller &controller)
+    {
+        return controller.getLastMCPError();
+    }
+
+    // Register-Level
+
+    static uint8_t readStatus(Controller &controller, uint8_t csPin)
+    {
+        (void) controller;
+
+        SPI.beginTransaction(SPISettings(CANBUS_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+        digitalWrite(csPin, LOW);
+        SPI.transfer(MCP2515_INSTRUCTION_READ_STATUS);
+        uint8_t Status = SPI.transfer(0x00);
+        digitalWrite(csPin, HIGH);
+        SPI.endTransaction();
+
+        return Status;
+    }
+
+    // The MCP2515 clears the RXnIF-Flag automatically after the Transaction, so the Buffer is released.
+    static void readReceiveBuffer(Controller &controller, uint8_t csPin, uint8_t BufferNumber, CANFrame &frame)
+    {
+        (void) controller;
+        uint8_t Header[5];
+
+        SPI.beginTransaction(SPISettings(CANBUS_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+        digitalWrite(csPin, LOW);
+        SPI.transfer(MCP2515_INSTRUCTION_READ_RX_BUFFER | (BufferNumber << 2));
+
+        for (uint8_t i = 0; i < 5; i++)
+        {
+            Header[i] = SPI.transfer(0x00);
+        }
+
+        canRegisterDecode(Header, frame);
+
+        for (uint8_t i = 0; i < frame.DLC; i++)
+        {
+            frame.Data[i] = SPI.transfer(0x00);
+        }
+
+        digitalWrite(csPin, HIGH);
+        SPI.endTransaction();
+    }
+
+    static uint8_t readRegister(Controller &controller, uint8_t csPin, uint8_t address)
+    {
+        (void) controller;
+
+        SPI.beginTransaction(SPISettings(CANBUS_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+        digitalWrite(csPin, LOW);
+        SPI.transfer(MCP2515_INSTRUCTION_READ);
+        SPI.transfer(address);
+        uint8_t Value = SPI.transfer(0x00);
+        digitalWrite(csPin, HIGH);
+        SPI.endTransaction();
+
+        return Value;
+    }
+
+    static void writeRegisters(Controller &controller, uint8_t csPin, uint8_t address, const uint8_t *Data, uint8_t length)
+    {
+        (void) controller;
+
+        SPI.beginTransaction(SPISettings(CANBUS_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+        digitalWrite(csPin, LOW);
+        SPI.transfer(MCP2515_INSTRUCTION_WRITE);
+        SPI.transfer(address);
+
+        for (uint8_t i = 0; i < length; i++)
+        {
+            SPI.transfer(Data[i]);
+        }
+
+        digitalWrite(csPin, HIGH);
+        SPI.endTransaction();
+    }
+
+    static void bitModify(Controller &controller, uint8_t csPin, uint8_t address, uint8_t mask, uint8_t data)
+    {
+        (void) controller;
+
+        SPI.beginTransaction(SPISettings(CANBUS_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+        digitalWrite(csPin, LOW);
+        SPI.transfer(MCP2515_INSTRUCTION_BIT_MODIFY);
+        SPI.transfer(address);
+        SPI.transfer(mask);
+        SPI.transfer(data);
+        digitalWrite(csPin, HIGH);
+        SPI.endTransaction();
+    }
+
+    // One Instruction-Byte starts the Transmission of all given Transmit-Buffers at once.
+    static void requestToSend(Controller &controller, uint8_t csPin, uint8_t buffers)
+    {
+        (void) controller;
+
+        SPI.beginTransaction(SPISettings(CANBUS_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+        digitalWrite(csPin, LOW);
+        SPI.transfer(MCP2515_INSTRUCTION_RTS | (buffers & 0x07));
+        digitalWrite(csPin, HIGH);
+        SPI.endTransaction();
+    }
+};
+
+#endif
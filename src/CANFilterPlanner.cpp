@@ -0,0 +1,641 @@
+#include "CANFilterPlanner.h"
+
+#define CANFILTERPLANNER_EXTENDED_BITS  0x1FFFFFFF
+#define CANFILTERPLANNER_BUFFER0_FILTERS    2   // RXF0 - RXF1 belong to RXM0
+
+
+/**
+ * @brief Constructor
+ */
+CANFilterPlanner::CANFilterPlanner()
+{
+    reset();
+}
+
+/**
+ * @brief Removes all IDs and the last Plan.
+ */
+void CANFilterPlanner::reset()
+{
+    _ClusterCount = 0;
+    _IdCount = 0;
+    _StandardIds = 0;
+    _ExtendedIds = 0;
+    _AcceptedIds = 0;
+    _isPlanned = false;
+
+    for (uint8_t i = 0; i < CANFILTERPLANNER_MASKS; i++)
+    {
+        _Masks[i] = 0;
+    }
+
+    for (uint8_t i = 0; i < CANFILTERPLANNER_FILTERS; i++)
+    {
+        _Filters[i] = 0;
+        _FilterFrames[i] = 0;
+    }
+}
+
+/**
+ * @brief Adds an ID they must pass the Filters.
+ * @param id Message-ID
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return true when success, false when the ID is not valid or no further ID can be added
+ */
+bool CANFilterPlanner::addId(uint32_t id, uint8_t frame)
+{
+    if (frame > 1 || id > (frame == 0 ? 0x7FF : CANFILTERPLANNER_EXTENDED_BITS))
+    {
+        return false;
+    }
+
+    return _addCluster(frame == 0 ? id << 18 : id, _frameBits(frame), frame);
+}
+
+/**
+ * @brief Adds a Range of IDs they must pass the Filters.
+ *
+ * The Range is split into aligned Blocks of 2^n IDs, each Block takes one Place of CANFILTERPLANNER_MAX_IDS
+ * (e.g. 0x100 - 0x1FF is one Block, 0x101 - 0x1FE are 14).
+ * @param firstId First Message-ID of the Range
+ * @param lastId Last Message-ID of the Range
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return true when success, false when the Range is not valid, does not fit or overlaps a Set of addMask() partially (the Planner has to be reset then)
+ */
+bool CANFilterPlanner::addRange(uint32_t firstId, uint32_t lastId, uint8_t frame)
+{
+    uint8_t Width = frame == 0 ? 11 : 29;
+
+    if (frame > 1 || firstId > lastId || lastId > (frame == 0 ? 0x7FF : CANFILTERPLANNER_EXTENDED_BITS))
+    {
+        return false;
+    }
+
+    uint32_t Id = firstId;
+
+    while (true)
+    {
+        // Largest Block they starts at the ID and ends within the Range
+        uint8_t Bits = 0;
+
+        while (Bits < Width && (Id & (((uint32_t) 2 << Bits) - 1)) == 0 && lastId - Id >= ((uint32_t) 2 << Bits) - 1)
+        {
+            Bits++;
+        }
+
+        uint32_t Free = ((uint32_t) 1 << Bits) - 1;
+
+        if (!_addCluster(frame == 0 ? Id << 18 : Id, frame == 0 ? ~(Free << 18) : ~Free, frame))
+        {
+            return false;
+        }
+
+        uint32_t Last = Id + (((uint32_t) 1 << Bits) - 1);
+
+        if (Last >= lastId)
+        {
+            return true;
+        }
+        Id = Last + 1;
+    }
+}
+
+/**
+ * @brief Adds all IDs they match the ID on the Bits of the Mask (e.g. a J1939-PGN from any Source).
+ *
+ * A Set they overlaps an added ID, Range or Set only partially can not be counted exactly and is rejected.
+ * @param id Message-ID
+ * @param mask Bits of the ID they must match (0x7FF resp. 0x1FFFFFFF = only this ID)
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return true when success, false when the ID is not valid, no further Set can be added or it overlaps partially
+ */
+bool CANFilterPlanner::addMask(uint32_t id, uint32_t mask, uint8_t frame)
+{
+    if (frame > 1 || id > (frame == 0 ? 0x7FF : CANFILTERPLANNER_EXTENDED_BITS))
+    {
+        return false;
+    }
+
+    return _addCluster(frame == 0 ? id << 18 : id, frame == 0 ? mask << 18 : mask, frame);
+}
+
+/**
+ * @brief Computes the Masks and Filters for all added IDs.
+ *
+ * Every added ID is guaranteed to pass, the Number of unwanted IDs passing is minimised.
+ * With up to 6 IDs no unwanted ID passes. The IDs are merged during planning, call reset() before planning a new Set of IDs.
+ * @return true when success, false when no ID was added
+ */
+bool CANFilterPlanner::plan()
+{
+    if (_ClusterCount == 0)
+    {
+        return false;
+    }
+
+    // Fewer Groups can share a Mask better, so all Levels from 6 Groups down to 1 are checked
+    uint32_t BestCost = 0xFFFFFFFF;
+
+    _mergeClusters(CANFILTERPLANNER_FILTERS);
+
+    do
+    {
+        uint8_t Members;
+        uint32_t Cost = _distribute(Members);
+
+        if (Cost < BestCost)
+        {
+            BestCost = Cost;
+            _assignGroups(Members);
+        }
+    } while (_mergeClusters(_ClusterCount - 1));
+
+    _AcceptedIds = BestCost;
+    _isPlanned = true;
+
+    return true;
+}
+
+/**
+ * @brief Returns a planned Mask.
+ * @param number Number of the Mask (0 = RXM0; 1 = RXM1)
+ * @return uint32_t Mask in the 29-bit Register-Layout (0 when not planned)
+ */
+uint32_t CANFilterPlanner::getMask(uint8_t number)
+{
+    if (!_isPlanned || number >= CANFILTERPLANNER_MASKS)
+    {
+        return 0;
+    }
+    return _Masks[number];
+}
+
+/**
+ * @brief Returns a planned Filter.
+ * @param number Number of the Filter (0 - 5 = RXF0 - RXF5)
+ * @return uint32_t Filter in the 29-bit Register-Layout (0 when not planned)
+ */
+uint32_t CANFilterPlanner::getFilter(uint8_t number)
+{
+    if (!_isPlanned || number >= CANFILTERPLANNER_FILTERS)
+    {
+        return 0;
+    }
+    return _Filters[number];
+}
+
+/**
+ * @brief Returns the Frame-Type a planned Filter applies to (EXIDE-Bit).
+ * @param number Number of the Filter (0 - 5 = RXF0 - RXF5)
+ * @return uint8_t CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ */
+uint8_t CANFilterPlanner::getFilterFrame(uint8_t number)
+{
+    if (!_isPlanned || number >= CANFILTERPLANNER_FILTERS)
+    {
+        return 0;
+    }
+    return _FilterFrames[number];
+}
+
+/**
+ * @brief Returns the Number of IDs passing the planned Filters (wanted and unwanted).
+ *
+ * Counted exactly over the Union of both Receive-Buffers (an ID passing both is counted once).
+ * @return uint32_t Accepted IDs (0 when not planned)
+ */
+uint32_t CANFilterPlanner::getAcceptedIds()
+{
+    return _isPlanned ? _AcceptedIds : 0;
+}
+
+/**
+ * @brief Returns the Number of unwanted IDs passing the planned Filters.
+ * @return uint32_t False Accepts (0 when not planned)
+ */
+uint32_t CANFilterPlanner::getFalseAccepts()
+{
+    if (!_isPlanned || _AcceptedIds < _IdCount)
+    {
+        return 0;
+    }
+    return _AcceptedIds - _IdCount;
+}
+
+/**
+ * @brief Returns the expected Rate of unwanted Frames passing the planned Filters.
+ *
+ * Assumes the unwanted IDs of the used Frame-Types are evenly distributed on the Bus.
+ * @return float False-Accept-Rate (0.0 - 1.0)
+ */
+float CANFilterPlanner::getFalseAcceptRate()
+{
+    float Unwanted = 0;
+
+    if (_StandardIds != 0)
+    {
+        Unwanted += 2048.0f - (float) _StandardIds;
+    }
+
+    if (_ExtendedIds != 0)
+    {
+        Unwanted += 536870912.0f - (float) _ExtendedIds;
+    }
+
+    if (Unwanted <= 0)
+    {
+        return 0;
+    }
+    return (float) getFalseAccepts() / Unwanted;
+}
+
+/**
+ * @brief Counts the set Bits of a Value.
+ * @param value Value
+ * @return uint8_t Number of set Bits
+ */
+uint8_t CANFilterPlanner::_bitCount(uint32_t value)
+{
+    uint8_t Count = 0;
+
+    while (value != 0)
+    {
+        value &= value - 1;
+        Count++;
+    }
+    return Count;
+}
+
+/**
+ * @brief Returns the Bits of the Register-Layout they are used by a Frame-Type.
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return uint32_t ID-Bits
+ */
+uint32_t CANFilterPlanner::_frameBits(uint8_t frame)
+{
+    return frame == 0 ? CANFILTERPLANNER_STANDARD_BITS : CANFILTERPLANNER_EXTENDED_BITS;
+}
+
+/**
+ * @brief Returns the Number of IDs passing a Filter with the given Mask.
+ * @param care Mask (Bits they are compared)
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return uint32_t Accepted IDs
+ */
+uint32_t CANFilterPlanner::_accepted(uint32_t care, uint8_t frame)
+{
+    uint8_t Width = frame == 0 ? 11 : 29;
+    return (uint32_t) 1 << (Width - _bitCount(care & _frameBits(frame)));
+}
+
+/**
+ * @brief Adds a Set of IDs as Cluster (all IDs they match the Value on the Care-Bits).
+ *
+ * Each wanted ID is counted once: a Cluster inside an added Cluster is skipped and added Clusters inside the
+ * new Cluster are replaced by it. Aligned Blocks and Clusters with the same Care-Bits are always disjoint or nested,
+ * a partial Overlap (neither contains the other) would not be counted exactly and is rejected.
+ * @param value Value in the 29-bit Register-Layout
+ * @param care Bits of the Value they must match, in the 29-bit Register-Layout
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return true when success, false when no further Cluster can be added or it overlaps an added Cluster partially
+ */
+bool CANFilterPlanner::_addCluster(uint32_t value, uint32_t care, uint8_t frame)
+{
+    care &= _frameBits(frame);
+    value &= care;
+
+    // Check all Clusters first, so a rejected Cluster leaves the Planner unchanged
+    for (uint8_t i = 0; i < _ClusterCount; i++)
+    {
+        const Cluster &Entry = _Clusters[i];
+
+        if (Entry.Frame != frame || ((Entry.Value ^ value) & Entry.Care & care) != 0)
+        {
+            continue;
+        }
+
+        if ((Entry.Care & ~care) == 0)
+        {
+            return true;
+        }
+
+        if ((care & ~Entry.Care) != 0)
+        {
+            return false;
+        }
+    }
+
+    uint8_t i = 0;
+
+    while (i < _ClusterCount)
+    {
+        const Cluster &Entry = _Clusters[i];
+
+        if (Entry.Frame != frame || ((Entry.Value ^ value) & care) != 0 || (care & ~Entry.Care) != 0)
+        {
+            i++;
+            continue;
+        }
+
+        uint32_t Size = _accepted(Entry.Care, frame);
+
+        _IdCount -= Size;
+
+        if (frame == 0)
+        {
+            _StandardIds -= Size;
+        } else {
+            _ExtendedIds -= Size;
+        }
+
+        _Clusters[i] = _Clusters[--_ClusterCount];
+    }
+
+    if (_ClusterCount >= CANFILTERPLANNER_MAX_IDS)
+    {
+        return false;
+    }
+
+    uint32_t Size = _accepted(care, frame);
+
+    _Clusters[_ClusterCount].Value = value;
+    _Clusters[_ClusterCount].Care = care;
+    _Clusters[_ClusterCount].Frame = frame;
+    _ClusterCount++;
+    _IdCount += Size;
+
+    if (frame == 0)
+    {
+        _StandardIds += Size;
+    } else {
+        _ExtendedIds += Size;
+    }
+
+    _isPlanned = false;
+
+    return true;
+}
+
+/**
+ * @brief Merges the IDs greedily until the given Number of Groups is reached.
+ *
+ * In each Step the 2 Groups of the same Frame-Type are merged, they add the fewest unwanted IDs.
+ * @param count Max. Number of Groups
+ * @return true when success, false when no further Groups of the same Frame-Type can be merged
+ */
+bool CANFilterPlanner::_mergeClusters(uint8_t count)
+{
+    while (_ClusterCount > count)
+    {
+        uint8_t BestFirst = 0;
+        uint8_t BestSecond = 0;
+        uint32_t BestCare = 0;
+        int32_t BestCost = 0x7FFFFFFF;
+        bool Found = false;
+
+        for (uint8_t i = 0; i < _ClusterCount; i++)
+        {
+            for (uint8_t j = i + 1; j < _ClusterCount; j++)
+            {
+                if (_Clusters[i].Frame != _Clusters[j].Frame)
+                {
+                    continue;
+                }
+
+                uint32_t Care = _Clusters[i].Care & _Clusters[j].Care & ~(_Clusters[i].Value ^ _Clusters[j].Value);
+                // Negative when one Group already contains the other one
+                int32_t Cost = (int32_t) _accepted(Care, _Clusters[i].Frame) - (int32_t) _accepted(_Clusters[i].Care, _Clusters[i].Frame) - (int32_t) _accepted(_Clusters[j].Care, _Clusters[j].Frame);
+
+                if (Cost < BestCost)
+                {
+                    Found = true;
+                    BestCost = Cost;
+                    BestCare = Care;
+                    BestFirst = i;
+                    BestSecond = j;
+                }
+            }
+        }
+
+        if (!Found)
+        {
+            return false;
+        }
+
+        _Clusters[BestFirst].Care = BestCare;
+        _Clusters[BestFirst].Value &= BestCare;
+        _Clusters[BestSecond] = _Clusters[--_ClusterCount];
+    }
+    return true;
+}
+
+/**
+ * @brief Searches the Distribution of the Groups to RXM0 (max. 2 Filters) and RXM1 (max. 4 Filters) with the fewest accepted IDs.
+ * @param members Groups of RXM0 (Bit n = Cluster n)
+ * @return uint32_t Accepted IDs
+ */
+uint32_t CANFilterPlanner::_distribute(uint8_t &members)
+{
+    uint8_t All = (uint8_t) ((1 << _ClusterCount) - 1);
+    uint32_t BestCost = 0xFFFFFFFF;
+
+    members = 0;
+
+    for (uint8_t Members = 0; Members <= All; Members++)
+    {
+        uint8_t Count = _bitCount(Members);
+
+        if (Count > CANFILTERPLANNER_BUFFER0_FILTERS || _ClusterCount - Count > CANFILTERPLANNER_FILTERS - CANFILTERPLANNER_BUFFER0_FILTERS)
+        {
+            continue;
+        }
+
+        uint32_t Mask0 = _groupMask(Members);
+        uint32_t Mask1 = _groupMask(All & ~Members);
+        uint32_t Cost = _groupCost(Members, Mask0) + _groupCost(All & ~Members, Mask1) - _groupOverlap(Members, Mask0, All & ~Members, Mask1);
+
+        if (Cost < BestCost)
+        {
+            BestCost = Cost;
+            members = Members;
+        }
+    }
+    return BestCost;
+}
+
+/**
+ * @brief Writes the Masks and Filters of both Receive-Buffers.
+ * @param members Groups of RXM0 (Bit n = Cluster n), all others belong to RXM1
+ */
+void CANFilterPlanner::_assignGroups(uint8_t members)
+{
+    uint8_t All = (uint8_t) ((1 << _ClusterCount) - 1);
+
+    _assignFilters(members, _groupMask(members), 0, CANFILTERPLANNER_BUFFER0_FILTERS);
+    _assignFilters(All & ~members, _groupMask(All & ~members), CANFILTERPLANNER_BUFFER0_FILTERS, CANFILTERPLANNER_FILTERS - CANFILTERPLANNER_BUFFER0_FILTERS);
+
+    // An unused Receive-Buffer gets a Copy of the other one, so it accepts no additional ID
+    if (members == 0)
+    {
+        _Masks[0] = _Masks[1];
+
+        for (uint8_t i = 0; i < CANFILTERPLANNER_BUFFER0_FILTERS; i++)
+        {
+            _Filters[i] = _Filters[CANFILTERPLANNER_BUFFER0_FILTERS];
+            _FilterFrames[i] = _FilterFrames[CANFILTERPLANNER_BUFFER0_FILTERS];
+        }
+    } else if (members == All)
+    {
+        _Masks[1] = _Masks[0];
+
+        for (uint8_t i = CANFILTERPLANNER_BUFFER0_FILTERS; i < CANFILTERPLANNER_FILTERS; i++)
+        {
+            _Filters[i] = _Filters[0];
+            _FilterFrames[i] = _FilterFrames[0];
+        }
+    }
+}
+
+/**
+ * @brief Returns the Mask of a Group of Clusters (only Bits they are equal in all Clusters).
+ *
+ * For Standard-Frames the MCP2515 compares the Extended-ID-Bits with the first 2 Data-Bytes,
+ * so they are not used when a Standard-Filter is in the Group.
+ * @param members Bit n = Cluster n is in the Group
+ * @return uint32_t Mask
+ */
+uint32_t CANFilterPlanner::_groupMask(uint8_t members)
+{
+    uint32_t Mask = CANFILTERPLANNER_EXTENDED_BITS;
+
+    for (uint8_t i = 0; i < _ClusterCount; i++)
+    {
+        if ((members & (1 << i)) == 0)
+        {
+            continue;
+        }
+
+        Mask &= _Clusters[i].Care;
+
+        if (_Clusters[i].Frame == 0)
+        {
+            Mask &= CANFILTERPLANNER_STANDARD_BITS;
+        }
+    }
+    return Mask;
+}
+
+/**
+ * @brief Returns the Number of IDs passing the Filters of a Group.
+ * @param members Bit n = Cluster n is in the Group
+ * @param mask Mask of the Group
+ * @return uint32_t Accepted IDs
+ */
+uint32_t CANFilterPlanner::_groupCost(uint8_t members, uint32_t mask)
+{
+    uint32_t Cost = 0;
+
+    for (uint8_t i = 0; i < _ClusterCount; i++)
+    {
+        if ((members & (1 << i)) == 0)
+        {
+            continue;
+        }
+
+        if (!_isDuplicate(members, mask, i))
+        {
+            Cost += _accepted(mask, _Clusters[i].Frame);
+        }
+    }
+    return Cost;
+}
+
+/**
+ * @brief Returns the Number of IDs passing the Filters of both Groups.
+ *
+ * The Filters of one Group share their Mask, so they are equal or disjoint. The IDs passing a Filter of each Group
+ * are therefore the disjoint Sum of the Intersections of each Pair (one Filter per Group).
+ * @param first Bit n = Cluster n is in the first Group
+ * @param firstMask Mask of the first Group
+ * @param second Bit n = Cluster n is in the second Group
+ * @param secondMask Mask of the second Group
+ * @return uint32_t IDs accepted by both Groups
+ */
+uint32_t CANFilterPlanner::_groupOverlap(uint8_t first, uint32_t firstMask, uint8_t second, uint32_t secondMask)
+{
+    uint32_t Overlap = 0;
+
+    for (uint8_t i = 0; i < _ClusterCount; i++)
+    {
+        if ((first & (1 << i)) == 0 || _isDuplicate(first, firstMask, i))
+        {
+            continue;
+        }
+
+        for (uint8_t j = 0; j < _ClusterCount; j++)
+        {
+            if ((second & (1 << j)) == 0 || _isDuplicate(second, secondMask, j) || _Clusters[i].Frame != _Clusters[j].Frame)
+            {
+                continue;
+            }
+
+            uint8_t Frame = _Clusters[i].Frame;
+
+            // Both Filters accept the IDs they match the Values on the Bits of both Masks
+            if (((_Clusters[i].Value ^ _Clusters[j].Value) & firstMask & secondMask & _frameBits(Frame)) == 0)
+            {
+                Overlap += _accepted(firstMask | secondMask, Frame);
+            }
+        }
+    }
+    return Overlap;
+}
+
+/**
+ * @brief Checks if a Cluster of a Group has the same Filter as a Cluster before it.
+ * @param members Bit n = Cluster n is in the Group
+ * @param mask Mask of the Group
+ * @param index Cluster
+ * @return true when the Filter is a Duplicate
+ */
+bool CANFilterPlanner::_isDuplicate(uint8_t members, uint32_t mask, uint8_t index)
+{
+    for (uint8_t j = 0; j < index; j++)
+    {
+        if ((members & (1 << j)) != 0 && _Clusters[j].Frame == _Clusters[index].Frame && ((_Clusters[j].Value ^ _Clusters[index].Value) & mask) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Writes the Mask and the Filters of a Group, unused Filters repeat the first Filter.
+ * @param members Bit n = Cluster n is in the Group
+ * @param mask Mask of the Group
+ * @param firstFilter Number of the first Filter of the Receive-Buffer
+ * @param filterCount Number of Filters of the Receive-Buffer
+ */
+void CANFilterPlanner::_assignFilters(uint8_t members, uint32_t mask, uint8_t firstFilter, uint8_t filterCount)
+{
+    uint8_t Filter = firstFilter;
+
+    _Masks[firstFilter == 0 ? 0 : 1] = mask;
+
+    for (uint8_t i = 0; i < _ClusterCount; i++)
+    {
+        if ((members & (1 << i)) != 0)
+        {
+            _Filters[Filter] = _Clusters[i].Value & mask;
+            _FilterFrames[Filter] = _Clusters[i].Frame;
+            Filter++;
+        }
+    }
+
+    for (; Filter > firstFilter && Filter < firstFilter + filterCount; Filter++)
+    {
+        _Filters[Filter] = _Filters[firstFilter];
+        _FilterFrames[Filter] = _FilterFrames[firstFilter];
+    }
+}
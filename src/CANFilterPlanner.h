@@ -0,0 +1,88 @@
+/**
+ * @file CANFilterPlanner.h
+ * @author MH-Tobi
+ * @brief Computes the Acceptance-Masks and -Filters of the MCP2515 for a Set of Receive-IDs.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANFILTERPLANNER_H
+#define CANFILTERPLANNER_H
+
+#include <stdint.h>
+
+
+#ifndef CANFILTERPLANNER_MAX_IDS
+#define CANFILTERPLANNER_MAX_IDS        32      // Max. Number of IDs (resp. ID-Blocks of the Ranges) they can be planned
+#endif
+
+#define CANFILTERPLANNER_MASKS          2       // RXM0 (RXB0) and RXM1 (RXB1)
+#define CANFILTERPLANNER_FILTERS        6       // RXF0 - RXF1 (RXB0) and RXF2 - RXF5 (RXB1)
+
+#define CANFILTERPLANNER_STANDARD_BITS  0x1FFC0000  // Position of the Standard-ID in the 29-bit Register-Layout
+
+
+/**
+ * @brief Plans the 2 Masks and 6 Filters with the lowest Number of unwanted IDs passing.
+ *
+ * All Values use the 29-bit Register-Layout of the MCP2515 (Standard-ID in Bit 18 - 28).
+ * The IDs are merged greedily into at most 6 Groups (each Merge adds the fewest unwanted IDs),
+ * for each Number of Groups all Distributions to the 2 Masks are checked.
+ */
+class CANFilterPlanner
+{
+	private:
+        struct Cluster
+        {
+            uint32_t Value;                 // Common Value of all IDs of the Group
+            uint32_t Care;                  // Bits they are equal in all IDs of the Group
+            uint8_t Frame;                  // Standard-Frame = 0; Extended-Frame = 1
+        };
+
+        Cluster _Clusters[CANFILTERPLANNER_MAX_IDS];
+        uint8_t _ClusterCount;
+        uint32_t _IdCount;                  // Wanted IDs (an ID of several Ranges is counted once)
+        uint32_t _StandardIds;              // Wanted IDs per Frame-Type
+        uint32_t _ExtendedIds;
+        uint32_t _Masks[CANFILTERPLANNER_MASKS];
+        uint32_t _Filters[CANFILTERPLANNER_FILTERS];
+        uint8_t _FilterFrames[CANFILTERPLANNER_FILTERS];
+        uint32_t _AcceptedIds;
+        bool _isPlanned;
+
+        static uint8_t _bitCount(uint32_t value);
+        static uint32_t _frameBits(uint8_t frame);
+        static uint32_t _accepted(uint32_t care, uint8_t frame);
+        bool _addCluster(uint32_t value, uint32_t care, uint8_t frame);
+        bool _mergeClusters(uint8_t count);
+        uint32_t _distribute(uint8_t &members);
+        void _assignGroups(uint8_t members);
+        uint32_t _groupMask(uint8_t members);
+        uint32_t _groupCost(uint8_t members, uint32_t mask);
+        uint32_t _groupOverlap(uint8_t first, uint32_t firstMask, uint8_t second, uint32_t secondMask);
+        bool _isDuplicate(uint8_t members, uint32_t mask, uint8_t index);
+        void _assignFilters(uint8_t members, uint32_t mask, uint8_t firstFilter, uint8_t filterCount);
+
+	public:
+
+        CANFilterPlanner();
+
+        void reset();
+        bool addId(uint32_t id, uint8_t frame);
+        bool addRange(uint32_t firstId, uint32_t lastId, uint8_t frame);
+        bool addMask(uint32_t id, uint32_t mask, uint8_t frame);
+        bool plan();
+
+        uint32_t getMask(uint8_t number);
+        uint32_t getFilter(uint8_t number);
+        uint8_t getFilterFrame(uint8_t number);
+        uint32_t getAcceptedIds();
+        uint32_t getFalseAccepts();
+        float getFalseAcceptRate();
+
+};
+
+#endif
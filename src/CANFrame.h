@@ -0,0 +1,82 @@
+/**
+ * @file CANFrame.h
+ * @author MH-Tobi
+ * @brief Raw CAN-Frame as it is read from or written to the CAN-Controller.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANFRAME_H
+#define CANFRAME_H
+
+#include <stdint.h>
+
+
+#define CANFRAME_MAX_DLC                15      // Highest Data-Length-Code (CAN FD: 64 Bytes)
+#define CANFRAME_MAX_LENGTH_FD          64      // Max. Payload of a CAN FD-Frame
+
+
+/**
+ * @brief Classic Frame of the Register-Level (Receive-Buffers, Transmit-Queue, FIFO and Mailbox).
+ */
+struct CANFrame
+{
+    uint32_t ID;                // Message-ID (11 bit for Standard-Frame; 29 bit for Extended Frame)
+    uint8_t Frame;              // Standard-Frame = 0; Extended-Frame = 1
+    bool RTR;                   // Remote Transmission Request
+    uint8_t DLC;                // Datalength 0-8
+    uint8_t Data[8];            // Data of the Frame
+};
+
+
+/**
+ * @brief Returns the Number of Data-Bytes of a Data-Length-Code.
+ *
+ * Up to 8 the Code is the Length, above it follows the non-linear Mapping of CAN FD (12, 16, 20, 24, 32, 48, 64).
+ * @param dlc Data-Length-Code (0 - 15)
+ * @return uint8_t Length in Bytes
+ */
+inline uint8_t canDlcToLength(uint8_t dlc)
+{
+    if (dlc <= 8)
+    {
+        return dlc;
+    }
+
+    if (dlc <= 12)
+    {
+        return (uint8_t) (8 + (dlc - 8) * 4);
+    }
+
+    return dlc == 13 ? 32 : (dlc == 14 ? 48 : 64);
+}
+
+/**
+ * @brief Returns the smallest Data-Length-Code they holds the Length (the Rest of the Frame is padded).
+ * @param length Length in Bytes (0 - 64)
+ * @return uint8_t Data-Length-Code, 0xFF when the Length is above 64
+ */
+inline uint8_t canLengthToDlc(uint8_t length)
+{
+    if (length <= 8)
+    {
+        return length;
+    }
+
+    if (length <= 24)
+    {
+        return (uint8_t) (8 + (length - 8 + 3) / 4);
+    }
+
+    if (length <= CANFRAME_MAX_LENGTH_FD)
+    {
+        return length <= 32 ? 13 : (length <= 48 ? 14 : 15);
+    }
+
+    return 0xFF;
+}
+
+#endif
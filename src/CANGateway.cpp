@@ -0,0 +1,522 @@
+#include "CANGateway.h"
+
+static_assert(CANGATEWAY_MAX_BUSES > 0 && CANGATEWAY_MAX_BUSES <= 8, "CANGATEWAY_MAX_BUSES must be 1 - 8");
+static_assert(CANGATEWAY_MAX_ROUTES > 0 && CANGATEWAY_MAX_ROUTES < CANGATEWAY_END, "CANGATEWAY_MAX_ROUTES must be 1 - 254");
+static_assert(CANGATEWAY_PENDING > 0 && CANGATEWAY_PENDING <= 255, "CANGATEWAY_PENDING must be 1 - 255");
+
+
+/**
+ * @brief Constructor
+ */
+CANGateway::CANGateway()
+{
+    _BusCount = 0;
+    _RouteCount = 0;
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    for (uint8_t i = 0; i < CANGATEWAY_MAX_BUSES; i++)
+    {
+        _Buses[i] = NULL;
+        _First[i] = CANGATEWAY_END;
+        _PendingCount[i] = 0;
+    }
+
+    resetStatistics();
+}
+
+/**
+ * @brief Returns the last occurred Error.
+ * @return Error-Code (see CANMessageError.h)
+ */
+uint16_t CANGateway::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Adds a Bus to the Gateway and links the Gateway with it.
+ *
+ * Afterwards dispatch() of the Bus passes each received Frame to the Routes of the Bus.
+ * The Frames are sent from the Transmit-Queue of the Destination, so call dispatch() or service() of each Bus.
+ * @param bus Initialised Bus
+ * @return int8_t Number of the Bus in the Gateway (Port), -1 on any error (Check getLastCanError())
+ */
+int8_t CANGateway::addBus(CANBus &bus)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_BusCount >= CANGATEWAY_MAX_BUSES)
+    {
+        _lastCanError = ERROR_CAN_GATEWAY_FULL;
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < _BusCount; i++)
+    {
+        if (_Buses[i] == &bus)
+        {
+            _lastCanError = ERROR_CAN_GATEWAY_BUS_ALREADY_ADDED;
+            return -1;
+        }
+    }
+
+    _Buses[_BusCount] = &bus;
+    bus.attachGateway(this, _BusCount);
+
+    return (int8_t) _BusCount++;
+}
+
+/**
+ * @brief Adds a Route for the Frames of a Source-Bus.
+ *
+ * A Frame matches when its Frame-Type is equal and all Bits of the Mask are equal with the ID.
+ * With a Rewrite the masked Bits of the ID are replaced by the Rewrite, the others are kept
+ * (with a Mask of all ID-Bits the Frame gets the Rewrite as ID).
+ * A Route with a Min. Interval forwards the first Frame and drops all Frames up to the End of the Interval.
+ * @param source Port of the Source-Bus
+ * @param id ID to be matched
+ * @param mask Bits of the ID to be compared (0x7FF resp. 0x1FFFFFFF = exactly this ID, 0 = all IDs)
+ * @param frame Frame-Type (CANMESSAGE_FRAME_STANDARD or CANMESSAGE_FRAME_EXTENDED)
+ * @param destinations Ports of the Destination-Buses (Bit n = Port n), the Source is not allowed
+ * @param rewriteId New ID (only the masked Bits are used), CANGATEWAY_KEEP_ID (default) = no Rewrite
+ * @param minInterval Min. Time [ms] between two forwarded Frames, 0 (default) = no Limit
+ * @return true when success, false on any error (Check getLastCanError())
+ */
+bool CANGateway::addRoute(uint8_t source, uint32_t id, uint32_t mask, uint8_t frame, uint8_t destinations,
+    uint32_t rewriteId, uint16_t minInterval)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (frame != CANMESSAGE_FRAME_STANDARD && frame != CANMESSAGE_FRAME_EXTENDED)
+    {
+        _lastCanError = ERROR_CAN_INIT_FRAME_NOT_PLAUSIBLE;
+        return false;
+    }
+
+    uint32_t MaxId = frame == CANMESSAGE_FRAME_EXTENDED ? 0x1FFFFFFF : 0x7FF;
+
+    if ((id & ~MaxId) != 0 || (rewriteId != CANGATEWAY_KEEP_ID && (rewriteId & ~MaxId) != 0))
+    {
+        _lastCanError = ERROR_CAN_INIT_ID_OUTA_RANGE;
+        return false;
+    }
+
+    if (source >= _BusCount || destinations == 0 || (destinations >> _BusCount) != 0)
+    {
+        _lastCanError = ERROR_CAN_GATEWAY_NO_BUS;
+        return false;
+    }
+
+    if ((destinations & (1 << source)) != 0)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    if (_RouteCount >= CANGATEWAY_MAX_ROUTES)
+    {
+        _lastCanError = ERROR_CAN_GATEWAY_FULL;
+        return false;
+    }
+
+    Route &Entry = _Routes[_RouteCount];
+
+    Entry.ID = id;
+    Entry.Mask = mask & MaxId;
+    Entry.Rewrite = rewriteId;
+    Entry.MinInterval = minInterval;
+    Entry.Frame = frame;
+    Entry.Source = source;
+    Entry.Destinations = destinations;
+    Entry.Next = CANGATEWAY_END;
+    Entry.Started = false;
+    Entry.LastForward = 0;
+
+    // Append at the End of the Source-List, so the Routes keep the Order they are added
+    CANMESSAGE_LOCK();
+
+    uint8_t *Link = &_First[source];
+
+    while (*Link != CANGATEWAY_END)
+    {
+        Link = &_Routes[*Link].Next;
+    }
+    *Link = _RouteCount;
+    _RouteCount++;
+
+    CANMESSAGE_UNLOCK();
+
+    return true;
+}
+
+/**
+ * @brief Adds the IDs of the Routes of a Source to the Filter-Plan of its Bus (called by applyFilters()).
+ *
+ * A Route with a Mask is planned as the Set of all IDs it matches, so it must not overlap another Route
+ * or a Range of the Bus partially (one contains the other or they are disjoint).
+ * @param port Port of the Source-Bus
+ * @param planner Planner of the Source-Bus
+ * @return true when success, false when a Route overlaps partially or the Planner is full
+ */
+bool CANGateway::addFilterIds(uint8_t port, CANFilterPlanner &planner)
+{
+    uint8_t Index = port < CANGATEWAY_MAX_BUSES ? _First[port] : CANGATEWAY_END;
+
+    while (Index != CANGATEWAY_END)
+    {
+        const Route &Entry = _Routes[Index];
+
+        if (!planner.addMask(Entry.ID, Entry.Mask, Entry.Frame))
+        {
+            return false;
+        }
+        Index = Entry.Next;
+    }
+    return true;
+}
+
+/**
+ * @brief Forwards a received Frame with the first matching Route of its Source.
+ *
+ * Called by dispatch() of the Source-Bus, the Frame is only changed during the Call (ID-Rewrite).
+ * @param port Port of the Source-Bus
+ * @param frame Frame read from the Receive-Buffer
+ */
+void CANGateway::route(uint8_t port, CANFrame &frame)
+{
+    uint8_t Index = port < CANGATEWAY_MAX_BUSES ? _First[port] : CANGATEWAY_END;
+
+    while (Index != CANGATEWAY_END)
+    {
+        const Route &Entry = _Routes[Index];
+
+        if (Entry.Frame == frame.Frame && ((frame.ID ^ Entry.ID) & Entry.Mask) == 0)
+        {
+            break;
+        }
+        Index = Entry.Next;
+    }
+
+    if (Index == CANGATEWAY_END)
+    {
+        return;
+    }
+
+    Route &Entry = _Routes[Index];
+
+    if (Entry.MinInterval != 0)
+    {
+        uint32_t Now = millis();
+
+        if (Entry.Started && Now - Entry.LastForward < Entry.MinInterval)
+        {
+            Entry.RateLimited++;
+            return;
+        }
+
+        Entry.Started = true;
+        Entry.LastForward = Now;
+    }
+
+    uint32_t ReceivedId = frame.ID;
+
+    if (Entry.Rewrite != CANGATEWAY_KEEP_ID)
+    {
+        frame.ID = (ReceivedId & ~Entry.Mask) | (Entry.Rewrite & Entry.Mask);
+    }
+
+    uint32_t Key = CANBus::arbitrationKey(frame);
+    uint16_t Checksum = _checksum(frame);
+    uint32_t Now = micros();
+
+    for (uint8_t Port = 0; Port < _BusCount; Port++)
+    {
+        if ((Entry.Destinations & (1 << Port)) == 0)
+        {
+            continue;
+        }
+
+        // Tracked before enqueue(), the Frame can be transmitted already within enqueue()
+        _track(Port, Key, Checksum, Index, Now);
+
+        if (_Buses[Port]->enqueue(frame))
+        {
+            Entry.Forwarded++;
+        } else {
+            _untrack(Port, Key);
+            Entry.QueueFull++;
+        }
+    }
+
+    frame.ID = ReceivedId;
+}
+
+/**
+ * @brief Takes the Latency of a forwarded Frame when its Transmission is finished.
+ *
+ * Called by the Transmit-Queue of the Destination-Bus (with disabled Interrupts or from the Interrupt-Routine).
+ * A forwarded Frame is matched by its Key and the Checksum of its Data, so a Frame of the Destination itself with the
+ * same ID does not end the Latency of a forwarded Frame still waiting in the Queue. Other Frames are ignored.
+ * @param port Port of the Destination-Bus
+ * @param key Arbitration-Key of the transmitted Frame
+ * @param frame Transmitted Frame
+ */
+void CANGateway::transmitted(uint8_t port, uint32_t key, const CANFrame &frame)
+{
+    if (port >= CANGATEWAY_MAX_BUSES)
+    {
+        return;
+    }
+
+    Pending *List = _Pending[port];
+    uint8_t Count = _PendingCount[port];
+    uint16_t Checksum = _checksum(frame);
+
+    // Frames with the same Key leave the Transmit-Queue in Enqueue-Order, so the oldest Entry belongs to the Frame
+    for (uint8_t i = 0; i < Count; i++)
+    {
+        if (List[i].Key != key || List[i].Checksum != Checksum)
+        {
+            continue;
+        }
+
+        Route &Entry = _Routes[List[i].Route];
+        uint32_t Latency = micros() - List[i].Time;
+
+        if (Entry.LatencySum > 0xFFFFFFFF - Latency)
+        {
+            Entry.LatencySum >>= 1;
+            Entry.LatencyCount >>= 1;
+        }
+
+        Entry.LatencySum += Latency;
+        Entry.LatencyCount++;
+
+        if (Latency > Entry.LatencyMax)
+        {
+            Entry.LatencyMax = Latency;
+        }
+
+        for (uint8_t j = i + 1; j < Count; j++)
+        {
+            List[j - 1] = List[j];
+        }
+        _PendingCount[port] = Count - 1;
+        return;
+    }
+}
+
+/**
+ * @brief Number of the added Buses.
+ * @return uint8_t Count
+ */
+uint8_t CANGateway::getBusCount()
+{
+    return _BusCount;
+}
+
+/**
+ * @brief Number of the added Routes.
+ * @return uint8_t Count
+ */
+uint8_t CANGateway::getRouteCount()
+{
+    return _RouteCount;
+}
+
+/**
+ * @brief Frames of a Route added to the Transmit-Queue of a Destination (a Frame for two Destinations counts twice).
+ * @param route Number of the Route (Order of addRoute())
+ * @return uint32_t Count
+ */
+uint32_t CANGateway::getForwarded(uint8_t route)
+{
+    if (route >= _RouteCount)
+    {
+        return 0;
+    }
+
+    CANMESSAGE_LOCK();
+    uint32_t Count = _Routes[route].Forwarded;
+    CANMESSAGE_UNLOCK();
+
+    return Count;
+}
+
+/**
+ * @brief Dropped Frames of a Route (Rate-Limit and full Transmit-Queues).
+ * @param route Number of the Route (Order of addRoute())
+ * @return uint32_t Count
+ */
+uint32_t CANGateway::getDropped(uint8_t route)
+{
+    if (route >= _RouteCount)
+    {
+        return 0;
+    }
+
+    CANMESSAGE_LOCK();
+    uint32_t Count = _Routes[route].RateLimited + _Routes[route].QueueFull;
+    CANMESSAGE_UNLOCK();
+
+    return Count;
+}
+
+/**
+ * @brief Frames of a Route dropped because they arrived within the Min. Interval.
+ * @param route Number of the Route (Order of addRoute())
+ * @return uint32_t Count
+ */
+uint32_t CANGateway::getRateLimited(uint8_t route)
+{
+    if (route >= _RouteCount)
+    {
+        return 0;
+    }
+
+    CANMESSAGE_LOCK();
+    uint32_t Count = _Routes[route].RateLimited;
+    CANMESSAGE_UNLOCK();
+
+    return Count;
+}
+
+/**
+ * @brief Frames of a Route dropped because the Transmit-Queue of a Destination was full.
+ * @param route Number of the Route (Order of addRoute())
+ * @return uint32_t Count
+ */
+uint32_t CANGateway::getQueueFull(uint8_t route)
+{
+    if (route >= _RouteCount)
+    {
+        return 0;
+    }
+
+    CANMESSAGE_LOCK();
+    uint32_t Count = _Routes[route].QueueFull;
+    CANMESSAGE_UNLOCK();
+
+    return Count;
+}
+
+/**
+ * @brief Average Time from the Reception to the finished Transmission of the forwarded Frames of a Route.
+ * @param route Number of the Route (Order of addRoute())
+ * @return uint32_t Latency [us], 0 when no Frame is transmitted yet
+ */
+uint32_t CANGateway::getAverageLatency(uint8_t route)
+{
+    if (route >= _RouteCount)
+    {
+        return 0;
+    }
+
+    CANMESSAGE_LOCK();
+    uint32_t Sum = _Routes[route].LatencySum;
+    uint32_t Count = _Routes[route].LatencyCount;
+    CANMESSAGE_UNLOCK();
+
+    return Count != 0 ? Sum / Count : 0;
+}
+
+/**
+ * @brief Longest Time from the Reception to the finished Transmission of a forwarded Frame of a Route.
+ * @param route Number of the Route (Order of addRoute())
+ * @return uint32_t Latency [us]
+ */
+uint32_t CANGateway::getMaxLatency(uint8_t route)
+{
+    if (route >= _RouteCount)
+    {
+        return 0;
+    }
+
+    CANMESSAGE_LOCK();
+    uint32_t Latency = _Routes[route].LatencyMax;
+    CANMESSAGE_UNLOCK();
+
+    return Latency;
+}
+
+/**
+ * @brief Resets the Counters and Latencies of all Routes.
+ */
+void CANGateway::resetStatistics()
+{
+    CANMESSAGE_LOCK();
+
+    for (uint8_t i = 0; i < CANGATEWAY_MAX_ROUTES; i++)
+    {
+        _Routes[i].Forwarded = 0;
+        _Routes[i].RateLimited = 0;
+        _Routes[i].QueueFull = 0;
+        _Routes[i].LatencySum = 0;
+        _Routes[i].LatencyCount = 0;
+        _Routes[i].LatencyMax = 0;
+    }
+
+    CANMESSAGE_UNLOCK();
+}
+
+/**
+ * @brief Fletcher-16 over DLC and Data of a Frame (identifies a forwarded Frame among Frames with the same Key).
+ */
+uint16_t CANGateway::_checksum(const CANFrame &frame)
+{
+    uint8_t Length = frame.DLC > 8 ? 8 : frame.DLC;
+    uint16_t Sum1 = frame.DLC;
+    uint16_t Sum2 = Sum1;
+
+    for (uint8_t i = 0; i < Length; i++)
+    {
+        Sum1 = (uint16_t) ((Sum1 + frame.Data[i]) % 255);
+        Sum2 = (uint16_t) ((Sum2 + Sum1) % 255);
+    }
+    return (uint16_t) ((Sum2 << 8) | Sum1);
+}
+
+/**
+ * @brief Notes a forwarded Frame in the Pending-List of its Destination, a full List drops its oldest Entry.
+ */
+void CANGateway::_track(uint8_t port, uint32_t key, uint16_t checksum, uint8_t route, uint32_t time)
+{
+    CANMESSAGE_LOCK();
+
+    Pending *List = _Pending[port];
+    uint8_t Count = _PendingCount[port];
+
+    if (Count >= CANGATEWAY_PENDING)
+    {
+        for (uint8_t i = 1; i < Count; i++)
+        {
+            List[i - 1] = List[i];
+        }
+        Count--;
+    }
+
+    List[Count].Key = key;
+    List[Count].Checksum = checksum;
+    List[Count].Time = time;
+    List[Count].Route = route;
+    _PendingCount[port] = Count + 1;
+
+    CANMESSAGE_UNLOCK();
+}
+
+/**
+ * @brief Removes the newest Entry of the Pending-List again (the Frame was not accepted by the Transmit-Queue).
+ */
+void CANGateway::_untrack(uint8_t port, uint32_t key)
+{
+    CANMESSAGE_LOCK();
+
+    uint8_t Count = _PendingCount[port];
+
+    if (Count != 0 && _Pending[port][Count - 1].Key == key)
+    {
+        _PendingCount[port] = Count - 1;
+    }
+
+    CANMESSAGE_UNLOCK();
+}
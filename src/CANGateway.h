@@ -0,0 +1,121 @@
+/**
+ * @file CANGateway.h
+ * @author MH-Tobi
+ * @brief Forwarding of Frames between several CANBus Instances (one per Controller) with an ID-based Routing-Table.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANGATEWAY_H
+#define CANGATEWAY_H
+
+#include "CANPlatform.h"
+#include "CANFrame.h"
+#include "CANBus.h"
+#include "CANMessageError.h"
+
+
+#ifndef CANGATEWAY_MAX_BUSES
+#define CANGATEWAY_MAX_BUSES            2       // Max. Number of Buses (Controllers) of one Gateway (up to 8)
+#endif
+
+#ifndef CANGATEWAY_MAX_ROUTES
+#define CANGATEWAY_MAX_ROUTES           8       // Max. Number of Routes of one Gateway (up to 254)
+#endif
+
+#ifndef CANGATEWAY_PENDING
+#define CANGATEWAY_PENDING              (CANBUS_TX_QUEUE_SIZE + CANBUS_TX_BUFFERS)  // Forwarded Frames per Destination whose Latency is tracked
+#endif
+
+#define CANGATEWAY_KEEP_ID              0xFFFFFFFF  // Route without ID-Rewrite
+#define CANGATEWAY_END                  0xFF        // End of the Route-List of a Source
+
+
+/**
+ * @brief Forwards the received Frames of a Bus to the Transmit-Queues of other Buses.
+ *
+ * Each Route matches the Frames of one Source-Bus by ID, Mask and Frame-Type and sends them to one or more
+ * Destination-Buses, optional with a new ID and limited to one Frame per Interval. The Routes of a Source
+ * are checked in the Order they are added, the first matching Route wins.
+ * dispatch() of the Source-Bus passes each Frame straight from the Receive-Buffer to enqueue() of the
+ * Destinations, so a Frame is only copied once into the Transmit-Queue (also with ID-Rewrite).
+ * The Latency of a Route is the Time from dispatch() of the Source to the finished Transmission on the Destination.
+ */
+class CANGateway
+{
+	private:
+        struct Route
+        {
+            uint32_t ID;
+            uint32_t Mask;                  // Bits of the ID they must match (and they are replaced by the Rewrite)
+            uint32_t Rewrite;               // New ID, CANGATEWAY_KEEP_ID = forward with the received ID
+            uint16_t MinInterval;           // Min. Time [ms] between two forwarded Frames, 0 = no Limit
+            uint8_t Frame;
+            uint8_t Source;
+            uint8_t Destinations;           // Bit n = Bus n
+            uint8_t Next;                   // Next Route of the same Source
+            bool Started;                   // LastForward is valid
+            uint32_t LastForward;           // Time [ms] of the last forwarded Frame
+            volatile uint32_t Forwarded;    // Frames added to a Transmit-Queue (one per Destination)
+            volatile uint32_t RateLimited;  // Frames dropped by the Min. Interval
+            volatile uint32_t QueueFull;    // Frames dropped because the Transmit-Queue of a Destination was full
+            volatile uint32_t LatencySum;   // us
+            volatile uint32_t LatencyCount;
+            volatile uint32_t LatencyMax;
+        };
+
+        struct Pending
+        {
+            uint32_t Key;                   // Arbitration-Key of the forwarded Frame
+            uint16_t Checksum;              // Checksum of DLC and Data, a Frame of the Destination with the same Key is not taken for it
+            uint32_t Time;                  // Time [us] of the Reception
+            uint8_t Route;
+        };
+
+        CANBus *_Buses[CANGATEWAY_MAX_BUSES];
+        uint8_t _BusCount;
+        Route _Routes[CANGATEWAY_MAX_ROUTES];
+        uint8_t _RouteCount;
+        uint8_t _First[CANGATEWAY_MAX_BUSES];       // First Route of each Source
+        Pending _Pending[CANGATEWAY_MAX_BUSES][CANGATEWAY_PENDING];  // Forwarded Frames in the Transmit-Queue of each Destination (oldest first)
+        uint8_t _PendingCount[CANGATEWAY_MAX_BUSES];
+        uint16_t _lastCanError;
+
+        static uint16_t _checksum(const CANFrame &frame);
+        void _track(uint8_t port, uint32_t key, uint16_t checksum, uint8_t route, uint32_t time);
+        void _untrack(uint8_t port, uint32_t key);
+
+	public:
+
+        CANGateway();
+
+        uint16_t getLastCanError();
+
+        int8_t addBus(CANBus &bus);
+        bool addRoute(uint8_t source, uint32_t id, uint32_t mask, uint8_t frame, uint8_t destinations,
+            uint32_t rewriteId = CANGATEWAY_KEEP_ID, uint16_t minInterval = 0);
+
+        // For the Bus (called by dispatch(), the Transmit-Queue and applyFilters())
+
+        void route(uint8_t port, CANFrame &frame);
+        bool addFilterIds(uint8_t port, CANFilterPlanner &planner);
+        void transmitted(uint8_t port, uint32_t key, const CANFrame &frame);
+
+        // Statistics (Routes are numbered in the Order they are added)
+
+        uint8_t getBusCount();
+        uint8_t getRouteCount();
+        uint32_t getForwarded(uint8_t route);
+        uint32_t getDropped(uint8_t route);
+        uint32_t getRateLimited(uint8_t route);
+        uint32_t getQueueFull(uint8_t route);
+        uint32_t getAverageLatency(uint8_t route);
+        uint32_t getMaxLatency(uint8_t route);
+        void resetStatistics();
+
+};
+
+#endif
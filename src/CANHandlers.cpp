@@ -0,0 +1,380 @@
+#include "CANHandlers.h"
+
+static_assert(CANHANDLERS_QUEUE_SIZE > 0 && CANHANDLERS_QUEUE_SIZE < CANHANDLERS_NONE, "CANHANDLERS_QUEUE_SIZE must be 1 - 254");
+static_assert(CANHANDLERS_MAX_RANGES < CANHANDLERS_NONE, "CANHANDLERS_MAX_RANGES must be 0 - 254");
+static_assert(CANBUS_MAX_MESSAGES < CANHANDLERS_NONE, "CANBUS_MAX_MESSAGES is too large for the CANHandlers");
+
+
+/**
+ * @brief Constructor
+ */
+CANHandlers::CANHandlers()
+{
+    _Bus = NULL;
+    _RangeCount = 0;
+    _PendingCount = 0;
+    _MaxPending = 0;
+    _Overflows = 0;
+    _Processed = 0;
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    for (uint8_t i = 0; i < CANBUS_MAX_MESSAGES; i++)
+    {
+        _Messages[i].Function = NULL;
+        _Messages[i].Priority = CANHANDLERS_PRIORITY_DEFAULT;
+    }
+
+    for (uint8_t i = 0; i < CANHANDLERS_QUEUE_SIZE; i++)
+    {
+        _Queue[i].Next = i + 1 < CANHANDLERS_QUEUE_SIZE ? i + 1 : CANHANDLERS_NONE;
+    }
+    _Free = 0;
+
+    for (uint8_t i = 0; i < CANHANDLERS_PRIORITIES; i++)
+    {
+        _Head[i] = CANHANDLERS_NONE;
+        _Tail[i] = CANHANDLERS_NONE;
+    }
+}
+
+/**
+ * @brief Returns the last occurred Error.
+ * @return Error-Code (see CANMessageError.h)
+ */
+uint16_t CANHandlers::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Links the Handlers with a Bus, afterwards dispatch() queues the Frames they have a Handler.
+ * @param bus Initialised Bus
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANHandlers::init(CANBus &bus)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    _Bus = &bus;
+    _Bus->attachHandlers(this);
+
+    return true;
+}
+
+/**
+ * @brief Sets the Handler of a registered Reception-Message.
+ *
+ * Calling it again for the same Message changes the Handler, NULL removes it (the Frames are delivered to the Message again).
+ * @param message Reception-Message registered at the Bus
+ * @param handler Handler, called by processPending() with the Frame and the Message
+ * @param priority Priority of the Frames (0 = highest - CANHANDLERS_PRIORITIES - 1)
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANHandlers::onMessage(CANMessage &message, CANReceiveHandler handler, uint8_t priority)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_Bus == NULL)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (priority >= CANHANDLERS_PRIORITIES)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    int16_t Index = _Bus->getMessageIndex(message);
+
+    if (Index < 0)
+    {
+        _lastCanError = ERROR_CAN_HANDLERS_NOT_REGISTERED;
+        return false;
+    }
+
+    CANMESSAGE_LOCK();
+    _Messages[Index].Function = handler;
+    _Messages[Index].Priority = priority;
+    CANMESSAGE_UNLOCK();
+
+    return true;
+}
+
+/**
+ * @brief Adds a Handler for a Range of IDs.
+ *
+ * Used for the Frames without a registered Message (they pass the Acceptance-Filters) and for the registered
+ * Messages without an own Handler. The Ranges are checked in the Order they are added, the first matching Range wins.
+ * @param firstId First ID of the Range
+ * @param lastId Last ID of the Range
+ * @param frame Frame-Type (CANMESSAGE_FRAME_STANDARD or CANMESSAGE_FRAME_EXTENDED)
+ * @param handler Handler, called by processPending() with the Frame and the registered Message (NULL when there is none)
+ * @param priority Priority of the Frames (0 = highest - CANHANDLERS_PRIORITIES - 1)
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANHandlers::onRange(uint32_t firstId, uint32_t lastId, uint8_t frame, CANReceiveHandler handler, uint8_t priority)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (frame != CANMESSAGE_FRAME_STANDARD && frame != CANMESSAGE_FRAME_EXTENDED)
+    {
+        _lastCanError = ERROR_CAN_INIT_FRAME_NOT_PLAUSIBLE;
+        return false;
+    }
+
+    if (lastId > (frame == CANMESSAGE_FRAME_EXTENDED ? 0x1FFFFFFF : 0x7FF))
+    {
+        _lastCanError = ERROR_CAN_INIT_ID_OUTA_RANGE;
+        return false;
+    }
+
+    if (handler == NULL || firstId > lastId || priority >= CANHANDLERS_PRIORITIES)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    if (_RangeCount >= CANHANDLERS_MAX_RANGES)
+    {
+        _lastCanError = ERROR_CAN_HANDLERS_FULL;
+        return false;
+    }
+
+    Range &Entry = _Ranges[_RangeCount];
+
+    Entry.FirstId = firstId;
+    Entry.LastId = lastId;
+    Entry.Frame = frame;
+    Entry.Entry.Function = handler;
+    Entry.Entry.Priority = priority;
+
+    CANMESSAGE_LOCK();
+    _RangeCount++;
+    CANMESSAGE_UNLOCK();
+
+    return true;
+}
+
+/**
+ * @brief Adds the ID-Ranges to the Filter-Plan of the Bus (called by applyFilters()).
+ * @param planner Planner of the Bus
+ * @return true when success, false when the Blocks of the Ranges do not fit into the Planner
+ */
+bool CANHandlers::addFilterIds(CANFilterPlanner &planner)
+{
+    for (uint8_t i = 0; i < _RangeCount; i++)
+    {
+        if (!planner.addRange(_Ranges[i].FirstId, _Ranges[i].LastId, _Ranges[i].Frame))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Top-Half: Queues a received Frame when it has a Handler.
+ *
+ * Called by dispatch() of the Bus, costs one Table-Access (registered Message with Handler)
+ * or one Compare per ID-Range and a Copy of the Frame.
+ * @param index Index of the registered Message at the Bus, -1 when the Frame has no registered Message
+ * @param frame Received Frame
+ * @return true when the Frame has a Handler (also when it is dropped because the Queue is full), false when it is not taken
+ */
+bool CANHandlers::push(int16_t index, const CANFrame &frame)
+{
+    if (index >= 0 && _Messages[index].Function != NULL)
+    {
+        _queue((uint8_t) index, CANHANDLERS_NONE, _Messages[index].Priority, frame);
+        return true;
+    }
+
+    for (uint8_t i = 0; i < _RangeCount; i++)
+    {
+        const Range &Entry = _Ranges[i];
+
+        if (Entry.Frame == frame.Frame && frame.ID >= Entry.FirstId && frame.ID <= Entry.LastId)
+        {
+            _queue(index >= 0 ? (uint8_t) index : CANHANDLERS_NONE, i, Entry.Entry.Priority, frame);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Bottom-Half: Calls the Handlers of the queued Frames, the highest Priority first.
+ *
+ * Call it in the loop(). A Frame arriving during a Handler is processed next, when its Priority is higher.
+ * The Frame is passed out of the Queue (no Copy), its Entry is free again after the Handler returned.
+ * @param budget Time-Budget in us, after it no further Handler is started (0 = until the Queue is empty)
+ * @return uint8_t Number of called Handlers
+ */
+uint8_t CANHandlers::processPending(uint16_t budget)
+{
+    uint32_t Start = budget != 0 ? micros() : 0;
+    uint8_t Count = 0;
+
+    while (Count < 0xFF)
+    {
+        CANMESSAGE_LOCK();
+
+        uint8_t Priority = 0;
+
+        while (Priority < CANHANDLERS_PRIORITIES && _Head[Priority] == CANHANDLERS_NONE)
+        {
+            Priority++;
+        }
+
+        if (Priority >= CANHANDLERS_PRIORITIES)
+        {
+            CANMESSAGE_UNLOCK();
+            break;
+        }
+
+        uint8_t Index = _Head[Priority];
+
+        _Head[Priority] = _Queue[Index].Next;
+
+        if (_Head[Priority] == CANHANDLERS_NONE)
+        {
+            _Tail[Priority] = CANHANDLERS_NONE;
+        }
+
+        CANMESSAGE_UNLOCK();
+
+        // The Entry is unlinked, so the Top-Half does not touch it during the Handler
+        Pending &Entry = _Queue[Index];
+        CANMessage *Message = Entry.Message != CANHANDLERS_NONE ? _Bus->getMessage(Entry.Message) : NULL;
+        CANReceiveHandler Function = Entry.Range != CANHANDLERS_NONE ? _Ranges[Entry.Range].Entry.Function : _Messages[Entry.Message].Function;
+
+        // The Handler of the Message is removed since the Frame was queued
+        if (Function != NULL)
+        {
+            Function(Entry.Frame, Message);
+        }
+
+        // Own Block, CANMESSAGE_LOCK() declares the saved Interrupt-State on AVR
+        {
+            CANMESSAGE_LOCK();
+            Entry.Next = _Free;
+            _Free = Index;
+            _PendingCount--;
+            CANMESSAGE_UNLOCK();
+        }
+
+        Count++;
+        _Processed++;
+
+        if (budget != 0 && micros() - Start >= budget)
+        {
+            break;
+        }
+    }
+
+    return Count;
+}
+
+/**
+ * @brief Frames waiting for their Handler.
+ * @return uint8_t Count
+ */
+uint8_t CANHandlers::getPending()
+{
+    return _PendingCount;
+}
+
+/**
+ * @brief Highest Number of Frames waiting at the same Time (Dimensioning of CANHANDLERS_QUEUE_SIZE).
+ * @return uint8_t Count
+ */
+uint8_t CANHandlers::getMaxPending()
+{
+    return _MaxPending;
+}
+
+/**
+ * @brief Frames with a Handler dropped because the Queue was full.
+ * @return uint32_t Count
+ */
+uint32_t CANHandlers::getOverflows()
+{
+    CANMESSAGE_LOCK();
+    uint32_t Count = _Overflows;
+    CANMESSAGE_UNLOCK();
+
+    return Count;
+}
+
+/**
+ * @brief Called Handlers since the Start or resetStatistics().
+ * @return uint32_t Count
+ */
+uint32_t CANHandlers::getProcessed()
+{
+    return _Processed;
+}
+
+/**
+ * @brief Resets the Counters and the Max. Number of waiting Frames.
+ */
+void CANHandlers::resetStatistics()
+{
+    CANMESSAGE_LOCK();
+    _MaxPending = _PendingCount;
+    _Overflows = 0;
+    _Processed = 0;
+    CANMESSAGE_UNLOCK();
+}
+
+/**
+ * @brief Appends a Frame to the Pending-List of its Priority.
+ * @param message Index of the registered Message, CANHANDLERS_NONE when there is none
+ * @param range Index of the ID-Range, CANHANDLERS_NONE for the Handler of the Message
+ * @param priority Priority of the Handler
+ * @param frame Received Frame
+ * @return true when success, false when the Queue is full
+ */
+bool CANHandlers::_queue(uint8_t message, uint8_t range, uint8_t priority, const CANFrame &frame)
+{
+    CANMESSAGE_LOCK();
+
+    uint8_t Index = _Free;
+
+    if (Index == CANHANDLERS_NONE)
+    {
+        _Overflows++;
+        CANMESSAGE_UNLOCK();
+        return false;
+    }
+
+    Pending &Entry = _Queue[Index];
+
+    _Free = Entry.Next;
+    Entry.Frame = frame;
+    Entry.Message = message;
+    Entry.Range = range;
+    Entry.Next = CANHANDLERS_NONE;
+
+    if (_Tail[priority] == CANHANDLERS_NONE)
+    {
+        _Head[priority] = Index;
+    } else {
+        _Queue[_Tail[priority]].Next = Index;
+    }
+    _Tail[priority] = Index;
+
+    _PendingCount++;
+
+    if (_PendingCount > _MaxPending)
+    {
+        _MaxPending = _PendingCount;
+    }
+
+    CANMESSAGE_UNLOCK();
+
+    return true;
+}
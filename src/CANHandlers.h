@@ -0,0 +1,125 @@
+/**
+ * @file CANHandlers.h
+ * @author MH-Tobi
+ * @brief Receive-Handlers of a CANBus, the Interrupt-Routine only queues the Frames and the loop() calls the Handlers.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANHANDLERS_H
+#define CANHANDLERS_H
+
+#include "CANPlatform.h"
+#include "CANFrame.h"
+#include "CANMessage.h"
+#include "CANBus.h"
+#include "CANMessageError.h"
+
+
+#ifndef CANHANDLERS_QUEUE_SIZE
+#define CANHANDLERS_QUEUE_SIZE          8       // Max. Number of Frames waiting for their Handler (up to 254)
+#endif
+
+#ifndef CANHANDLERS_MAX_RANGES
+#define CANHANDLERS_MAX_RANGES          4       // Max. Number of ID-Ranges with a Handler
+#endif
+
+#define CANHANDLERS_PRIORITIES          4       // Priority-Levels, 0 = highest
+#define CANHANDLERS_PRIORITY_DEFAULT    2
+#define CANHANDLERS_NONE                0xFF    // No Handler resp. End of a Pending-List
+
+
+/**
+ * @brief Called by processPending() for a received Frame.
+ * @param frame Received Frame
+ * @param message Registered Message of the Frame, NULL for the Handler of an ID-Range
+ */
+typedef void (*CANReceiveHandler)(const CANFrame &frame, CANMessage *message);
+
+
+/**
+ * @brief Deferred Receive-Handlers of the Messages registered at a CANBus and of ID-Ranges without a registered Message.
+ *
+ * Top-Half: dispatch() of the Bus only moves the Frame of a Handler into a Pending-Queue (one List per Priority),
+ * so the Interrupt-Routine does not grow with the Number of Messages and Handlers.
+ * Bottom-Half: processPending() in the loop() calls the Handlers, the highest Priority first and Frames of the same
+ * Priority in Order of their Reception, until the Queue is empty or the Time-Budget is used up.
+ * A Frame with a Handler is not delivered to its Message (Buffer, FIFO or Mailbox), the Handler gets it instead.
+ */
+class CANHandlers
+{
+	private:
+        struct Handler
+        {
+            CANReceiveHandler Function;
+            uint8_t Priority;
+        };
+
+        struct Range
+        {
+            uint32_t FirstId;
+            uint32_t LastId;
+            uint8_t Frame;
+            Handler Entry;
+        };
+
+        struct Pending
+        {
+            CANFrame Frame;
+            uint8_t Message;                // Index of the registered Message, CANHANDLERS_NONE = no Message
+            uint8_t Range;                  // Index of the ID-Range, CANHANDLERS_NONE = Handler of the Message
+            uint8_t Next;
+        };
+
+        CANBus *_Bus;
+        Handler _Messages[CANBUS_MAX_MESSAGES];     // Same Index as the Message at the Bus
+        Range _Ranges[CANHANDLERS_MAX_RANGES];
+        uint8_t _RangeCount;
+        Pending _Queue[CANHANDLERS_QUEUE_SIZE];
+        uint8_t _Free;                              // List of the free Entries
+        uint8_t _Head[CANHANDLERS_PRIORITIES];      // Pending-List of each Priority (oldest first)
+        uint8_t _Tail[CANHANDLERS_PRIORITIES];
+        volatile uint8_t _PendingCount;
+        uint8_t _MaxPending;
+        volatile uint32_t _Overflows;               // Frames dropped because the Pending-Queue was full
+        uint32_t _Processed;
+        uint16_t _lastCanError;
+
+        bool _queue(uint8_t message, uint8_t range, uint8_t priority, const CANFrame &frame);
+
+	public:
+
+        CANHandlers();
+
+        uint16_t getLastCanError();
+
+        bool init(CANBus &bus);
+        bool onMessage(CANMessage &message, CANReceiveHandler handler, uint8_t priority = CANHANDLERS_PRIORITY_DEFAULT);
+        bool onRange(uint32_t firstId, uint32_t lastId, uint8_t frame, CANReceiveHandler handler, uint8_t priority = CANHANDLERS_PRIORITY_DEFAULT);
+
+        // For the Bus (called by applyFilters())
+
+        bool addFilterIds(CANFilterPlanner &planner);
+
+        // Top-Half (called by dispatch() of the Bus)
+
+        bool push(int16_t index, const CANFrame &frame);
+
+        // Bottom-Half (called in the loop())
+
+        uint8_t processPending(uint16_t budget = 0);
+
+        // Statistics
+
+        uint8_t getPending();
+        uint8_t getMaxPending();
+        uint32_t getOverflows();
+        uint32_t getProcessed();
+        void resetStatistics();
+
+};
+
+#endif
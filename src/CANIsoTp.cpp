@@ -0,0 +1,559 @@
+#include <string.h>
+#include "CANIsoTp.h"
+
+#define CANISOTP_NO_FLOW                0xFF    // No Flow-Control-Frame pending
+
+
+/**
+ * @brief Constructor
+ */
+CANIsoTp::CANIsoTp()
+{
+    _Tx = NULL;
+    _Rx = NULL;
+    _BlockSize = 0;
+    _STmin = 0;
+    _Now = 0;
+
+    _TxData = NULL;
+    _TxLength = 0;
+    _TxOffset = 0;
+    _TxState = CANISOTP_IDLE;
+    _TxSequence = 0;
+    _TxBlockLeft = 0;
+    _TxSeparation = 0;
+    _TxWaits = 0;
+    _TxWaitFlow = false;
+    _TxTimerStarted = false;
+    _TxTimer = 0;
+
+    _RxBuffer = NULL;
+    _RxSize = 0;
+    _RxLength = 0;
+    _RxOffset = 0;
+    _RxState = CANISOTP_IDLE;
+    _RxSequence = 0;
+    _RxBlockLeft = 0;
+    _RxBlockSize = 0;
+    _RxSTmin = 0;
+    _RxFlowPending = CANISOTP_NO_FLOW;
+    _RxTimer = 0;
+
+    _lastCanError = EMPTY_VALUE_16_BIT;
+}
+
+/**
+ * @brief Returns the last occurred Error.
+ * @return Error-Code (see CANMessageError.h)
+ */
+uint16_t CANIsoTp::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Initialisation of the Channel.
+ * @param tx Transmission-Message (DLC 8, registered at a CANBus)
+ * @param rx Reception-Message (DLC 8, registered at the CANBus or checked with checkReceive())
+ * @param blockSize Consecutive-Frames the Peer may send before it waits for the next Flow-Control (0 = unlimited)
+ * @param stMin Min. Time between the Consecutive-Frames of the Peer (0x00 - 0x7F ms, 0xF1 - 0xF9 = 100 - 900 us)
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANIsoTp::init(CANMessage &tx, CANMessage &rx, uint8_t blockSize, uint8_t stMin)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!tx.isInitialized() || !rx.isInitialized())
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (tx.getDirection() != CANMESSAGE_DIRECTION_TRANSMIT || rx.getDirection() != CANMESSAGE_DIRECTION_RECEIVE || tx.getRTR())
+    {
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
+    }
+
+    if (tx.getDLC() != 8 || rx.getDLC() != 8)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    // Without the Transmit-Queue the MCP2515 sends Buffers with the same Priority highest Buffer first, so the Order would be lost
+    if (tx.getBus() == NULL)
+    {
+        _lastCanError = ERROR_CAN_ISOTP_NO_BUS;
+        return false;
+    }
+
+    _Tx = &tx;
+    _Rx = &rx;
+    setFlowControl(blockSize, stMin);
+
+    return true;
+}
+
+/**
+ * @brief Changes Block-Size and STmin of the own Flow-Control-Frames (used from the next Reception).
+ * @param blockSize Consecutive-Frames the Peer may send before it waits for the next Flow-Control (0 = unlimited)
+ * @param stMin Min. Time between the Consecutive-Frames of the Peer
+ */
+void CANIsoTp::setFlowControl(uint8_t blockSize, uint8_t stMin)
+{
+    _BlockSize = blockSize;
+    _STmin = stMin;
+}
+
+/**
+ * @brief Starts the Transmission of Data.
+ *
+ * Up to 7 Bytes are sent as Single-Frame at once, longer Data as First-Frame and Consecutive-Frames from service().
+ * The Data is not copied, so it must not be changed until getTransmitState() is no more CANISOTP_BUSY.
+ * @param data Data
+ * @param length Length (1 - CANISOTP_MAX_LENGTH)
+ * @return true when success, false when not (Check getLastCanError() for further Information, retry on ERROR_CAN_BUS_TX_QUEUE_FULL)
+ */
+bool CANIsoTp::send(const uint8_t *data, uint16_t length)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_Tx == NULL)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (_TxState == CANISOTP_BUSY)
+    {
+        _lastCanError = ERROR_CAN_ISOTP_BUSY;
+        return false;
+    }
+
+    if (data == NULL || length == 0 || length > CANISOTP_MAX_LENGTH)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    uint8_t Data[8];
+
+    if (length <= 7)
+    {
+        Data[0] = CANISOTP_PCI_SINGLE | (uint8_t) length;
+
+        for (uint8_t i = 0; i < 7; i++)
+        {
+            Data[i + 1] = i < length ? data[i] : CANISOTP_PADDING;
+        }
+
+        if (!_sendFrame(Data))
+        {
+            return false;
+        }
+
+        _TxState = CANISOTP_DONE;
+        return true;
+    }
+
+    Data[0] = CANISOTP_PCI_FIRST | (uint8_t) (length >> 8);
+    Data[1] = (uint8_t) length;
+
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        Data[i + 2] = data[i];
+    }
+
+    if (!_sendFrame(Data))
+    {
+        return false;
+    }
+
+    _TxData = data;
+    _TxLength = length;
+    _TxOffset = 6;
+    _TxSequence = 1;
+    _TxWaits = 0;
+    _TxWaitFlow = true;
+    _TxTimerStarted = false;
+    _TxState = CANISOTP_BUSY;
+
+    return true;
+}
+
+/**
+ * @brief Prepares the Reception of the next Transfer of the Peer.
+ *
+ * The Data is written directly into the Buffer, it must not be used until getReceiveState() is no more CANISOTP_BUSY.
+ * Transfers they are longer than the Buffer are rejected with a Flow-Control Overflow.
+ * @param buffer Buffer for the received Data
+ * @param size Size of the Buffer
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANIsoTp::receive(uint8_t *buffer, uint16_t size)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_Rx == NULL)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (_RxState == CANISOTP_BUSY && _RxOffset != 0)
+    {
+        _lastCanError = ERROR_CAN_ISOTP_BUSY;
+        return false;
+    }
+
+    if (buffer == NULL || size == 0)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    _RxBuffer = buffer;
+    _RxSize = size;
+    _RxLength = 0;
+    _RxOffset = 0;
+    _RxFlowPending = CANISOTP_NO_FLOW;
+    _RxState = CANISOTP_BUSY;
+
+    return true;
+}
+
+/**
+ * @brief Processes the received Frames, sends the next Consecutive-Frames and checks the Timeouts.
+ *
+ * Call it in the loop() as often as possible. When the Transmit-Interrupts of the Bus are not used, call Bus.service() as well.
+ */
+void CANIsoTp::service()
+{
+    service((uint32_t) millis());
+}
+
+/**
+ * @brief Processes the received Frames, sends the next Consecutive-Frames and checks the Timeouts.
+ * @param now Current Time in ms
+ */
+void CANIsoTp::service(uint32_t now)
+{
+    if (_Tx == NULL)
+    {
+        return;
+    }
+
+    _Now = now;
+
+    uint8_t Data[8];
+
+    while (_Rx->getPayload(Data))
+    {
+        _handleFrame(Data);
+    }
+
+    if (_RxFlowPending != CANISOTP_NO_FLOW && _sendFlowControl(_RxFlowPending))
+    {
+        _RxFlowPending = CANISOTP_NO_FLOW;
+    }
+
+    if (_RxState == CANISOTP_BUSY && _RxOffset != 0 && now - _RxTimer > CANISOTP_TIMEOUT)
+    {
+        _failReception(ERROR_CAN_ISOTP_TIMEOUT);
+    }
+
+    if (_TxState != CANISOTP_BUSY)
+    {
+        return;
+    }
+
+    if (!_TxTimerStarted)
+    {
+        _TxTimer = now;
+        _TxTimerStarted = true;
+    }
+
+    if (_TxWaitFlow)
+    {
+        if (now - _TxTimer > CANISOTP_TIMEOUT)
+        {
+            _failTransmission(ERROR_CAN_ISOTP_TIMEOUT);
+        }
+        return;
+    }
+
+    _sendConsecutiveFrames();
+}
+
+/**
+ * @brief Returns the State of the Transmission (CANISOTP_IDLE, CANISOTP_BUSY, CANISOTP_DONE or CANISOTP_FAILED).
+ */
+uint8_t CANIsoTp::getTransmitState()
+{
+    return _TxState;
+}
+
+/**
+ * @brief Returns the State of the Reception (CANISOTP_IDLE, CANISOTP_BUSY, CANISOTP_DONE or CANISOTP_FAILED).
+ */
+uint8_t CANIsoTp::getReceiveState()
+{
+    return _RxState;
+}
+
+/**
+ * @brief Returns the Length of the received Transfer (valid when getReceiveState() is CANISOTP_DONE).
+ */
+uint16_t CANIsoTp::getReceivedLength()
+{
+    return _RxLength;
+}
+
+/**
+ * @brief Sends a Frame with the Transmission-Message.
+ */
+bool CANIsoTp::_sendFrame(const uint8_t *Data)
+{
+    if (!_Tx->setPayload(Data, 8) || !_Tx->send())
+    {
+        _lastCanError = _Tx->getLastCanError();
+        return false;
+    }
+    return true;
+}
+
+bool CANIsoTp::_sendFlowControl(uint8_t status)
+{
+    uint8_t Data[8] = { (uint8_t) (CANISOTP_PCI_FLOW_CONTROL | status), _RxBlockSize, _RxSTmin,
+        CANISOTP_PADDING, CANISOTP_PADDING, CANISOTP_PADDING, CANISOTP_PADDING, CANISOTP_PADDING };
+
+    return _sendFrame(Data);
+}
+
+/**
+ * @brief Processes a received Frame of the Peer.
+ */
+void CANIsoTp::_handleFrame(const uint8_t *Data)
+{
+    uint8_t Type = Data[0] & 0xF0;
+
+    if (Type == CANISOTP_PCI_FLOW_CONTROL)
+    {
+        _handleFlowControl(Data);
+        return;
+    }
+
+    // Without Buffer the Transfers of the Peer are ignored
+    if (_RxState != CANISOTP_BUSY)
+    {
+        return;
+    }
+
+    // A new Transfer replaces an unfinished one
+    if (Type == CANISOTP_PCI_SINGLE)
+    {
+        uint8_t Length = Data[0] & 0x0F;
+
+        if (Length == 0 || Length > 7)
+        {
+            return;
+        }
+
+        if (Length > _RxSize)
+        {
+            _failReception(ERROR_CAN_ISOTP_OVERFLOW);
+            return;
+        }
+
+        memcpy(_RxBuffer, &Data[1], Length);
+        _RxLength = Length;
+        _RxOffset = 0;
+        _RxState = CANISOTP_DONE;
+        return;
+    }
+
+    if (Type == CANISOTP_PCI_FIRST)
+    {
+        uint16_t Length = ((uint16_t) (Data[0] & 0x0F) << 8) | Data[1];
+
+        if (Length < 8)
+        {
+            return;
+        }
+
+        // Block-Size and STmin stay the same for the whole Transfer (setFlowControl() applies to the next one)
+        _RxBlockSize = _BlockSize;
+        _RxSTmin = _STmin;
+
+        if (Length > _RxSize)
+        {
+            _RxFlowPending = CANISOTP_FLOW_OVERFLOW;
+            _failReception(ERROR_CAN_ISOTP_OVERFLOW);
+            return;
+        }
+
+        memcpy(_RxBuffer, &Data[2], 6);
+        _RxLength = Length;
+        _RxOffset = 6;
+        _RxSequence = 1;
+        _RxBlockLeft = _RxBlockSize;
+        _RxTimer = _Now;
+        _RxFlowPending = CANISOTP_FLOW_CONTINUE;
+        return;
+    }
+
+    if (Type != CANISOTP_PCI_CONSECUTIVE || _RxOffset == 0)
+    {
+        return;
+    }
+
+    if ((Data[0] & 0x0F) != _RxSequence)
+    {
+        _failReception(ERROR_CAN_ISOTP_UNEXPECTED_FRAME);
+        return;
+    }
+
+    uint16_t Count = _RxLength - _RxOffset < 7 ? _RxLength - _RxOffset : 7;
+
+    memcpy(&_RxBuffer[_RxOffset], &Data[1], Count);
+    _RxOffset += Count;
+    _RxSequence = (_RxSequence + 1) & 0x0F;
+    _RxTimer = _Now;
+
+    if (_RxOffset >= _RxLength)
+    {
+        _RxOffset = 0;
+        _RxState = CANISOTP_DONE;
+        return;
+    }
+
+    if (_RxBlockSize != 0 && --_RxBlockLeft == 0)
+    {
+        _RxBlockLeft = _RxBlockSize;
+        _RxFlowPending = CANISOTP_FLOW_CONTINUE;
+    }
+}
+
+/**
+ * @brief Processes a Flow-Control-Frame of the Peer for the own Transmission.
+ */
+void CANIsoTp::_handleFlowControl(const uint8_t *Data)
+{
+    if (_TxState != CANISOTP_BUSY || !_TxWaitFlow)
+    {
+        return;
+    }
+
+    switch (Data[0] & 0x0F)
+    {
+        case CANISOTP_FLOW_CONTINUE:
+            _TxBlockLeft = Data[1];
+            _TxSeparation = _decodeSTmin(Data[2]);
+            _TxWaitFlow = false;
+            _TxWaits = 0;
+            // The first Consecutive-Frame is sent without Delay
+            _TxTimer = _Now - _TxSeparation;
+            break;
+
+        case CANISOTP_FLOW_WAIT:
+            if (++_TxWaits > CANISOTP_MAX_WAIT_FRAMES)
+            {
+                _failTransmission(ERROR_CAN_ISOTP_TIMEOUT);
+                break;
+            }
+            _TxTimer = _Now;
+            break;
+
+        case CANISOTP_FLOW_OVERFLOW:
+            _failTransmission(ERROR_CAN_ISOTP_OVERFLOW);
+            break;
+
+        default:
+            _failTransmission(ERROR_CAN_ISOTP_UNEXPECTED_FRAME);
+            break;
+    }
+}
+
+/**
+ * @brief Sends Consecutive-Frames until the Block ends, STmin must pass or the Transmit-Queue is full.
+ *
+ * With STmin 0 the whole Block is pipelined through the Transmit-Queue and all free Transmit-Buffers.
+ */
+void CANIsoTp::_sendConsecutiveFrames()
+{
+    uint8_t Data[8];
+
+    while (_TxOffset < _TxLength)
+    {
+        if (_TxSeparation != 0 && _Now - _TxTimer < _TxSeparation)
+        {
+            return;
+        }
+
+        uint16_t Count = _TxLength - _TxOffset < 7 ? _TxLength - _TxOffset : 7;
+
+        Data[0] = CANISOTP_PCI_CONSECUTIVE | _TxSequence;
+
+        for (uint8_t i = 0; i < 7; i++)
+        {
+            Data[i + 1] = i < Count ? _TxData[_TxOffset + i] : CANISOTP_PADDING;
+        }
+
+        if (!_sendFrame(Data))
+        {
+            // Queue full, the next service() continues
+            if (_lastCanError != ERROR_CAN_BUS_TX_QUEUE_FULL)
+            {
+                _failTransmission(_lastCanError);
+            }
+            return;
+        }
+
+        _TxOffset += Count;
+        _TxSequence = (_TxSequence + 1) & 0x0F;
+        _TxTimer = _Now;
+
+        if (_TxOffset >= _TxLength)
+        {
+            _TxState = CANISOTP_DONE;
+            return;
+        }
+
+        if (_TxBlockLeft != 0 && --_TxBlockLeft == 0)
+        {
+            _TxWaitFlow = true;
+            return;
+        }
+    }
+}
+
+void CANIsoTp::_failTransmission(uint16_t error)
+{
+    _lastCanError = error;
+    _TxState = CANISOTP_FAILED;
+}
+
+void CANIsoTp::_failReception(uint16_t error)
+{
+    _lastCanError = error;
+    _RxOffset = 0;
+    _RxState = CANISOTP_FAILED;
+}
+
+/**
+ * @brief Converts STmin into ms (the us-Values are rounded up to 1 ms, reserved Values are handled as 127 ms).
+ */
+uint8_t CANIsoTp::_decodeSTmin(uint8_t value)
+{
+    if (value <= 0x7F)
+    {
+        return value;
+    }
+
+    if (value >= 0xF1 && value <= 0xF9)
+    {
+        return 1;
+    }
+    return 0x7F;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file CANIsoTp.h
+ * @author MH-Tobi
+ * @brief Segmented Transfer of up to 4095 Bytes (ISO 15765-2, ISO-TP) on top of two CAN-Messages.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANISOTP_H
+#define CANISOTP_H
+
+#include "CANPlatform.h"
+#include "CANMessage.h"
+#include "CANBus.h"
+#include "CANMessageError.h"
+
+
+#define CANISOTP_MAX_LENGTH             4095    // Max. Length of a Transfer (12-bit Length of the First-Frame)
+
+#ifndef CANISOTP_PADDING
+#define CANISOTP_PADDING                0xCC    // Value of the unused Bytes of a Frame
+#endif
+
+#ifndef CANISOTP_TIMEOUT
+#define CANISOTP_TIMEOUT                1000    // N_Bs / N_Cr: max. Time in ms to wait for the next Flow-Control- or Consecutive-Frame
+#endif
+
+#ifndef CANISOTP_MAX_WAIT_FRAMES
+#define CANISOTP_MAX_WAIT_FRAMES        10      // N_WFTmax: max. Number of Flow-Control-Frames with Wait in a Row
+#endif
+
+// Protocol Control Information (high Nibble of the first Byte)
+#define CANISOTP_PCI_SINGLE             0x00
+#define CANISOTP_PCI_FIRST              0x10
+#define CANISOTP_PCI_CONSECUTIVE        0x20
+#define CANISOTP_PCI_FLOW_CONTROL       0x30
+
+// Flow-Status of a Flow-Control-Frame
+#define CANISOTP_FLOW_CONTINUE          0x00
+#define CANISOTP_FLOW_WAIT              0x01
+#define CANISOTP_FLOW_OVERFLOW          0x02
+
+// State of a Transmission or Reception
+#define CANISOTP_IDLE                   0       // Nothing to do (Reception: no Buffer given)
+#define CANISOTP_BUSY                   1       // In Progress (Reception: waiting for or receiving a Transfer)
+#define CANISOTP_DONE                   2       // Finished
+#define CANISOTP_FAILED                 3       // Aborted (Check getLastCanError() for further Information)
+
+
+/**
+ * @brief ISO-TP-Channel with a Transmission-Message (own ID) and a Reception-Message (ID of the Peer).
+ *
+ * Both Messages need a DLC of 8. The Transmission-Message must be registered at a CANBus, so the Consecutive-Frames
+ * are pipelined through the Transmit-Queue and all free Transmit-Buffers and keep their Order.
+ * A Receive-FIFO at the Reception-Message keeps Consecutive-Frames they arrive faster than service() is called.
+ * Received Data is written directly into the Buffer of the Caller, sent Data is read from the Buffer of the Caller (no Copy, no Heap).
+ */
+class CANIsoTp
+{
+	private:
+        CANMessage *_Tx;
+        CANMessage *_Rx;
+        uint8_t _BlockSize;                 // Block-Size and STmin of the own Flow-Control-Frames
+        uint8_t _STmin;
+        uint32_t _Now;                      // Time of the last service()
+
+        const uint8_t *_TxData;
+        uint16_t _TxLength;
+        uint16_t _TxOffset;
+        uint8_t _TxState;
+        uint8_t _TxSequence;
+        uint8_t _TxBlockLeft;               // Consecutive-Frames until the next Flow-Control (0 = unlimited)
+        uint8_t _TxSeparation;              // STmin of the Peer in ms
+        uint8_t _TxWaits;
+        bool _TxWaitFlow;
+        bool _TxTimerStarted;
+        uint32_t _TxTimer;                  // Start of the Wait for the Flow-Control or Time of the last Consecutive-Frame
+
+        uint8_t *_RxBuffer;
+        uint16_t _RxSize;
+        uint16_t _RxLength;
+        uint16_t _RxOffset;
+        uint8_t _RxState;
+        uint8_t _RxSequence;
+        uint8_t _RxBlockLeft;
+        uint8_t _RxBlockSize;               // Block-Size and STmin of the current Reception (latched at the First-Frame)
+        uint8_t _RxSTmin;
+        uint8_t _RxFlowPending;             // Flow-Status of a Flow-Control-Frame they could not be sent yet (0xFF = none)
+        uint32_t _RxTimer;
+
+        uint16_t _lastCanError;
+
+        bool _sendFrame(const uint8_t *Data);
+        bool _sendFlowControl(uint8_t status);
+        void _handleFrame(const uint8_t *Data);
+        void _handleFlowControl(const uint8_t *Data);
+        void _sendConsecutiveFrames();
+        void _failTransmission(uint16_t error);
+        void _failReception(uint16_t error);
+        static uint8_t _decodeSTmin(uint8_t value);
+
+	public:
+
+        CANIsoTp();
+
+        uint16_t getLastCanError();
+
+        bool init(CANMessage &tx, CANMessage &rx, uint8_t blockSize = 0, uint8_t stMin = 0);
+        void setFlowControl(uint8_t blockSize, uint8_t stMin);
+
+        bool send(const uint8_t *data, uint16_t length);
+        bool receive(uint8_t *buffer, uint16_t size);
+        void service();
+        void service(uint32_t now);
+
+        uint8_t getTransmitState();
+        uint8_t getReceiveState();
+        uint16_t getReceivedLength();
+
+};
+
+#endif
@@ -0,0 +1,899 @@
+#include <string.h>
+#include "CANJ1939.h"
+
+#define CANJ1939_NONE                   0xFF    // Empty Slot of the PGN-Table
+#define CANJ1939_BUILD_TRIES            256     // Multipliers tried for a collision-free PGN-Table
+
+// State of a Session
+#define CANJ1939_SESSION_FREE           0
+#define CANJ1939_SESSION_BAM            1       // Broadcast Announce Message
+#define CANJ1939_SESSION_CMDT           2       // Connection Mode Data Transfer (RTS/CTS)
+#define CANJ1939_SESSION_EOMA           3       // Complete RTS/CTS-Session, End-of-Message-Acknowledgment not queued yet
+
+// State of the Address-Claim
+#define CANJ1939_CLAIM_NONE             0       // Address used without Claim
+#define CANJ1939_CLAIM_PENDING          1
+#define CANJ1939_CLAIM_DONE             2
+#define CANJ1939_CLAIM_LOST             3
+
+static_assert(CANJ1939_MAX_PGNS > 0 && CANJ1939_MAX_PGNS < CANJ1939_NONE, "CANJ1939_MAX_PGNS must be 1 - 254");
+static_assert(CANJ1939_TABLE_SIZE >= CANJ1939_MAX_PGNS && CANJ1939_TABLE_SIZE <= 256 && (CANJ1939_TABLE_SIZE & (CANJ1939_TABLE_SIZE - 1)) == 0,
+    "CANJ1939_TABLE_SIZE must be a power of 2 between CANJ1939_MAX_PGNS and 256");
+
+
+/**
+ * @brief Constructor
+ */
+CANJ1939::CANJ1939()
+{
+    _Bus = NULL;
+    _RouteCount = 0;
+    _Multiplier = 0x9E3779B1;
+    _SessionCount = 0;
+    _Name = 0;
+    _Preferred = CANJ1939_ADDRESS_NULL;
+    _Address = CANJ1939_ADDRESS_NULL;
+    _ClaimState = CANJ1939_CLAIM_NONE;
+    _ClaimTimerStarted = false;
+    _ClaimTimer = 0;
+    _Now = 0;
+    _Frames = 0;
+    _Transfers = 0;
+    _Aborts = 0;
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    memset(_Table, CANJ1939_NONE, sizeof(_Table));
+}
+
+/**
+ * @brief Returns the last occurred Error.
+ * @return Error-Code (see CANMessageError.h)
+ */
+uint16_t CANJ1939::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Links the Node with a Bus, afterwards dispatch() passes the Extended Frames without a registered Message to it.
+ *
+ * The Address is used at once, claimAddress() claims it on the Bus.
+ * @param bus Initialised Bus
+ * @param address Own Address (0 - 253)
+ * @param name 64-bit NAME of the Node, the lower NAME wins an Address-Contention
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANJ1939::init(CANBus &bus, uint8_t address, uint64_t name)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (address >= CANJ1939_ADDRESS_NULL)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    _Name = name;
+    _Preferred = address;
+    _Address = address;
+    _ClaimState = CANJ1939_CLAIM_NONE;
+
+    _Bus = &bus;
+    _Bus->attachJ1939(this);
+
+    return true;
+}
+
+/**
+ * @brief Sets the Handler of a PGN, it is called for the PGN from any Source-Address (single Frames and Transfers).
+ *
+ * Calling it again for the same PGN changes the Handler. Each new PGN rebuilds the PGN-Table with a collision-free
+ * Multiplier, so the Lookup in push() stays constant-time.
+ * @param pgn Parameter Group Number (PDU1: low Byte 0)
+ * @param handler Handler, called by service() with the Header and the Data
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANJ1939::onPgn(uint32_t pgn, CANJ1939Handler handler)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (handler == NULL || pgn > 0x3FFFF || (((pgn >> 8) & 0xFF) < 240 && (pgn & 0xFF) != 0))
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    int16_t Index = _lookup(pgn);
+
+    if (Index >= 0)
+    {
+        CANMESSAGE_LOCK();
+        _Routes[Index].Handler = handler;
+        CANMESSAGE_UNLOCK();
+        return true;
+    }
+
+    if (_RouteCount >= CANJ1939_MAX_PGNS)
+    {
+        _lastCanError = ERROR_CAN_J1939_TABLE_FULL;
+        return false;
+    }
+
+    // The new Route is not referenced by the Table until _build() succeeds
+    _Routes[_RouteCount].PGN = pgn;
+    _Routes[_RouteCount].Handler = handler;
+
+    if (!_build(_RouteCount + 1))
+    {
+        _lastCanError = ERROR_CAN_J1939_TABLE_FULL;
+        return false;
+    }
+
+    _RouteCount++;
+
+    return true;
+}
+
+/**
+ * @brief Adds a Buffer for the Reception of a Multi-Packet-Transfer (one Session per Buffer).
+ *
+ * A Transfer gets the first free Session with a Buffer large enough, the Buffer is passed to the Handler of the PGN.
+ * @param buffer Buffer of the Caller, it must stay valid
+ * @param size Size of the Buffer (9 - CANJ1939_MAX_LENGTH Bytes are used)
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANJ1939::addSession(uint8_t *buffer, uint16_t size)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (buffer == NULL || size < 9)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    if (_SessionCount >= CANJ1939_MAX_SESSIONS)
+    {
+        _lastCanError = ERROR_CAN_J1939_SESSIONS_FULL;
+        return false;
+    }
+
+    Session &Entry = _Sessions[_SessionCount];
+
+    Entry.Buffer = buffer;
+    Entry.Size = size;
+    Entry.State = CANJ1939_SESSION_FREE;
+    _SessionCount++;
+
+    return true;
+}
+
+/**
+ * @brief Adds the Frames for this Node to the Filter-Plan of the Bus (called by applyFilters()).
+ *
+ * Each PGN with a Handler and the PGNs of the Transport-Protocol and the Network-Management are planned from any
+ * Priority and Source-Address: PDU1 to the own (preferred) and the Global Address, PDU2 with its Group-Extension.
+ * @param planner Planner of the Bus
+ * @return true when success, false when the PGNs do not fit into the Planner
+ */
+bool CANJ1939::addFilterIds(CANFilterPlanner &planner)
+{
+    static const uint32_t Network[] = { CANJ1939_PGN_REQUEST, CANJ1939_PGN_TP_DT, CANJ1939_PGN_TP_CM, CANJ1939_PGN_ADDRESS_CLAIMED };
+    const uint8_t NetworkCount = sizeof(Network) / sizeof(Network[0]);
+
+    for (uint8_t i = 0; i < NetworkCount + _RouteCount; i++)
+    {
+        uint32_t Pgn = i < NetworkCount ? Network[i] : _Routes[i - NetworkCount].PGN;
+
+        if (((Pgn >> 8) & 0xFF) >= 240)
+        {
+            if (!planner.addMask((Pgn & 0x3FFFF) << 8, CANJ1939_FILTER_MASK, CANMESSAGE_FRAME_EXTENDED))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if (!planner.addMask(((Pgn & 0x3FF00) | CANJ1939_ADDRESS_GLOBAL) << 8, CANJ1939_FILTER_MASK, CANMESSAGE_FRAME_EXTENDED)
+            || (_Preferred != CANJ1939_ADDRESS_NULL
+                && !planner.addMask(((Pgn & 0x3FF00) | _Preferred) << 8, CANJ1939_FILTER_MASK, CANMESSAGE_FRAME_EXTENDED)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Top-Half: Queues a received Extended Frame when it is for this Node.
+ *
+ * Called by dispatch() of the Bus, costs the Decoding of the ID, one Multiplication and one Compare (PGN-Table)
+ * and a Copy of the Frame. PDU1-Frames are only taken for the own Address or Global.
+ * @param frame Received Frame
+ * @return true when the Frame is taken (also when it is dropped because the Queue is full), false when it is not
+ */
+bool CANJ1939::push(const CANFrame &frame)
+{
+    if (frame.Frame != CANMESSAGE_FRAME_EXTENDED || frame.RTR)
+    {
+        return false;
+    }
+
+    CANJ1939Header Header;
+
+    canJ1939Decode(frame.ID, Header);
+
+    if (Header.Destination != CANJ1939_ADDRESS_GLOBAL && Header.Destination != _Address)
+    {
+        return false;
+    }
+
+    if (Header.PGN != CANJ1939_PGN_TP_CM && Header.PGN != CANJ1939_PGN_TP_DT && Header.PGN != CANJ1939_PGN_ADDRESS_CLAIMED
+        && Header.PGN != CANJ1939_PGN_REQUEST && _lookup(Header.PGN) < 0)
+    {
+        return false;
+    }
+
+    _Queue.push(frame);
+
+    return true;
+}
+
+/**
+ * @brief Bottom-Half: Calls the Handlers of the queued Frames, reassembles the Transfers and checks the Timeouts.
+ *
+ * Call it in the loop() as often as possible. When the Transmit-Interrupts of the Bus are not used, call Bus.service() as well.
+ */
+void CANJ1939::service()
+{
+    service((uint32_t) millis());
+}
+
+/**
+ * @brief Bottom-Half: Calls the Handlers of the queued Frames, reassembles the Transfers and checks the Timeouts.
+ * @param now Current Time in ms
+ */
+void CANJ1939::service(uint32_t now)
+{
+    if (_Bus == NULL)
+    {
+        return;
+    }
+
+    _Now = now;
+
+    CANFrame Frame;
+
+    while (_Queue.pop(Frame))
+    {
+        _handleFrame(Frame);
+    }
+
+    for (uint8_t i = 0; i < _SessionCount; i++)
+    {
+        Session &Entry = _Sessions[i];
+
+        if (Entry.State == CANJ1939_SESSION_EOMA)
+        {
+            // The Handler has got the Transfer already, the Sender only waits for the Acknowledgment
+            if (_sendAcknowledgment(Entry) || now - Entry.Timer > CANJ1939_TIMEOUT)
+            {
+                Entry.State = CANJ1939_SESSION_FREE;
+            }
+            continue;
+        }
+
+        if (Entry.State == CANJ1939_SESSION_CMDT && Entry.Pending)
+        {
+            _sendClearToSend(Entry);
+        }
+
+        if (Entry.State != CANJ1939_SESSION_FREE && now - Entry.Timer > (Entry.Waiting ? CANJ1939_TIMEOUT_CTS : CANJ1939_TIMEOUT))
+        {
+            _abortSession(Entry, CANJ1939_ABORT_TIMEOUT);
+        }
+    }
+
+    if (_ClaimState == CANJ1939_CLAIM_PENDING)
+    {
+        if (!_ClaimTimerStarted)
+        {
+            _ClaimTimer = now;
+            _ClaimTimerStarted = true;
+        } else if (now - _ClaimTimer >= CANJ1939_CLAIM_TIME) {
+            _ClaimState = CANJ1939_CLAIM_DONE;
+        }
+    }
+}
+
+/**
+ * @brief Sends a single Frame of a PGN from the own Address.
+ * @param pgn Parameter Group Number (PDU1: low Byte 0)
+ * @param data Data
+ * @param length Bytes of Data (0 - 8)
+ * @param destination Destination-Address (PDU1 only, CANJ1939_ADDRESS_GLOBAL = all)
+ * @param priority Priority (0 = highest - 7)
+ * @return true when the Frame is queued, false when not (Check getLastCanError() for further Information)
+ */
+bool CANJ1939::send(uint32_t pgn, const uint8_t *data, uint8_t length, uint8_t destination, uint8_t priority)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_Bus == NULL)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (length > 8 || (length > 0 && data == NULL) || priority > 7 || pgn > 0x3FFFF || (((pgn >> 8) & 0xFF) < 240 && (pgn & 0xFF) != 0))
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    if (_ClaimState == CANJ1939_CLAIM_LOST)
+    {
+        _lastCanError = ERROR_CAN_J1939_ADDRESS_LOST;
+        return false;
+    }
+
+    return _sendFrame(pgn, _Address, destination, priority, data, length);
+}
+
+/**
+ * @brief Claims the Address given to init(): sends the Address-Claimed-Frame with the NAME.
+ *
+ * The Address is claimed when no Node with a lower NAME claims it within CANJ1939_CLAIM_TIME (checked by service()).
+ * A Node with a lower NAME wins, this Node answers with Cannot-Claim and loses its Address.
+ * @return true when the Frame is queued, false when not (Check getLastCanError() for further Information)
+ */
+bool CANJ1939::claimAddress()
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_Bus == NULL)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    _Address = _Preferred;
+    _ClaimState = CANJ1939_CLAIM_PENDING;
+    _ClaimTimerStarted = false;
+
+    return _sendClaim();
+}
+
+/**
+ * @brief Own Address, CANJ1939_ADDRESS_NULL when it is lost.
+ * @return uint8_t Address
+ */
+uint8_t CANJ1939::getAddress()
+{
+    return _Address;
+}
+
+/**
+ * @brief The Address is claimed (claimAddress() without Contention for CANJ1939_CLAIM_TIME).
+ * @return true when claimed, false when not (yet)
+ */
+bool CANJ1939::isAddressClaimed()
+{
+    return _ClaimState == CANJ1939_CLAIM_DONE;
+}
+
+/**
+ * @brief Frames processed by service() since the Start or resetStatistics().
+ * @return uint32_t Count
+ */
+uint32_t CANJ1939::getFrames()
+{
+    return _Frames;
+}
+
+/**
+ * @brief Completed Multi-Packet-Transfers.
+ * @return uint32_t Count
+ */
+uint32_t CANJ1939::getTransfers()
+{
+    return _Transfers;
+}
+
+/**
+ * @brief Aborted or rejected Multi-Packet-Transfers (Timeout, Sequence, no free Session, Abort of the Sender).
+ * @return uint32_t Count
+ */
+uint32_t CANJ1939::getAborts()
+{
+    return _Aborts;
+}
+
+/**
+ * @brief Frames lost because the Queue was full (since the Start, saturates at 0xFFFF).
+ * @return uint16_t Count
+ */
+uint16_t CANJ1939::getOverruns()
+{
+    return _Queue.getOverruns();
+}
+
+/**
+ * @brief Resets the Counters of Frames, Transfers and Aborts.
+ */
+void CANJ1939::resetStatistics()
+{
+    _Frames = 0;
+    _Transfers = 0;
+    _Aborts = 0;
+}
+
+/**
+ * @brief Finds the Route of a PGN: one Multiplication and one Compare.
+ * @param pgn Parameter Group Number
+ * @return int16_t Index of the Route, -1 when the PGN has no Handler
+ */
+int16_t CANJ1939::_lookup(uint32_t pgn)
+{
+    uint8_t Index = _Table[_slot(pgn, _Multiplier)];
+
+    if (Index != CANJ1939_NONE && _Routes[Index].PGN == pgn)
+    {
+        return Index;
+    }
+    return -1;
+}
+
+/**
+ * @brief Slot of a PGN in the PGN-Table (multiplicative Hash).
+ */
+uint8_t CANJ1939::_slot(uint32_t pgn, uint32_t multiplier)
+{
+    return (uint8_t) (((pgn * multiplier) >> 16) & (CANJ1939_TABLE_SIZE - 1));
+}
+
+/**
+ * @brief Searches a Multiplier they maps the first count Routes to different Slots and takes over its Table.
+ * @param count Number of Routes
+ * @return true when success, false when no collision-free Multiplier was found
+ */
+bool CANJ1939::_build(uint8_t count)
+{
+    uint32_t Multiplier = _Multiplier;
+    uint8_t Table[CANJ1939_TABLE_SIZE];
+
+    for (uint16_t Try = 0; Try < CANJ1939_BUILD_TRIES; Try++)
+    {
+        bool Free = true;
+
+        memset(Table, CANJ1939_NONE, sizeof(Table));
+
+        for (uint8_t i = 0; i < count && Free; i++)
+        {
+            uint8_t Slot = _slot(_Routes[i].PGN, Multiplier);
+
+            if (Table[Slot] != CANJ1939_NONE)
+            {
+                Free = false;
+            }
+            Table[Slot] = i;
+        }
+
+        if (Free)
+        {
+            // push() reads Table and Multiplier in the Interrupt-Routine
+            CANMESSAGE_LOCK();
+            memcpy(_Table, Table, sizeof(Table));
+            _Multiplier = Multiplier;
+            CANMESSAGE_UNLOCK();
+            return true;
+        }
+
+        // Next odd Multiplier (Linear Congruential Generator)
+        Multiplier = (Multiplier * 1664525 + 1013904223) | 1;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Processes a queued Frame.
+ * @param frame Received Frame
+ */
+void CANJ1939::_handleFrame(const CANFrame &frame)
+{
+    CANJ1939Header Header;
+
+    canJ1939Decode(frame.ID, Header);
+    _Frames++;
+
+    switch (Header.PGN)
+    {
+        case CANJ1939_PGN_TP_CM:
+            if (frame.DLC == 8)
+            {
+                _handleConnection(Header, frame.Data);
+            }
+            return;
+
+        case CANJ1939_PGN_TP_DT:
+            if (frame.DLC == 8)
+            {
+                _handleTransfer(Header, frame.Data);
+            }
+            return;
+
+        case CANJ1939_PGN_ADDRESS_CLAIMED:
+            if (frame.DLC == 8)
+            {
+                _handleClaim(Header, frame.Data);
+            }
+            break;
+
+        case CANJ1939_PGN_REQUEST:
+            if (frame.DLC >= 3 && _ClaimState != CANJ1939_CLAIM_NONE
+                && (frame.Data[0] | ((uint32_t) frame.Data[1] << 8) | ((uint32_t) frame.Data[2] << 16)) == CANJ1939_PGN_ADDRESS_CLAIMED)
+            {
+                _sendClaim();
+            }
+            break;
+    }
+
+    _deliver(Header, frame.Data, frame.DLC);
+}
+
+/**
+ * @brief Processes a TP.CM-Frame: starts a BAM- or RTS/CTS-Session or aborts one.
+ * @param header Header of the Frame
+ * @param data Data of the Frame
+ */
+void CANJ1939::_handleConnection(const CANJ1939Header &header, const uint8_t *data)
+{
+    uint32_t PGN = data[5] | ((uint32_t) data[6] << 8) | ((uint32_t) (data[7] & 0x03) << 16);
+    uint8_t Control = data[0];
+
+    if (Control == CANJ1939_TP_ABORT)
+    {
+        Session *Entry = _findSession(header.Source, CANJ1939_SESSION_CMDT);
+
+        if (Entry != NULL && Entry->PGN == PGN && header.Destination == _Address)
+        {
+            Entry->State = CANJ1939_SESSION_FREE;
+            _Aborts++;
+            _lastCanError = ERROR_CAN_J1939_TRANSFER_ABORTED;
+        }
+        return;
+    }
+
+    if (Control != CANJ1939_TP_BAM && Control != CANJ1939_TP_RTS)
+    {
+        return;
+    }
+
+    uint8_t State = Control == CANJ1939_TP_BAM ? CANJ1939_SESSION_BAM : CANJ1939_SESSION_CMDT;
+    bool Directed = State == CANJ1939_SESSION_CMDT;
+    uint16_t Length = data[1] | ((uint16_t) data[2] << 8);
+    uint8_t Packets = data[3];
+
+    // A BAM is Global, an RTS is for the own Address; Transfers of PGNs without Handler are not received
+    if ((header.Destination == CANJ1939_ADDRESS_GLOBAL) == Directed || _lookup(PGN) < 0)
+    {
+        return;
+    }
+
+    if (Length < 9 || Length > CANJ1939_MAX_LENGTH || Packets != (Length + 6) / 7)
+    {
+        return;
+    }
+
+    // A new Announcement of the same Sender replaces its running Transfer
+    Session *Entry = _findSession(header.Source, State);
+    bool Busy = true;
+
+    if (Entry != NULL)
+    {
+        Entry->State = CANJ1939_SESSION_FREE;
+        _Aborts++;
+    }
+
+    Entry = NULL;
+
+    for (uint8_t i = 0; i < _SessionCount && Entry == NULL; i++)
+    {
+        if (_Sessions[i].State == CANJ1939_SESSION_FREE)
+        {
+            Busy = false;
+
+            if (_Sessions[i].Size >= Length)
+            {
+                Entry = &_Sessions[i];
+            }
+        }
+    }
+
+    if (Entry == NULL)
+    {
+        _Aborts++;
+        _lastCanError = Busy ? ERROR_CAN_J1939_SESSIONS_FULL : ERROR_CAN_J1939_TRANSFER_ABORTED;
+
+        if (Directed)
+        {
+            _sendAbort(header.Source, PGN, Busy ? CANJ1939_ABORT_BUSY : CANJ1939_ABORT_RESOURCES);
+        }
+        return;
+    }
+
+    Entry->State = State;
+    Entry->Source = header.Source;
+    Entry->Priority = header.Priority;
+    Entry->PGN = PGN;
+    Entry->Length = Length;
+    Entry->Packets = Packets;
+    Entry->Sequence = 1;
+    Entry->WindowEnd = Packets;
+    Entry->MaxWindow = data[4] != 0 ? data[4] : 0xFF;
+    Entry->Waiting = false;
+    Entry->Pending = false;
+    Entry->Timer = _Now;
+
+    if (Directed)
+    {
+        _sendClearToSend(*Entry);
+    }
+}
+
+/**
+ * @brief Processes a TP.DT-Frame: copies its 7 Bytes into the Buffer of the Session.
+ * @param header Header of the Frame
+ * @param data Data of the Frame
+ */
+void CANJ1939::_handleTransfer(const CANJ1939Header &header, const uint8_t *data)
+{
+    Session *Entry = _findSession(header.Source, header.Destination == CANJ1939_ADDRESS_GLOBAL ? CANJ1939_SESSION_BAM : CANJ1939_SESSION_CMDT);
+
+    if (Entry == NULL)
+    {
+        return;
+    }
+
+    if (data[0] != Entry->Sequence || Entry->Sequence > Entry->WindowEnd)
+    {
+        _abortSession(*Entry, CANJ1939_ABORT_SEQUENCE);
+        return;
+    }
+
+    uint16_t Offset = (uint16_t) (Entry->Sequence - 1) * 7;
+    uint16_t Count = Entry->Length - Offset < 7 ? Entry->Length - Offset : 7;
+
+    memcpy(Entry->Buffer + Offset, data + 1, Count);
+
+    Entry->Timer = _Now;
+    Entry->Waiting = false;
+
+    if (Entry->Sequence == Entry->Packets)
+    {
+        _completeSession(*Entry);
+        return;
+    }
+
+    Entry->Sequence++;
+
+    if (Entry->State == CANJ1939_SESSION_CMDT && Entry->Sequence > Entry->WindowEnd)
+    {
+        _sendClearToSend(*Entry);
+    }
+}
+
+/**
+ * @brief Processes an Address-Claimed-Frame of another Node with the own Address: the lower NAME wins.
+ * @param header Header of the Frame
+ * @param data NAME of the other Node (little-endian)
+ */
+void CANJ1939::_handleClaim(const CANJ1939Header &header, const uint8_t *data)
+{
+    if (_ClaimState == CANJ1939_CLAIM_NONE || _ClaimState == CANJ1939_CLAIM_LOST || header.Source != _Address)
+    {
+        return;
+    }
+
+    uint64_t Name = 0;
+
+    for (uint8_t i = 8; i > 0; i--)
+    {
+        Name = (Name << 8) | data[i - 1];
+    }
+
+    if (Name < _Name)
+    {
+        // Cannot-Claim from the Null-Address
+        _Address = CANJ1939_ADDRESS_NULL;
+        _ClaimState = CANJ1939_CLAIM_LOST;
+        _lastCanError = ERROR_CAN_J1939_ADDRESS_LOST;
+        _sendClaim();
+    } else if (Name > _Name) {
+        _sendClaim();
+    }
+}
+
+/**
+ * @brief Calls the Handler of the PGN.
+ */
+void CANJ1939::_deliver(const CANJ1939Header &header, const uint8_t *data, uint16_t length)
+{
+    int16_t Index = _lookup(header.PGN);
+
+    if (Index >= 0)
+    {
+        _Routes[Index].Handler(header, data, length);
+    }
+}
+
+/**
+ * @brief Finds the running Session of a Sender.
+ * @param source Source-Address of the Sender
+ * @param state CANJ1939_SESSION_BAM or CANJ1939_SESSION_CMDT
+ * @return Session *, NULL when there is none
+ */
+CANJ1939::Session *CANJ1939::_findSession(uint8_t source, uint8_t state)
+{
+    for (uint8_t i = 0; i < _SessionCount; i++)
+    {
+        if (_Sessions[i].State == state && _Sessions[i].Source == source)
+        {
+            return &_Sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Requests the next Data-Transfer-Frames of an RTS/CTS-Session, not more than the Queue can take until the next service().
+ *
+ * When the Transmit-Queue of the Bus is full, the Clear-to-Send is pending and resent by service();
+ * the Timeout T2 runs from the last Data-Transfer-Frame then.
+ */
+void CANJ1939::_sendClearToSend(Session &session)
+{
+    uint8_t Count = session.Packets - session.Sequence + 1;
+    uint8_t Free = CANJ1939_QUEUE_SIZE - _Queue.available();
+
+    if (Count > session.MaxWindow)
+    {
+        Count = session.MaxWindow;
+    }
+
+    if (Count > CANJ1939_CTS_PACKETS)
+    {
+        Count = CANJ1939_CTS_PACKETS;
+    }
+
+    if (Count > Free)
+    {
+        Count = Free > 0 ? Free : 1;
+    }
+
+    uint8_t Data[8] = { CANJ1939_TP_CTS, Count, session.Sequence, 0xFF, 0xFF,
+        (uint8_t) session.PGN, (uint8_t) (session.PGN >> 8), (uint8_t) (session.PGN >> 16) };
+
+    session.WindowEnd = session.Sequence + Count - 1;
+    session.Waiting = true;
+    session.Pending = !_sendFrame(CANJ1939_PGN_TP_CM, _Address, session.Source, CANJ1939_PRIORITY_TP, Data, 8);
+
+    if (!session.Pending)
+    {
+        session.Timer = _Now;
+    }
+}
+
+/**
+ * @brief Sends the End-of-Message-Acknowledgment of a complete RTS/CTS-Session.
+ * @return true when the Frame is queued, false when not
+ */
+bool CANJ1939::_sendAcknowledgment(Session &session)
+{
+    uint8_t Data[8] = { CANJ1939_TP_EOMA, (uint8_t) session.Length, (uint8_t) (session.Length >> 8), session.Packets, 0xFF,
+        (uint8_t) session.PGN, (uint8_t) (session.PGN >> 8), (uint8_t) (session.PGN >> 16) };
+
+    return _sendFrame(CANJ1939_PGN_TP_CM, _Address, session.Source, CANJ1939_PRIORITY_TP, Data, 8);
+}
+
+/**
+ * @brief Sends a TP.CM Abort.
+ */
+void CANJ1939::_sendAbort(uint8_t destination, uint32_t pgn, uint8_t reason)
+{
+    uint8_t Data[8] = { CANJ1939_TP_ABORT, reason, 0xFF, 0xFF, 0xFF, (uint8_t) pgn, (uint8_t) (pgn >> 8), (uint8_t) (pgn >> 16) };
+
+    _sendFrame(CANJ1939_PGN_TP_CM, _Address, destination, CANJ1939_PRIORITY_TP, Data, 8);
+}
+
+/**
+ * @brief Ends a Session without Result, the Sender of an RTS/CTS-Session gets an Abort (a BAM is only dropped).
+ */
+void CANJ1939::_abortSession(Session &session, uint8_t reason)
+{
+    if (session.State == CANJ1939_SESSION_CMDT)
+    {
+        _sendAbort(session.Source, session.PGN, reason);
+    }
+
+    session.State = CANJ1939_SESSION_FREE;
+    _Aborts++;
+    _lastCanError = ERROR_CAN_J1939_TRANSFER_ABORTED;
+}
+
+/**
+ * @brief Ends a complete Session: acknowledges an RTS/CTS-Session and calls the Handler with the Buffer.
+ *
+ * When the Transmit-Queue of the Bus is full, the Session stays reserved until service() has queued the Acknowledgment.
+ */
+void CANJ1939::_completeSession(Session &session)
+{
+    CANJ1939Header Header;
+    bool Acknowledged = true;
+
+    Header.Priority = session.Priority;
+    Header.PGN = session.PGN;
+    Header.Source = session.Source;
+    Header.Destination = CANJ1939_ADDRESS_GLOBAL;
+
+    if (session.State == CANJ1939_SESSION_CMDT)
+    {
+        Header.Destination = _Address;
+        Acknowledged = _sendAcknowledgment(session);
+    }
+
+    _Transfers++;
+    _deliver(Header, session.Buffer, session.Length);
+
+    // Free after the Handler, so the Buffer is not overwritten by a new Transfer during it
+    session.State = Acknowledged ? CANJ1939_SESSION_FREE : CANJ1939_SESSION_EOMA;
+}
+
+/**
+ * @brief Sends the Address-Claimed-Frame with the NAME (Cannot-Claim when the Address is lost).
+ * @return true when the Frame is queued, false when not
+ */
+bool CANJ1939::_sendClaim()
+{
+    uint8_t Data[8];
+
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        Data[i] = (uint8_t) (_Name >> (8 * i));
+    }
+
+    return _sendFrame(CANJ1939_PGN_ADDRESS_CLAIMED, _Address, CANJ1939_ADDRESS_GLOBAL, CANJ1939_PRIORITY_DEFAULT, Data, 8);
+}
+
+/**
+ * @brief Queues a Frame at the Transmit-Queue of the Bus.
+ * @return true when the Frame is queued, false when not (Check getLastCanError() for further Information)
+ */
+bool CANJ1939::_sendFrame(uint32_t pgn, uint8_t source, uint8_t destination, uint8_t priority, const uint8_t *data, uint8_t length)
+{
+    CANJ1939Header Header;
+    CANFrame Frame;
+
+    Header.Priority = priority;
+    Header.PGN = pgn;
+    Header.Source = source;
+    Header.Destination = destination;
+
+    Frame.ID = canJ1939Encode(Header);
+    Frame.Frame = CANMESSAGE_FRAME_EXTENDED;
+    Frame.RTR = false;
+    Frame.DLC = length;
+
+    if (length > 0)
+    {
+        memcpy(Frame.Data, data, length);
+    }
+
+    if (!_Bus->enqueue(Frame))
+    {
+        _lastCanError = _Bus->getLastCanError();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,261 @@
+/**
+ * @file CANJ1939.h
+ * @author MH-Tobi
+ * @brief SAE J1939 on top of a CANBus: PGN-Dispatch for any Source-Address, Multi-Packet-Transfers (BAM and RTS/CTS) and Address-Claim.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANJ1939_H
+#define CANJ1939_H
+
+#include "CANPlatform.h"
+#include "CANFrame.h"
+#include "CANBus.h"
+#include "CANReceiveFifo.h"
+#include "CANMessageError.h"
+
+
+#ifndef CANJ1939_MAX_PGNS
+#define CANJ1939_MAX_PGNS               16      // Max. Number of PGNs with a Handler (up to 254)
+#endif
+
+#ifndef CANJ1939_TABLE_SIZE
+#define CANJ1939_TABLE_SIZE             64      // Slots of the PGN-Table (power of 2 up to 256, min. 4 * CANJ1939_MAX_PGNS recommended)
+#endif
+
+#ifndef CANJ1939_MAX_SESSIONS
+#define CANJ1939_MAX_SESSIONS           2       // Max. Number of Multi-Packet-Transfers received at the same Time
+#endif
+
+#ifndef CANJ1939_QUEUE_SIZE
+#define CANJ1939_QUEUE_SIZE             8       // Frames waiting for service() (power of 2, 2 - 128)
+#endif
+
+#ifndef CANJ1939_TIMEOUT
+#define CANJ1939_TIMEOUT                750     // T1: max. Time in ms between two Data-Transfer-Frames
+#endif
+
+#ifndef CANJ1939_TIMEOUT_CTS
+#define CANJ1939_TIMEOUT_CTS            1250    // T2: max. Time in ms from the own Clear-to-Send to the next Data-Transfer-Frame
+#endif
+
+#ifndef CANJ1939_CTS_PACKETS
+#define CANJ1939_CTS_PACKETS            8       // Max. Data-Transfer-Frames requested with one Clear-to-Send (max. CANJ1939_QUEUE_SIZE)
+#endif
+
+#define CANJ1939_CLAIM_TIME             250     // Time in ms without Contention until the Address is claimed
+#define CANJ1939_MAX_LENGTH             1785    // Max. Length of a Multi-Packet-Transfer (255 Packets * 7 Bytes)
+#define CANJ1939_FILTER_MASK            0x03FFFF00  // Bits of the ID compared for a PGN (Priority and Source-Address are free)
+
+// Addresses
+#define CANJ1939_ADDRESS_GLOBAL         0xFF
+#define CANJ1939_ADDRESS_NULL           0xFE    // Source-Address of Cannot-Claim
+
+// PGNs of the Network-Management and the Transport-Protocol
+#define CANJ1939_PGN_REQUEST            0xEA00
+#define CANJ1939_PGN_TP_DT              0xEB00
+#define CANJ1939_PGN_TP_CM              0xEC00
+#define CANJ1939_PGN_ADDRESS_CLAIMED    0xEE00
+
+// Control-Byte of a TP.CM-Frame
+#define CANJ1939_TP_RTS                 16
+#define CANJ1939_TP_CTS                 17
+#define CANJ1939_TP_EOMA                19
+#define CANJ1939_TP_BAM                 32
+#define CANJ1939_TP_ABORT               255
+
+// Abort-Reasons of a TP.CM Abort
+#define CANJ1939_ABORT_BUSY             1       // No free Session
+#define CANJ1939_ABORT_RESOURCES        2       // Transfer longer than the Buffer
+#define CANJ1939_ABORT_TIMEOUT          3
+#define CANJ1939_ABORT_SEQUENCE         7       // Bad Sequence-Number
+
+#define CANJ1939_PRIORITY_DEFAULT       6
+#define CANJ1939_PRIORITY_TP            7
+
+
+/**
+ * @brief Fields of a 29-bit J1939-ID.
+ *
+ * PDU1 (PDU-Format < 240): the PDU-Specific Byte is the Destination-Address, the low Byte of the PGN is 0.
+ * PDU2 (PDU-Format >= 240): the PDU-Specific Byte is the Group-Extension, the Destination is Global.
+ */
+struct CANJ1939Header
+{
+    uint8_t Priority;               // 0 (highest) - 7
+    uint32_t PGN;                   // Parameter Group Number (18 bit)
+    uint8_t Source;
+    uint8_t Destination;            // CANJ1939_ADDRESS_GLOBAL for PDU2 and Broadcasts
+};
+
+/**
+ * @brief Decodes a 29-bit ID.
+ * @param id Extended ID
+ * @param header Header to be filled
+ */
+inline void canJ1939Decode(uint32_t id, CANJ1939Header &header)
+{
+    uint8_t Format = (uint8_t) (id >> 16);
+    uint8_t Specific = (uint8_t) (id >> 8);
+
+    header.Priority = (uint8_t) ((id >> 26) & 0x07);
+    header.Source = (uint8_t) id;
+
+    if (Format < 240)
+    {
+        header.PGN = (id >> 8) & 0x3FF00;
+        header.Destination = Specific;
+    } else {
+        header.PGN = (id >> 8) & 0x3FFFF;
+        header.Destination = CANJ1939_ADDRESS_GLOBAL;
+    }
+}
+
+/**
+ * @brief Encodes a Header into a 29-bit ID (the Destination is only used for PDU1).
+ * @param header Header
+ * @return uint32_t Extended ID
+ */
+inline uint32_t canJ1939Encode(const CANJ1939Header &header)
+{
+    uint32_t Id = ((uint32_t) (header.Priority & 0x07) << 26) | ((header.PGN & 0x3FFFF) << 8) | header.Source;
+
+    if (((header.PGN >> 8) & 0xFF) < 240)
+    {
+        Id = (Id & ~((uint32_t) 0xFF00)) | ((uint32_t) header.Destination << 8);
+    }
+    return Id;
+}
+
+
+/**
+ * @brief Called by service() for a received Parameter Group.
+ * @param header Priority, PGN, Source and Destination
+ * @param data Data of the Frame resp. the Buffer of the Transfer (valid during the Handler only)
+ * @param length Bytes of Data
+ */
+typedef void (*CANJ1939Handler)(const CANJ1939Header &header, const uint8_t *data, uint16_t length);
+
+
+/**
+ * @brief J1939-Node at a CANBus.
+ *
+ * Receives the Extended Frames without a registered Message: dispatch() of the Bus passes them to push() (Top-Half),
+ * which decodes the ID and queues the Frames of the Transport-Protocol, the Network-Management and of the PGNs
+ * with a Handler, independent of their Source-Address. The PGNs are found in a perfect hashed Table: one Multiplication
+ * and one Compare per Frame, independent of the Number of PGNs.
+ * service() (Bottom-Half) in the loop() calls the Handlers and reassembles the Multi-Packet-Transfers (BAM and RTS/CTS)
+ * into the Buffers of the Caller (no Heap), up to CANJ1939_MAX_SESSIONS at the same Time.
+ */
+class CANJ1939
+{
+    static_assert(CANJ1939_CTS_PACKETS >= 1 && CANJ1939_CTS_PACKETS <= CANJ1939_QUEUE_SIZE, "CANJ1939_CTS_PACKETS must be between 1 and CANJ1939_QUEUE_SIZE");
+
+	private:
+        struct Route
+        {
+            uint32_t PGN;
+            CANJ1939Handler Handler;
+        };
+
+        struct Session
+        {
+            uint8_t *Buffer;                // Buffer of the Caller
+            uint16_t Size;
+            uint8_t State;
+            uint8_t Source;
+            uint8_t Priority;
+            uint32_t PGN;
+            uint16_t Length;
+            uint8_t Packets;
+            uint8_t Sequence;               // Next expected Sequence-Number
+            uint8_t WindowEnd;              // Last Sequence-Number of the current Clear-to-Send
+            uint8_t MaxWindow;              // Max. Packets per Clear-to-Send requested by the Sender
+            bool Waiting;                   // Waiting for the first Frame after the own Clear-to-Send (Timeout T2)
+            bool Pending;                   // Own Clear-to-Send not queued yet (Transmit-Queue full), resent by service()
+            uint32_t Timer;                 // Time of the last Frame resp. of the own Clear-to-Send
+        };
+
+        CANBus *_Bus;
+        Route _Routes[CANJ1939_MAX_PGNS];
+        uint8_t _RouteCount;
+        uint8_t _Table[CANJ1939_TABLE_SIZE];    // Index of the Route per Slot, CANJ1939_NONE = empty
+        uint32_t _Multiplier;                   // Multiplier of the perfect Hash
+        CANReceiveFifo<CANJ1939_QUEUE_SIZE> _Queue;
+        Session _Sessions[CANJ1939_MAX_SESSIONS];
+        uint8_t _SessionCount;
+        uint64_t _Name;
+        uint8_t _Preferred;                     // Address to be claimed
+        volatile uint8_t _Address;              // Own Address, CANJ1939_ADDRESS_NULL when it is lost
+        uint8_t _ClaimState;
+        bool _ClaimTimerStarted;
+        uint32_t _ClaimTimer;
+        uint32_t _Now;                          // Time of the last service()
+        uint32_t _Frames;
+        uint32_t _Transfers;
+        uint32_t _Aborts;
+        uint16_t _lastCanError;
+
+        int16_t _lookup(uint32_t pgn);
+        static uint8_t _slot(uint32_t pgn, uint32_t multiplier);
+        bool _build(uint8_t count);
+        void _handleFrame(const CANFrame &frame);
+        void _handleConnection(const CANJ1939Header &header, const uint8_t *data);
+        void _handleTransfer(const CANJ1939Header &header, const uint8_t *data);
+        void _handleClaim(const CANJ1939Header &header, const uint8_t *data);
+        void _deliver(const CANJ1939Header &header, const uint8_t *data, uint16_t length);
+        Session *_findSession(uint8_t source, uint8_t state);
+        void _sendClearToSend(Session &session);
+        bool _sendAcknowledgment(Session &session);
+        void _sendAbort(uint8_t destination, uint32_t pgn, uint8_t reason);
+        void _abortSession(Session &session, uint8_t reason);
+        void _completeSession(Session &session);
+        bool _sendClaim();
+        bool _sendFrame(uint32_t pgn, uint8_t source, uint8_t destination, uint8_t priority, const uint8_t *data, uint8_t length);
+
+	public:
+
+        CANJ1939();
+
+        uint16_t getLastCanError();
+
+        bool init(CANBus &bus, uint8_t address, uint64_t name);
+        bool onPgn(uint32_t pgn, CANJ1939Handler handler);
+        bool addSession(uint8_t *buffer, uint16_t size);
+
+        // For the Bus (called by applyFilters())
+
+        bool addFilterIds(CANFilterPlanner &planner);
+
+        // Top-Half (called by dispatch() of the Bus)
+
+        bool push(const CANFrame &frame);
+
+        // Bottom-Half (called in the loop())
+
+        void service();
+        void service(uint32_t now);
+
+        bool send(uint32_t pgn, const uint8_t *data, uint8_t length, uint8_t destination = CANJ1939_ADDRESS_GLOBAL, uint8_t priority = CANJ1939_PRIORITY_DEFAULT);
+
+        // Address-Claim
+
+        bool claimAddress();
+        uint8_t getAddress();
+        bool isAddressClaimed();
+
+        // Statistics
+
+        uint32_t getFrames();
+        uint32_t getTransfers();
+        uint32_t getAborts();
+        uint16_t getOverruns();
+        void resetStatistics();
+
+};
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @file CANMailbox.h
+ * @author MH-Tobi
+ * @brief Latest-Value-Mailbox for CAN-Messages with consistent (torn-free) Reads.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANMAILBOX_H
+#define CANMAILBOX_H
+
+#include <stdint.h>
+#include "CANFrame.h"
+#include "CANPlatform.h"
+
+
+/**
+ * @brief Double-buffered Mailbox, the Interrupt-Routine always overwrites the older Payload.
+ *
+ * The Writer fills the inactive Buffer and switches it active, the Sequence-Counter is odd while writing.
+ * The Reader copies the active Buffer and repeats when the Sequence-Counter changed in between,
+ * so the loop() always gets all Bytes of one Frame without disabling Interrupts.
+ */
+class CANMailbox
+{
+	private:
+        uint8_t _Data[2][8];                // Double-Buffer for the Payload
+        uint8_t _Length[2];                 // Number of valid Bytes of each Buffer
+        volatile uint8_t _Active;           // Index of the Buffer with the latest Payload
+        volatile uint8_t _Sequence;         // Incremented before and after each write (odd = write in progress)
+        volatile bool _Pending;             // Set by each write, cleared by read() (the 8-bit Sequence wraps after 128 writes)
+        uint8_t _ReadSequence;              // Sequence of the last read Payload (Reader only)
+
+	public:
+
+        CANMailbox() :
+            _Active(0),
+            _Sequence(0),
+            _Pending(false),
+            _ReadSequence(0)
+        {
+            _Length[0] = 0;
+            _Length[1] = 0;
+        }
+
+        /**
+         * @brief Overwrites the Mailbox with the Payload of a Frame (Writer-Side).
+         * @param frame Received Frame
+         * @param length Number of Bytes to be stored (max. 8)
+         */
+        void write(const CANFrame &frame, uint8_t length)
+        {
+            uint8_t Next = _Active ^ 1;
+
+            _Sequence = _Sequence + 1;
+            CANMESSAGE_MEMORY_BARRIER();
+
+            for (uint8_t i = 0; i < length; i++)
+            {
+                _Data[Next][i] = frame.Data[i];
+            }
+            _Length[Next] = length;
+
+            CANMESSAGE_MEMORY_BARRIER();
+            _Active = Next;
+            _Sequence = _Sequence + 1;
+            _Pending = true;
+        }
+
+        /**
+         * @brief Copies the latest Payload (Reader-Side).
+         * @param Data Destination for the Payload (at least 8 Bytes)
+         * @return True when the Payload was updated since the last read()
+         */
+        bool read(uint8_t *Data)
+        {
+            uint8_t Sequence;
+            uint8_t Length;
+
+            // Cleared before the Copy, so a write during it stays pending (at worst reported once more)
+            bool Pending = _Pending;
+            _Pending = false;
+
+            do
+            {
+                Sequence = _Sequence;
+                CANMESSAGE_MEMORY_BARRIER();
+
+                uint8_t Active = _Active;
+                Length = _Length[Active];
+
+                for (uint8_t i = 0; i < Length; i++)
+                {
+                    Data[i] = _Data[Active][i];
+                }
+
+                CANMESSAGE_MEMORY_BARRIER();
+            } while ((Sequence & 0x01) != 0 || Sequence != _Sequence);
+
+            bool Updated = Pending || Sequence != _ReadSequence;
+            _ReadSequence = Sequence;
+
+            return Updated;
+        }
+
+        /**
+         * @brief Checks if the Mailbox was updated since the last read().
+         * @return True when a new Payload is available
+         */
+        bool isUpdated()
+        {
+            return _Pending || _Sequence != _ReadSequence;
+        }
+
+};
+
+#endif
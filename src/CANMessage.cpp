@@ -1,25 +1,71 @@
 #include "CANMessage.h"
+#include "CANBus.h"
+#include "CANCapture.h"
 
 /**
  * @brief Constructor
+ * @param data Data-Buffer of the derived CANMessageT (capacity Data-Bytes followed by the Filled-Bits)
+ * @param capacity Size of the Data-Buffer
  */
-CANMessage::CANMessage() :
-    _ID(0),
+CANMessageBase::CANMessageBase(uint8_t *data, uint8_t capacity) :
+    _Descriptor(0),
+    _lastCanError(EMPTY_VALUE_16_BIT),
     _DLC(0),
-    _RTR(false),
-    _Frame(0),
-    _Direction(0),
-    _Controller(),
     _DataBufferIndex(-1),
-    _isInitialized(false),
-    _lastCanError(EMPTY_VALUE_16_BIT)
+    _Controller(NULL),
+    _Storage(NULL),
+    _DataByte(data),
+    _Capacity(capacity),
+    _Flags(0)
 {
+    _clearFilled();
+#if CANMESSAGE_STATISTICS
+    memset(&_Statistics, 0, sizeof(_Statistics));
+#endif
+}
+
+/**
+ * @brief Copy-Constructor, the Copy keeps its own Data-Buffer.
+ * @param other Message with the same Capacity
+ * @param data Data-Buffer of the derived CANMessageT
+ */
+CANMessageBase::CANMessageBase(const CANMessageBase &other, uint8_t *data) :
+    _DataByte(data),
+    _Capacity(other._Capacity)
+{
+    *this = other;
+}
+
+/**
+ * @brief Copies all Properties and the Data, the Data-Buffer is not shared.
+ *
+ * A FIFO, Mailbox or Change-Filter of the other Message is not taken over (it serves one Message only),
+ * the Copy keeps the Link with the CANBus and receives into its own Buffer.
+ * @param other Message with the same Capacity
+ */
+CANMessageBase &CANMessageBase::operator=(const CANMessageBase &other)
+{
+    if (this != &other)
+    {
+        _Descriptor = other._Descriptor;
+        _lastCanError = other._lastCanError;
+        _DataBufferIndex = other._DataBufferIndex;
+        _Controller = other._Controller;
+        _Storage = other._bus();
+        _DLC = (other._DLC & CANMESSAGE_DLC_MASK) | (_Storage != NULL ? CANMESSAGE_STORAGE_BUS : CANMESSAGE_STORAGE_BUFFER);
+        _Flags = other._Flags;
+        memcpy(_DataByte, other._DataByte, _Capacity + (_Capacity + 7) / 8);
+#if CANMESSAGE_STATISTICS
+        _Statistics = other._Statistics;
+#endif
+    }
+    return *this;
 }
 
 /**
  * @brief Deconstructor
  */
-CANMessage::~CANMessage()
+CANMessageBase::~CANMessageBase()
 {
 }
 
@@ -31,7 +77,7 @@ CANMessage::~CANMessage()
  *
  * 0x0000 = no Error
  */
-uint16_t CANMessage::getLastCanError()
+uint16_t CANMessageBase::getLastCanError()
 {
     return _lastCanError;
 }
@@ -39,28 +85,35 @@ uint16_t CANMessage::getLastCanError()
 /**
  * @brief Initialisation of a Message.
  * @param id Message ID (11-Bit for Standard-Frames, 29-Bit for Extended-Frames)
- * @param dlc Data-Length-Code (0 - 8 bytes)
- * @param rtr Remote-Transmission-Request (only allowed when Message-Direction is a transmit)
- * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @param dlc Datalength (0 - 8 bytes, CAN FD: 12, 16, 20, 24, 32, 48 or 64 bytes, max. the Capacity of the Message)
+ * @param rtr Remote-Transmission-Request (only allowed when Message-Direction is a transmit, not for CAN FD)
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame), for CAN FD combined with CANMESSAGE_FRAME_FD and optional CANMESSAGE_FRAME_BRS
  * @param direction Message-Direction (0 = Recieve; 1 = Transmit)
- * @param controller Object of a MCP2515 Instance
+ * @param controller Controller of the CANDriver, e.g. a MCP2515 Instance (shared by Reference, it has to exist as long as the Message)
  * @return True when initialisation is successfull, False when not.
  */
-bool CANMessage::init(uint32_t id, uint8_t dlc, bool rtr, uint8_t frame, uint8_t direction, MCP2515 controller){
+bool CANMessageBase::init(uint32_t id, uint8_t dlc, bool rtr, uint8_t frame, uint8_t direction, CANController &controller){
 
-    _isInitialized = true;
+    _Controller = NULL;
     _lastCanError = EMPTY_VALUE_16_BIT;
 
-    if (frame != CANMESSAGE_FRAME_STANDARD && frame != CANMESSAGE_FRAME_EXTENDED)
+    uint8_t Flags = frame & (CANMESSAGE_FRAME_FD | CANMESSAGE_FRAME_BRS);
+    frame &= ~(CANMESSAGE_FRAME_FD | CANMESSAGE_FRAME_BRS);
+
+    if ((frame != CANMESSAGE_FRAME_STANDARD && frame != CANMESSAGE_FRAME_EXTENDED) || Flags == CANMESSAGE_FRAME_BRS)
     {
-        _isInitialized = false;
         _lastCanError = ERROR_CAN_INIT_FRAME_NOT_PLAUSIBLE;
         return false;
     }
 
+    if (Flags != 0 && !CANDriver::SupportsFD)
+    {
+        _lastCanError = ERROR_CAN_INIT_FD_NOT_SUPPORTED;
+        return false;
+    }
+
     if (direction != CANMESSAGE_DIRECTION_RECEIVE && direction != CANMESSAGE_DIRECTION_TRANSMIT)
     {
-        _isInitialized = false;
         _lastCanError = ERROR_CAN_INIT_DIRECTION_NOT_PLAUSIBLE;
         return false;
     }
@@ -69,75 +122,122 @@ bool CANMessage::init(uint32_t id, uint8_t dlc, bool rtr, uint8_t frame, uint8_t
     {
         if (frame != CANMESSAGE_FRAME_EXTENDED && id > 0x7FF)
         {
-            _isInitialized = false;
             _lastCanError = ERROR_CAN_INIT_ID_NOT_PLAUSIBLE;
             return false;
         }
     } else {
-        _isInitialized = false;
         _lastCanError = ERROR_CAN_INIT_ID_OUTA_RANGE;
         return false;
     }
 
-    if (rtr && direction != CANMESSAGE_DIRECTION_TRANSMIT)
+    if (rtr && (direction != CANMESSAGE_DIRECTION_TRANSMIT || Flags != 0))
     {
-        _isInitialized = false;
         _lastCanError = ERROR_CAN_INIT_RTR_NOT_ALLOWED;
         return false;
     }
 
-    if (dlc > 8)
+    // CAN FD only knows the Lengths of its Data-Length-Codes
+    uint8_t Code = canLengthToDlc(dlc);
+
+    if ((Flags == 0 && dlc > 8) || dlc > _Capacity || canDlcToLength(Code) != dlc)
     {
-        _isInitialized = false;
         _lastCanError = ERROR_CAN_INIT_DLC_NOT_VALID;
         return false;
     }
 
-    _ID = id;
-    _DLC = dlc;
-    _RTR = rtr;
-    _Frame = frame;
-    _Direction = direction;
-    _Controller = controller;
+    _Descriptor = makeKey(id, frame);
+
+    if (rtr)
+    {
+        _Descriptor |= CANMESSAGE_DESCRIPTOR_RTR;
+    }
+
+    if (direction == CANMESSAGE_DIRECTION_TRANSMIT)
+    {
+        _Descriptor |= CANMESSAGE_DESCRIPTOR_TRANSMIT;
+    }
+
+    _DLC = Code;
+    _Flags = Flags;
+    _Controller = &controller;
+    _DataBufferIndex = -1;
+    _clearFilled();
+    _Storage = NULL;
     return true;
 }
 
 /**
  * @brief Add Data to the defined DataBuffer.
  * @param Data Data to be filled in the Buffer
- * @param BufferNumber Number of the Buffer (0 - 7)
+ * @param BufferNumber Number of the Buffer (0 - Datalength-1)
  * @return true when success, false on any error (Check _lastCanError)
  */
-bool CANMessage::addDataByte(uint8_t Data, uint8_t BufferNumber)
+bool CANMessageBase::addDataByte(uint8_t Data, uint8_t BufferNumber)
 {
     _lastCanError = EMPTY_VALUE_16_BIT;
 
-    if (!_isInitialized)
+    if (!isInitialized())
     {
         _lastCanError = ERROR_CAN_NOT_INITIALIZED;
         return false;
     }
 
-    if (_Direction != CANMESSAGE_DIRECTION_TRANSMIT)
+    if (_direction() != CANMESSAGE_DIRECTION_TRANSMIT)
     {
         _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
         return false;
     }
 
-    if (BufferNumber > 7 || BufferNumber >= _DLC)
+    if (BufferNumber >= _length())
     {
         _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
         return false;
     }
 
-    if (_BufferFilled[BufferNumber] == true)
+    if (_filled()[BufferNumber >> 3] & (1 << (BufferNumber & 0x07)))
     {
         _lastCanError = ERROR_CAN_BUFFER_FILLED;
         return false;
     }
 
     _DataByte[BufferNumber] = Data;
-    _BufferFilled[BufferNumber] = true;
+    _markFilled(BufferNumber, 1);
+
+    return true;
+}
+
+/**
+ * @brief Copies the complete Payload to the DataBuffer and marks the Bytes as filled.
+ *
+ * Already filled Buffers are overwritten.
+ * @param Data Payload
+ * @param length Number of Bytes (max. DLC)
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANMessageBase::setPayload(const uint8_t *Data, uint8_t length)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!isInitialized())
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (_direction() != CANMESSAGE_DIRECTION_TRANSMIT)
+    {
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
+    }
+
+    if (length > _length())
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    memcpy(_DataByte, Data, length);
+    _markFilled(0, length);
 
     return true;
 }
@@ -146,92 +246,212 @@ bool CANMessage::addDataByte(uint8_t Data, uint8_t BufferNumber)
  * @brief Initiates the transmitting-Request.
  *
  * Fails when Message is not complete (all relevant Buffer are filled with data).
+ * When the Message is registered at a CANBus the Frame is added to its priority-ordered Transmit-Queue and the Method returns immediately.
+ * With an attached CANChangeFilter an unchanged Payload is not sent, the Method returns true anyway (the Suppression is counted by the Filter).
  * @return true when success, false on any error (Check _lastCanError)
  */
-bool CANMessage::send()
+bool CANMessageBase::send()
 {
     _lastCanError = EMPTY_VALUE_16_BIT;
 
-    if (!_isInitialized)
+    if (!isInitialized())
     {
         _lastCanError = ERROR_CAN_NOT_INITIALIZED;
         return false;
     }
 
-    if (_Direction != CANMESSAGE_DIRECTION_TRANSMIT)
+    if (_direction() != CANMESSAGE_DIRECTION_TRANSMIT)
     {
         _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
         return false;
     }
 
-    if (!_RTR)
+    if (!_rtr() && !messageSendReady())
+    {
+        _lastCanError = ERROR_CAN_MESSAGE_NOT_COMPLETE;
+        return false;
+    }
+
+    uint8_t Reason = CANCHANGEFILTER_FIRST;
+    uint32_t Now = 0;
+
+    if (_changeFilter() != NULL && !_rtr())
     {
-        for (size_t i = 0; i < _DLC; i++)
+        Now = (uint32_t) millis();
+        Reason = _changeFilter()->check(_DataByte, _length(), Now);
+
+        if (Reason == CANCHANGEFILTER_SUPPRESS)
         {
-            if (_BufferFilled[i] != true)
+            _clearFilled();
+            return true;
+        }
+    }
+
+    if (_bus() != NULL)
+    {
+        CANFrame Frame;
+
+        Frame.ID = _id();
+        Frame.Frame = _frame();
+        Frame.RTR = _rtr();
+        Frame.DLC = _dlc();
+
+        for (size_t i = 0; i < Frame.DLC; i++)
+        {
+            Frame.Data[i] = _DataByte[i];
+        }
+
+        if (!_bus()->enqueue(Frame))
+        {
+            _lastCanError = _bus()->getLastCanError();
+
+            if (_lastCanError == ERROR_CAN_BUS_TX_QUEUE_FULL)
             {
-                _lastCanError = ERROR_CAN_MESSAGE_NOT_COMPLETE;
-                return false;
+                CANSTATISTICS_COUNT(_Statistics.TxBufferFull);
             }
+            return false;
         }
+
+        _sent(Reason, Now);
+
+        return true;
     }
 
-    uint8_t Buffer = _Controller.check4FreeTransmitBuffer();
+    uint8_t Buffer = CANDriver::findFreeTransmitBuffer(*_Controller);
 
     if (Buffer >= 0xE0)
     {
         _lastCanError = ERROR_CAN_NO_FREE_TRANSMIT_BUFFER | Buffer;
+        CANSTATISTICS_COUNT(_Statistics.TxBufferFull);
         return false;
     }
 
-    if (!_Controller.fillTransmitBuffer(Buffer, _ID, _Frame, _RTR, _DLC, _DataByte))
+    if (!CANDriver::fillTransmitBuffer(*_Controller, Buffer, _id(), _frame() | _Flags, _rtr(), _dlc(), _DataByte))
     {
         _lastCanError = ERROR_CAN_FILLING_TRANSMIT_BUFFER;
+        CANSTATISTICS_COUNT(_Statistics.FillFailures);
+        return false;
+    }
+
+    if (!CANDriver::sendTransmitBuffer(*_Controller, Buffer, 0))
+    {
+        _lastCanError = CANDriver::getLastError(*_Controller) | ERROR_CAN_MESSAGE_NOT_SEND;
+        CANSTATISTICS_COUNT(_Statistics.SendErrors);
+        CANSTATISTICS_SET(_Statistics.LastControllerError, CANDriver::getLastError(*_Controller));
         return false;
     }
 
-    if (!_Controller.sendMessage(Buffer, 0))
+    CANCAPTURE_RECORD(_Descriptor, _dlc() | (_isClassic() ? 0 : CANCAPTURE_CONTROL_FD), _DataByte);
+    _sent(Reason, Now);
+
+    return true;
+}
+
+/**
+ * @brief Links the Transmit-Message with the Transmit-Queue of a CANBus.
+ *
+ * Called by CANBus::registerMessage(), afterwards send() only adds the Frame to the Queue of the Bus.
+ * @param bus CANBus the Message is registered at
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANMessageBase::attachBus(CANBus &bus)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!isInitialized())
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (_direction() != CANMESSAGE_DIRECTION_TRANSMIT || !_isClassic())
+    {
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
+    }
+
+    if (_changeFilter() != NULL)
+    {
+        _changeFilter()->setBus(&bus);
+        return true;
+    }
+
+    _Storage = &bus;
+    _DLC = (_DLC & CANMESSAGE_DLC_MASK) | CANMESSAGE_STORAGE_BUS;
+
+    return true;
+}
+
+/**
+ * @brief Attaches a Send-on-Change-Filter to the Transmit-Message.
+ *
+ * Afterwards send() only transmits when the Payload changed, a Signal left its Deadband or the Heartbeat elapsed.
+ * A Link with a CANBus is kept (the Filter holds it).
+ * @param filter Instance of a CANChangeFilter (one per Message)
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANMessageBase::attachChangeFilter(CANChangeFilter &filter)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!isInitialized())
     {
-        _lastCanError = _Controller.getLastMCPError() | ERROR_CAN_MESSAGE_NOT_SEND;
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
         return false;
     }
 
-    for (size_t i = 0; i < 8; i++)
+    if (_direction() != CANMESSAGE_DIRECTION_TRANSMIT || !_isClassic())
     {
-        _BufferFilled[i] = false;
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
     }
 
+    filter.setBus(_bus());
+    filter.reset();
+
+    _Storage = &filter;
+    _DLC = (_DLC & CANMESSAGE_DLC_MASK) | CANMESSAGE_STORAGE_CHANGE;
+
     return true;
 }
 
+/**
+ * @brief Returns the CANBus the Transmit-Message is linked with.
+ * @return Pointer to the Bus, NULL when send() uses a free Transmit-Buffer of the Controller directly
+ */
+CANBus *CANMessageBase::getBus()
+{
+    return _bus();
+}
+
 /**
  * @brief Release the defined Buffer.
- * @param BufferNumber Value 0 - 7
+ * @param BufferNumber Value 0 - Capacity-1
  * @return true when success, false on any error (Check _lastCanError)
  */
-bool CANMessage::releaseBuffer(uint8_t BufferNumber)
+bool CANMessageBase::releaseBuffer(uint8_t BufferNumber)
 {
     _lastCanError = EMPTY_VALUE_16_BIT;
 
-    if (!_isInitialized)
+    if (!isInitialized())
     {
         _lastCanError = ERROR_CAN_NOT_INITIALIZED;
         return false;
     }
 
-    if (_Direction != CANMESSAGE_DIRECTION_TRANSMIT)
+    if (_direction() != CANMESSAGE_DIRECTION_TRANSMIT)
     {
         _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
         return false;
     }
 
-    if (BufferNumber > 7)
+    if (BufferNumber >= _Capacity)
     {
         _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
         return false;
     }
 
-    _BufferFilled[BufferNumber] = false;
+    _filled()[BufferNumber >> 3] &= ~(1 << (BufferNumber & 0x07));
 
     return true;
 }
@@ -240,23 +460,30 @@ bool CANMessage::releaseBuffer(uint8_t BufferNumber)
  * @brief Check if a RemoteTransmissionRequest for the Message was received.
  * @return True if a RemoteTransmissionRequest for the Message was received, False when not (or on Error check _lastCanError).
  */
-bool CANMessage::checkForRTR()
+bool CANMessageBase::checkForRTR()
 {
     _lastCanError = EMPTY_VALUE_16_BIT;
 
-    if (!_isInitialized)
+    if (!isInitialized())
     {
         _lastCanError = ERROR_CAN_NOT_INITIALIZED;
         return false;
     }
 
-    if (_Direction != CANMESSAGE_DIRECTION_TRANSMIT)
+    if (_direction() != CANMESSAGE_DIRECTION_TRANSMIT)
     {
         _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
         return false;
     }
 
-    return _Controller.check4Rtr(_ID, _Frame);
+    if (!CANDriver::checkRtr(*_Controller, _id(), _frame()))
+    {
+        return false;
+    }
+
+    CANCAPTURE_RECORD((_Descriptor & CANMESSAGE_DESCRIPTOR_KEY_MASK) | CANMESSAGE_DESCRIPTOR_RTR, _dlc(), NULL);
+
+    return true;
 }
 
 /**
@@ -265,27 +492,131 @@ bool CANMessage::checkForRTR()
  * If this Message is received the Data is send to the local Buffer, so the Buffer of the CAN-Module can be released for the next incomming messages.
  * @return true when success, false on any error (Check _lastCanError)
  */
-bool CANMessage::checkReceive()
+bool CANMessageBase::checkReceive()
 {
-    if (_Direction != CANMESSAGE_DIRECTION_RECEIVE)
+    if (!isInitialized())
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE)
     {
         _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
         return false;
     }
 
+    if (_fifo() != NULL || _mailbox() != NULL)
+    {
+        CANFrame Frame;
+
+        if (!CANDriver::receive(*_Controller, _id(), _frame(), _dlc(), Frame.Data))
+        {
+            _lastCanError = CANDriver::getLastError(*_Controller) | ERROR_CAN_MESSAGE_NOT_RECEIVED;
+            return false;
+        }
+
+        Frame.ID = _id();
+        Frame.Frame = _frame();
+        Frame.RTR = false;
+        Frame.DLC = _dlc();
+
+        CANCAPTURE_RECORD(_Descriptor, Frame.DLC, Frame.Data);
+
+        return deliver(Frame);
+    }
+
     if (_DataBufferIndex != -1)
     {
         _lastCanError = ERROR_CAN_RECEIVED_DATA_IN_BUFFER;
+        CANSTATISTICS_COUNT(_Statistics.DataInBuffer);
         return false;
     }
 
-    if (!_Controller.check4Receive(_ID, _Frame, _DLC, _DataByte))
+    if (!CANDriver::receive(*_Controller, _id(), _frame() | (_Flags & CANMESSAGE_FRAME_FD), _dlc(), _DataByte))
     {
-        _lastCanError = _Controller.getLastMCPError() | ERROR_CAN_MESSAGE_NOT_RECEIVED;
+        _lastCanError = CANDriver::getLastError(*_Controller) | ERROR_CAN_MESSAGE_NOT_RECEIVED;
         return false;
     }
 
+    if (!_isClassic())
+    {
+        _Flags = CANMESSAGE_FRAME_FD | (CANDriver::getReceiveFlags(*_Controller) & (CANMESSAGE_FRAME_BRS | CANMESSAGE_FRAME_ESI));
+    }
+
+    CANCAPTURE_RECORD(_Descriptor, _dlc() | (_isClassic() ? 0 : CANCAPTURE_CONTROL_FD), _DataByte);
     _DataBufferIndex = 0;
+    CANSTATISTICS_COUNT(_Statistics.Received);
+
+    return true;
+}
+
+/**
+ * @brief Stores an already received Frame in the local Buffer.
+ *
+ * Used by the CANBus-Dispatcher, which reads each Receive-Buffer of the CAN-Module once and routes the Frame to the matching Message.
+ * A Frame with less Data-Bytes than the DLC is rejected, so no Bytes they were not received are delivered.
+ * @param frame Received Frame (ID and Frame are already matched by the caller)
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANMessageBase::deliver(const CANFrame &frame)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!isInitialized())
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE)
+    {
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
+    }
+
+    if (frame.DLC < _dlc())
+    {
+        _lastCanError = ERROR_CAN_RECEIVED_FRAME_TOO_SHORT;
+        CANSTATISTICS_COUNT(_Statistics.ShortFrames);
+        return false;
+    }
+
+    if (_mailbox() != NULL)
+    {
+        _mailbox()->write(frame, _dlc());
+        CANSTATISTICS_COUNT(_Statistics.Received);
+        return true;
+    }
+
+    if (_fifo() != NULL)
+    {
+        if (!_fifo()->push(frame))
+        {
+            _lastCanError = ERROR_CAN_RECEIVE_FIFO_FULL;
+            CANSTATISTICS_COUNT(_Statistics.Overruns);
+            return false;
+        }
+        CANSTATISTICS_COUNT(_Statistics.Received);
+        return true;
+    }
+
+    // The Caller has already read the Frame from the Controller, so it is lost
+    if (_DataBufferIndex != -1)
+    {
+        _lastCanError = ERROR_CAN_RECEIVED_DATA_IN_BUFFER;
+        CANSTATISTICS_COUNT(_Statistics.DataInBuffer);
+        CANSTATISTICS_COUNT(_Statistics.Overruns);
+        return false;
+    }
+
+    for (size_t i = 0; i < _dlc(); i++)
+    {
+        _DataByte[i] = frame.Data[i];
+    }
+
+    _DataBufferIndex = 0;
+    CANSTATISTICS_COUNT(_Statistics.Received);
 
     return true;
 }
@@ -296,23 +627,23 @@ bool CANMessage::checkReceive()
  * Check if Data is available with the dataAvailable()-Method.
  * @return The highest available DataByte.
  */
-uint8_t CANMessage::getDataByte()
+uint8_t CANMessageBase::getDataByte()
 {
     // Check if Message is a receiving Message.
-    if (_Direction != CANMESSAGE_DIRECTION_RECEIVE)
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE)
     {
         return 0;
     }
 
-    // Check if Message is checked
-    if (_DataBufferIndex == -1)
+    // Check if Message is checked (or take the next Frame from the FIFO or Mailbox)
+    if (_DataBufferIndex == -1 && !_fetchNext())
     {
         return 0;
     }
 
     uint8_t Data = _DataByte[_DataBufferIndex];
 
-    if (_DataBufferIndex == (_DLC - 1))
+    if (_DataBufferIndex == (_length() - 1))
     {
         _DataBufferIndex = -1;
     } else {
@@ -322,21 +653,234 @@ uint8_t CANMessage::getDataByte()
     return Data;
 }
 
+/**
+ * @brief Copies all Bytes of the received Data and releases them.
+ * @param Data Destination for the Payload (at least getLength() Bytes)
+ * @return True when Data was available, False when not.
+ */
+bool CANMessageBase::getPayload(uint8_t *Data)
+{
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE)
+    {
+        return false;
+    }
+
+    if (_DataBufferIndex == -1 && !_fetchNext())
+    {
+        return false;
+    }
+
+    memcpy(Data, _DataByte, _length());
+    _DataBufferIndex = -1;
+
+    return true;
+}
+
+/**
+ * @brief Releases the received Data, so the next Frame can be taken.
+ * @return True when Data was released, False when no Data was available.
+ */
+bool CANMessageBase::releaseData()
+{
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE || _DataBufferIndex == -1)
+    {
+        return false;
+    }
+
+    _DataBufferIndex = -1;
+
+    return true;
+}
+
 /**
  * @brief Checks if Data is available in the Buffer.
  * @return True when Data is available, False when no Data is available.
  */
-bool CANMessage::dataAvailable()
+bool CANMessageBase::dataAvailable()
 {
-    if (_Direction != CANMESSAGE_DIRECTION_RECEIVE)
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE)
     {
         return false;
     }
 
     if (_DataBufferIndex == -1)
     {
+        if (_mailbox() != NULL)
+        {
+            return _mailbox()->isUpdated();
+        }
+        return _fifo() != NULL && _fifo()->available() != 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Attaches a Receive-FIFO to the Message.
+ *
+ * Without a FIFO the Message rejects new Frames as long as the Data of the previous Frame is not read.
+ * With a FIFO the Interrupt-Routine adds the Frames and the loop() takes them without disabling Interrupts.
+ * @param fifo Instance of a CANReceiveFifo<N>
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANMessageBase::attachFifo(CANReceiveFifoBase &fifo)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!isInitialized())
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
         return false;
     }
+
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE || !_isClassic())
+    {
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
+    }
+
+    _Storage = &fifo;
+    _DLC = (_DLC & CANMESSAGE_DLC_MASK) | CANMESSAGE_STORAGE_FIFO;
+
+    return true;
+}
+
+/**
+ * @brief Takes the oldest received Frame from the FIFO.
+ *
+ * Only usable when a FIFO is attached. Do not mix it with getDataByte() for the same Frame.
+ * @param frame Frame to be filled
+ * @return true when a Frame was available, false when not (or on Error check _lastCanError)
+ */
+bool CANMessageBase::readFrame(CANFrame &frame)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE || _fifo() == NULL)
+    {
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
+    }
+
+    return _fifo()->pop(frame);
+}
+
+/**
+ * @brief Returns the Number of received Frames in the FIFO.
+ * @return uint8_t Frames (0 when no FIFO is attached)
+ */
+uint8_t CANMessageBase::framesAvailable()
+{
+    if (_fifo() == NULL)
+    {
+        return 0;
+    }
+    return _fifo()->available();
+}
+
+/**
+ * @brief Returns the Number of Frames they are lost because the FIFO was full.
+ * @return uint16_t Overruns (0 when no FIFO is attached)
+ */
+uint16_t CANMessageBase::getOverruns()
+{
+    if (_fifo() == NULL)
+    {
+        return 0;
+    }
+    return _fifo()->getOverruns();
+}
+
+/**
+ * @brief Attaches a Latest-Value-Mailbox to the Message.
+ *
+ * With a Mailbox the Interrupt-Routine always overwrites the Payload, so the loop() gets the newest Value (instead of the oldest unread one).
+ * An attached FIFO is replaced by the Mailbox.
+ * @param mailbox Instance of a CANMailbox
+ * @return true when success, false on any error (Check _lastCanError)
+ */
+bool CANMessageBase::attachMailbox(CANMailbox &mailbox)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!isInitialized())
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE || !_isClassic())
+    {
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
+    }
+
+    _Storage = &mailbox;
+    _DLC = (_DLC & CANMESSAGE_DLC_MASK) | CANMESSAGE_STORAGE_MAILBOX;
+
+    return true;
+}
+
+/**
+ * @brief Copies the latest received Payload (all DLC Bytes of one Frame) from the Mailbox.
+ * @param Data Destination for the Payload (at least 8 Bytes)
+ * @return True when the Payload was updated since the last read, False when not (or on Error check _lastCanError)
+ */
+bool CANMessageBase::readLatest(uint8_t *Data)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_direction() != CANMESSAGE_DIRECTION_RECEIVE || _mailbox() == NULL)
+    {
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
+    }
+
+    return _mailbox()->read(Data);
+}
+
+/**
+ * @brief Checks if the Payload in the Mailbox was updated since the last read.
+ * @return True when a new Payload is available, False when not or no Mailbox is attached
+ */
+bool CANMessageBase::isUpdated()
+{
+    if (_mailbox() == NULL)
+    {
+        return false;
+    }
+    return _mailbox()->isUpdated();
+}
+
+/**
+ * @brief Takes the next Payload from the FIFO or the Mailbox into the local Buffer.
+ * @return True when a Payload was taken, False when nothing was available
+ */
+bool CANMessageBase::_fetchNext()
+{
+    if (_mailbox() != NULL)
+    {
+        if (!_mailbox()->isUpdated())
+        {
+            return false;
+        }
+        _mailbox()->read(_DataByte);
+        _DataBufferIndex = 0;
+        return true;
+    }
+
+    CANFrame Frame;
+
+    if (_fifo() == NULL || !_fifo()->pop(Frame))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < _dlc(); i++)
+    {
+        _DataByte[i] = Frame.Data[i];
+    }
+    _DataBufferIndex = 0;
+
     return true;
 }
 
@@ -345,59 +889,200 @@ bool CANMessage::dataAvailable()
  * @return uint32_t CAN-Message-ID
  * @note If it is an extended Message you can get from getFrame().
  */
-uint32_t CANMessage::getID()
+uint32_t CANMessageBase::getID()
 {
-    return _ID;
+    return _id();
 }
 
 /**
  * @brief Returns the DLC of the CAN-Message.
- * @return uint8_t CAN-Message-DLC (max. 8 Byte)
+ * @return uint8_t CAN-Message-DLC (Classic Frames: Datalength 0 - 8, CAN FD: Data-Length-Code 0 - 15)
+ */
+uint8_t CANMessageBase::getDLC()
+{
+    return _dlc();
+}
+
+/**
+ * @brief Returns the Datalength of the CAN-Message.
+ * @return uint8_t Number of Data-Bytes (max. 8 Byte, CAN FD max. 64 Byte)
  */
-uint8_t CANMessage::getDLC()
+uint8_t CANMessageBase::getLength()
 {
-    return _DLC;
+    return _length();
 }
 
 /**
  * @brief Returns if Message is a Remote-Transmit-Request Message.
  * @return bool True if Message is a RTR-Message
  */
-bool CANMessage::getRTR()
+bool CANMessageBase::getRTR()
 {
-    return _RTR;
+    return _rtr();
 }
 
 /**
  * @brief Returns the Kind of the Frame.
  * @return uint8_t 0 if Message is a Standard-Frame, 1 if Message is an Extended-Frame
  */
-uint8_t CANMessage::getFrame()
+uint8_t CANMessageBase::getFrame()
 {
-    return _Frame;
+    return _frame();
+}
+
+/**
+ * @brief Returns if the Message is a CAN FD-Frame.
+ * @return bool True if the Message was initialised with CANMESSAGE_FRAME_FD
+ */
+bool CANMessageBase::isFD()
+{
+    return !_isClassic();
+}
+
+/**
+ * @brief Returns if the Data-Phase uses the faster Data-Bitrate (Bit-Rate-Switch).
+ * @return bool Transmit: BRS given at init(), Receive: BRS of the last received Frame
+ */
+bool CANMessageBase::getBRS()
+{
+    return (_Flags & CANMESSAGE_FRAME_BRS) != 0;
+}
+
+/**
+ * @brief Returns the Error-State-Indicator of the last received CAN FD-Frame.
+ * @return bool True if the Transmitter of the Frame was Error-Passive
+ */
+bool CANMessageBase::getESI()
+{
+    return (_Flags & CANMESSAGE_FRAME_ESI) != 0;
 }
 
 /**
  * @brief Returns the Direction of the Message.
  * @return uint8_t 0 if Message is Received, 1 if Message is Transmit
  */
-uint8_t CANMessage::getDirection()
+uint8_t CANMessageBase::getDirection()
+{
+    return _direction();
+}
+
+/**
+ * @brief Returns if the Message is initialised.
+ * @return bool True if init() was successfull
+ */
+bool CANMessageBase::isInitialized()
+{
+    return _Controller != NULL;
+}
+
+/**
+ * @brief Returns the packed Descriptor of the Message.
+ * @return uint32_t Bit 0-28 = ID; Bit 29 = Extended-Frame; Bit 30 = RTR; Bit 31 = Transmit
+ */
+uint32_t CANMessageBase::getDescriptor()
 {
-    return _Direction;
+    return _Descriptor;
+}
+
+/**
+ * @brief Builds the Lookup-Key (Descriptor without RTR and Direction) of an ID.
+ * @param id Message-ID
+ * @param frame CAN-Frame (0 = Standard-Frame; 1 = Extended-Frame)
+ * @return uint32_t Key
+ */
+uint32_t CANMessageBase::makeKey(uint32_t id, uint8_t frame)
+{
+    if (frame == CANMESSAGE_FRAME_EXTENDED)
+    {
+        return (id & CANMESSAGE_DESCRIPTOR_ID_MASK) | CANMESSAGE_DESCRIPTOR_EXTENDED;
+    }
+    return id & CANMESSAGE_DESCRIPTOR_ID_MASK;
 }
 
 /**
  * @brief Checks if Message is ready to Send.
  * @return bool True if Message is ready, false if Message is not ready
  */
-bool CANMessage::messageSendReady()
+bool CANMessageBase::messageSendReady()
 {
-    for (size_t i = 0; i < _DLC; i++)
+    uint8_t Length = _length();
+    uint8_t *Filled = _filled();
+
+    for (uint8_t i = 0; i < (Length >> 3); i++)
     {
-        if (_BufferFilled[i] != true)
+        if (Filled[i] != 0xFF)
         {
             return false;
         }
     }
+
+    uint8_t Required = (uint8_t) ((1 << (Length & 0x07)) - 1);
+
+    return (Length & 0x07) == 0 || (Filled[Length >> 3] & Required) == Required;
+}
+
+/**
+ * @brief Marks the Bytes offset to offset+length-1 as filled.
+ */
+void CANMessageBase::_markFilled(uint8_t offset, uint8_t length)
+{
+    uint8_t *Filled = _filled();
+
+    for (uint8_t i = offset; i < offset + length; i++)
+    {
+        Filled[i >> 3] |= (uint8_t) (1 << (i & 0x07));
+    }
+}
+
+/**
+ * @brief Finishes a successfull Transmission.
+ * @param reason Result of the CANChangeFilter (CANCHANGEFILTER_FIRST without Filter)
+ * @param now Time of the Check of the Filter
+ */
+void CANMessageBase::_sent(uint8_t reason, uint32_t now)
+{
+    if (_changeFilter() != NULL && !_rtr())
+    {
+        _changeFilter()->commit(_DataByte, _length(), now, reason);
+    }
+
+    _clearFilled();
+    CANSTATISTICS_COUNT(_Statistics.Sent);
+}
+
+/**
+ * @brief Marks all Bytes as not filled.
+ */
+void CANMessageBase::_clearFilled()
+{
+    memset(_filled(), 0, (_Capacity + 7) / 8);
+}
+
+/**
+ * @brief Copies the Counters of the Message (with disabled Interrupts, so all Counters belong to the same Moment).
+ *
+ * The Counters are only available when CANMESSAGE_STATISTICS is defined as 1.
+ * @param stats Counters to be filled (all 0 when the Counters are disabled)
+ * @param reset Reset the Counters in the same Step
+ * @return true when the Counters are enabled, false when not
+ */
+bool CANMessageBase::getStatistics(CANMessageStatistics &stats, bool reset)
+{
+#if CANMESSAGE_STATISTICS
+    CANMESSAGE_LOCK();
+    stats = _Statistics;
+
+    if (reset)
+    {
+        memset(&_Statistics, 0, sizeof(_Statistics));
+    }
+    CANMESSAGE_UNLOCK();
+
     return true;
+#else
+    (void) reset;
+    memset(&stats, 0, sizeof(stats));
+
+    return false;
+#endif
 }
@@ -12,8 +12,14 @@
 #ifndef CANMESSAGE_H
 #define CANMESSAGE_H
 
-#include <Arduino.h>
-#include <MCP2515.h>
+#include "CANPlatform.h"
+#include "CANDriver.h"
+#include "CANFrame.h"
+#include "CANPayload.h"
+#include "CANReceiveFifo.h"
+#include "CANMailbox.h"
+#include "CANChangeFilter.h"
+#include "CANStatistics.h"
 #include "CANMessageError.h"
 
 
@@ -23,52 +29,254 @@
 #define CANMESSAGE_FRAME_STANDARD   	0
 #define CANMESSAGE_FRAME_EXTENDED   	1
 
+// Flags of CAN FD-Frames (combined with the Frame, e.g. CANMESSAGE_FRAME_STANDARD | CANMESSAGE_FRAME_FD | CANMESSAGE_FRAME_BRS)
+#define CANMESSAGE_FRAME_FD             0x02        // FD-Format (up to 64 Bytes, no RTR)
+#define CANMESSAGE_FRAME_BRS            0x04        // Bit-Rate-Switch, the Data-Phase uses the faster Data-Bitrate
+#define CANMESSAGE_FRAME_ESI            0x08        // Error-State-Indicator of the Transmitter (received Frames only)
 
-class CANMessage
+// Layout of the packed Message-Descriptor
+#define CANMESSAGE_DESCRIPTOR_ID_MASK   0x1FFFFFFF  // Bit 0-28: Message-ID
+#define CANMESSAGE_DESCRIPTOR_EXTENDED  0x20000000  // Bit 29: Extended-Frame
+#define CANMESSAGE_DESCRIPTOR_RTR       0x40000000  // Bit 30: Remote Transmission Request
+#define CANMESSAGE_DESCRIPTOR_TRANSMIT  0x80000000  // Bit 31: Direction Transmit
+#define CANMESSAGE_DESCRIPTOR_KEY_MASK  (CANMESSAGE_DESCRIPTOR_ID_MASK | CANMESSAGE_DESCRIPTOR_EXTENDED)
+
+// Layout of the DLC-Byte
+#define CANMESSAGE_DLC_MASK             0x0F        // Bit 0-3: Data-Length-Code
+#define CANMESSAGE_STORAGE_MASK         0x70        // Bit 4-6: Receive-Storage
+#define CANMESSAGE_STORAGE_BUFFER       0x00        // Single local Buffer
+#define CANMESSAGE_STORAGE_FIFO         0x10        // CANReceiveFifo attached
+#define CANMESSAGE_STORAGE_MAILBOX      0x20        // CANMailbox attached
+#define CANMESSAGE_STORAGE_BUS          0x30        // Transmit-Message queued via CANBus
+#define CANMESSAGE_STORAGE_CHANGE       0x40        // CANChangeFilter attached to a Transmit-Message (holds the CANBus)
+
+
+class CANBus;
+
+
+/**
+ * @brief Capacity independent Part of a Message.
+ *
+ * The Data-Buffer and the Filled-Bits are stored in the derived CANMessageT, so Classic Messages only carry 8 Bytes.
+ * Use CANMessage (8 Bytes) or CANMessageT<Capacity> for CAN FD (e.g. CANMessageFD with 64 Bytes).
+ */
+class CANMessageBase
 {
 	private:
-		uint32_t _ID;               // Message-ID (11 bit for Standard-Frame; 29 bit for Extended Frame)
-        uint8_t _DLC;               // Datalength 0-8
-		bool _RTR;                  // Remote Transmission Request
-		uint8_t _Frame;             // Standard-Frame = 0; Extended-Frame = 1
-        uint8_t _Direction;         // Message-Direction (0 = Receive; 1 = Transmit)
-        MCP2515 _Controller;        // MCP2515-Controller Instance
-		uint8_t _DataByte[8];       // Buffer for the sending or receiving Data
-        int8_t _DataBufferIndex;    // Index of the actual readed Buffer
-        bool _BufferFilled[8];      // Shows if a Buffer is filled with Data
-        bool _isInitialized;
+        uint32_t _Descriptor;       // Packed ID, Frame, RTR and Direction (see CANMESSAGE_DESCRIPTOR_*)
         uint16_t _lastCanError;
+        uint8_t _DLC;               // Data-Length-Code 0-15 and Receive-Storage (see CANMESSAGE_DLC_MASK)
+        int8_t _DataBufferIndex;    // Index of the actual readed Buffer
+        CANController *_Controller; // Shared Controller Instance of the CANDriver (NULL = not initialized)
+        void *_Storage;             // Attached CANReceiveFifo or CANMailbox (Receive), CANBus (Transmit)
+        uint8_t *_DataByte;         // Buffer for the sending or receiving Data, followed by the Filled-Bits (Bit n shows if Buffer n is filled)
+        uint8_t _Capacity;          // Size of the Data-Buffer
+        uint8_t _Flags;             // CANMESSAGE_FRAME_FD, _BRS and _ESI (of the last received Frame)
+#if CANMESSAGE_STATISTICS
+        CANMessageStatistics _Statistics;
+#endif
+
+        uint32_t _id() { return _Descriptor & CANMESSAGE_DESCRIPTOR_ID_MASK; }
+        uint8_t _frame() { return (_Descriptor & CANMESSAGE_DESCRIPTOR_EXTENDED) ? CANMESSAGE_FRAME_EXTENDED : CANMESSAGE_FRAME_STANDARD; }
+        bool _rtr() { return (_Descriptor & CANMESSAGE_DESCRIPTOR_RTR) != 0; }
+        uint8_t _direction() { return (_Descriptor & CANMESSAGE_DESCRIPTOR_TRANSMIT) ? CANMESSAGE_DIRECTION_TRANSMIT : CANMESSAGE_DIRECTION_RECEIVE; }
+        uint8_t _dlc() { return _DLC & CANMESSAGE_DLC_MASK; }
+        uint8_t _length() { return canDlcToLength(_DLC & CANMESSAGE_DLC_MASK); }
+        bool _isClassic() { return (_Flags & CANMESSAGE_FRAME_FD) == 0; }
+        uint8_t *_filled() { return _DataByte + _Capacity; }
+        CANReceiveFifoBase *_fifo() { return (_DLC & CANMESSAGE_STORAGE_MASK) == CANMESSAGE_STORAGE_FIFO ? (CANReceiveFifoBase *) _Storage : NULL; }
+        CANMailbox *_mailbox() { return (_DLC & CANMESSAGE_STORAGE_MASK) == CANMESSAGE_STORAGE_MAILBOX ? (CANMailbox *) _Storage : NULL; }
+        CANChangeFilter *_changeFilter() const { return (_DLC & CANMESSAGE_STORAGE_MASK) == CANMESSAGE_STORAGE_CHANGE ? (CANChangeFilter *) _Storage : NULL; }
+        CANBus *_bus() const
+        {
+            if ((_DLC & CANMESSAGE_STORAGE_MASK) == CANMESSAGE_STORAGE_CHANGE)
+            {
+                return _changeFilter()->getBus();
+            }
+            return (_DLC & CANMESSAGE_STORAGE_MASK) == CANMESSAGE_STORAGE_BUS ? (CANBus *) _Storage : NULL;
+        }
+
+        bool _fetchNext();
+        void _markFilled(uint8_t offset, uint8_t length);
+        void _clearFilled();
+        void _sent(uint8_t reason, uint32_t now);
+
+	protected:
+
+        CANMessageBase(uint8_t *data, uint8_t capacity);
+        CANMessageBase(const CANMessageBase &other, uint8_t *data);
+        CANMessageBase &operator=(const CANMessageBase &other);
 
 	public:
 
-		CANMessage();
-		~CANMessage();
+		~CANMessageBase();
 
         uint16_t getLastCanError();
 
-        bool init(uint32_t id, uint8_t dlc, bool rtr, uint8_t frame, uint8_t direction, MCP2515 controller);
+        bool init(uint32_t id, uint8_t dlc, bool rtr, uint8_t frame, uint8_t direction, CANController &controller);
 
         // For Transmit-Messages
 
         bool addDataByte(uint8_t Data, uint8_t BufferNumber = 0);
         bool releaseBuffer(uint8_t BufferNumber = 0);
+        bool setPayload(const uint8_t *Data, uint8_t length);
+
+        /**
+         * @brief Writes a Value to the DataBuffer and marks its Bytes as filled.
+         * @tparam T Type of the Value (1, 2, 4 or 8 Bytes)
+         * @param offset Number of the first Buffer
+         * @param value Value
+         * @param byteOrder CANMESSAGE_BYTEORDER_MOTOROLA (default) or CANMESSAGE_BYTEORDER_INTEL
+         * @return true when success, false on any error (Check _lastCanError)
+         */
+        template <typename T>
+        bool put(uint8_t offset, T value, uint8_t byteOrder = CANMESSAGE_BYTEORDER_MOTOROLA)
+        {
+            _lastCanError = EMPTY_VALUE_16_BIT;
+
+            if (!isInitialized() || _direction() != CANMESSAGE_DIRECTION_TRANSMIT)
+            {
+                _lastCanError = isInitialized() ? ERROR_CAN_METHOD_NOT_ALLOWED : ERROR_CAN_NOT_INITIALIZED;
+                return false;
+            }
+
+            if (offset + sizeof(T) > _length())
+            {
+                _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+                return false;
+            }
+
+            canPayloadPut<T>(&_DataByte[offset], value, byteOrder);
+            _markFilled(offset, sizeof(T));
+
+            return true;
+        }
+
         bool checkForRTR();
         bool messageSendReady();
         bool send();
+        bool attachBus(CANBus &bus);
+        CANBus *getBus();
+        bool attachChangeFilter(CANChangeFilter &filter);
 
         // for Receive-Messages
 
         bool checkReceive();
+        bool deliver(const CANFrame &frame);
         uint8_t getDataByte();
+        bool getPayload(uint8_t *Data);
+        bool releaseData();
+
+        /**
+         * @brief Reads a Value from the received Data without releasing it.
+         *
+         * Check if Data is available with the dataAvailable()-Method, release the Data with releaseData() afterwards.
+         * @tparam T Type of the Value (1, 2, 4 or 8 Bytes)
+         * @param offset Number of the first Buffer
+         * @param byteOrder CANMESSAGE_BYTEORDER_MOTOROLA (default) or CANMESSAGE_BYTEORDER_INTEL
+         * @return T Value (0 when no Data is available or the Value is outside the DLC)
+         */
+        template <typename T>
+        T get(uint8_t offset, uint8_t byteOrder = CANMESSAGE_BYTEORDER_MOTOROLA)
+        {
+            if (_direction() != CANMESSAGE_DIRECTION_RECEIVE || offset + sizeof(T) > _length())
+            {
+                return 0;
+            }
+
+            if (_DataBufferIndex == -1 && !_fetchNext())
+            {
+                return 0;
+            }
+
+            return canPayloadGet<T>(&_DataByte[offset], byteOrder);
+        }
+
         bool dataAvailable();
+        bool attachFifo(CANReceiveFifoBase &fifo);
+        bool readFrame(CANFrame &frame);
+        uint8_t framesAvailable();
+        uint16_t getOverruns();
+        bool attachMailbox(CANMailbox &mailbox);
+        bool readLatest(uint8_t *Data);
+        bool isUpdated();
 
         // Getter Message properties
 
         uint32_t getID();
         uint8_t getDLC();
+        uint8_t getLength();
         bool getRTR();
         uint8_t getFrame();
+        bool isFD();
+        bool getBRS();
+        bool getESI();
         uint8_t getDirection();
+        bool isInitialized();
+        uint32_t getDescriptor();
+
+        // Statistics
+
+        bool getStatistics(CANMessageStatistics &stats, bool reset = false);
+
+        static uint32_t makeKey(uint32_t id, uint8_t frame);
+
+};
+
+
+/**
+ * @brief Message with a Data-Buffer of Capacity Bytes.
+ * @tparam Capacity Max. Length of the Payload (8 for Classic Frames, up to 64 for CAN FD)
+ */
+template <uint8_t Capacity>
+class CANMessageT : public CANMessageBase
+{
+    static_assert(Capacity >= 8 && Capacity <= CANFRAME_MAX_LENGTH_FD, "CANMessageT capacity must be between 8 and 64");
+
+	private:
+        uint8_t _Buffer[Capacity + (Capacity + 7) / 8];     // Data-Bytes and Filled-Bits
+
+	public:
+
+        CANMessageT() : CANMessageBase(_Buffer, Capacity)
+        {
+        }
+
+        CANMessageT(const CANMessageT &other) : CANMessageBase(other, _Buffer)
+        {
+        }
+
+        CANMessageT &operator=(const CANMessageT &other)
+        {
+            CANMessageBase::operator=(other);
+            return *this;
+        }
+
+};
+
+
+typedef CANMessageT<8> CANMessage;                          // Classic Frame
+typedef CANMessageT<CANFRAME_MAX_LENGTH_FD> CANMessageFD;   // CAN FD-Frame with up to 64 Bytes
+
+
+/**
+ * @brief Statically sized Table of Messages, stored contiguously.
+ *
+ * Can be registered at a CANBus at once with registerTable().
+ * @tparam N Number of Messages
+ */
+template <uint8_t N>
+class CANMessageTable
+{
+	private:
+        CANMessage _Messages[N];
+
+	public:
+
+        CANMessage &operator[](uint8_t index) { return _Messages[index]; }
+        uint8_t size() { return N; }
+        CANMessage *begin() { return _Messages; }
+        CANMessage *end() { return _Messages + N; }
 
 };
 
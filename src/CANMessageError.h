@@ -9,6 +9,37 @@
 #define ERROR_CAN_NO_FREE_TRANSMIT_BUFFER               0x6000      // Occurs when during message transmission preparation no free Transmit-Buffer could be found.
 #define ERROR_CAN_FILLING_TRANSMIT_BUFFER               0x7000      // Occurs when filling the Transmit-Buffer is not successfull.
 #define ERROR_CAN_RECEIVED_DATA_IN_BUFFER               0x8000      // Occurs when in the DataBuffer is still Data.
+#define ERROR_CAN_RECEIVE_FIFO_FULL                     0x8100      // Occurs when a received Frame is lost because the Receive-FIFO is full.
+#define ERROR_CAN_RECEIVED_FRAME_TOO_SHORT              0x8200      // Occurs when a received Frame has less Data-Bytes than the DLC of the Message.
+
+#define ERROR_CAN_BUS_MESSAGE_TABLE_FULL                0x9100      // Occurs when no further Message can be registered at the CAN-Bus.
+#define ERROR_CAN_BUS_ID_ALREADY_REGISTERED             0x9200      // Occurs when a Message with the same ID and Frame is already registered at the CAN-Bus.
+#define ERROR_CAN_BUS_TX_QUEUE_FULL                     0x9300      // Occurs when a Frame can not be added because the Transmit-Queue of the CAN-Bus is full.
+#define ERROR_CAN_BUS_NO_RECEIVE_MESSAGE                0x9400      // Occurs when the Acceptance-Filters are planned, but no Receive-Message is registered at the CAN-Bus.
+#define ERROR_CAN_BUS_MODE_CHANGE_FAILED                0x9500      // Occurs when the MCP2515 does not change into the requested Operation-Mode.
+#define ERROR_CAN_BUS_FILTERS_NOT_PLANNABLE             0x9600      // Occurs when the Acceptance-Filters are planned, but a Receiver at the CAN-Bus needs Frames they are not given as single IDs.
+
+#define ERROR_CAN_SCHEDULER_FULL                        0xA100      // Occurs when no further Message can be added to the CAN-Scheduler.
+#define ERROR_CAN_SCHEDULER_ALREADY_ADDED               0xA200      // Occurs when the Message is already added to the CAN-Scheduler.
+#define ERROR_CAN_SUPERVISOR_NOT_REGISTERED             0xA300      // Occurs when a Message is supervised, but not registered at the CAN-Bus of the CAN-Supervisor.
+
+#define ERROR_CAN_ISOTP_BUSY                            0xB100      // Occurs when an ISO-TP-Transfer is started, but the previous one is still in Progress.
+#define ERROR_CAN_ISOTP_TIMEOUT                         0xB200      // Occurs when the ISO-TP-Peer does not send the next Flow-Control- or Consecutive-Frame in Time.
+#define ERROR_CAN_ISOTP_OVERFLOW                        0xB300      // Occurs when an ISO-TP-Transfer is longer than the Buffer of the Receiver.
+#define ERROR_CAN_ISOTP_UNEXPECTED_FRAME                0xB400      // Occurs when an ISO-TP-Frame has a wrong Sequence-Number or an invalid Flow-Status.
+#define ERROR_CAN_ISOTP_NO_BUS                          0xB500      // Occurs when the Transmit-Message of an ISO-TP-Channel is not registered at a CAN-Bus.
+
+#define ERROR_CAN_GATEWAY_FULL                          0xC100      // Occurs when no further Bus or Route can be added to the CAN-Gateway.
+#define ERROR_CAN_GATEWAY_NO_BUS                        0xC200      // Occurs when a Route uses a Bus they is not added to the CAN-Gateway.
+#define ERROR_CAN_GATEWAY_BUS_ALREADY_ADDED             0xC300      // Occurs when the Bus is already added to the CAN-Gateway.
+
+#define ERROR_CAN_HANDLERS_FULL                         0xD100      // Occurs when no further ID-Range can be added to the CAN-Handlers.
+#define ERROR_CAN_HANDLERS_NOT_REGISTERED               0xD200      // Occurs when a Message gets a Handler, but is not registered at the CAN-Bus of the CAN-Handlers.
+
+#define ERROR_CAN_J1939_TABLE_FULL                      0xE100      // Occurs when no further PGN can be added to the J1939-Node (CANJ1939_MAX_PGNS or no collision-free PGN-Table).
+#define ERROR_CAN_J1939_SESSIONS_FULL                   0xE200      // Occurs when no further Session can be added or a Transfer finds no free Session.
+#define ERROR_CAN_J1939_ADDRESS_LOST                    0xE300      // Occurs when a Node with a lower NAME claims the own Address.
+#define ERROR_CAN_J1939_TRANSFER_ABORTED                0xE400      // Occurs when a Multi-Packet-Transfer is aborted (Timeout, Sequence, Buffer too small or Abort of the Sender).
 
 #define ERROR_CAN_INIT_FRAME_NOT_PLAUSIBLE              0xF100      // Occurs when during the initialisation a not defined Frame is given.
 #define ERROR_CAN_INIT_DIRECTION_NOT_PLAUSIBLE          0xF200      // Occurs when during the initialisation a not defined Direction is given.
@@ -16,6 +47,7 @@
 #define ERROR_CAN_INIT_ID_NOT_PLAUSIBLE                 0xF400      // Occurs when during the initialisation the given ID does not match with the given Frame.
 #define ERROR_CAN_INIT_RTR_NOT_ALLOWED                  0xF500      // Occurs when during the initialisation the RTR is set but the direction is not Transmit.
 #define ERROR_CAN_INIT_DLC_NOT_VALID                    0xF600      // Occurs when during the initialisation the given DLC is not in the allowed Range.
+#define ERROR_CAN_INIT_FD_NOT_SUPPORTED                 0xF700      // Occurs when during the initialisation a CAN FD-Frame is given, but the CAN-Driver supports Classic Frames only.
 
 #define ERROR_CAN_MESSAGE_NOT_SEND                      0x000E      // Occurs when sending Message wasn't successfull (the higher bits would be filled with the MCP-Error).
 #define ERROR_CAN_MESSAGE_NOT_RECEIVED                  0x000F      // Occurs when receiving Message wasn't successfull (the higher bits would be filled with the MCP-Error).
@@ -0,0 +1,109 @@
+/**
+ * @file CANPayload.h
+ * @author MH-Tobi
+ * @brief Typed Access (Big- and Little-Endian) to the Payload of CAN-Frames.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANPAYLOAD_H
+#define CANPAYLOAD_H
+
+#include <stdint.h>
+#include <string.h>
+
+
+#define CANMESSAGE_BYTEORDER_MOTOROLA   0       // Big-Endian (most significant Byte first)
+#define CANMESSAGE_BYTEORDER_INTEL      1       // Little-Endian (least significant Byte first)
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define CANMESSAGE_BYTEORDER_HOST       CANMESSAGE_BYTEORDER_MOTOROLA
+#else
+#define CANMESSAGE_BYTEORDER_HOST       CANMESSAGE_BYTEORDER_INTEL
+#endif
+
+
+/**
+ * @brief Unsigned Word with the same Size as the accessed Type, used for the Byte-Swap.
+ */
+template <uint8_t Size> struct CANPayloadWord;
+
+template <> struct CANPayloadWord<1>
+{
+    typedef uint8_t Type;
+    static Type swap(Type value) { return value; }
+};
+
+template <> struct CANPayloadWord<2>
+{
+    typedef uint16_t Type;
+    static Type swap(Type value) { return __builtin_bswap16(value); }
+};
+
+template <> struct CANPayloadWord<4>
+{
+    typedef uint32_t Type;
+    static Type swap(Type value) { return __builtin_bswap32(value); }
+};
+
+template <> struct CANPayloadWord<8>
+{
+    typedef uint64_t Type;
+    static Type swap(Type value) { return __builtin_bswap64(value); }
+};
+
+
+/**
+ * @brief Reads a Value from the Payload.
+ *
+ * memcpy() of a constant Size compiles to plain Loads, the Byte-Swap only when the Byte-Order differs from the Target.
+ * @tparam T Type of the Value (1, 2, 4 or 8 Bytes)
+ * @param Data Pointer to the first Byte of the Value
+ * @param byteOrder CANMESSAGE_BYTEORDER_MOTOROLA or CANMESSAGE_BYTEORDER_INTEL
+ * @return T Value
+ */
+template <typename T>
+inline T canPayloadGet(const uint8_t *Data, uint8_t byteOrder)
+{
+    typedef CANPayloadWord<sizeof(T)> Word;
+    typename Word::Type Raw;
+    T Value;
+
+    memcpy(&Raw, Data, sizeof(T));
+
+    if (byteOrder != CANMESSAGE_BYTEORDER_HOST)
+    {
+        Raw = Word::swap(Raw);
+    }
+
+    memcpy(&Value, &Raw, sizeof(T));
+    return Value;
+}
+
+/**
+ * @brief Writes a Value to the Payload.
+ * @tparam T Type of the Value (1, 2, 4 or 8 Bytes)
+ * @param Data Pointer to the first Byte of the Value
+ * @param value Value
+ * @param byteOrder CANMESSAGE_BYTEORDER_MOTOROLA or CANMESSAGE_BYTEORDER_INTEL
+ */
+template <typename T>
+inline void canPayloadPut(uint8_t *Data, T value, uint8_t byteOrder)
+{
+    typedef CANPayloadWord<sizeof(T)> Word;
+    typename Word::Type Raw;
+
+    memcpy(&Raw, &value, sizeof(T));
+
+    if (byteOrder != CANMESSAGE_BYTEORDER_HOST)
+    {
+        Raw = Word::swap(Raw);
+    }
+
+    memcpy(Data, &Raw, sizeof(T));
+}
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * @file CANPlatform.h
+ * @author MH-Tobi
+ * @brief Platform dependent helpers of the CANMessage-Library.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANPLATFORM_H
+#define CANPLATFORM_H
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+
+// Host-Build (Benchmarks, Simulation): single-threaded, so no Interrupts to be locked
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// Virtual Time of a Simulation in us (e.g. CANSimulator), NULL = steady Clock of the Host
+typedef unsigned long long (*CANHostClock)();
+
+inline CANHostClock &canHostClock()
+{
+    static CANHostClock Clock = NULL;
+    return Clock;
+}
+
+inline unsigned long micros()
+{
+    if (canHostClock() != NULL)
+    {
+        return (unsigned long) canHostClock()();
+    }
+    return (unsigned long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline unsigned long millis()
+{
+    if (canHostClock() != NULL)
+    {
+        return (unsigned long) (canHostClock()() / 1000);
+    }
+    return (unsigned long) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Locks the Interrupts in a Block they is called from the loop() and from the Interrupt-Routine.
+// On AVR the previous Interrupt-State is restored, so the Interrupt-Routine is not opened for nested Interrupts.
+#if defined(ARDUINO) && defined(__AVR__)
+#define CANMESSAGE_LOCK()               uint8_t CanMessageSreg = SREG; cli()
+#define CANMESSAGE_UNLOCK()             SREG = CanMessageSreg
+#else
+#define CANMESSAGE_LOCK()               noInterrupts()
+#define CANMESSAGE_UNLOCK()             interrupts()
+#endif
+
+// Keeps the Compiler from moving Memory-Accesses across this Point.
+// On the single-core Arduino-Boards a Compiler-Barrier is sufficient between Interrupt-Routine and loop().
+#if defined(ARDUINO)
+#define CANMESSAGE_MEMORY_BARRIER()     __asm__ __volatile__("" ::: "memory")
+#else
+#define CANMESSAGE_MEMORY_BARRIER()     __sync_synchronize()
+#endif
+
+#endif
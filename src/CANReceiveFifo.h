@@ -0,0 +1,154 @@
+/**
+ * @file CANReceiveFifo.h
+ * @author MH-Tobi
+ * @brief Lock-free Receive-FIFO (single producer, single consumer) for CAN-Messages.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANRECEIVEFIFO_H
+#define CANRECEIVEFIFO_H
+
+#include <stdint.h>
+#include "CANFrame.h"
+#include "CANPlatform.h"
+
+
+/**
+ * @brief Depth independent Part of the FIFO.
+ *
+ * push() is only called by the Interrupt-Routine (Producer), pop() only by the loop() (Consumer).
+ * Each Side writes only its own Index, so no Interrupts have to be disabled.
+ */
+class CANReceiveFifoBase
+{
+	private:
+        CANFrame *_Frames;                  // Storage of the derived CANReceiveFifo
+        uint8_t _Mask;                      // Depth - 1
+        volatile uint8_t _Head;             // Written by the Producer only
+        volatile uint8_t _Tail;             // Written by the Consumer only
+        volatile uint16_t _Overruns;        // Frames they are lost because the FIFO was full (saturating)
+
+	protected:
+
+        CANReceiveFifoBase(CANFrame *frames, uint8_t depth) :
+            _Frames(frames),
+            _Mask(depth - 1),
+            _Head(0),
+            _Tail(0),
+            _Overruns(0)
+        {
+        }
+
+	public:
+
+        /**
+         * @brief Adds a Frame to the FIFO (Producer-Side).
+         * @param frame Received Frame
+         * @return true when success, false when the FIFO is full (the Overrun is counted)
+         */
+        bool push(const CANFrame &frame)
+        {
+            uint8_t Head = _Head;
+
+            if ((uint8_t) (Head - _Tail) > _Mask)
+            {
+                if (_Overruns != 0xFFFF)
+                {
+                    _Overruns = _Overruns + 1;
+                }
+                return false;
+            }
+
+            _Frames[Head & _Mask] = frame;
+            CANMESSAGE_MEMORY_BARRIER();
+            _Head = Head + 1;
+
+            return true;
+        }
+
+        /**
+         * @brief Takes the oldest Frame from the FIFO (Consumer-Side).
+         * @param frame Frame to be filled
+         * @return true when a Frame was available, false when the FIFO is empty
+         */
+        bool pop(CANFrame &frame)
+        {
+            uint8_t Tail = _Tail;
+
+            if (Tail == _Head)
+            {
+                return false;
+            }
+
+            CANMESSAGE_MEMORY_BARRIER();
+            frame = _Frames[Tail & _Mask];
+            CANMESSAGE_MEMORY_BARRIER();
+            _Tail = Tail + 1;
+
+            return true;
+        }
+
+        /**
+         * @brief Returns the Number of Frames in the FIFO.
+         * @return uint8_t Frames
+         */
+        uint8_t available()
+        {
+            return (uint8_t) (_Head - _Tail);
+        }
+
+        /**
+         * @brief Returns the Depth of the FIFO.
+         * @return uint8_t Depth
+         */
+        uint8_t getDepth()
+        {
+            return _Mask + 1;
+        }
+
+        /**
+         * @brief Returns the Number of lost Frames.
+         *
+         * The Counter is read twice, so a torn 16-bit read on 8-bit Controllers is detected without disabling Interrupts.
+         * @return uint16_t Overruns (saturates at 0xFFFF)
+         */
+        uint16_t getOverruns()
+        {
+            uint16_t Value;
+
+            do
+            {
+                Value = _Overruns;
+            } while (Value != _Overruns);
+
+            return Value;
+        }
+
+};
+
+
+/**
+ * @brief Receive-FIFO with a Depth of N Frames.
+ * @tparam N Depth (power of 2, 2 - 128)
+ */
+template <uint8_t N>
+class CANReceiveFifo : public CANReceiveFifoBase
+{
+    static_assert(N >= 2 && N <= 128 && (N & (N - 1)) == 0, "CANReceiveFifo depth must be a power of 2 between 2 and 128");
+
+	private:
+        CANFrame _Storage[N];
+
+	public:
+
+        CANReceiveFifo() : CANReceiveFifoBase(_Storage, N)
+        {
+        }
+
+};
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file CANRegisterMap.h
+ * @author MH-Tobi
+ * @brief Registers of the MCP2515 used by the CAN-Bus, shared by the Drivers.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANREGISTERMAP_H
+#define CANREGISTERMAP_H
+
+#include <stdint.h>
+#include "CANFrame.h"
+
+
+// Registers
+#define MCP2515_REGISTER_RXF0SIDH               0x00    // RXF1 = 0x04, RXF2 = 0x08, RXF3 = 0x10, RXF4 = 0x14, RXF5 = 0x18
+#define MCP2515_REGISTER_CANSTAT                0x0E
+#define MCP2515_REGISTER_CANCTRL                0x0F
+#define MCP2515_REGISTER_RXM0SIDH               0x20    // RXM1 = + 0x04
+#define MCP2515_REGISTER_CANINTE                0x2B
+#define MCP2515_REGISTER_CANINTF                0x2C
+#define MCP2515_REGISTER_TXB0CTRL               0x30    // + (BufferNumber << 4), followed by SIDH, SIDL, EID8, EID0, DLC, D0 - D7
+#define MCP2515_REGISTER_RXB0CTRL               0x60    // + (BufferNumber << 4), followed by SIDH, SIDL, EID8, EID0, DLC, D0 - D7
+#define MCP2515_REGISTER_RXB1CTRL               0x70
+
+// Register-Bits
+#define MCP2515_CANCTRL_REQOP                   0xE0    // Also OPMOD in CANSTAT
+#define MCP2515_MODE_NORMAL                     0x00
+#define MCP2515_MODE_CONFIGURATION              0x80
+#define MCP2515_TXBCTRL_TXREQ                   0x08
+#define MCP2515_TXBCTRL_TXP                     0x03
+#define MCP2515_RXBCTRL_RXM                     0x60    // 00 = Receive Messages matching the Filters; 11 = Receive all
+#define MCP2515_RXBCTRL_BUKT                    0x04    // Rollover from RXB0 to RXB1
+#define MCP2515_CANINT_RX0I                     0x01    // << BufferNumber
+#define MCP2515_CANINT_TX0I                     0x04    // << BufferNumber
+#define MCP2515_SIDL_IDE                        0x08    // Also EXIDE in the Filters
+#define MCP2515_SIDL_SRR                        0x10
+#define MCP2515_DLC_RTR                         0x40
+
+// Bits of READ STATUS
+#define MCP2515_STATUS_RXIF(n)                  (0x01 << (n))
+#define MCP2515_STATUS_TXREQ(n)                 (0x04 << ((n) * 2))
+#define MCP2515_STATUS_TXIF(n)                  (0x08 << ((n) * 2))
+
+
+/**
+ * @brief Converts the Header-Registers (SIDH, SIDL, EID8, EID0, DLC) of a Receive-Buffer into a Frame.
+ * @param Header 5 Header-Registers
+ * @param frame Frame to be filled (without Data)
+ */
+inline void canRegisterDecode(const uint8_t *Header, CANFrame &frame)
+{
+    uint32_t StandardId = ((uint32_t) Header[0] << 3) | (Header[1] >> 5);
+
+    frame.DLC = Header[4] & 0x0F;
+
+    if (frame.DLC > 8)
+    {
+        frame.DLC = 8;
+    }
+
+    if (Header[1] & MCP2515_SIDL_IDE)
+    {
+        frame.Frame = 1;
+        frame.ID = (StandardId << 18) | ((uint32_t) (Header[1] & 0x03) << 16) | ((uint32_t) Header[2] << 8) | Header[3];
+        frame.RTR = (Header[4] & MCP2515_DLC_RTR) != 0;
+    } else {
+        frame.Frame = 0;
+        frame.ID = StandardId;
+        frame.RTR = (Header[1] & MCP2515_SIDL_SRR) != 0;
+    }
+}
+
+/**
+ * @brief Converts a Frame into the Header-Registers (SIDH, SIDL, EID8, EID0, DLC) of a Transmit-Buffer.
+ * @param frame Frame
+ * @param Header 5 Header-Registers to be filled
+ */
+inline void canRegisterEncode(const CANFrame &frame, uint8_t *Header)
+{
+    uint32_t Value = frame.Frame == 1 ? frame.ID : frame.ID << 18;
+
+    Header[0] = (uint8_t) (Value >> 21);
+    Header[1] = (uint8_t) ((((Value >> 18) & 0x07) << 5) | (frame.Frame == 1 ? MCP2515_SIDL_IDE | ((Value >> 16) & 0x03) : 0x00));
+    Header[2] = frame.Frame == 1 ? (uint8_t) (Value >> 8) : 0x00;
+    Header[3] = frame.Frame == 1 ? (uint8_t) Value : 0x00;
+    Header[4] = (frame.DLC & 0x0F) | (frame.RTR ? MCP2515_DLC_RTR : 0x00);
+}
+
+/**
+ * @brief Converts a Mask or Filter in the 29-bit Register-Layout (Standard-ID in Bit 18 - 28) into the Registers (SIDH, SIDL, EID8, EID0).
+ * @param value Mask or Filter
+ * @param extended Sets the EXIDE-Bit (only for Filters)
+ * @param Registers 4 Registers to be filled
+ */
+inline void canRegisterEncodeAcceptance(uint32_t value, bool extended, uint8_t *Registers)
+{
+    Registers[0] = (uint8_t) (value >> 21);
+    Registers[1] = (uint8_t) ((((value >> 18) & 0x07) << 5) | (extended ? MCP2515_SIDL_IDE : 0x00) | ((value >> 16) & 0x03));
+    Registers[2] = (uint8_t) (value >> 8);
+    Registers[3] = (uint8_t) value;
+}
+
+#endif
@@ -0,0 +1,483 @@
+#include "CANScheduler.h"
+
+
+/**
+ * @brief Constructor
+ */
+CANScheduler::CANScheduler()
+{
+    _Count = 0;
+    _Start = 0;
+    _Now = 0;
+    _isStarted = false;
+    _lastCanError = EMPTY_VALUE_16_BIT;
+    resetStatistics();
+}
+
+/**
+ * @brief Returns the last occurred Error.
+ * @return Error-Code (see CANMessageError.h)
+ */
+uint16_t CANScheduler::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Adds a Transmission-Message, they is sent every period ms.
+ *
+ * With CANSCHEDULER_AUTO_OFFSET the Offset with the largest Distance to the Transmissions of all
+ * Messages added before is chosen (two Periods p and q collide when the Offsets are equal modulo gcd(p, q)).
+ * Add the Messages with the shortest Period first, they have the fewest free Offsets.
+ * Messages can also be added after start() while tick() runs in a Timer-Interrupt.
+ *
+ * @param message Initialised Transmission-Message
+ * @param period Period in ms (1 - 65535)
+ * @param callback Fills the Payload before each Transmission (optional, without the Payload must be filled before)
+ * @param offset Time of the first Transmission after start() in ms (0 - period-1 or CANSCHEDULER_AUTO_OFFSET)
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANScheduler::add(CANMessage &message, uint16_t period, CANSchedulerCallback callback, uint16_t offset)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (!message.isInitialized())
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    if (message.getDirection() != CANMESSAGE_DIRECTION_TRANSMIT)
+    {
+        _lastCanError = ERROR_CAN_METHOD_NOT_ALLOWED;
+        return false;
+    }
+
+    if (period == 0 || (offset != CANSCHEDULER_AUTO_OFFSET && offset >= period))
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    if (_find(message) >= 0)
+    {
+        _lastCanError = ERROR_CAN_SCHEDULER_ALREADY_ADDED;
+        return false;
+    }
+
+    if (_Count >= CANSCHEDULER_MAX_MESSAGES)
+    {
+        _lastCanError = ERROR_CAN_SCHEDULER_FULL;
+        return false;
+    }
+
+    uint16_t Offset = offset == CANSCHEDULER_AUTO_OFFSET ? _chooseOffset(period) : offset;
+
+    // tick() may run in a Timer-Interrupt, so the Heap is changed with Interrupts disabled
+    CANMESSAGE_LOCK();
+
+    Entry &New = _Entries[_Count];
+
+    New.Message = &message;
+    New.Callback = callback;
+    New.Period = period;
+    New.Offset = Offset;
+    New.Misses = 0;
+    New.MaxJitter = 0;
+    New.Due = 0;
+
+    _Heap[_Count] = _Count;
+    _Count++;
+
+    if (_isStarted)
+    {
+        _schedule(New);
+        _siftUp(_Count - 1);
+    }
+
+    CANMESSAGE_UNLOCK();
+
+    return true;
+}
+
+/**
+ * @brief Starts the Transmissions, all Offsets refer to this Time.
+ *
+ * Without start() the first tick() starts the Scheduler.
+ */
+void CANScheduler::start()
+{
+    start((uint32_t) millis());
+}
+
+/**
+ * @brief Starts the Transmissions, all Offsets refer to this Time.
+ * @param now Current Time in ms
+ */
+void CANScheduler::start(uint32_t now)
+{
+    _Start = now;
+    _Now = now;
+    _isStarted = true;
+
+    for (uint8_t i = 0; i < _Count; i++)
+    {
+        _Heap[i] = i;
+        _schedule(_Entries[i]);
+        _siftUp(i);
+    }
+}
+
+/**
+ * @brief Sends all due Messages.
+ *
+ * Call it in the loop() or in a Timer-Interrupt (the Callbacks are then also called in the Interrupt).
+ *
+ * @return Number of sent Messages
+ */
+uint8_t CANScheduler::tick()
+{
+    return tick((uint32_t) millis());
+}
+
+/**
+ * @brief Sends all due Messages.
+ *
+ * A Message they is due for a whole Period or more skips the missed Cycles (counted as Misses), so each Message is sent at most once per tick().
+ *
+ * @param now Current Time in ms
+ * @return Number of sent Messages
+ */
+uint8_t CANScheduler::tick(uint32_t now)
+{
+    uint8_t Sent = 0;
+
+    if (!_isStarted)
+    {
+        start(now);
+    }
+
+    _Now = now;
+
+    while (_Count > 0)
+    {
+        Entry &Next = _Entries[_Heap[0]];
+        uint32_t Late = now - Next.Due;
+
+        if ((int32_t) Late < 0)
+        {
+            break;
+        }
+
+        if (Late >= Next.Period)
+        {
+            uint32_t Skipped = Late / Next.Period;
+
+            _addSaturating(Next.Misses, Skipped);
+            _addSaturating(_Misses, Skipped);
+            Next.Due += Skipped * Next.Period;
+            Late -= Skipped * Next.Period;
+        }
+
+        if (_fire(Next, (uint16_t) Late))
+        {
+            Sent++;
+        }
+
+        Next.Due += Next.Period;
+        _siftDown(0);
+    }
+    return Sent;
+}
+
+/**
+ * @brief Returns the Number of added Messages.
+ */
+uint8_t CANScheduler::getMessageCount()
+{
+    return _Count;
+}
+
+/**
+ * @brief Returns the Time of the next Transmission (e.g. to set up a Timer).
+ * @return Time in ms, 0 when the Scheduler is not started or no Message is added
+ */
+uint32_t CANScheduler::getNextDue()
+{
+    if (!_isStarted || _Count == 0)
+    {
+        return 0;
+    }
+    return _Entries[_Heap[0]].Due;
+}
+
+/**
+ * @brief Returns the Offset of a Message.
+ * @param message Added Message
+ * @return Offset in ms, CANSCHEDULER_AUTO_OFFSET when the Message is not added
+ */
+uint16_t CANScheduler::getOffset(CANMessage &message)
+{
+    int16_t Index = _find(message);
+
+    return Index < 0 ? CANSCHEDULER_AUTO_OFFSET : _Entries[Index].Offset;
+}
+
+/**
+ * @brief Returns the Cycles of a Message without Transmission (skipped or send() failed).
+ * @param message Added Message
+ */
+uint16_t CANScheduler::getMisses(CANMessage &message)
+{
+    int16_t Index = _find(message);
+
+    return Index < 0 ? 0 : _Entries[Index].Misses;
+}
+
+/**
+ * @brief Returns the max. Delay of a Transmission of a Message.
+ * @param message Added Message
+ * @return Delay in ms
+ */
+uint16_t CANScheduler::getMaxJitter(CANMessage &message)
+{
+    int16_t Index = _find(message);
+
+    return Index < 0 ? 0 : _Entries[Index].MaxJitter;
+}
+
+/**
+ * @brief Returns the Number of sent Messages.
+ */
+uint32_t CANScheduler::getSentFrames()
+{
+    return _Sent;
+}
+
+/**
+ * @brief Returns the Cycles of all Messages without Transmission.
+ */
+uint16_t CANScheduler::getMisses()
+{
+    return _Misses;
+}
+
+/**
+ * @brief Returns the max. Delay of a Transmission of all Messages in ms.
+ */
+uint16_t CANScheduler::getMaxJitter()
+{
+    return _MaxJitter;
+}
+
+/**
+ * @brief Returns the average Delay of the Transmissions in ms.
+ */
+float CANScheduler::getAverageJitter()
+{
+    if (_Sent == 0)
+    {
+        return 0.0;
+    }
+    return (float) _JitterSum / _Sent;
+}
+
+/**
+ * @brief Resets Misses, Jitter and sent Messages of all Messages.
+ */
+void CANScheduler::resetStatistics()
+{
+    _Sent = 0;
+    _JitterSum = 0;
+    _Misses = 0;
+    _MaxJitter = 0;
+
+    for (uint8_t i = 0; i < _Count; i++)
+    {
+        _Entries[i].Misses = 0;
+        _Entries[i].MaxJitter = 0;
+    }
+}
+
+uint16_t CANScheduler::_gcd(uint16_t a, uint16_t b)
+{
+    while (b != 0)
+    {
+        uint16_t Rest = a % b;
+        a = b;
+        b = Rest;
+    }
+    return a;
+}
+
+void CANScheduler::_addSaturating(uint16_t &counter, uint32_t value)
+{
+    counter = (uint32_t) counter + value > 0xFFFF ? 0xFFFF : (uint16_t) (counter + value);
+}
+
+/**
+ * @brief Compares the next Transmissions of two Entries (also correct after the Overflow of millis()).
+ */
+bool CANScheduler::_before(uint8_t a, uint8_t b)
+{
+    return (int32_t) (_Entries[a].Due - _Entries[b].Due) < 0;
+}
+
+void CANScheduler::_siftUp(uint8_t position)
+{
+    while (position > 0)
+    {
+        uint8_t Parent = (position - 1) / 2;
+
+        if (!_before(_Heap[position], _Heap[Parent]))
+        {
+            break;
+        }
+
+        uint8_t Swap = _Heap[position];
+        _Heap[position] = _Heap[Parent];
+        _Heap[Parent] = Swap;
+        position = Parent;
+    }
+}
+
+void CANScheduler::_siftDown(uint8_t position)
+{
+    while (true)
+    {
+        uint8_t Child = 2 * position + 1;
+
+        if (Child >= _Count)
+        {
+            break;
+        }
+
+        if (Child + 1 < _Count && _before(_Heap[Child + 1], _Heap[Child]))
+        {
+            Child++;
+        }
+
+        if (!_before(_Heap[Child], _Heap[position]))
+        {
+            break;
+        }
+
+        uint8_t Swap = _Heap[position];
+        _Heap[position] = _Heap[Child];
+        _Heap[Child] = Swap;
+        position = Child;
+    }
+}
+
+/**
+ * @brief Sets the first Transmission of an Entry, not before the last tick().
+ */
+void CANScheduler::_schedule(Entry &entry)
+{
+    entry.Due = _Start + entry.Offset;
+
+    uint32_t Late = _Now - entry.Due;
+
+    if ((int32_t) Late > 0)
+    {
+        entry.Due += ((Late + entry.Period - 1) / entry.Period) * entry.Period;
+    }
+}
+
+/**
+ * @brief Chooses the Offset with the largest Distance to the Transmissions of all Entries.
+ *
+ * The Distance to an Entry only depends on the Offset modulo gcd(period, Period of the Entry),
+ * so only the Offsets below the lcm of these gcds (a Divisor of period) are checked.
+ * On equal Distance the Offset with the fewest Entries at this Distance wins.
+ */
+uint16_t CANScheduler::_chooseOffset(uint16_t period)
+{
+    uint16_t Gcds[CANSCHEDULER_MAX_MESSAGES];
+    uint16_t Range = 1;
+
+    for (uint8_t i = 0; i < _Count; i++)
+    {
+        Gcds[i] = _gcd(period, _Entries[i].Period);
+        Range = Range / _gcd(Range, Gcds[i]) * Gcds[i];
+    }
+
+    uint16_t Best = 0;
+    int32_t BestDistance = -1;
+    uint8_t BestCount = 0;
+
+    for (uint16_t Offset = 0; Offset < Range; Offset++)
+    {
+        uint16_t Distance = 0xFFFF;
+        uint8_t Count = 0;
+
+        for (uint8_t i = 0; i < _Count && (int32_t) Distance >= BestDistance; i++)
+        {
+            uint16_t Rest = (uint16_t) ((Offset + Gcds[i] - _Entries[i].Offset % Gcds[i]) % Gcds[i]);
+            uint16_t Current = Rest < Gcds[i] - Rest ? Rest : Gcds[i] - Rest;
+
+            if (Current < Distance)
+            {
+                Distance = Current;
+                Count = 1;
+            } else if (Current == Distance)
+            {
+                Count++;
+            }
+        }
+
+        if ((int32_t) Distance > BestDistance || ((int32_t) Distance == BestDistance && Count < BestCount))
+        {
+            Best = Offset;
+            BestDistance = Distance;
+            BestCount = Count;
+        }
+    }
+    return Best;
+}
+
+int16_t CANScheduler::_find(CANMessage &message)
+{
+    for (uint8_t i = 0; i < _Count; i++)
+    {
+        if (_Entries[i].Message == &message)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Fills and sends the Message of an Entry.
+ * @return true when the Message was sent
+ */
+bool CANScheduler::_fire(Entry &entry, uint16_t jitter)
+{
+    if (entry.Callback != NULL)
+    {
+        entry.Callback(*entry.Message);
+    }
+
+    if (!entry.Message->send())
+    {
+        _lastCanError = entry.Message->getLastCanError();
+        _addSaturating(entry.Misses, 1);
+        _addSaturating(_Misses, 1);
+        return false;
+    }
+
+    _Sent++;
+    _JitterSum += jitter;
+
+    if (jitter > entry.MaxJitter)
+    {
+        entry.MaxJitter = jitter;
+    }
+
+    if (jitter > _MaxJitter)
+    {
+        _MaxJitter = jitter;
+    }
+    return true;
+}
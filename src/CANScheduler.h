@@ -0,0 +1,101 @@
+/**
+ * @file CANScheduler.h
+ * @author MH-Tobi
+ * @brief Cyclic Transmission of Messages with staggered Offsets.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANSCHEDULER_H
+#define CANSCHEDULER_H
+
+#include "CANPlatform.h"
+#include "CANMessage.h"
+#include "CANMessageError.h"
+
+
+#ifndef CANSCHEDULER_MAX_MESSAGES
+#define CANSCHEDULER_MAX_MESSAGES       16      // Max. Number of cyclic Messages
+#endif
+
+#define CANSCHEDULER_AUTO_OFFSET        0xFFFF  // The Scheduler chooses the Offset
+
+
+/**
+ * @brief Called before each Transmission to fill the Payload of the Message.
+ */
+typedef void (*CANSchedulerCallback)(CANMessage &message);
+
+
+/**
+ * @brief Sends Transmission-Messages with a fixed Period (ms).
+ *
+ * The next Transmissions are kept in a Min-Heap, so a tick() without due Message costs one Comparison
+ * and each Transmission O(log n), independent of the Number of Messages.
+ * Messages with the same Period are staggered by their Offsets, so they do not reach the Bus at the same Time.
+ */
+class CANScheduler
+{
+	private:
+        struct Entry
+        {
+            CANMessage *Message;
+            CANSchedulerCallback Callback;  // Optional, fills the Payload before each Transmission
+            uint32_t Due;                   // Time of the next Transmission
+            uint16_t Period;
+            uint16_t Offset;                // Time of the first Transmission after start()
+            uint16_t Misses;                // Cycles without Transmission (skipped or send() failed)
+            uint16_t MaxJitter;             // Max. Delay of a Transmission in ms
+        };
+
+        Entry _Entries[CANSCHEDULER_MAX_MESSAGES];
+        uint8_t _Heap[CANSCHEDULER_MAX_MESSAGES];   // Indices of _Entries, next Transmission first
+        uint8_t _Count;
+        uint32_t _Start;                            // Time of start(), Reference of all Offsets
+        uint32_t _Now;                              // Time of the last tick()
+        bool _isStarted;
+        uint32_t _Sent;
+        uint32_t _JitterSum;
+        uint16_t _Misses;
+        uint16_t _MaxJitter;
+        uint16_t _lastCanError;
+
+        static uint16_t _gcd(uint16_t a, uint16_t b);
+        static void _addSaturating(uint16_t &counter, uint32_t value);
+        bool _before(uint8_t a, uint8_t b);
+        void _siftUp(uint8_t position);
+        void _siftDown(uint8_t position);
+        void _schedule(Entry &entry);
+        uint16_t _chooseOffset(uint16_t period);
+        int16_t _find(CANMessage &message);
+        bool _fire(Entry &entry, uint16_t jitter);
+
+	public:
+
+        CANScheduler();
+
+        uint16_t getLastCanError();
+
+        bool add(CANMessage &message, uint16_t period, CANSchedulerCallback callback = NULL, uint16_t offset = CANSCHEDULER_AUTO_OFFSET);
+        void start();
+        void start(uint32_t now);
+        uint8_t tick();
+        uint8_t tick(uint32_t now);
+
+        uint8_t getMessageCount();
+        uint32_t getNextDue();
+        uint16_t getOffset(CANMessage &message);
+        uint16_t getMisses(CANMessage &message);
+        uint16_t getMaxJitter(CANMessage &message);
+        uint32_t getSentFrames();
+        uint16_t getMisses();
+        uint16_t getMaxJitter();
+        float getAverageJitter();
+        void resetStatistics();
+
+};
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * @file CANSignal.h
+ * @author MH-Tobi
+ * @brief Compile-Time Signal-Codec for bit-packed Signals in the Payload of CAN-Frames.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANSIGNAL_H
+#define CANSIGNAL_H
+
+#include <stdint.h>
+#include "CANPayload.h"
+
+
+/**
+ * @brief Description of a Signal (same Convention as DBC-Files).
+ *
+ * Define it as constexpr and use it as Template-Parameter of CANSignal:
+ * @code
+ * constexpr CANSignalDescriptor EngineTemp = { 8, 12, CANMESSAGE_BYTEORDER_INTEL, true, 0.1f, -40.0f };
+ * int16_t Raw = CANSignal<EngineTemp>::unpack(Data);
+ * @endcode
+ */
+struct CANSignalDescriptor
+{
+    uint8_t StartBit;           // Intel: least significant Bit; Motorola: most significant Bit (Bit 7 of Byte 0 = 7)
+    uint8_t Length;             // Length in Bit (1 - 32)
+    uint8_t ByteOrder;          // CANMESSAGE_BYTEORDER_INTEL or CANMESSAGE_BYTEORDER_MOTOROLA
+    bool Signed;                // Two's complement Signal
+    float Factor;               // Physical Value = Raw * Factor + Offset
+    float Offset;
+};
+
+
+/**
+ * @brief Smallest Word (1, 2 or 4 Bytes) they can hold the given Number of Bytes.
+ */
+template <uint8_t Bytes> struct CANSignalWord { typedef uint32_t Type; };
+template <> struct CANSignalWord<1> { typedef uint8_t Type; };
+template <> struct CANSignalWord<2> { typedef uint16_t Type; };
+
+/**
+ * @brief Raw-Type of a Signal, depending on Length and Signedness.
+ */
+template <uint8_t Bytes, bool Signed> struct CANSignalRaw { typedef typename CANSignalWord<Bytes>::Type Type; };
+template <> struct CANSignalRaw<1, true> { typedef int8_t Type; };
+template <> struct CANSignalRaw<2, true> { typedef int16_t Type; };
+template <> struct CANSignalRaw<3, true> { typedef int32_t Type; };
+template <> struct CANSignalRaw<4, true> { typedef int32_t Type; };
+
+
+/**
+ * @brief Pack- and Unpack-Code for one Signal, generated at Compile-Time.
+ *
+ * Only the Bytes covered by the Signal are loaded (as 1, 2 or 4 Byte Word), all Shifts and Masks are Constants.
+ * No Descriptor is interpreted at Runtime and Floating-Point is only used by decode() and encode().
+ * The Payload must provide 8 Bytes.
+ * @tparam D constexpr Descriptor of the Signal
+ */
+template <const CANSignalDescriptor &D>
+class CANSignal
+{
+    static_assert(D.Length >= 1 && D.Length <= 32, "CANSignal length must be between 1 and 32 bit");
+    static_assert(D.StartBit < 64, "CANSignal start bit must be inside the 8 byte payload");
+
+	private:
+        // Linear Bit-Index counted from the most significant Bit of Byte 0 (Motorola-Order)
+        static constexpr uint8_t _MotorolaMsb = (D.StartBit / 8) * 8 + (7 - (D.StartBit % 8));
+
+        static constexpr uint8_t _FirstByte = D.StartBit / 8;
+        static constexpr uint8_t _LastByte = D.ByteOrder == CANMESSAGE_BYTEORDER_INTEL ? (D.StartBit + D.Length - 1) / 8 : (_MotorolaMsb + D.Length - 1) / 8;
+        static constexpr uint8_t _Span = _LastByte - _FirstByte + 1;
+        static constexpr uint8_t _WordBytes = _Span == 1 ? 1 : (_Span == 2 ? 2 : 4);
+
+        static_assert(_LastByte < 8 && _Span <= 4, "CANSignal must fit into 4 consecutive bytes of the payload");
+
+        // Loaded Window (moved backwards when it would end behind the Payload)
+        static constexpr uint8_t _WindowStart = _FirstByte + _WordBytes > 8 ? 8 - _WordBytes : _FirstByte;
+        static constexpr uint8_t _Shift = D.ByteOrder == CANMESSAGE_BYTEORDER_INTEL
+            ? D.StartBit - _WindowStart * 8
+            : (_WindowStart + _WordBytes) * 8 - 1 - (_MotorolaMsb + D.Length - 1);
+
+        typedef typename CANSignalWord<_WordBytes>::Type _Word;
+
+        static constexpr uint32_t _Mask = D.Length == 32 ? 0xFFFFFFFF : (((uint32_t) 1 << D.Length) - 1);
+        static constexpr uint32_t _SignBit = (uint32_t) 1 << (D.Length - 1);
+
+	public:
+
+        typedef typename CANSignalRaw<(D.Length + 7) / 8, D.Signed>::Type RawType;
+
+        /**
+         * @brief Extracts the Raw-Value of the Signal.
+         * @param Data Payload (8 Bytes)
+         * @return RawType Raw-Value (sign-extended for signed Signals)
+         */
+        static RawType unpack(const uint8_t *Data)
+        {
+            uint32_t Value = ((uint32_t) canPayloadGet<_Word>(&Data[_WindowStart], D.ByteOrder) >> _Shift) & _Mask;
+
+            if (D.Signed)
+            {
+                Value = (Value ^ _SignBit) - _SignBit;
+            }
+            return (RawType) Value;
+        }
+
+        /**
+         * @brief Inserts the Raw-Value of the Signal, all other Bits of the Payload are kept.
+         * @param Data Payload (8 Bytes)
+         * @param value Raw-Value (Bits above the Signal-Length are ignored)
+         */
+        static void pack(uint8_t *Data, RawType value)
+        {
+            _Word Word = canPayloadGet<_Word>(&Data[_WindowStart], D.ByteOrder);
+
+            Word = (_Word) ((Word & ~(_Word) (_Mask << _Shift)) | ((((uint32_t) value) & _Mask) << _Shift));
+            canPayloadPut<_Word>(&Data[_WindowStart], Word, D.ByteOrder);
+        }
+
+        /**
+         * @brief Extracts the physical Value of the Signal (Raw * Factor + Offset).
+         * @param Data Payload (8 Bytes)
+         * @return float Physical Value
+         */
+        static float decode(const uint8_t *Data)
+        {
+            return (float) unpack(Data) * D.Factor + D.Offset;
+        }
+
+        /**
+         * @brief Inserts the physical Value of the Signal (rounded to the next Raw-Value).
+         * @param Data Payload (8 Bytes)
+         * @param value Physical Value
+         */
+        static void encode(uint8_t *Data, float value)
+        {
+            float Raw = (value - D.Offset) / D.Factor;
+            pack(Data, (RawType) (Raw < 0 ? Raw - 0.5f : Raw + 0.5f));
+        }
+
+};
+
+#endif
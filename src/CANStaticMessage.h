@@ -0,0 +1,284 @@
+/**
+ * @file CANStaticMessage.h
+ * @author MH-Tobi
+ * @brief Message with ID, DLC, Frame, Direction and RTR as Template-Parameters, checked at Compile-Time.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANSTATICMESSAGE_H
+#define CANSTATICMESSAGE_H
+
+#include "CANPlatform.h"
+#include "CANDriver.h"
+#include "CANFrame.h"
+#include "CANPayload.h"
+#include "CANMessage.h"
+#include "CANBus.h"
+#include "CANCapture.h"
+
+
+/**
+ * @brief Compile-Time Checks and Constants (Key, Descriptor) shared by the Transmit- and the Receive-Message.
+ *
+ * Replaces the Checks of CANMessage::init(), an invalid Combination does not compile.
+ */
+template <uint32_t ID, uint8_t DLC, uint8_t Frame, uint8_t Direction, bool RTR>
+struct CANStaticMessageTraits
+{
+    static_assert(Frame == CANMESSAGE_FRAME_STANDARD || Frame == CANMESSAGE_FRAME_EXTENDED, "CANStaticMessage frame must be CANMESSAGE_FRAME_STANDARD or CANMESSAGE_FRAME_EXTENDED");
+    static_assert(Direction == CANMESSAGE_DIRECTION_RECEIVE || Direction == CANMESSAGE_DIRECTION_TRANSMIT, "CANStaticMessage direction must be CANMESSAGE_DIRECTION_RECEIVE or CANMESSAGE_DIRECTION_TRANSMIT");
+    static_assert(ID <= CANMESSAGE_DESCRIPTOR_ID_MASK, "CANStaticMessage ID is above 29 bit");
+    static_assert(Frame == CANMESSAGE_FRAME_EXTENDED || ID <= 0x7FF, "CANStaticMessage ID of a standard frame is above 11 bit");
+    static_assert(!RTR || Direction == CANMESSAGE_DIRECTION_TRANSMIT, "CANStaticMessage RTR is only allowed for transmit messages");
+    static_assert(DLC <= 8, "CANStaticMessage DLC must be 0 - 8");
+
+    static const uint32_t Key = ID | (Frame == CANMESSAGE_FRAME_EXTENDED ? CANMESSAGE_DESCRIPTOR_EXTENDED : 0);    // Same as CANMessage::makeKey()
+    static const uint32_t Descriptor = Key | (RTR ? CANMESSAGE_DESCRIPTOR_RTR : 0) | (Direction == CANMESSAGE_DIRECTION_TRANSMIT ? CANMESSAGE_DESCRIPTOR_TRANSMIT : 0);
+};
+
+
+/**
+ * @brief Compile-Time defined Message, only the Methods of its Direction exist.
+ *
+ * There is no init() and no Runtime-Check of the Properties, each Method calls the Driver directly.
+ * Offsets of typed Values are Template-Parameters too, so they are checked against the DLC at Compile-Time.
+ *
+ *  CANStaticMessage<0x123, 8, CANMESSAGE_FRAME_STANDARD, CANMESSAGE_DIRECTION_TRANSMIT> Message(Controller);
+ *
+ * @tparam ID Message-ID (11 bit for Standard-Frames, 29 bit for Extended-Frames)
+ * @tparam DLC Datalength (0 - 8)
+ * @tparam Frame CANMESSAGE_FRAME_STANDARD or CANMESSAGE_FRAME_EXTENDED
+ * @tparam Direction CANMESSAGE_DIRECTION_RECEIVE or CANMESSAGE_DIRECTION_TRANSMIT
+ * @tparam RTR Remote-Transmission-Request (Transmit only)
+ */
+template <uint32_t ID, uint8_t DLC, uint8_t Frame, uint8_t Direction, bool RTR = false>
+class CANStaticMessage
+{
+    // Only used for an invalid Direction, the valid ones are specialised below
+    static_assert(Direction == CANMESSAGE_DIRECTION_RECEIVE || Direction == CANMESSAGE_DIRECTION_TRANSMIT, "CANStaticMessage direction must be CANMESSAGE_DIRECTION_RECEIVE or CANMESSAGE_DIRECTION_TRANSMIT");
+};
+
+
+/**
+ * @brief Transmit-Message, the Data-Buffer is sent as it is (no Fill-State).
+ */
+template <uint32_t ID, uint8_t DLC, uint8_t Frame, bool RTR>
+class CANStaticMessage<ID, DLC, Frame, CANMESSAGE_DIRECTION_TRANSMIT, RTR> : public CANStaticMessageTraits<ID, DLC, Frame, CANMESSAGE_DIRECTION_TRANSMIT, RTR>
+{
+	private:
+        CANController &_Controller;
+        uint8_t _DataByte[DLC > 0 ? DLC : 1];
+
+	public:
+
+        /**
+         * @param controller Controller of the CANDriver (shared by Reference, it has to exist as long as the Message)
+         */
+        explicit CANStaticMessage(CANController &controller) : _Controller(controller)
+        {
+            memset(_DataByte, 0, sizeof(_DataByte));
+        }
+
+        /**
+         * @brief Writes one Byte of the Payload.
+         * @tparam Index Number of the Byte (0 - DLC-1)
+         */
+        template <uint8_t Index>
+        void setByte(uint8_t value)
+        {
+            static_assert(Index < DLC, "CANStaticMessage byte index is outside the DLC");
+
+            _DataByte[Index] = value;
+        }
+
+        /**
+         * @brief Writes a Value to the Payload.
+         * @tparam Offset Number of the first Byte
+         * @tparam T Type of the Value (1, 2, 4 or 8 Bytes)
+         * @param byteOrder CANMESSAGE_BYTEORDER_MOTOROLA (default) or CANMESSAGE_BYTEORDER_INTEL
+         */
+        template <uint8_t Offset, typename T>
+        void put(T value, uint8_t byteOrder = CANMESSAGE_BYTEORDER_MOTOROLA)
+        {
+            static_assert(Offset + sizeof(T) <= DLC, "CANStaticMessage value is outside the DLC");
+
+            canPayloadPut<T>(&_DataByte[Offset], value, byteOrder);
+        }
+
+        /**
+         * @brief Copies the complete Payload (DLC Bytes).
+         */
+        void setPayload(const uint8_t *Data)
+        {
+            memcpy(_DataByte, Data, DLC);
+        }
+
+        /**
+         * @brief Direct Access to the Payload (DLC Bytes).
+         */
+        uint8_t *data()
+        {
+            return _DataByte;
+        }
+
+        /**
+         * @brief Loads the Payload into a free Transmit-Buffer and requests the Transmission.
+         * @return true when success, false when no Transmit-Buffer is free or the Driver failed (Check CANDriver::getLastError())
+         */
+        bool send()
+        {
+            uint8_t Buffer = CANDriver::findFreeTransmitBuffer(_Controller);
+
+            if (Buffer >= 0xE0
+                || !CANDriver::fillTransmitBuffer(_Controller, Buffer, ID, Frame, RTR, DLC, _DataByte)
+                || !CANDriver::sendTransmitBuffer(_Controller, Buffer, 0))
+            {
+                return false;
+            }
+
+            CANCAPTURE_RECORD(this->Descriptor, DLC, _DataByte);
+            return true;
+        }
+
+        /**
+         * @brief Adds the Frame to the Transmit-Queue of a Bus.
+         * @return true when success, false when the Queue is full (Check bus.getLastCanError())
+         */
+        bool send(CANBus &bus)
+        {
+            CANFrame Queued;
+
+            Queued.ID = ID;
+            Queued.Frame = Frame;
+            Queued.RTR = RTR;
+            Queued.DLC = DLC;
+            memcpy(Queued.Data, _DataByte, DLC);
+
+            return bus.enqueue(Queued);
+        }
+
+        /**
+         * @brief Check if a Remote-Transmission-Request for the Message was received.
+         */
+        bool checkForRTR()
+        {
+            return CANDriver::checkRtr(_Controller, ID, Frame);
+        }
+
+};
+
+
+/**
+ * @brief Receive-Message with a single local Buffer.
+ */
+template <uint32_t ID, uint8_t DLC, uint8_t Frame, bool RTR>
+class CANStaticMessage<ID, DLC, Frame, CANMESSAGE_DIRECTION_RECEIVE, RTR> : public CANStaticMessageTraits<ID, DLC, Frame, CANMESSAGE_DIRECTION_RECEIVE, RTR>
+{
+	private:
+        CANController &_Controller;
+        uint8_t _DataByte[DLC > 0 ? DLC : 1];
+        volatile bool _Available;           // Set by the Interrupt-Routine, cleared by the loop()
+
+	public:
+
+        /**
+         * @param controller Controller of the CANDriver (shared by Reference, it has to exist as long as the Message)
+         */
+        explicit CANStaticMessage(CANController &controller) : _Controller(controller), _Available(false)
+        {
+            memset(_DataByte, 0, sizeof(_DataByte));
+        }
+
+        /**
+         * @brief Takes the Frame of the Message from the Receive-Buffers of the Controller.
+         * @return true when a Frame was taken, false when the previous Data is not released yet or no Frame was received
+         */
+        bool checkReceive()
+        {
+            if (_Available || !CANDriver::receive(_Controller, ID, Frame, DLC, _DataByte))
+            {
+                return false;
+            }
+
+            CANCAPTURE_RECORD(this->Descriptor, DLC, _DataByte);
+            _Available = true;
+            return true;
+        }
+
+        /**
+         * @brief Takes an already received Frame (e.g. from the own Dispatcher), the Caller has matched the Key.
+         *
+         * A Frame shorter than the DLC is rejected, else get() would return Bytes of the previous Frame.
+         * @return true when success, false when the previous Data is not released yet or the Frame is shorter than the DLC
+         */
+        bool deliver(const CANFrame &frame)
+        {
+            if (_Available || frame.DLC < DLC)
+            {
+                return false;
+            }
+
+            memcpy(_DataByte, frame.Data, DLC);
+            _Available = true;
+            return true;
+        }
+
+        bool dataAvailable()
+        {
+            return _Available;
+        }
+
+        /**
+         * @brief Reads one Byte of the received Data without releasing it.
+         * @tparam Index Number of the Byte (0 - DLC-1)
+         */
+        template <uint8_t Index>
+        uint8_t getByte()
+        {
+            static_assert(Index < DLC, "CANStaticMessage byte index is outside the DLC");
+
+            return _DataByte[Index];
+        }
+
+        /**
+         * @brief Reads a Value from the received Data without releasing it.
+         * @tparam Offset Number of the first Byte
+         * @tparam T Type of the Value (1, 2, 4 or 8 Bytes)
+         * @param byteOrder CANMESSAGE_BYTEORDER_MOTOROLA (default) or CANMESSAGE_BYTEORDER_INTEL
+         */
+        template <uint8_t Offset, typename T>
+        T get(uint8_t byteOrder = CANMESSAGE_BYTEORDER_MOTOROLA)
+        {
+            static_assert(Offset + sizeof(T) <= DLC, "CANStaticMessage value is outside the DLC");
+
+            return canPayloadGet<T>(&_DataByte[Offset], byteOrder);
+        }
+
+        /**
+         * @brief Copies the received Data (DLC Bytes) and releases it.
+         * @return true when Data was available
+         */
+        bool getPayload(uint8_t *Data)
+        {
+            if (!_Available)
+            {
+                return false;
+            }
+
+            memcpy(Data, _DataByte, DLC);
+            _Available = false;
+            return true;
+        }
+
+        void releaseData()
+        {
+            _Available = false;
+        }
+
+};
+
+#endif
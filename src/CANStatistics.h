@@ -0,0 +1,69 @@
+/**
+ * @file CANStatistics.h
+ * @author MH-Tobi
+ * @brief Optional Runtime-Counters of the Messages and the Bus.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANSTATISTICS_H
+#define CANSTATISTICS_H
+
+#include <stdint.h>
+
+
+// Define CANMESSAGE_STATISTICS as 1 with a Build-Flag (e.g. build_flags = -DCANMESSAGE_STATISTICS=1), so all Files of the Library see the same Value.
+// When disabled the Counters use no Memory and no Code, getStatistics() returns false.
+#ifndef CANMESSAGE_STATISTICS
+#define CANMESSAGE_STATISTICS           0
+#endif
+
+#define CANSTATISTICS_MAX               0xFFFF  // Counters stop at this Value
+
+#if CANMESSAGE_STATISTICS
+#define CANSTATISTICS_COUNT(counter)    do { if ((counter) != CANSTATISTICS_MAX) { (counter)++; } } while (0)
+#define CANSTATISTICS_SET(target, value) do { (target) = (value); } while (0)
+#else
+#define CANSTATISTICS_COUNT(counter)    do { } while (0)
+#define CANSTATISTICS_SET(target, value) do { } while (0)
+#endif
+
+
+/**
+ * @brief Counters of a Message (saturating at CANSTATISTICS_MAX).
+ */
+struct CANMessageStatistics
+{
+    uint16_t Received;              // Frames taken by the Message
+    uint16_t Sent;                  // Frames handed to the Controller or the Transmit-Queue
+    uint16_t Overruns;              // Received Frames lost (Data still in Buffer, Receive-FIFO full)
+    uint16_t DataInBuffer;          // ERROR_CAN_RECEIVED_DATA_IN_BUFFER
+    uint16_t ShortFrames;           // ERROR_CAN_RECEIVED_FRAME_TOO_SHORT
+    uint16_t TxBufferFull;          // ERROR_CAN_NO_FREE_TRANSMIT_BUFFER or ERROR_CAN_BUS_TX_QUEUE_FULL
+    uint16_t FillFailures;          // ERROR_CAN_FILLING_TRANSMIT_BUFFER
+    uint16_t SendErrors;            // ERROR_CAN_MESSAGE_NOT_SEND
+    uint16_t LastControllerError;   // Last Error reported by the Controller
+};
+
+
+/**
+ * @brief Counters of a Bus (the uint32_t Counters are always active, the others saturate at CANSTATISTICS_MAX).
+ */
+struct CANBusStatistics
+{
+    uint32_t SpiTransactions;
+    uint32_t ReceivedFrames;
+    uint32_t UnmatchedFrames;
+    uint32_t RejectedFrames;
+    uint32_t TransmittedFrames;
+    uint16_t TxQueueFull;           // enqueue() with full Transmit-Queue
+    uint16_t TxAborts;              // Transmissions aborted for a Frame with higher Priority
+    uint16_t FillFailures;          // Filling a Transmit-Buffer failed
+    uint16_t SendErrors;            // Requesting a Transmission failed
+    uint16_t LastControllerError;   // Last Error reported by the Controller
+};
+
+#endif
@@ -0,0 +1,420 @@
+#include "CANSupervisor.h"
+
+static_assert((CANSUPERVISOR_WHEEL_SIZE & (CANSUPERVISOR_WHEEL_SIZE - 1)) == 0 && CANSUPERVISOR_WHEEL_SIZE <= 256, "CANSUPERVISOR_WHEEL_SIZE must be a power of 2 up to 256");
+static_assert(CANBUS_MAX_MESSAGES < CANSUPERVISOR_END, "CANBUS_MAX_MESSAGES must be below 255 for the CANSupervisor");
+
+
+/**
+ * @brief Constructor
+ */
+CANSupervisor::CANSupervisor()
+{
+    _Bus = NULL;
+    _Position = 0;
+    _WheelTime = 0;
+    _Now = 0;
+    _isStarted = false;
+    _Callback = NULL;
+    _Timeouts = 0;
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    for (uint8_t i = 0; i < CANBUS_MAX_MESSAGES; i++)
+    {
+        _Entries[i].LastRx = 0;
+        _Entries[i].Timeout = 0;
+        _Entries[i].MaxInterval = 0;
+        _Entries[i].Timeouts = 0;
+        _Entries[i].TimedOut = false;
+        _Entries[i].Next = CANSUPERVISOR_END;
+    }
+
+    for (uint16_t i = 0; i < CANSUPERVISOR_WHEEL_SIZE; i++)
+    {
+        _Slots[i] = CANSUPERVISOR_END;
+    }
+}
+
+/**
+ * @brief Returns the last occurred Error.
+ * @return Error-Code (see CANMessageError.h)
+ */
+uint16_t CANSupervisor::getLastCanError()
+{
+    return _lastCanError;
+}
+
+/**
+ * @brief Links the Supervisor with a Bus, afterwards dispatch() reports each received Frame.
+ * @param bus Initialised Bus
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANSupervisor::init(CANBus &bus)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    _Bus = &bus;
+    _Bus->attachSupervisor(this);
+
+    return true;
+}
+
+/**
+ * @brief Supervises a registered Reception-Message.
+ *
+ * Calling it again for the same Message changes the Timeout.
+ * @param message Reception-Message registered at the Bus
+ * @param cycleTime Expected Time between two Frames in ms
+ * @param timeout Time without Frame until the Message is timed out in ms (0 = CANSUPERVISOR_TIMEOUT_CYCLES * cycleTime)
+ * @return true when success, false when not (Check getLastCanError() for further Information)
+ */
+bool CANSupervisor::watch(CANMessage &message, uint16_t cycleTime, uint16_t timeout)
+{
+    _lastCanError = EMPTY_VALUE_16_BIT;
+
+    if (_Bus == NULL)
+    {
+        _lastCanError = ERROR_CAN_NOT_INITIALIZED;
+        return false;
+    }
+
+    int16_t Index = _Bus->getMessageIndex(message);
+
+    if (Index < 0)
+    {
+        _lastCanError = ERROR_CAN_SUPERVISOR_NOT_REGISTERED;
+        return false;
+    }
+
+    if (timeout == 0)
+    {
+        uint32_t Default = (uint32_t) cycleTime * CANSUPERVISOR_TIMEOUT_CYCLES;
+
+        timeout = Default > 0xFFFF ? 0xFFFF : (uint16_t) Default;
+    }
+
+    if (timeout == 0)
+    {
+        _lastCanError = ERROR_CAN_VALUE_OUTA_RANGE;
+        return false;
+    }
+
+    Entry &Current = _Entries[Index];
+    bool isNew = Current.Timeout == 0;
+
+    // An Entry in the Wheel takes the new Timeout at its next Visit
+    Current.Timeout = timeout;
+
+    if (isNew && _isStarted)
+    {
+        CANMESSAGE_LOCK();
+        Current.LastRx = _Now;
+        Current.TimedOut = false;
+        CANMESSAGE_UNLOCK();
+
+        _insert((uint8_t) Index, _Now + timeout);
+    }
+    return true;
+}
+
+/**
+ * @brief Sets the Function they is called when a Message times out.
+ * @param callback Callback, NULL for none
+ */
+void CANSupervisor::setCallback(CANSupervisorCallback callback)
+{
+    _Callback = callback;
+}
+
+/**
+ * @brief Starts the Supervision, the Timeouts of all Messages start now.
+ *
+ * Without start() the first tick() starts the Supervisor.
+ */
+void CANSupervisor::start()
+{
+    start((uint32_t) millis());
+}
+
+/**
+ * @brief Starts the Supervision, the Timeouts of all Messages start now.
+ * @param now Current Time in ms
+ */
+void CANSupervisor::start(uint32_t now)
+{
+    CANMESSAGE_LOCK();
+    _Now = now;
+    CANMESSAGE_UNLOCK();
+
+    _WheelTime = now;
+    _Position = 0;
+    _isStarted = true;
+
+    for (uint16_t i = 0; i < CANSUPERVISOR_WHEEL_SIZE; i++)
+    {
+        _Slots[i] = CANSUPERVISOR_END;
+    }
+
+    for (uint8_t i = 0; i < CANBUS_MAX_MESSAGES; i++)
+    {
+        if (_Entries[i].Timeout == 0)
+        {
+            continue;
+        }
+
+        CANMESSAGE_LOCK();
+        _Entries[i].LastRx = now;
+        _Entries[i].TimedOut = false;
+        CANMESSAGE_UNLOCK();
+
+        _insert(i, now + _Entries[i].Timeout);
+    }
+}
+
+/**
+ * @brief Checks the Deadlines passed since the last tick().
+ *
+ * Call it in the loop(), the Callback is called from here.
+ * @return Number of Messages they timed out in this tick()
+ */
+uint8_t CANSupervisor::tick()
+{
+    return tick((uint32_t) millis());
+}
+
+/**
+ * @brief Checks the Deadlines passed since the last tick().
+ * @param now Current Time in ms
+ * @return Number of Messages they timed out in this tick()
+ */
+uint8_t CANSupervisor::tick(uint32_t now)
+{
+    if (!_isStarted)
+    {
+        start(now);
+    }
+
+    CANMESSAGE_LOCK();
+    _Now = now;
+    CANMESSAGE_UNLOCK();
+
+    if ((int32_t) (now - _WheelTime) < 0)
+    {
+        return 0;
+    }
+
+    uint32_t Steps = (now - _WheelTime) / CANSUPERVISOR_RESOLUTION;
+
+    // After a long Pause one Revolution visits each Entry, they are checked against the current Time anyway
+    if (Steps > CANSUPERVISOR_WHEEL_SIZE)
+    {
+        uint32_t Skip = Steps - CANSUPERVISOR_WHEEL_SIZE;
+
+        _WheelTime += Skip * CANSUPERVISOR_RESOLUTION;
+        _Position = (uint8_t) ((_Position + Skip) & (CANSUPERVISOR_WHEEL_SIZE - 1));
+        Steps = CANSUPERVISOR_WHEEL_SIZE;
+    }
+
+    uint8_t Expired = 0;
+
+    for (uint32_t i = 0; i < Steps; i++)
+    {
+        _WheelTime += CANSUPERVISOR_RESOLUTION;
+        _Position = (uint8_t) ((_Position + 1) & (CANSUPERVISOR_WHEEL_SIZE - 1));
+        Expired += _processSlot();
+    }
+    return Expired;
+}
+
+/**
+ * @brief Stores the Time of a received Frame (Time of the last tick()), called by dispatch().
+ * @param index Index of the Message at the Bus
+ */
+void CANSupervisor::received(uint8_t index)
+{
+    if (index >= CANBUS_MAX_MESSAGES || _Entries[index].Timeout == 0)
+    {
+        return;
+    }
+
+    Entry &Current = _Entries[index];
+    uint32_t Now = _Now;
+    uint32_t Interval = Now - Current.LastRx;
+
+    if (Interval > Current.MaxInterval)
+    {
+        Current.MaxInterval = Interval > 0xFFFF ? 0xFFFF : (uint16_t) Interval;
+    }
+
+    Current.LastRx = Now;
+    Current.TimedOut = false;
+}
+
+/**
+ * @brief Returns if the Message is timed out (no Frame within the Timeout, reset by the next Frame).
+ * @param message Supervised Message
+ */
+bool CANSupervisor::isTimedOut(CANMessage &message)
+{
+    int16_t Index = _index(message);
+
+    return Index >= 0 && _Entries[Index].TimedOut;
+}
+
+/**
+ * @brief Returns the Time since the last Frame of the Message.
+ * @param message Supervised Message
+ * @return Age in ms (Resolution of the tick() Calls), 0 when the Message is not supervised
+ */
+uint32_t CANSupervisor::getAge(CANMessage &message)
+{
+    int16_t Index = _index(message);
+
+    if (Index < 0)
+    {
+        return 0;
+    }
+
+    CANMESSAGE_LOCK();
+    uint32_t LastRx = _Entries[Index].LastRx;
+    CANMESSAGE_UNLOCK();
+
+    return _Now - LastRx;
+}
+
+/**
+ * @brief Returns the longest Time between two Frames of the Message.
+ * @param message Supervised Message
+ * @return Interval in ms
+ */
+uint16_t CANSupervisor::getMaxInterval(CANMessage &message)
+{
+    int16_t Index = _index(message);
+
+    return Index < 0 ? 0 : _Entries[Index].MaxInterval;
+}
+
+/**
+ * @brief Returns how often the Message timed out.
+ * @param message Supervised Message
+ */
+uint16_t CANSupervisor::getTimeouts(CANMessage &message)
+{
+    int16_t Index = _index(message);
+
+    return Index < 0 ? 0 : _Entries[Index].Timeouts;
+}
+
+/**
+ * @brief Returns how often any Message timed out.
+ */
+uint16_t CANSupervisor::getTimeouts()
+{
+    return _Timeouts;
+}
+
+/**
+ * @brief Resets Timeouts and max. Intervals of all Messages.
+ */
+void CANSupervisor::resetStatistics()
+{
+    _Timeouts = 0;
+
+    for (uint8_t i = 0; i < CANBUS_MAX_MESSAGES; i++)
+    {
+        _Entries[i].Timeouts = 0;
+        _Entries[i].MaxInterval = 0;
+    }
+}
+
+/**
+ * @brief Adds an Entry to the Slot of the Deadline (at least the next Slot).
+ *
+ * Deadlines beyond one Revolution are visited earlier and inserted again.
+ */
+void CANSupervisor::_insert(uint8_t index, uint32_t deadline)
+{
+    int32_t Delta = (int32_t) (deadline - _WheelTime);
+    uint32_t Steps = Delta <= 0 ? 1 : ((uint32_t) Delta + CANSUPERVISOR_RESOLUTION - 1) / CANSUPERVISOR_RESOLUTION;
+
+    if (Steps >= CANSUPERVISOR_WHEEL_SIZE)
+    {
+        Steps = CANSUPERVISOR_WHEEL_SIZE - 1;
+    }
+
+    uint8_t Slot = (uint8_t) ((_Position + Steps) & (CANSUPERVISOR_WHEEL_SIZE - 1));
+
+    _Entries[index].Next = _Slots[Slot];
+    _Slots[Slot] = index;
+}
+
+/**
+ * @brief Checks all Entries of the current Slot and inserts them at their next Deadline.
+ * @return Number of Messages they timed out
+ */
+uint8_t CANSupervisor::_processSlot()
+{
+    uint8_t Index = _Slots[_Position];
+    uint8_t Expired = 0;
+
+    _Slots[_Position] = CANSUPERVISOR_END;
+
+    while (Index != CANSUPERVISOR_END)
+    {
+        Entry &Current = _Entries[Index];
+        uint8_t Next = Current.Next;
+        bool isExpired = false;
+
+        // A Frame between Check and Flag would be lost
+        CANMESSAGE_LOCK();
+        uint32_t Deadline = Current.LastRx + Current.Timeout;
+
+        if ((int32_t) (_WheelTime - Deadline) >= 0)
+        {
+            isExpired = !Current.TimedOut;
+            Current.TimedOut = true;
+            Deadline = _WheelTime + Current.Timeout;
+        }
+        CANMESSAGE_UNLOCK();
+
+        _insert(Index, Deadline);
+
+        if (isExpired)
+        {
+            Expired++;
+
+            if (Current.Timeouts != 0xFFFF)
+            {
+                Current.Timeouts++;
+            }
+
+            if (_Timeouts != 0xFFFF)
+            {
+                _Timeouts++;
+            }
+
+            if (_Callback != NULL)
+            {
+                _Callback(*_Bus->getMessage(Index));
+            }
+        }
+
+        Index = Next;
+    }
+    return Expired;
+}
+
+int16_t CANSupervisor::_index(CANMessage &message)
+{
+    if (_Bus == NULL)
+    {
+        return -1;
+    }
+
+    int16_t Index = _Bus->getMessageIndex(message);
+
+    if (Index < 0 || _Entries[Index].Timeout == 0)
+    {
+        return -1;
+    }
+    return Index;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file CANSupervisor.h
+ * @author MH-Tobi
+ * @brief Receive-Timeouts of the Messages registered at a CANBus.
+ * @version 0.0.1
+ * @date 2024-07-20
+ *
+ * @copyright -
+ *
+ */
+
+#ifndef CANSUPERVISOR_H
+#define CANSUPERVISOR_H
+
+#include "CANPlatform.h"
+#include "CANMessage.h"
+#include "CANBus.h"
+#include "CANMessageError.h"
+
+
+#ifndef CANSUPERVISOR_WHEEL_SIZE
+#define CANSUPERVISOR_WHEEL_SIZE        32      // Slots of the Timer-Wheel (power of 2)
+#endif
+
+#ifndef CANSUPERVISOR_RESOLUTION
+#define CANSUPERVISOR_RESOLUTION        10      // ms per Slot, Timeouts are detected with this Resolution
+#endif
+
+#define CANSUPERVISOR_TIMEOUT_CYCLES    3       // Default Timeout in Cycle-Times
+#define CANSUPERVISOR_END               0xFF    // End of the Entry-List of a Slot
+
+
+/**
+ * @brief Called by tick() when a Message is not received within its Timeout.
+ */
+typedef void (*CANSupervisorCallback)(CANMessage &message);
+
+
+/**
+ * @brief Detects Reception-Messages they are not received within their Timeout.
+ *
+ * The Deadlines are kept in a hashed Timer-Wheel, each tick() only visits the Slots passed since the last tick().
+ * dispatch() of the Bus only stores the Time of the Frame (lazy Rearm), the Entry is moved to its new Slot
+ * when its old Deadline is reached. So each supervised Message costs at most one Visit per Timeout,
+ * independent of the Number of Messages and Frames.
+ */
+class CANSupervisor
+{
+	private:
+        struct Entry
+        {
+            volatile uint32_t LastRx;       // Time of the last Frame (Time of the last tick() before the Frame)
+            uint16_t Timeout;               // 0 = not supervised
+            volatile uint16_t MaxInterval;  // Longest Time between two Frames
+            uint16_t Timeouts;
+            volatile bool TimedOut;
+            uint8_t Next;                   // Next Entry in the same Slot
+        };
+
+        CANBus *_Bus;
+        Entry _Entries[CANBUS_MAX_MESSAGES];        // Same Index as the Message at the Bus
+        uint8_t _Slots[CANSUPERVISOR_WHEEL_SIZE];   // First Entry of each Slot
+        uint8_t _Position;                          // Slot of _WheelTime
+        uint32_t _WheelTime;                        // Time of the last visited Slot
+        volatile uint32_t _Now;                     // Time of the last tick()
+        bool _isStarted;
+        CANSupervisorCallback _Callback;
+        uint16_t _Timeouts;
+        uint16_t _lastCanError;
+
+        void _insert(uint8_t index, uint32_t deadline);
+        uint8_t _processSlot();
+        int16_t _index(CANMessage &message);
+
+	public:
+
+        CANSupervisor();
+
+        uint16_t getLastCanError();
+
+        bool init(CANBus &bus);
+        bool watch(CANMessage &message, uint16_t cycleTime, uint16_t timeout = 0);
+        void setCallback(CANSupervisorCallback callback);
+        void start();
+        void start(uint32_t now);
+        uint8_t tick();
+        uint8_t tick(uint32_t now);
+
+        // For the Interrupt-Routine (called by dispatch())
+
+        void received(uint8_t index);
+
+        bool isTimedOut(CANMessage &message);
+        uint32_t getAge(CANMessage &message);
+        uint16_t getMaxInterval(CANMessage &message);
+        uint16_t getTimeouts(CANMessage &message);
+        uint16_t getTimeouts();
+        void resetStatistics();
+
+};
+
+#endif